@@ -2,6 +2,8 @@
 
 #include "pochivm/ast_arithmetic_expr_type.h"
 #include "pochivm/ast_comparison_expr_type.h"
+#include "pochivm/ast_atomic_expr_type.h"
+#include "pochivm/ast_bit_intrinsic_expr_type.h"
 #include "pochivm/interp_control_signal.h"
 #include "fastinterp_tpl_opaque_params.h"
 #include "fastinterp_tpl_abi_distinct_type_helper.h"
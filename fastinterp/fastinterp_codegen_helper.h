@@ -107,6 +107,27 @@ public:
         m_log2CodeSectionAlignment = log2CodeSectionAlignment;
     }
 
+    // Mark this instance as the entry of a cold path (e.g. exception handling or trap).
+    // If the cold path layout is enabled (see FastInterpCodegenEngine::SetColdPathLayoutEnabled()),
+    // everything not reachable from a function entry point without going through a cold path entry
+    // is considered cold, and is placed after all hot code.
+    //
+    void MarkAsColdPathEntry()
+    {
+        m_isColdPathEntry = true;
+    }
+
+    int32_t TestOnly_GetRelativeCodeAddress() const
+    {
+        TestAssert(m_populatedRelativeCodeAddress);
+        return m_relativeCodeAddr;
+    }
+
+    bool TestOnly_IsHot() const
+    {
+        return m_isHot;
+    }
+
 private:
     FastInterpBoilerplateInstance(TempArenaAllocator& alloc,
                                   const FastInterpBoilerplateBluePrint* owner,
@@ -120,6 +141,8 @@ private:
         , m_isContinuationOfAnotherInstance(false)
         , m_populatedRelativeCodeAddress(false)
         , m_shouldStripLITC(false)
+        , m_isColdPathEntry(false)
+        , m_isHot(false)
 #ifdef TESTBUILD
         , m_populatedBoilerplateFnPtrPlaceholderMask(0)
         , m_populatedUInt64PlaceholderMask(0)
@@ -136,6 +159,16 @@ private:
         }
     }
 
+    uint32_t GetNumBoilerplateFnPtrPlaceholders() const
+    {
+        return m_owner->m_highestBoilerplateFnptrPlaceholderOrdinal;
+    }
+
+    int GetLastInstructionTailCallOrd() const
+    {
+        return m_owner->m_lastInstructionTailCallOrd;
+    }
+
     // Called after PlaceBoilerplate() phase which populates the m_relativeCodeAddr of every boilerplate function
     //
     void Materialize(uintptr_t baseAddress)
@@ -197,6 +230,15 @@ private:
     //
     bool m_shouldStripLITC;
 
+    // Whether this instance is marked as the entry of a cold path
+    //
+    bool m_isColdPathEntry;
+
+    // Whether this instance is reachable from a function entry point without going through a cold path entry.
+    // Populated by ComputeHotInstances()
+    //
+    bool m_isHot;
+
     // An array of length m_owner->m_highestBoilerplateFnptrPlaceholderOrdinal +
     // m_owner->m_highestUInt64PlaceholderOrdinal + m_owner->m_highestCppFnptrPlaceholderOrdinal
     //
@@ -212,6 +254,27 @@ private:
 
 class AstFunction;
 
+// Statistics of the peephole pass run by FastInterpCodegenEngine::Materialize()
+//
+struct FastInterpPeepholeStats
+{
+    FastInterpPeepholeStats()
+        : m_numInstancesRemoved(0)
+        , m_numBytesRemoved(0)
+        , m_numJumpsThreaded(0)
+    { }
+
+    // Number of boilerplate instances removed from the program
+    //
+    size_t m_numInstancesRemoved;
+    // Total code section length of the removed instances
+    //
+    size_t m_numBytesRemoved;
+    // Number of boilerplate fnptr placeholders retargeted to skip over a removed instance
+    //
+    size_t m_numJumpsThreaded;
+};
+
 // A owning generated program.
 // When this class is destructed, the program is gone.
 // So it is undefined behavior if this class is destructed while the program is still running.
@@ -253,6 +316,7 @@ class FastInterpCodegenEngine : NonCopyable, NonMovable
 {
 public:
     FastInterpCodegenEngine()
+        : m_coldPathLayoutEnabled(false)
     {
         Reset();
     }
@@ -264,6 +328,7 @@ public:
         m_boilerplateFnEntryPointPlaceholders.clear();
         m_fastInterpFnPtrFixList.clear();
         m_boilerplateAlloc.Reset();
+        m_peepholeStats = FastInterpPeepholeStats();
 #ifdef TESTBUILD
         m_materialized = false;
 #endif
@@ -314,14 +379,45 @@ public:
     //
     std::unique_ptr<FastInterpGeneratedProgram> WARN_UNUSED Materialize();
 
+    // If enabled, Materialize() places the code only reachable through a cold path entry
+    // (see FastInterpBoilerplateInstance::MarkAsColdPathEntry()) after all the hot code,
+    // for better i-cache and i-TLB locality of the hot code. Disabled by default.
+    //
+    void SetColdPathLayoutEnabled(bool value)
+    {
+        m_coldPathLayoutEnabled = value;
+    }
+
+    // Statistics of the peephole pass of the last Materialize() call
+    //
+    const FastInterpPeepholeStats& GetPeepholeStats() const
+    {
+        return m_peepholeStats;
+    }
+
 private:
     static void InvalidateInstructionCache(const void* addr, size_t len);
 
+    // Returns true if the instance does nothing but jumping to its placeholder 0
+    //
+    static bool IsNoopInstance(FastInterpBoilerplateInstance* inst);
+
+    // Remove noop instances, and thread every jump to a noop instance directly to its final destination.
+    // Must be called after all boilerplate fnptr placeholders are populated, and before code layout.
+    //
+    void RunPeepholePass();
+
+    // Populate m_isHot for all instances. If the cold path layout is disabled, every instance is hot.
+    //
+    void ComputeHotInstances();
+
     std::vector<std::pair<AstFunction*, FastInterpBoilerplateInstance*>> m_fastInterpFnPtrFixList;
     std::unordered_map<AstFunction*, std::pair<FastInterpBoilerplateInstance*, FastInterpBoilerplateInstance*> > m_functionEntryPoint;
     std::vector<FastInterpBoilerplateInstance*> m_allBoilerplateInstances;
     std::vector<std::pair<FastInterpBoilerplateInstance*, std::pair<AstFunction*, uint32_t>>> m_boilerplateFnEntryPointPlaceholders;
     TempArenaAllocator m_boilerplateAlloc;
+    FastInterpPeepholeStats m_peepholeStats;
+    bool m_coldPathLayoutEnabled;
 #ifdef TESTBUILD
     bool m_materialized;
 #endif
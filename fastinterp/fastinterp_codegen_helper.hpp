@@ -13,7 +13,7 @@ inline void FastInterpCodegenEngine::RegisterGeneratedFunctionEntryPoint(AstFunc
     FastInterpBoilerplateInstance* cdeclWrapper = InstantiateBoilerplate(
                 FastInterpBoilerplateLibrary<FICdeclInterfaceImpl>::SelectBoilerplateBluePrint(
                     fn->GetReturnType().GetDefaultFastInterpTypeId(),
-                    fn->GetIsNoExcept()));
+                    fn->GetIsNoExceptForCodegen()));
     cdeclWrapper->PopulateBoilerplateFnPtrPlaceholder(0, inst);
     m_functionEntryPoint[fn] = std::make_pair(inst, cdeclWrapper);
 }
@@ -30,6 +30,232 @@ inline void FastInterpCodegenEngine::TestOnly_RegisterUnitTestFunctionEntryPoint
     m_functionEntryPoint[fn] = std::make_pair(inst, cdeclWrapper);
 }
 
+inline bool FastInterpCodegenEngine::IsNoopInstance(FastInterpBoilerplateInstance* inst)
+{
+    return inst->m_owner == FastInterpBoilerplateLibrary<FINoopImpl>::SelectBoilerplateBluePrint(
+                FIOpaqueParamsHelper::GetMaxOIP(),
+                FIOpaqueParamsHelper::GetMaxOFP());
+}
+
+inline void FastInterpCodegenEngine::RunPeepholePass()
+{
+    m_peepholeStats = FastInterpPeepholeStats();
+    size_t n = m_allBoilerplateInstances.size();
+
+    // Step 1: for each noop instance, find the final destination of the jump chain starting from it.
+    // A chain consisting only of noops may form a cycle (an empty infinite loop),
+    // in which case we keep exactly one noop in the cycle, which becomes a jump to itself.
+    //
+    // state: 0 = not visited, 1 = on current chain, 2 = resolved
+    //
+    // A removed noop that is a cold path entry passes the mark on to its jump target, but only if that target
+    // is exclusively reached through the noop: a target shared with other (possibly hot) code must stay hot.
+    // So we count the references to each instance (function entry points are referenced by their cdecl wrapper,
+    // and calls by their callers, both already populated at this point).
+    //
+    std::vector<uint32_t> numReferences(n, 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        FastInterpBoilerplateInstance* inst = m_allBoilerplateInstances[i];
+        for (uint32_t k = 0; k < inst->GetNumBoilerplateFnPtrPlaceholders(); k++)
+        {
+            FastInterpBoilerplateInstance* target = reinterpret_cast<FastInterpBoilerplateInstance*>(inst->m_fixupValues[k]);
+            if (target != nullptr)
+            {
+                numReferences[target->m_ordinalInArray]++;
+            }
+        }
+    }
+
+    std::vector<uint8_t> state(n, 0);
+    std::vector<FastInterpBoilerplateInstance*> resolved(n, nullptr);
+    std::vector<FastInterpBoilerplateInstance*> chain;
+    for (size_t i = 0; i < n; i++)
+    {
+        FastInterpBoilerplateInstance* cur = m_allBoilerplateInstances[i];
+        if (!IsNoopInstance(cur) || state[i] == 2)
+        {
+            continue;
+        }
+        chain.clear();
+        FastInterpBoilerplateInstance* result;
+        // Whether 'result' is only reachable through the chain. Conservatively false if the chain
+        // joins a chain resolved earlier.
+        //
+        bool isResultExclusive;
+        while (true)
+        {
+            if (!IsNoopInstance(cur))
+            {
+                result = cur;
+                isResultExclusive = (numReferences[cur->m_ordinalInArray] == 1);
+                break;
+            }
+            uint32_t ord = cur->m_ordinalInArray;
+            if (state[ord] == 2)
+            {
+                result = resolved[ord];
+                isResultExclusive = false;
+                break;
+            }
+            if (state[ord] == 1 || cur->m_fixupValues[0] == 0)
+            {
+                result = cur;
+                isResultExclusive = false;
+                break;
+            }
+            state[ord] = 1;
+            chain.push_back(cur);
+            cur = reinterpret_cast<FastInterpBoilerplateInstance*>(cur->m_fixupValues[0]);
+        }
+        // Process the chain backwards, so we know whether everything after the current noop
+        // (up to 'result') is only reachable through it
+        //
+        for (size_t k = chain.size(); k-- > 0;)
+        {
+            FastInterpBoilerplateInstance* inst = chain[k];
+            state[inst->m_ordinalInArray] = 2;
+            resolved[inst->m_ordinalInArray] = result;
+            // If the removed noop requested an alignment (e.g. a loop head), transfer it to the jump target
+            //
+            if (inst != result && inst->m_log2CodeSectionAlignment > result->m_log2CodeSectionAlignment)
+            {
+                result->SetAlignmentLog2(inst->m_log2CodeSectionAlignment);
+            }
+            // Similarly, if the removed noop is the entry of a cold path, its jump target becomes the entry,
+            // unless the target is shared with other code
+            //
+            if (inst != result && inst->m_isColdPathEntry && isResultExclusive)
+            {
+                result->MarkAsColdPathEntry();
+            }
+            isResultExclusive = isResultExclusive && (numReferences[inst->m_ordinalInArray] == 1);
+        }
+    }
+
+    auto isRemoved = [&](FastInterpBoilerplateInstance* inst) -> bool
+    {
+        return state[inst->m_ordinalInArray] == 2 && resolved[inst->m_ordinalInArray] != inst;
+    };
+
+    auto resolve = [&](FastInterpBoilerplateInstance* inst) -> FastInterpBoilerplateInstance*
+    {
+        if (state[inst->m_ordinalInArray] == 2)
+        {
+            return resolved[inst->m_ordinalInArray];
+        }
+        return inst;
+    };
+
+    // Step 2: retarget all jumps and function entry points to skip the removed instances
+    //
+    for (size_t i = 0; i < n; i++)
+    {
+        FastInterpBoilerplateInstance* inst = m_allBoilerplateInstances[i];
+        if (isRemoved(inst))
+        {
+            continue;
+        }
+        for (uint32_t k = 0; k < inst->GetNumBoilerplateFnPtrPlaceholders(); k++)
+        {
+            FastInterpBoilerplateInstance* target = reinterpret_cast<FastInterpBoilerplateInstance*>(inst->m_fixupValues[k]);
+            if (target != nullptr)
+            {
+                FastInterpBoilerplateInstance* newTarget = resolve(target);
+                if (newTarget != target)
+                {
+                    inst->m_fixupValues[k] = reinterpret_cast<uint64_t>(newTarget);
+                    m_peepholeStats.m_numJumpsThreaded++;
+                }
+            }
+        }
+    }
+
+    for (auto it = m_functionEntryPoint.begin(); it != m_functionEntryPoint.end(); it++)
+    {
+        it->second.first = resolve(it->second.first);
+    }
+
+    // Step 3: compact the instance array, and recompute the LITC relationship, since both the ordinals
+    // and the tail call targets may have changed.
+    //
+    std::vector<FastInterpBoilerplateInstance*> newList;
+    newList.reserve(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        FastInterpBoilerplateInstance* inst = m_allBoilerplateInstances[i];
+        if (isRemoved(inst))
+        {
+            m_peepholeStats.m_numInstancesRemoved++;
+            m_peepholeStats.m_numBytesRemoved += inst->m_owner->GetCodeSectionLength();
+            continue;
+        }
+        inst->m_ordinalInArray = static_cast<uint32_t>(newList.size());
+        inst->m_litcInstanceOrd = static_cast<uint32_t>(-1);
+        inst->m_isContinuationOfAnotherInstance = false;
+        newList.push_back(inst);
+    }
+
+    for (FastInterpBoilerplateInstance* inst : newList)
+    {
+        int litcOrd = inst->GetLastInstructionTailCallOrd();
+        if (litcOrd != -1)
+        {
+            FastInterpBoilerplateInstance* target = reinterpret_cast<FastInterpBoilerplateInstance*>(
+                        inst->m_fixupValues[static_cast<uint32_t>(litcOrd)]);
+            if (target != nullptr)
+            {
+                TestAssert(!isRemoved(target));
+                inst->m_litcInstanceOrd = target->m_ordinalInArray;
+                target->m_isContinuationOfAnotherInstance = true;
+            }
+        }
+    }
+
+    m_allBoilerplateInstances = std::move(newList);
+}
+
+inline void FastInterpCodegenEngine::ComputeHotInstances()
+{
+    // Hot instances are those reachable from a function entry point without going through a cold path entry.
+    //
+    std::vector<FastInterpBoilerplateInstance*> worklist;
+    auto push = [&](FastInterpBoilerplateInstance* inst)
+    {
+        if (!inst->m_isHot && !inst->m_isColdPathEntry)
+        {
+            inst->m_isHot = true;
+            worklist.push_back(inst);
+        }
+    };
+
+    for (FastInterpBoilerplateInstance* inst : m_allBoilerplateInstances)
+    {
+        inst->m_isHot = !m_coldPathLayoutEnabled;
+    }
+    if (!m_coldPathLayoutEnabled)
+    {
+        return;
+    }
+    for (auto it = m_functionEntryPoint.begin(); it != m_functionEntryPoint.end(); it++)
+    {
+        push(it->second.second);
+    }
+    while (!worklist.empty())
+    {
+        FastInterpBoilerplateInstance* inst = worklist.back();
+        worklist.pop_back();
+        for (uint32_t k = 0; k < inst->GetNumBoilerplateFnPtrPlaceholders(); k++)
+        {
+            FastInterpBoilerplateInstance* target = reinterpret_cast<FastInterpBoilerplateInstance*>(inst->m_fixupValues[k]);
+            if (target != nullptr)
+            {
+                push(target);
+            }
+        }
+    }
+}
+
 inline std::unique_ptr<FastInterpGeneratedProgram> WARN_UNUSED FastInterpCodegenEngine::Materialize()
 {
     TestAssert(!m_materialized);
@@ -51,6 +277,10 @@ inline std::unique_ptr<FastInterpGeneratedProgram> WARN_UNUSED FastInterpCodegen
         inst->PopulateBoilerplateFnPtrPlaceholder(ord, target);
     }
 
+    // Phase 1.5: now that all jump targets are known, run the peephole pass.
+    //
+    RunPeepholePass();
+
     // Phase 2: place all code sections. Code section grows up from base address.
     //
     // The complication is that we want to eliminate tail calls as much as possible.
@@ -61,60 +291,80 @@ inline std::unique_ptr<FastInterpGeneratedProgram> WARN_UNUSED FastInterpCodegen
     // It is easy to prove that the following greedy algorithm produces an optimal ordering:
     // Repeat: pick a node with no inbound-degree, chase its outlink until we reach an end or a visited node.
     //
+    // Additionally, we want the hot code to be packed together for better i-cache and i-TLB locality,
+    // so we first place all hot instances (without chasing into cold instances), then all the cold instances.
+    // This gives up a few fallthroughs from hot code into cold code, which are rarely executed anyway.
+    //
+    ComputeHotInstances();
+
     int32_t codeSectionLength = 0;
     size_t numInstantiated = 0;
-    for (int pass = 0; pass < 2; pass++)
+    for (int tier = 0; tier < 2; tier++)
     {
-        for (size_t i = 0; i < m_allBoilerplateInstances.size(); i++)
+        bool isHotTier = (tier == 0);
+        for (int pass = 0; pass < 2; pass++)
         {
-            FastInterpBoilerplateInstance* instance = m_allBoilerplateInstances[i];
-
-            // In pass 1, only start with node with no inbound-degree.
-            // After pass 1, the remaining are loops.
-            //
-            if (instance->m_populatedRelativeCodeAddress || (pass == 0 && instance->m_isContinuationOfAnotherInstance))
+            for (size_t i = 0; i < m_allBoilerplateInstances.size(); i++)
             {
-                continue;
-            }
-            // Align the beginning of a code sequence to 16 bytes, it helps with CPU pipelining.
-            // There is no cost in this case: since this is the beginning of a code sequence,
-            // the inserted nops are never executed.
-            //
-            instance->SetAlignmentLog2(4);
-            while (true)
-            {
-                numInstantiated++;
-                int padding = codeSectionLength & ((1 << instance->m_log2CodeSectionAlignment) - 1);
-                if (padding != 0) { padding = (1 << instance->m_log2CodeSectionAlignment) - padding; }
-                codeSectionLength += padding;
-                instance->m_relativeCodeAddr = codeSectionLength;
-                instance->m_codeSectionPaddingRequired = static_cast<uint16_t>(padding);
-                codeSectionLength += static_cast<int32_t>(instance->m_owner->GetCodeSectionLength());
-                instance->m_populatedRelativeCodeAddress = true;
-                if (instance->m_litcInstanceOrd == static_cast<uint32_t>(-1))
+                FastInterpBoilerplateInstance* instance = m_allBoilerplateInstances[i];
+
+                // In pass 1, only start with node with no inbound-degree.
+                // After pass 1, the remaining are loops.
+                //
+                if (instance->m_populatedRelativeCodeAddress || (pass == 0 && instance->m_isContinuationOfAnotherInstance))
                 {
-                    break;
+                    continue;
                 }
-                else
+                if (isHotTier && !instance->m_isHot)
                 {
-                    TestAssert(instance->m_litcInstanceOrd < m_allBoilerplateInstances.size());
-                    FastInterpBoilerplateInstance* nextInstance = m_allBoilerplateInstances[instance->m_litcInstanceOrd];
-                    TestAssert(nextInstance->m_isContinuationOfAnotherInstance);
-                    if (nextInstance->m_populatedRelativeCodeAddress)
+                    continue;
+                }
+                // Align the beginning of a code sequence to 16 bytes, it helps with CPU pipelining.
+                // There is no cost in this case: since this is the beginning of a code sequence,
+                // the inserted nops are never executed.
+                //
+                instance->SetAlignmentLog2(4);
+                while (true)
+                {
+                    numInstantiated++;
+                    int padding = codeSectionLength & ((1 << instance->m_log2CodeSectionAlignment) - 1);
+                    if (padding != 0) { padding = (1 << instance->m_log2CodeSectionAlignment) - padding; }
+                    codeSectionLength += padding;
+                    instance->m_relativeCodeAddr = codeSectionLength;
+                    instance->m_codeSectionPaddingRequired = static_cast<uint16_t>(padding);
+                    codeSectionLength += static_cast<int32_t>(instance->m_owner->GetCodeSectionLength());
+                    instance->m_populatedRelativeCodeAddress = true;
+                    if (instance->m_litcInstanceOrd == static_cast<uint32_t>(-1))
                     {
                         break;
                     }
-                    instance->m_shouldStripLITC = true;
-                    instance = nextInstance;
-                    codeSectionLength -= x86_64_rip_relative_jmp_instruction_len;
+                    else
+                    {
+                        TestAssert(instance->m_litcInstanceOrd < m_allBoilerplateInstances.size());
+                        FastInterpBoilerplateInstance* nextInstance = m_allBoilerplateInstances[instance->m_litcInstanceOrd];
+                        TestAssert(nextInstance->m_isContinuationOfAnotherInstance);
+                        if (nextInstance->m_populatedRelativeCodeAddress)
+                        {
+                            break;
+                        }
+                        // Do not pull cold code into the hot code section
+                        //
+                        if (isHotTier && !nextInstance->m_isHot)
+                        {
+                            break;
+                        }
+                        instance->m_shouldStripLITC = true;
+                        instance = nextInstance;
+                        codeSectionLength -= x86_64_rip_relative_jmp_instruction_len;
+                    }
                 }
             }
-        }
-        // If in the first pass, we have instantiated everything, just break out.
-        //
-        if (numInstantiated == m_allBoilerplateInstances.size())
-        {
-            break;
+            // If we have instantiated everything, just break out.
+            //
+            if (numInstantiated == m_allBoilerplateInstances.size())
+            {
+                break;
+            }
         }
     }
     TestAssert(numInstantiated == m_allBoilerplateInstances.size());
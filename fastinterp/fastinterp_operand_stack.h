@@ -21,22 +21,46 @@ struct FITempOperand
     FISpillLocation m_spillLoc;
 };
 
+// Plans the layout of the stack frame of a generated function.
+//
+// Local variables are allocated when declared and freed when they go out of scope
+// (or earlier, when they are known to be dead, see FILocalVarLiveness).
+// Temporaries (spilled operands) are allocated and freed during the evaluation of a statement,
+// that is, no temporary may be in use when a local variable is allocated or freed.
+//
+// By default a local variable is always placed on top of all live local variables, which is optimal
+// only if local variables are freed in the reverse order of allocation. If compact layout is enabled,
+// local variables are placed in the lowest free range that fits them, and temporaries may also take
+// the 8-byte holes between live local variables, so the stack frame stays small even if local variables
+// are freed in arbitrary order.
+//
 class FIStackFramePlanner
 {
 public:
     FIStackFramePlanner()
+        : m_isCompactLayout(false)
     {
         Reset(8);
     }
 
+    void SetCompactLayout(bool value)
+    {
+        m_isCompactLayout = value;
+    }
+
+    bool IsCompactLayout() const
+    {
+        return m_isCompactLayout;
+    }
+
     void Reset(uint32_t startOffset)
     {
         TestAssert(startOffset % 8 == 0);
-        m_baseOffset = startOffset;
-        m_topOffset = startOffset;
+        m_startOffset = startOffset;
+        m_varTopOffset = startOffset;
         m_maxOffsetEver = startOffset;
-        m_freeList.clear();
-        m_oldAddress.clear();
+        m_liveVars.clear();
+        ResetTemps();
     }
 
     // Get a 8-byte temporary space
@@ -49,11 +73,19 @@ public:
             m_freeList.pop_back();
             return result;
         }
+        else if (!m_holeList.empty())
+        {
+            uint32_t result = m_holeList.back();
+            m_holeList.pop_back();
+            m_numTempSlots++;
+            return result;
+        }
         else
         {
             TestAssert(m_topOffset % 8 == 0);
             uint32_t result = m_topOffset;
             m_topOffset += 8;
+            m_numTempSlots++;
             UpdateMaxOffsetEver();
             return result;
         }
@@ -61,55 +93,56 @@ public:
 
     void FreeTemp(uint32_t offset)
     {
-        TestAssert(offset % 8 == 0 && m_baseOffset <= offset && offset < m_topOffset);
+        TestAssert(offset % 8 == 0 && m_startOffset <= offset && offset < m_topOffset);
         m_freeList.push_back(offset);
     }
 
     bool IsNoTempInUse() const
     {
-        uint32_t bottom = UpAlign(m_baseOffset, 8);
-        TestAssert(bottom <= m_topOffset);
-        TestAssert((m_topOffset - bottom) % 8 == 0);
-        size_t count = (m_topOffset - bottom) / 8;
-        TestAssert(m_freeList.size() <= count);
+        TestAssert(m_freeList.size() <= m_numTempSlots);
 #ifdef TESTBUILD
         // Just to sanity check that the elements in freeList are distinct
         //
-        std::vector<bool> m_used;
-        m_used.resize(count, false);
+        std::set<uint32_t> used;
         for (size_t i = 0; i < m_freeList.size(); i++)
         {
-            TestAssert(bottom <= m_freeList[i] && m_freeList[i] < m_topOffset);
-            TestAssert((m_freeList[i] - bottom) % 8 == 0);
-            uint32_t offset = (m_freeList[i] - bottom) / 8;
-            TestAssert(0 <= offset && offset < count && !m_used[offset]);
-            m_used[offset] = true;
+            TestAssert(m_startOffset <= m_freeList[i] && m_freeList[i] < m_topOffset);
+            TestAssert(m_freeList[i] % 8 == 0);
+            TestAssert(!used.count(m_freeList[i]));
+            used.insert(m_freeList[i]);
         }
 #endif
-        return count == m_freeList.size();
+        return m_numTempSlots == m_freeList.size();
     }
 
     uint32_t GetLocalVar(uint32_t size, uint32_t alignment)
     {
         TestAssert(IsNoTempInUse());
-        m_oldAddress.push_back(m_baseOffset);
-        m_baseOffset = UpAlign(m_baseOffset, alignment);
-        uint32_t result = m_baseOffset;
-        m_baseOffset += size;
-        m_topOffset = UpAlign(m_baseOffset, 8);
-        m_freeList.clear();
+        TestAssert(size > 0 && alignment > 0);
+        uint32_t result = FindFreeRange(size, alignment);
+        TestAssert(!m_liveVars.count(result));
+        m_liveVars[result] = size;
+        m_varTopOffset = std::max(m_varTopOffset, result + size);
+        ResetTemps();
         UpdateMaxOffsetEver();
         return result;
     }
 
-    void PopLocalVar()
+    void FreeLocalVar(uint32_t offset)
     {
         TestAssert(IsNoTempInUse());
-        TestAssert(!m_oldAddress.empty());
-        m_baseOffset = m_oldAddress.back();
-        m_oldAddress.pop_back();
-        m_topOffset = UpAlign(m_baseOffset, 8);
-        m_freeList.clear();
+        auto it = m_liveVars.find(offset);
+        TestAssert(it != m_liveVars.end());
+        m_liveVars.erase(it);
+        if (m_liveVars.empty())
+        {
+            m_varTopOffset = m_startOffset;
+        }
+        else
+        {
+            m_varTopOffset = m_liveVars.rbegin()->first + m_liveVars.rbegin()->second;
+        }
+        ResetTemps();
     }
 
     uint32_t GetFinalStackFrameSize() const
@@ -123,16 +156,74 @@ public:
     }
 
 private:
+    uint32_t FindFreeRange(uint32_t size, uint32_t alignment) const
+    {
+        if (!m_isCompactLayout)
+        {
+            return UpAlign(m_varTopOffset, alignment);
+        }
+        // First fit
+        //
+        uint32_t cur = m_startOffset;
+        for (auto it = m_liveVars.begin(); it != m_liveVars.end(); it++)
+        {
+            uint32_t candidate = UpAlign(cur, alignment);
+            if (candidate + size <= it->first)
+            {
+                return candidate;
+            }
+            cur = std::max(cur, it->first + it->second);
+        }
+        return UpAlign(cur, alignment);
+    }
+
+    // Called whenever the set of live local variables changes (at which time no temporary may be in use)
+    //
+    void ResetTemps()
+    {
+        m_topOffset = UpAlign(m_varTopOffset, 8);
+        m_freeList.clear();
+        m_holeList.clear();
+        m_numTempSlots = 0;
+        if (m_isCompactLayout)
+        {
+            uint32_t cur = m_startOffset;
+            for (auto it = m_liveVars.begin(); it != m_liveVars.end(); it++)
+            {
+                for (uint32_t offset = UpAlign(cur, 8); offset + 8 <= it->first; offset += 8)
+                {
+                    m_holeList.push_back(offset);
+                }
+                cur = std::max(cur, it->first + it->second);
+            }
+            // Lowest address is used first
+            //
+            std::reverse(m_holeList.begin(), m_holeList.end());
+        }
+    }
+
     void UpdateMaxOffsetEver()
     {
         m_maxOffsetEver = std::max(m_maxOffsetEver, m_topOffset);
     }
 
-    uint32_t m_baseOffset;
+    bool m_isCompactLayout;
+    uint32_t m_startOffset;
+    // The end of the highest live local variable
+    //
+    uint32_t m_varTopOffset;
+    // The end of the temporaries allocated on top of the live local variables
+    //
     uint32_t m_topOffset;
     uint32_t m_maxOffsetEver;
+    // Number of distinct temporary slots handed out since the set of live local variables last changed
+    //
+    size_t m_numTempSlots;
     std::vector<uint32_t> m_freeList;
-    std::vector<uint32_t> m_oldAddress;
+    std::vector<uint32_t> m_holeList;
+    // offset => size
+    //
+    std::map<uint32_t, uint32_t> m_liveVars;
 };
 
 class FITempOperandStack
@@ -231,7 +322,7 @@ public:
         m_floatOperandStack.Reset();
 #ifdef TESTBUILD
         m_tempStack.clear();
-        m_localVarStack.clear();
+        m_localVars.clear();
 #endif
     }
 
@@ -304,23 +395,37 @@ public:
     {
         TestAssert(!typeId.IsVoid());
         TestAssert(m_tempStack.size() == 0);
-#ifdef TESTBUILD
-        m_localVarStack.push_back(typeId);
-#endif
         // TODO: support custom CPP class alignment
         //
         uint32_t alignment = typeId.IsCppClassType() ? 8 : static_cast<uint32_t>(typeId.Size());
-        return m_planner.GetLocalVar(static_cast<uint32_t>(typeId.Size()), alignment);
+        uint32_t offset = m_planner.GetLocalVar(static_cast<uint32_t>(typeId.Size()), alignment);
+#ifdef TESTBUILD
+        TestAssert(!m_localVars.count(offset));
+        m_localVars[offset] = typeId;
+#endif
+        return offset;
     }
 
-    void PopLocalVar([[maybe_unused]] TypeId typeId)
+    // Local variables may be popped in any order
+    //
+    void PopLocalVar([[maybe_unused]] TypeId typeId, uint64_t offset)
     {
-        TestAssert(m_localVarStack.size() > 0 && m_localVarStack.back() == typeId);
+        TestAssert(m_localVars.count(static_cast<uint32_t>(offset)) && m_localVars[static_cast<uint32_t>(offset)] == typeId);
         TestAssert(m_tempStack.size() == 0);
 #ifdef TESTBUILD
-        m_localVarStack.pop_back();
+        m_localVars.erase(static_cast<uint32_t>(offset));
 #endif
-        m_planner.PopLocalVar();
+        m_planner.FreeLocalVar(static_cast<uint32_t>(offset));
+    }
+
+    void SetCompactLayout(bool value)
+    {
+        m_planner.SetCompactLayout(value);
+    }
+
+    bool IsCompactLayout() const
+    {
+        return m_planner.IsCompactLayout();
     }
 
     void ForceSpillAll()
@@ -341,7 +446,7 @@ public:
 
     void AssertEmpty() const
     {
-        TestAssert(m_localVarStack.size() == 0 && m_tempStack.size() == 0);
+        TestAssert(m_localVars.size() == 0 && m_tempStack.size() == 0);
     }
 
     void AssertNoTemp() const
@@ -351,7 +456,7 @@ public:
 
     uint32_t GetFinalStackFrameSize() const
     {
-        TestAssert(m_localVarStack.size() == 0 && m_tempStack.size() == 0);
+        TestAssert(m_localVars.size() == 0 && m_tempStack.size() == 0);
         return m_planner.GetFinalStackFrameSize();
     }
 
@@ -361,7 +466,9 @@ private:
     FITempOperandStack m_floatOperandStack;
 #ifdef TESTBUILD
     std::vector<TypeId> m_tempStack;
-    std::vector<TypeId> m_localVarStack;
+    // offset => type
+    //
+    std::map<uint32_t, TypeId> m_localVars;
 #endif
 };
 
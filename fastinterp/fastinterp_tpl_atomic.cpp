@@ -0,0 +1,461 @@
+#define POCHIVM_INSIDE_FASTINTERP_TPL_CPP
+
+#include "fastinterp_tpl_common.hpp"
+#include "pochivm/ast_atomic_expr_type.h"
+
+namespace PochiVM
+{
+
+// FastInterp only targets x86-64, where every atomic load is a plain 'mov', every read-modify-write
+// is a 'lock'-prefixed instruction (which is a full barrier), and only a sequentially-consistent store
+// and a sequentially-consistent fence need extra code ('xchg' and 'mfence').
+// So the boilerplates below use the strongest order except in those two cases,
+// which is valid for any requested order and produces identical code.
+// Since each boilerplate is an opaque function to the compiler, no memory access may be reordered across it.
+//
+template<typename OperandType>
+static constexpr bool FIIsAtomicOperandType()
+{
+    if (std::is_same<OperandType, void*>::value) { return true; }
+    if (std::is_integral<OperandType>::value && !std::is_same<OperandType, bool>::value) { return true; }
+    return false;
+}
+
+// T* -> T
+//
+struct FIAtomicLoadImpl
+{
+    template<typename OperandType>
+    static constexpr bool cond()
+    {
+        return FIIsAtomicOperandType<OperandType>();
+    }
+
+    template<typename OperandType,
+             bool spillOutput,
+             FINumOpaqueIntegralParams numOIP>
+    static constexpr bool cond()
+    {
+        if (!FIOpaqueParamsHelper::CanPush(numOIP)) { return false; }
+        return true;
+    }
+
+    template<typename OperandType,
+             bool spillOutput,
+             FINumOpaqueIntegralParams numOIP,
+             FINumOpaqueFloatingParams numOFP>
+    static constexpr bool cond()
+    {
+        if (FIOpaqueParamsHelper::CanPush(numOFP)) { return false; }
+        return true;
+    }
+
+    // Placeholder rules:
+    // constant placeholder 0: spill location, if spillOutput
+    //
+    template<typename OperandType,
+             bool spillOutput,
+             FINumOpaqueIntegralParams numOIP,
+             FINumOpaqueFloatingParams numOFP,
+             typename... OpaqueParams>
+    static void f(uintptr_t stackframe, OpaqueParams... opaqueParams, OperandType* ptr) noexcept
+    {
+        OperandType result = __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+
+        if constexpr(!spillOutput)
+        {
+            DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t, OpaqueParams..., OperandType) noexcept);
+            BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe, opaqueParams..., result);
+        }
+        else
+        {
+            DEFINE_INDEX_CONSTANT_PLACEHOLDER_0;
+            *GetLocalVarAddress<OperandType>(stackframe, CONSTANT_PLACEHOLDER_0) = result;
+
+            DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t, OpaqueParams...) noexcept);
+            BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe, opaqueParams...);
+        }
+    }
+
+    static auto metavars()
+    {
+        return CreateMetaVarList(
+                    CreateTypeMetaVar("operandType"),
+                    CreateBoolMetaVar("spillOutput"),
+                    CreateOpaqueIntegralParamsLimit(),
+                    CreateOpaqueFloatParamsLimit()
+        );
+    }
+};
+
+// T*, T -> void
+//
+struct FIAtomicStoreImpl
+{
+    template<typename OperandType>
+    static constexpr bool cond()
+    {
+        return FIIsAtomicOperandType<OperandType>();
+    }
+
+    template<typename OperandType,
+             bool isPtrQAP,
+             bool isSeqCst,
+             FINumOpaqueIntegralParams numOIP>
+    static constexpr bool cond()
+    {
+        if (!FIOpaqueParamsHelper::CanPush(numOIP, 1 + (isPtrQAP ? 1 : 0))) { return false; }
+        return true;
+    }
+
+    template<typename OperandType,
+             bool isPtrQAP,
+             bool isSeqCst,
+             FINumOpaqueIntegralParams numOIP,
+             FINumOpaqueFloatingParams numOFP>
+    static constexpr bool cond()
+    {
+        if (FIOpaqueParamsHelper::CanPush(numOFP)) { return false; }
+        return true;
+    }
+
+    // Placeholder rules:
+    // constant placeholder 1: spill location of the pointer, if not isPtrQAP
+    //
+    template<typename OperandType,
+             bool isPtrQAP,
+             bool isSeqCst,
+             FINumOpaqueIntegralParams numOIP,
+             FINumOpaqueFloatingParams numOFP,
+             typename... OpaqueParams>
+    static void f(uintptr_t stackframe,
+                  OpaqueParams... opaqueParams,
+                  typename std::conditional<isPtrQAP, OperandType*, OperandType>::type qa1,
+                  [[maybe_unused]] OperandType qa2) noexcept
+    {
+        OperandType* ptr;
+        OperandType value;
+        if constexpr(isPtrQAP)
+        {
+            ptr = qa1;
+            value = qa2;
+        }
+        else
+        {
+            DEFINE_INDEX_CONSTANT_PLACEHOLDER_1;
+            ptr = *GetLocalVarAddress<OperandType*>(stackframe, CONSTANT_PLACEHOLDER_1);
+            value = qa1;
+        }
+
+        if constexpr(isSeqCst)
+        {
+            __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+        }
+        else
+        {
+            __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+        }
+
+        DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t, OpaqueParams...) noexcept);
+        BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe, opaqueParams...);
+    }
+
+    static auto metavars()
+    {
+        return CreateMetaVarList(
+                    CreateTypeMetaVar("operandType"),
+                    CreateBoolMetaVar("isPtrQAP"),
+                    CreateBoolMetaVar("isSeqCst"),
+                    CreateOpaqueIntegralParamsLimit(),
+                    CreateOpaqueFloatParamsLimit()
+        );
+    }
+};
+
+// T*, T -> T (the old value)
+//
+struct FIAtomicFetchOpImpl
+{
+    template<typename OperandType>
+    static constexpr bool cond()
+    {
+        if (!FIIsAtomicOperandType<OperandType>()) { return false; }
+        if (std::is_pointer<OperandType>::value) { return false; }
+        return true;
+    }
+
+    template<typename OperandType,
+             AstAtomicExprType op>
+    static constexpr bool cond()
+    {
+        return IsAtomicFetchOp(op);
+    }
+
+    template<typename OperandType,
+             AstAtomicExprType op,
+             bool isPtrQAP,
+             bool spillOutput,
+             FINumOpaqueIntegralParams numOIP>
+    static constexpr bool cond()
+    {
+        if (!FIOpaqueParamsHelper::CanPush(numOIP, 1 + (isPtrQAP ? 1 : 0))) { return false; }
+        return true;
+    }
+
+    template<typename OperandType,
+             AstAtomicExprType op,
+             bool isPtrQAP,
+             bool spillOutput,
+             FINumOpaqueIntegralParams numOIP,
+             FINumOpaqueFloatingParams numOFP>
+    static constexpr bool cond()
+    {
+        if (FIOpaqueParamsHelper::CanPush(numOFP)) { return false; }
+        return true;
+    }
+
+    // Placeholder rules:
+    // constant placeholder 0: spill location, if spillOutput
+    // constant placeholder 1: spill location of the pointer, if not isPtrQAP
+    //
+    template<typename OperandType,
+             AstAtomicExprType op,
+             bool isPtrQAP,
+             bool spillOutput,
+             FINumOpaqueIntegralParams numOIP,
+             FINumOpaqueFloatingParams numOFP,
+             typename... OpaqueParams>
+    static void f(uintptr_t stackframe,
+                  OpaqueParams... opaqueParams,
+                  typename std::conditional<isPtrQAP, OperandType*, OperandType>::type qa1,
+                  [[maybe_unused]] OperandType qa2) noexcept
+    {
+        OperandType* ptr;
+        OperandType value;
+        if constexpr(isPtrQAP)
+        {
+            ptr = qa1;
+            value = qa2;
+        }
+        else
+        {
+            DEFINE_INDEX_CONSTANT_PLACEHOLDER_1;
+            ptr = *GetLocalVarAddress<OperandType*>(stackframe, CONSTANT_PLACEHOLDER_1);
+            value = qa1;
+        }
+
+        OperandType result;
+        if constexpr(op == AstAtomicExprType::FETCH_ADD)
+        {
+            result = __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+        }
+        else if constexpr(op == AstAtomicExprType::FETCH_SUB)
+        {
+            result = __atomic_fetch_sub(ptr, value, __ATOMIC_SEQ_CST);
+        }
+        else if constexpr(op == AstAtomicExprType::FETCH_AND)
+        {
+            result = __atomic_fetch_and(ptr, value, __ATOMIC_SEQ_CST);
+        }
+        else
+        {
+            static_assert(op == AstAtomicExprType::FETCH_OR);
+            result = __atomic_fetch_or(ptr, value, __ATOMIC_SEQ_CST);
+        }
+
+        if constexpr(!spillOutput)
+        {
+            DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t, OpaqueParams..., OperandType) noexcept);
+            BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe, opaqueParams..., result);
+        }
+        else
+        {
+            DEFINE_INDEX_CONSTANT_PLACEHOLDER_0;
+            *GetLocalVarAddress<OperandType>(stackframe, CONSTANT_PLACEHOLDER_0) = result;
+
+            DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t, OpaqueParams...) noexcept);
+            BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe, opaqueParams...);
+        }
+    }
+
+    static auto metavars()
+    {
+        return CreateMetaVarList(
+                    CreateTypeMetaVar("operandType"),
+                    CreateEnumMetaVar<AstAtomicExprType::X_END_OF_ENUM>("atomicOp"),
+                    CreateBoolMetaVar("isPtrQAP"),
+                    CreateBoolMetaVar("spillOutput"),
+                    CreateOpaqueIntegralParamsLimit(),
+                    CreateOpaqueFloatParamsLimit()
+        );
+    }
+};
+
+// T*, T (expected), T (desired) -> T (the old value)
+// The operands are pushed in that order, so if the expected value is spilled, the pointer is spilled as well.
+//
+struct FIAtomicCompareExchangeImpl
+{
+    template<typename OperandType>
+    static constexpr bool cond()
+    {
+        return FIIsAtomicOperandType<OperandType>();
+    }
+
+    template<typename OperandType,
+             bool isPtrQAP,
+             bool isExpectedQAP>
+    static constexpr bool cond()
+    {
+        if (isPtrQAP && !isExpectedQAP) { return false; }
+        return true;
+    }
+
+    template<typename OperandType,
+             bool isPtrQAP,
+             bool isExpectedQAP,
+             bool spillOutput,
+             FINumOpaqueIntegralParams numOIP>
+    static constexpr bool cond()
+    {
+        if (!FIOpaqueParamsHelper::CanPush(numOIP, 1 + (isPtrQAP ? 1 : 0) + (isExpectedQAP ? 1 : 0))) { return false; }
+        return true;
+    }
+
+    template<typename OperandType,
+             bool isPtrQAP,
+             bool isExpectedQAP,
+             bool spillOutput,
+             FINumOpaqueIntegralParams numOIP,
+             FINumOpaqueFloatingParams numOFP>
+    static constexpr bool cond()
+    {
+        if (FIOpaqueParamsHelper::CanPush(numOFP)) { return false; }
+        return true;
+    }
+
+    // Placeholder rules:
+    // constant placeholder 0: spill location, if spillOutput
+    // constant placeholder 1: spill location of the pointer, if not isPtrQAP
+    // constant placeholder 2: spill location of the expected value, if not isExpectedQAP
+    //
+    template<typename OperandType,
+             bool isPtrQAP,
+             bool isExpectedQAP,
+             bool spillOutput,
+             FINumOpaqueIntegralParams numOIP,
+             FINumOpaqueFloatingParams numOFP,
+             typename... OpaqueParams>
+    static void f(uintptr_t stackframe,
+                  OpaqueParams... opaqueParams,
+                  typename std::conditional<isPtrQAP, OperandType*, OperandType>::type qa1,
+                  [[maybe_unused]] OperandType qa2,
+                  [[maybe_unused]] OperandType qa3) noexcept
+    {
+        OperandType* ptr;
+        OperandType expected;
+        OperandType desired;
+        if constexpr(isPtrQAP)
+        {
+            ptr = qa1;
+            expected = qa2;
+            desired = qa3;
+        }
+        else
+        {
+            DEFINE_INDEX_CONSTANT_PLACEHOLDER_1;
+            ptr = *GetLocalVarAddress<OperandType*>(stackframe, CONSTANT_PLACEHOLDER_1);
+            if constexpr(isExpectedQAP)
+            {
+                expected = qa1;
+                desired = qa2;
+            }
+            else
+            {
+                DEFINE_INDEX_CONSTANT_PLACEHOLDER_2;
+                expected = *GetLocalVarAddress<OperandType>(stackframe, CONSTANT_PLACEHOLDER_2);
+                desired = qa1;
+            }
+        }
+
+        // On failure 'expected' is updated to the old value, and on success it already equals the old value
+        //
+        __atomic_compare_exchange_n(ptr, &expected, desired, false /*weak*/, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+        OperandType result = expected;
+
+        if constexpr(!spillOutput)
+        {
+            DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t, OpaqueParams..., OperandType) noexcept);
+            BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe, opaqueParams..., result);
+        }
+        else
+        {
+            DEFINE_INDEX_CONSTANT_PLACEHOLDER_0;
+            *GetLocalVarAddress<OperandType>(stackframe, CONSTANT_PLACEHOLDER_0) = result;
+
+            DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t, OpaqueParams...) noexcept);
+            BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe, opaqueParams...);
+        }
+    }
+
+    static auto metavars()
+    {
+        return CreateMetaVarList(
+                    CreateTypeMetaVar("operandType"),
+                    CreateBoolMetaVar("isPtrQAP"),
+                    CreateBoolMetaVar("isExpectedQAP"),
+                    CreateBoolMetaVar("spillOutput"),
+                    CreateOpaqueIntegralParamsLimit(),
+                    CreateOpaqueFloatParamsLimit()
+        );
+    }
+};
+
+// A sequentially-consistent fence. Weaker fences need no instruction on x86-64,
+// so they are lowered to a noop boilerplate.
+//
+struct FISeqCstFenceImpl
+{
+    template<FINumOpaqueIntegralParams numOIP,
+             FINumOpaqueFloatingParams numOFP>
+    static constexpr bool cond()
+    {
+        if (FIOpaqueParamsHelper::CanPush(numOIP)) { return false; }
+        if (FIOpaqueParamsHelper::CanPush(numOFP)) { return false; }
+        return true;
+    }
+
+    template<FINumOpaqueIntegralParams numOIP,
+             FINumOpaqueFloatingParams numOFP,
+             typename... OpaqueParams>
+    static void f(uintptr_t stackframe, OpaqueParams... opaqueParams) noexcept
+    {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t, OpaqueParams...) noexcept);
+        BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe, opaqueParams...);
+    }
+
+    static auto metavars()
+    {
+        return CreateMetaVarList(
+                    CreateOpaqueIntegralParamsLimit(),
+                    CreateOpaqueFloatParamsLimit()
+        );
+    }
+};
+
+}   // namespace PochiVM
+
+// build_fast_interp_lib.cpp JIT entry point
+//
+extern "C"
+void __pochivm_build_fast_interp_library__()
+{
+    using namespace PochiVM;
+    RegisterBoilerplate<FIAtomicLoadImpl>();
+    RegisterBoilerplate<FIAtomicStoreImpl>();
+    RegisterBoilerplate<FIAtomicFetchOpImpl>();
+    RegisterBoilerplate<FIAtomicCompareExchangeImpl>();
+    RegisterBoilerplate<FISeqCstFenceImpl>();
+}
@@ -0,0 +1,250 @@
+#define POCHIVM_INSIDE_FASTINTERP_TPL_CPP
+
+#include "fastinterp_tpl_common.hpp"
+#include "pochivm/ast_bit_intrinsic_expr_type.h"
+
+namespace PochiVM
+{
+
+template<typename OperandType>
+static constexpr bool FIIsBitIntrinsicOperandType()
+{
+    return std::is_integral<OperandType>::value && !std::is_same<OperandType, bool>::value;
+}
+
+// T -> T
+//
+struct FIBitUnaryIntrinsicImpl
+{
+    template<typename OperandType>
+    static constexpr bool cond()
+    {
+        return FIIsBitIntrinsicOperandType<OperandType>();
+    }
+
+    template<typename OperandType,
+             AstBitIntrinsicExprType op>
+    static constexpr bool cond()
+    {
+        return IsUnaryBitIntrinsic(op);
+    }
+
+    template<typename OperandType,
+             AstBitIntrinsicExprType op,
+             bool spillOutput,
+             FINumOpaqueIntegralParams numOIP>
+    static constexpr bool cond()
+    {
+        if (!FIOpaqueParamsHelper::CanPush(numOIP)) { return false; }
+        return true;
+    }
+
+    template<typename OperandType,
+             AstBitIntrinsicExprType op,
+             bool spillOutput,
+             FINumOpaqueIntegralParams numOIP,
+             FINumOpaqueFloatingParams numOFP>
+    static constexpr bool cond()
+    {
+        if (FIOpaqueParamsHelper::CanPush(numOFP)) { return false; }
+        return true;
+    }
+
+    // Placeholder rules:
+    // constant placeholder 0: spill location, if spillOutput
+    //
+    template<typename OperandType,
+             AstBitIntrinsicExprType op,
+             bool spillOutput,
+             FINumOpaqueIntegralParams numOIP,
+             FINumOpaqueFloatingParams numOFP,
+             typename... OpaqueParams>
+    static void f(uintptr_t stackframe, OpaqueParams... opaqueParams, OperandType qa1) noexcept
+    {
+        OperandType result;
+        if constexpr(op == AstBitIntrinsicExprType::POPCOUNT)
+        {
+            result = BitIntrinsicPopCount(qa1);
+        }
+        else if constexpr(op == AstBitIntrinsicExprType::CLZ)
+        {
+            result = BitIntrinsicCountLeadingZeros(qa1);
+        }
+        else if constexpr(op == AstBitIntrinsicExprType::CTZ)
+        {
+            result = BitIntrinsicCountTrailingZeros(qa1);
+        }
+        else
+        {
+            static_assert(op == AstBitIntrinsicExprType::BSWAP);
+            result = BitIntrinsicByteSwap(qa1);
+        }
+
+        if constexpr(!spillOutput)
+        {
+            DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t, OpaqueParams..., OperandType) noexcept);
+            BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe, opaqueParams..., result);
+        }
+        else
+        {
+            DEFINE_INDEX_CONSTANT_PLACEHOLDER_0;
+            *GetLocalVarAddress<OperandType>(stackframe, CONSTANT_PLACEHOLDER_0) = result;
+
+            DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t, OpaqueParams...) noexcept);
+            BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe, opaqueParams...);
+        }
+    }
+
+    static auto metavars()
+    {
+        return CreateMetaVarList(
+                    CreateTypeMetaVar("operandType"),
+                    CreateEnumMetaVar<AstBitIntrinsicExprType::X_END_OF_ENUM>("bitIntrinsicOp"),
+                    CreateBoolMetaVar("spillOutput"),
+                    CreateOpaqueIntegralParamsLimit(),
+                    CreateOpaqueFloatParamsLimit()
+        );
+    }
+};
+
+// T, T -> T for ROTL, ROTR and MULHI
+// uint32_t, T -> uint32_t for CRC32
+//
+struct FIBitBinaryIntrinsicImpl
+{
+    template<typename OperandType>
+    static constexpr bool cond()
+    {
+        return FIIsBitIntrinsicOperandType<OperandType>();
+    }
+
+    template<typename OperandType,
+             AstBitIntrinsicExprType op>
+    static constexpr bool cond()
+    {
+        return !IsUnaryBitIntrinsic(op);
+    }
+
+    template<typename OperandType,
+             AstBitIntrinsicExprType op,
+             bool isLhsQAP,
+             bool spillOutput,
+             FINumOpaqueIntegralParams numOIP>
+    static constexpr bool cond()
+    {
+        if (!FIOpaqueParamsHelper::CanPush(numOIP, 1 + (isLhsQAP ? 1 : 0))) { return false; }
+        return true;
+    }
+
+    template<typename OperandType,
+             AstBitIntrinsicExprType op,
+             bool isLhsQAP,
+             bool spillOutput,
+             FINumOpaqueIntegralParams numOIP,
+             FINumOpaqueFloatingParams numOFP>
+    static constexpr bool cond()
+    {
+        if (FIOpaqueParamsHelper::CanPush(numOFP)) { return false; }
+        return true;
+    }
+
+    // Placeholder rules:
+    // constant placeholder 0: spill location, if spillOutput
+    // constant placeholder 1: spill location of LHS, if not isLhsQAP
+    //
+    template<typename OperandType,
+             AstBitIntrinsicExprType op,
+             bool isLhsQAP,
+             bool spillOutput,
+             FINumOpaqueIntegralParams numOIP,
+             FINumOpaqueFloatingParams numOFP,
+             typename... OpaqueParams>
+    static void f(uintptr_t stackframe,
+                  OpaqueParams... opaqueParams,
+                  typename std::conditional<isLhsQAP,
+                      typename std::conditional<op == AstBitIntrinsicExprType::CRC32, uint32_t, OperandType>::type,
+                      OperandType>::type qa1,
+                  [[maybe_unused]] OperandType qa2) noexcept
+    {
+        // For CRC32, the LHS (and the result) is the uint32_t checksum
+        //
+        using LhsType = typename std::conditional<op == AstBitIntrinsicExprType::CRC32, uint32_t, OperandType>::type;
+
+        LhsType lhs;
+        OperandType rhs;
+        if constexpr(!isLhsQAP)
+        {
+            // We always evaluate LHS before RHS, so the QAP is always RHS
+            //
+            DEFINE_INDEX_CONSTANT_PLACEHOLDER_1;
+            lhs = *GetLocalVarAddress<LhsType>(stackframe, CONSTANT_PLACEHOLDER_1);
+            // 'qa1' is not a typo: 'qa2' simply doesn't exist, 'qa1' is top of stack.
+            //
+            rhs = qa1;
+        }
+        else
+        {
+            lhs = qa1;
+            rhs = qa2;
+        }
+
+        LhsType result;
+        if constexpr(op == AstBitIntrinsicExprType::ROTL)
+        {
+            result = BitIntrinsicRotateLeft(lhs, rhs);
+        }
+        else if constexpr(op == AstBitIntrinsicExprType::ROTR)
+        {
+            result = BitIntrinsicRotateRight(lhs, rhs);
+        }
+        else if constexpr(op == AstBitIntrinsicExprType::MULHI)
+        {
+            result = BitIntrinsicMulHi(lhs, rhs);
+        }
+        else
+        {
+            // Only used if the host supports SSE4.2, see FIBitCrc32SoftwareImpl
+            //
+            static_assert(op == AstBitIntrinsicExprType::CRC32);
+            result = BitIntrinsicCrc32Hardware(lhs, rhs);
+        }
+
+        if constexpr(!spillOutput)
+        {
+            DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t, OpaqueParams..., LhsType) noexcept);
+            BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe, opaqueParams..., result);
+        }
+        else
+        {
+            DEFINE_INDEX_CONSTANT_PLACEHOLDER_0;
+            *GetLocalVarAddress<LhsType>(stackframe, CONSTANT_PLACEHOLDER_0) = result;
+
+            DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t, OpaqueParams...) noexcept);
+            BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe, opaqueParams...);
+        }
+    }
+
+    static auto metavars()
+    {
+        return CreateMetaVarList(
+                    CreateTypeMetaVar("operandType"),
+                    CreateEnumMetaVar<AstBitIntrinsicExprType::X_END_OF_ENUM>("bitIntrinsicOp"),
+                    CreateBoolMetaVar("isLhsQAP"),
+                    CreateBoolMetaVar("spillOutput"),
+                    CreateOpaqueIntegralParamsLimit(),
+                    CreateOpaqueFloatParamsLimit()
+        );
+    }
+};
+
+}   // namespace PochiVM
+
+// build_fast_interp_lib.cpp JIT entry point
+//
+extern "C"
+void __pochivm_build_fast_interp_library__()
+{
+    using namespace PochiVM;
+    RegisterBoilerplate<FIBitUnaryIntrinsicImpl>();
+    RegisterBoilerplate<FIBitBinaryIntrinsicImpl>();
+}
@@ -0,0 +1,122 @@
+#define POCHIVM_INSIDE_FASTINTERP_TPL_CPP
+#define FASTINTERP_TPL_USE_MEDIUM_MCMODEL
+
+#include "fastinterp_tpl_common.hpp"
+#include "pochivm/ast_bit_intrinsic_expr_type.h"
+
+namespace PochiVM
+{
+
+// uint32_t, T -> uint32_t, CRC32 for hosts without SSE4.2 (see BitIntrinsicUseHardwareCrc32)
+// Same algorithm as BitIntrinsicCrc32Software. The boilerplate may not reference the lookup table,
+// so its address is passed in as a constant placeholder, which requires the 'medium' code model.
+//
+struct FIBitCrc32SoftwareImpl
+{
+    template<typename OperandType>
+    static constexpr bool cond()
+    {
+        return std::is_integral<OperandType>::value && !std::is_same<OperandType, bool>::value;
+    }
+
+    template<typename OperandType,
+             bool isLhsQAP,
+             bool spillOutput,
+             FINumOpaqueIntegralParams numOIP>
+    static constexpr bool cond()
+    {
+        if (!FIOpaqueParamsHelper::CanPush(numOIP, 1 + (isLhsQAP ? 1 : 0))) { return false; }
+        return true;
+    }
+
+    template<typename OperandType,
+             bool isLhsQAP,
+             bool spillOutput,
+             FINumOpaqueIntegralParams numOIP,
+             FINumOpaqueFloatingParams numOFP>
+    static constexpr bool cond()
+    {
+        if (FIOpaqueParamsHelper::CanPush(numOFP)) { return false; }
+        return true;
+    }
+
+    // Placeholder rules:
+    // constant placeholder 0: spill location, if spillOutput
+    // constant placeholder 1: spill location of LHS, if not isLhsQAP
+    // constant placeholder 2: address of x_crc32cTable
+    //
+    template<typename OperandType,
+             bool isLhsQAP,
+             bool spillOutput,
+             FINumOpaqueIntegralParams numOIP,
+             FINumOpaqueFloatingParams numOFP,
+             typename... OpaqueParams>
+    static void f(uintptr_t stackframe,
+                  OpaqueParams... opaqueParams,
+                  typename std::conditional<isLhsQAP, uint32_t, OperandType>::type qa1,
+                  [[maybe_unused]] OperandType qa2) noexcept
+    {
+        uint32_t crc;
+        OperandType data;
+        if constexpr(!isLhsQAP)
+        {
+            // We always evaluate LHS before RHS, so the QAP is always RHS
+            //
+            DEFINE_INDEX_CONSTANT_PLACEHOLDER_1;
+            crc = *GetLocalVarAddress<uint32_t>(stackframe, CONSTANT_PLACEHOLDER_1);
+            // 'qa1' is not a typo: 'qa2' simply doesn't exist, 'qa1' is top of stack.
+            //
+            data = qa1;
+        }
+        else
+        {
+            crc = qa1;
+            data = qa2;
+        }
+
+        DEFINE_CONSTANT_PLACEHOLDER_2(const uint32_t*);
+        using U = typename std::make_unsigned<OperandType>::type;
+        uint64_t bytes = static_cast<uint64_t>(static_cast<U>(data));
+        for (size_t i = 0; i < sizeof(OperandType); i++)
+        {
+            crc = CONSTANT_PLACEHOLDER_2[(crc ^ static_cast<uint32_t>(bytes)) & 0xFFU] ^ (crc >> 8);
+            bytes >>= 8;
+        }
+
+        if constexpr(!spillOutput)
+        {
+            DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t, OpaqueParams..., uint32_t) noexcept);
+            BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe, opaqueParams..., crc);
+        }
+        else
+        {
+            DEFINE_INDEX_CONSTANT_PLACEHOLDER_0;
+            *GetLocalVarAddress<uint32_t>(stackframe, CONSTANT_PLACEHOLDER_0) = crc;
+
+            DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t, OpaqueParams...) noexcept);
+            BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe, opaqueParams...);
+        }
+    }
+
+    static auto metavars()
+    {
+        return CreateMetaVarList(
+                    CreateTypeMetaVar("operandType"),
+                    CreateBoolMetaVar("isLhsQAP"),
+                    CreateBoolMetaVar("spillOutput"),
+                    CreateOpaqueIntegralParamsLimit(),
+                    CreateOpaqueFloatParamsLimit()
+        );
+    }
+};
+
+}   // namespace PochiVM
+
+// build_fast_interp_lib.cpp JIT entry point
+//
+extern "C"
+void __pochivm_build_fast_interp_library__()
+{
+    using namespace PochiVM;
+    RegisterBoilerplate<FIBitCrc32SoftwareImpl>(FIAttribute::CodeModelMedium);
+}
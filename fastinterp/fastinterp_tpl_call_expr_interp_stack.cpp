@@ -0,0 +1,149 @@
+#define POCHIVM_INSIDE_FASTINTERP_TPL_CPP
+#define FASTINTERP_TPL_USE_MEDIUM_MCMODEL
+
+#include "fastinterp_tpl_common.hpp"
+#include "fastinterp_function_alignment.h"
+#include "fastinterp_tpl_return_type.h"
+
+namespace PochiVM
+{
+
+// Call a generated function, same as FICallExprImpl, except that the stack frame of the callee
+// is allocated from the interpreter stack of the current thread instead of the C stack.
+// See AstModule::SetFastInterpCallFramesOnInterpStack().
+//
+// The boilerplate may not reference the C++ functions that push and pop the frame (they read the thread-local
+// interpreter stack), so their addresses are passed in as constant placeholders, which requires the 'medium'
+// code model. For the same reason, the callee stack frame size is a constant placeholder instead of a metavar.
+//
+struct FICallExprInterpStackImpl
+{
+    template<typename ReturnType>
+    static constexpr bool cond()
+    {
+        if (std::is_pointer<ReturnType>::value && !std::is_same<ReturnType, void*>::value) { return false; }
+        return true;
+    }
+
+    template<typename ReturnType,
+             bool spillReturnValue>
+    static constexpr bool cond()
+    {
+        if (std::is_same<void, ReturnType>::value && spillReturnValue) { return false; }
+        return true;
+    }
+
+    template<typename ReturnType,
+             bool spillReturnValue,
+             bool isCalleeNoExcept>
+    static constexpr bool cond()
+    {
+        return true;
+    }
+
+    template<typename T>
+    using WorkaroundVoidType = typename std::conditional<std::is_same<T, void>::value, void*, T>::type;
+
+    // Placeholder rules:
+    // boilerplate placeholder 1: call expression
+    // constant placeholder 0: spill location, if spillReturnValue
+    // constant placeholder 1: stack frame size of the callee
+    // constant placeholder 2: address of FastInterpInterpStackPushCallFrame
+    // constant placeholder 3: address of FastInterpInterpStackPopCallFrame
+    //
+    template<typename ReturnType,
+             bool spillReturnValue,
+             bool isCalleeNoExcept>
+    static void f(uintptr_t stackframe) noexcept
+    {
+        using PushFnPrototype = uintptr_t(*)(uint64_t) noexcept;
+        using PopFnPrototype = void(*)(uint64_t, uintptr_t) noexcept;
+        DEFINE_CONSTANT_PLACEHOLDER_1(uint64_t);
+        DEFINE_CONSTANT_PLACEHOLDER_2(uint64_t);
+        DEFINE_CONSTANT_PLACEHOLDER_3(uint64_t);
+
+        // Push reports a clear error and aborts if the interpreter stack limit is exceeded
+        //
+        uintptr_t newStackframe = reinterpret_cast<PushFnPrototype>(CONSTANT_PLACEHOLDER_2)(CONSTANT_PLACEHOLDER_1);
+
+        [[maybe_unused]] WorkaroundVoidType<FIReturnType<ReturnType, isCalleeNoExcept>> returnValue;
+
+        DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_1_NO_TAILCALL(
+                    FIReturnType<ReturnType, isCalleeNoExcept>(*)(uintptr_t, uint8_t*) noexcept);
+        if constexpr(std::is_same<FIReturnType<ReturnType, isCalleeNoExcept>, void>::value)
+        {
+            BOILERPLATE_FNPTR_PLACEHOLDER_1(stackframe, reinterpret_cast<uint8_t*>(newStackframe));
+        }
+        else
+        {
+            returnValue = BOILERPLATE_FNPTR_PLACEHOLDER_1(stackframe, reinterpret_cast<uint8_t*>(newStackframe));
+        }
+
+        reinterpret_cast<PopFnPrototype>(CONSTANT_PLACEHOLDER_3)(CONSTANT_PLACEHOLDER_1, newStackframe);
+
+        if constexpr(std::is_same<ReturnType, void>::value)
+        {
+            if constexpr(isCalleeNoExcept)
+            {
+                DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t) noexcept);
+                BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe);
+            }
+            else
+            {
+                DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t, uint64_t) noexcept);
+                BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe, FIReturnValueHelper::HasException<ReturnType>(returnValue));
+            }
+        }
+        else if constexpr(spillReturnValue)
+        {
+            DEFINE_INDEX_CONSTANT_PLACEHOLDER_0;
+            *GetLocalVarAddress<ReturnType>(stackframe, CONSTANT_PLACEHOLDER_0) =
+                    FIReturnValueHelper::GetReturnValue<ReturnType, isCalleeNoExcept>(returnValue);
+
+            if constexpr(isCalleeNoExcept)
+            {
+                DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t) noexcept);
+                BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe);
+            }
+            else
+            {
+                DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t, uint64_t) noexcept);
+                BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe, FIReturnValueHelper::HasException<ReturnType>(returnValue));
+            }
+        }
+        else
+        {
+            ReturnType ret = FIReturnValueHelper::GetReturnValue<ReturnType, isCalleeNoExcept>(returnValue);
+            if constexpr(isCalleeNoExcept)
+            {
+                DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t, ReturnType) noexcept);
+                BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe, ret);
+            }
+            else
+            {
+                DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t, ReturnType, uint64_t) noexcept);
+                BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe, ret, FIReturnValueHelper::HasException<ReturnType>(returnValue));
+            }
+        }
+    }
+
+    static auto metavars()
+    {
+        return CreateMetaVarList(
+                    CreateTypeMetaVar("returnType"),
+                    CreateBoolMetaVar("spillReturnValue"),
+                    CreateBoolMetaVar("isCalleeNoExcept")
+        );
+    }
+};
+
+}   // namespace PochiVM
+
+// build_fast_interp_lib.cpp JIT entry point
+//
+extern "C"
+void __pochivm_build_fast_interp_library__()
+{
+    using namespace PochiVM;
+    RegisterBoilerplate<FICallExprInterpStackImpl>(FIAttribute::CodeModelMedium);
+}
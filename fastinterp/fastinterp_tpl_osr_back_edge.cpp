@@ -0,0 +1,76 @@
+#define POCHIVM_INSIDE_FASTINTERP_TPL_CPP
+#define FASTINTERP_TPL_USE_MEDIUM_MCMODEL
+
+#include "fastinterp_tpl_common.hpp"
+#include "fastinterp_function_alignment.h"
+#include "fastinterp_tpl_return_type.h"
+
+namespace PochiVM
+{
+
+// The back-edge of a loop that may be transferred to a compiled continuation by on-stack replacement.
+// See FastInterpOsrEntry for details. Only used in noexcept functions.
+//
+struct FIOsrBackEdgeImpl
+{
+    template<typename ReturnType>
+    static constexpr bool cond()
+    {
+        if (std::is_pointer<ReturnType>::value && !std::is_same<ReturnType, void*>::value) { return false; }
+        return true;
+    }
+
+    // Placeholder rules:
+    // constant placeholder 0: stack offset of the uint64_t back-edge counter
+    // constant placeholder 1: the threshold
+    // constant placeholder 2: address of the compiled continuation slot
+    // boilerplate placeholder 0: continuation (the loop head)
+    //
+    template<typename ReturnType>
+    static ReturnType f(uintptr_t stackframe) noexcept
+    {
+        DEFINE_INDEX_CONSTANT_PLACEHOLDER_0;
+        DEFINE_CONSTANT_PLACEHOLDER_1(uint64_t);
+        DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(ReturnType(*)(uintptr_t) noexcept);
+
+        uint64_t* counter = GetLocalVarAddress<uint64_t>(stackframe, CONSTANT_PLACEHOLDER_0);
+        uint64_t value = *counter + 1;
+        if (likely(value < CONSTANT_PLACEHOLDER_1))
+        {
+            *counter = value;
+            return BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe);
+        }
+
+        *counter = 0;
+        DEFINE_CONSTANT_PLACEHOLDER_2(uintptr_t*);
+        uintptr_t target = __atomic_load_n(CONSTANT_PLACEHOLDER_2, __ATOMIC_ACQUIRE);
+        if (target == 0)
+        {
+            return BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe);
+        }
+
+        // Transfer to the compiled continuation. It executes the rest of the function,
+        // so its return value is the return value of this function.
+        //
+        using OsrContinuationPrototype = ReturnType(*)(uintptr_t) noexcept;
+        return reinterpret_cast<OsrContinuationPrototype>(target)(stackframe);
+    }
+
+    static auto metavars()
+    {
+        return CreateMetaVarList(
+                    CreateTypeMetaVar("returnType")
+        );
+    }
+};
+
+}   // namespace PochiVM
+
+// build_fast_interp_lib.cpp JIT entry point
+//
+extern "C"
+void __pochivm_build_fast_interp_library__()
+{
+    using namespace PochiVM;
+    RegisterBoilerplate<FIOsrBackEdgeImpl>(FIAttribute::CodeModelMedium);
+}
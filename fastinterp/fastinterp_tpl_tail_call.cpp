@@ -0,0 +1,54 @@
+#define POCHIVM_INSIDE_FASTINTERP_TPL_CPP
+
+#include "fastinterp_tpl_common.hpp"
+
+namespace PochiVM
+{
+
+// Move an evaluated argument of a tail call into its parameter slot in the current stack frame,
+// which becomes the stack frame of the callee. See AstReturnStmt.
+//
+struct FITailCallMoveParamImpl
+{
+    template<typename ParamType>
+    static constexpr bool cond()
+    {
+        if (std::is_same<ParamType, void>::value) { return false; }
+        if (std::is_pointer<ParamType>::value && !std::is_same<ParamType, void*>::value) { return false; }
+        return true;
+    }
+
+    // Placeholder rules:
+    // constant placeholder 0: offset of the evaluated argument
+    // constant placeholder 1: offset of the parameter slot
+    //
+    template<typename ParamType>
+    static void f(uintptr_t stackframe) noexcept
+    {
+        DEFINE_INDEX_CONSTANT_PLACEHOLDER_0;
+        DEFINE_INDEX_CONSTANT_PLACEHOLDER_1;
+        *GetLocalVarAddress<ParamType>(stackframe, CONSTANT_PLACEHOLDER_1) =
+                *GetLocalVarAddress<ParamType>(stackframe, CONSTANT_PLACEHOLDER_0);
+
+        DEFINE_BOILERPLATE_FNPTR_PLACEHOLDER_0(void(*)(uintptr_t) noexcept);
+        BOILERPLATE_FNPTR_PLACEHOLDER_0(stackframe);
+    }
+
+    static auto metavars()
+    {
+        return CreateMetaVarList(
+                    CreateTypeMetaVar("paramType")
+        );
+    }
+};
+
+}   // namespace PochiVM
+
+// build_fast_interp_lib.cpp JIT entry point
+//
+extern "C"
+void __pochivm_build_fast_interp_library__()
+{
+    using namespace PochiVM;
+    RegisterBoilerplate<FITailCallMoveParamImpl>();
+}
@@ -446,6 +446,12 @@ public:
     std::string m_hashFnName;
 
     SqlRow* m_row;
+
+private:
+    void EmitCrc32HashFnBody(PochiVM::Function fn);
+    void EmitLegacyHashFnBody(PochiVM::Function fn);
+    PochiVM::Value<size_t> WARN_UNUSED EmitSlotOfHash(const PochiVM::Value<size_t>& hash,
+                                                      const PochiVM::Value<size_t>& tableSize);
 };
 
 // A piece of logic which creates a stream of SQL rows from some source
@@ -645,6 +651,10 @@ struct QueryCodegenContext
     PochiVM::Variable<SqlResultPrinter*>* m_sqlResultPrinter;
     PochiVM::Function* m_curFunction;
     PochiVM::Block* m_fnStartBlock;
+    // Generate the original polynomial hash function and modulo slot mapping for hash tables,
+    // instead of CRC-32C and MulHi. Only used to benchmark the two against each other.
+    //
+    bool m_useLegacyHashFn = false;
 
     PochiVM::Variable<uintptr_t>& GetRow(SqlRow* which)
     {
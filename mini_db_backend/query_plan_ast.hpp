@@ -238,6 +238,109 @@ inline Block WARN_UNUSED AggregatedRowContainer::EmitDeclaration()
     return result;
 }
 
+// The fields are accumulated into a CRC-32C checksum, which costs one instruction per integer field or character.
+// The 32-bit checksum is then spread over 64 bits by a Fibonacci hashing multiplication,
+// so that MulHi(hash, tableSize) (see EmitSlotOfHash) maps it uniformly to a slot.
+//
+inline void HashTableContainer::EmitCrc32HashFnBody(Function fn)
+{
+    Block body;
+    auto crc = fn.NewVariable<uint32_t>();
+    body.Append(Declare(crc, static_cast<uint32_t>(0xFFFFFFFFU)));
+    TestAssert(m_groupByFields.size() > 0);
+    for (SqlField* field : m_groupByFields)
+    {
+        if (field->GetType().IsFloatingPoint())
+        {
+            ReleaseAssert(false && "cannot hash floating point");
+        }
+        else if (field->GetType().IsPrimitiveIntType())
+        {
+            body.Append(Assign(crc, Crc32(crc, StaticCast<uint64_t>(field->Codegen()))));
+        }
+        else
+        {
+            TestAssert(field->GetType() == TypeId::Get<char*>());
+            Value<char*> v(field->Codegen());
+            auto i = fn.NewVariable<char*>();
+            body.Append(Block(
+                Declare(i, v),
+                While(*i != '\0').Do(
+                    Assign(crc, Crc32(crc, *i)),
+                    Assign(i, i + 1)
+                ),
+                // Also hash the terminator, so that ("ab", "c") and ("a", "bc") hash differently
+                //
+                Assign(crc, Crc32(crc, Literal<uint8_t>(0)))
+            ));
+        }
+    }
+    fn.SetBody(body, Return(StaticCast<size_t>(crc) * Literal<size_t>(0x9E3779B97F4A7C15ULL)));
+}
+
+// The original polynomial hash, mapped to a slot by a 64-bit modulo.
+// Only used when benchmarking against the CRC-32C hash.
+//
+inline void HashTableContainer::EmitLegacyHashFnBody(Function fn)
+{
+    Block initBlock;
+    auto genHash = [&](SqlField* field) -> Value<size_t>
+    {
+        if (field->GetType().IsFloatingPoint())
+        {
+            ReleaseAssert(false && "cannot hash floating point");
+        }
+        else if (field->GetType().IsPrimitiveIntType())
+        {
+            return StaticCast<size_t>(field->Codegen());
+        }
+        else
+        {
+            TestAssert(field->GetType() == TypeId::Get<char*>());
+            Value<char*> v(field->Codegen());
+            auto i = fn.NewVariable<char*>();
+            auto hashValue = fn.NewVariable<size_t>();
+            initBlock.Append(Block(
+                Declare(i, v),
+                Declare(hashValue, static_cast<size_t>(0)),
+                While(*i != '\0').Do(
+                    Assign(hashValue, hashValue * Literal<size_t>(100000000007ULL) + StaticCast<size_t>(*i)),
+                    Assign(i, i + 1)
+                )
+            ));
+            return hashValue;
+        }
+    };
+
+    std::function<Value<size_t>(size_t, size_t)> genExpr = [&](size_t seed, size_t n) -> Value<size_t>
+    {
+        Value<size_t> term = genHash(m_groupByFields[n]) * Literal<size_t>(seed);
+        if (n == 0)
+        {
+            return term;
+        }
+        else
+        {
+            return genExpr(seed * 13331, n - 1) + term;
+        }
+    };
+
+    TestAssert(m_groupByFields.size() > 0);
+    fn.SetBody(initBlock, Return(genExpr(13331, m_groupByFields.size() - 1)));
+}
+
+inline Value<size_t> WARN_UNUSED HashTableContainer::EmitSlotOfHash(const Value<size_t>& hash, const Value<size_t>& tableSize)
+{
+    if (thread_queryCodegenContext.m_useLegacyHashFn)
+    {
+        return hash % tableSize;
+    }
+    else
+    {
+        return MulHi(hash, tableSize);
+    }
+}
+
 inline Block WARN_UNUSED HashTableContainer::EmitDeclaration()
 {
     m_alloc = new Variable<QueryExecutionTempAllocator>(thread_queryCodegenContext.m_curFunction->NewVariable<QueryExecutionTempAllocator>());
@@ -250,51 +353,14 @@ inline Block WARN_UNUSED HashTableContainer::EmitDeclaration()
 
         thread_queryCodegenContext.m_rowMap[m_row] = &row;
 
-        Function f = fn;
-        Block initBlock;
-        auto genHash = [&](SqlField* field) -> Value<size_t>
+        if (thread_queryCodegenContext.m_useLegacyHashFn)
         {
-            if (field->GetType().IsFloatingPoint())
-            {
-                ReleaseAssert(false && "cannot hash floating point");
-            }
-            else if (field->GetType().IsPrimitiveIntType())
-            {
-                return StaticCast<size_t>(field->Codegen());
-            }
-            else
-            {
-                TestAssert(field->GetType() == TypeId::Get<char*>());
-                Value<char*> v(field->Codegen());
-                auto i = f.NewVariable<char*>();
-                auto hashValue = f.NewVariable<size_t>();
-                initBlock.Append(Block(
-                    Declare(i, v),
-                    Declare(hashValue, static_cast<size_t>(0)),
-                    While(*i != '\0').Do(
-                        Assign(hashValue, hashValue * Literal<size_t>(100000000007ULL) + StaticCast<size_t>(*i)),
-                        Assign(i, i + 1)
-                    )
-                ));
-                return hashValue;
-            }
-        };
-
-        std::function<Value<size_t>(size_t, size_t)> genExpr = [&](size_t seed, size_t n) -> Value<size_t>
+            EmitLegacyHashFnBody(fn);
+        }
+        else
         {
-            Value<size_t> term = genHash(m_groupByFields[n]) * Literal<size_t>(seed);
-            if (n == 0)
-            {
-                return term;
-            }
-            else
-            {
-                return genExpr(seed * 13331, n - 1) + term;
-            }
-        };
-
-        TestAssert(m_groupByFields.size() > 0);
-        fn.SetBody(initBlock, Return(genExpr(13331, m_groupByFields.size() - 1)));
+            EmitCrc32HashFnBody(fn);
+        }
 
         bakRowMap.swap(thread_queryCodegenContext.m_rowMap);
     }
@@ -396,7 +462,7 @@ inline Block WARN_UNUSED HashTableContainer::EmitProbe(const Variable<uintptr_t>
     auto quadratic_probe_factor = thread_queryCodegenContext.m_curFunction->NewVariable<size_t>();
     return Block(
         emitCheckExpand ? EmitCheckExpand() : Block(),
-        Declare(output, Call<HashFnPrototype>(m_hashFnName, input) % (*m_tableSize)),
+        Declare(output, EmitSlotOfHash(Call<HashFnPrototype>(m_hashFnName, input), *m_tableSize)),
         Declare(quadratic_probe_factor, static_cast<size_t>(0)),
         While((*m_keys)[output] != Literal<size_t>(0) &&
               !Call<CmpFnPrototype>(m_cmpFnName, input, (*m_keys)[output])).Do(
@@ -428,7 +494,7 @@ inline Block WARN_UNUSED HashTableContainer::EmitCheckExpand()
             For(Declare(i, static_cast<size_t>(0)), i < *m_tableSize, Increment(i)).Do(
                 Declare(input, (*m_keys)[i]),
                 If(input != Literal<size_t>(0)).Then(
-                    Declare(slot, Call<HashFnPrototype>(m_hashFnName, input) % newTableSize),
+                    Declare(slot, EmitSlotOfHash(Call<HashFnPrototype>(m_hashFnName, input), newTableSize)),
                     Declare(quadratic_probe_factor, static_cast<size_t>(0)),
                     While(newKeys[slot] != Literal<size_t>(0)).Do(
                         Increment(quadratic_probe_factor),
@@ -438,6 +504,10 @@ inline Block WARN_UNUSED HashTableContainer::EmitCheckExpand()
                     Assign(newValues[slot], (*m_values)[i])
                 )
             ),
+            // Large tables return their memory to the pool, so the next expansion may reuse it
+            //
+            m_alloc->Free(ReinterpretCast<uintptr_t>(*m_values), Literal<size_t>(8) * (*m_tableSize)),
+            m_alloc->Free(ReinterpretCast<uintptr_t>(*m_keys), Literal<size_t>(8) * (*m_tableSize)),
             Assign(*m_keys, newKeys),
             Assign(*m_values, newValues),
             Assign(*m_tableSize, newTableSize),
@@ -703,7 +773,6 @@ inline void HashJoinHashTableOutputter::Codegen(Scope insertPoint)
     auto oldSize = thread_queryCodegenContext.m_curFunction->NewVariable<size_t>();
     auto newSize = thread_queryCodegenContext.m_curFunction->NewVariable<size_t>();
     auto expandedVec = thread_queryCodegenContext.m_curFunction->NewVariable<uintptr_t*>();
-    auto i = thread_queryCodegenContext.m_curFunction->NewVariable<size_t>();
     insertPoint.Append(Block(
         m_container->EmitProbe(inputRow, slot),
         If((*m_container->m_keys)[slot] == Literal<size_t>(0)).Then(
@@ -719,12 +788,13 @@ inline void HashJoinHashTableOutputter::Codegen(Scope insertPoint)
         If(vec[-2] == vec[-1]).Then(
             Declare(oldSize, vec[-1]),
             Declare(newSize, oldSize + oldSize),
-            Declare(expandedVec, ReinterpretCast<uintptr_t*>(m_container->m_alloc->Allocate(Literal<size_t>(8) * (newSize + Literal<size_t>(2)))) + 2),
+            // Grows in place if the vector is the last allocation, or a large object that stays in its size class
+            //
+            Declare(expandedVec, ReinterpretCast<uintptr_t*>(m_container->m_alloc->Reallocate(
+                        ReinterpretCast<uintptr_t>(vec) - Literal<uintptr_t>(16),
+                        Literal<size_t>(8) * (oldSize + Literal<size_t>(2)),
+                        Literal<size_t>(8) * (newSize + Literal<size_t>(2)))) + 2),
             Assign(expandedVec[-2], newSize),
-            Assign(expandedVec[-1], oldSize),
-            For(Declare(i, Literal<size_t>(0)), i < oldSize, Increment(i)).Do(
-                Assign(expandedVec[i], vec[i])
-            ),
             Assign(*vecAddr, expandedVec),
             Assign(vec, expandedVec)
         ),
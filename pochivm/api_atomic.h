@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+
+#include "atomic_expr.h"
+#include "api_base.h"
+
+namespace PochiVM
+{
+
+// Atomic operations on non-bool integral or pointer values, with the same semantics as the std::atomic
+// member functions of the same name. The memory orders follow the rules of std::atomic:
+// a load may not use release or acq_rel order, and a store may not use acquire or acq_rel order.
+// The pointer must be aligned to the size of T.
+//
+
+namespace internal
+{
+
+inline AstMemoryOrder GetAstMemoryOrder(std::memory_order order)
+{
+    switch (order)
+    {
+    case std::memory_order_relaxed: { return AstMemoryOrder::RELAXED; }
+    // consume is treated as acquire, as all compilers do
+    //
+    case std::memory_order_consume: { return AstMemoryOrder::ACQUIRE; }
+    case std::memory_order_acquire: { return AstMemoryOrder::ACQUIRE; }
+    case std::memory_order_release: { return AstMemoryOrder::RELEASE; }
+    case std::memory_order_acq_rel: { return AstMemoryOrder::ACQ_REL; }
+    case std::memory_order_seq_cst: { return AstMemoryOrder::SEQ_CST; }
+    }   /*switch*/
+    TestAssert(false);
+    __builtin_unreachable();
+}
+
+template<typename T>
+Value<T> AtomicFetchOpImpl(AstAtomicExprType op, const Value<T*>& ptr, const Value<T>& value, std::memory_order order)
+{
+    static_assert(AstTypeHelper::atomic_operand_type<T>::value && !std::is_pointer<T>::value,
+                  "Atomic fetch operations are only supported for non-bool integral types");
+    return Value<T>(new AstAtomicExpr(op, GetAstMemoryOrder(order), ptr.__pochivm_value_ptr, nullptr /*expected*/, value.__pochivm_value_ptr));
+}
+
+}   // namespace internal
+
+// Returns *ptr
+//
+template<typename T>
+Value<T> AtomicLoad(const Value<T*>& ptr, std::memory_order order = std::memory_order_seq_cst)
+{
+    static_assert(AstTypeHelper::atomic_operand_type<T>::value, "Atomic operations are only supported for non-bool integral types and pointers");
+    return Value<T>(new AstAtomicExpr(AstAtomicExprType::LOAD, internal::GetAstMemoryOrder(order),
+                                      ptr.__pochivm_value_ptr, nullptr /*expected*/, nullptr /*value*/));
+}
+
+// *ptr = value
+//
+template<typename T>
+Value<void> AtomicStore(const Value<T*>& ptr, const Value<T>& value, std::memory_order order = std::memory_order_seq_cst)
+{
+    static_assert(AstTypeHelper::atomic_operand_type<T>::value, "Atomic operations are only supported for non-bool integral types and pointers");
+    return Value<void>(new AstAtomicExpr(AstAtomicExprType::STORE, internal::GetAstMemoryOrder(order),
+                                         ptr.__pochivm_value_ptr, nullptr /*expected*/, value.__pochivm_value_ptr));
+}
+
+// The fetch operations perform '*ptr = *ptr op value' and return the old value of *ptr
+//
+template<typename T>
+Value<T> AtomicFetchAdd(const Value<T*>& ptr, const Value<T>& value, std::memory_order order = std::memory_order_seq_cst)
+{
+    return internal::AtomicFetchOpImpl(AstAtomicExprType::FETCH_ADD, ptr, value, order);
+}
+
+template<typename T>
+Value<T> AtomicFetchSub(const Value<T*>& ptr, const Value<T>& value, std::memory_order order = std::memory_order_seq_cst)
+{
+    return internal::AtomicFetchOpImpl(AstAtomicExprType::FETCH_SUB, ptr, value, order);
+}
+
+template<typename T>
+Value<T> AtomicFetchAnd(const Value<T*>& ptr, const Value<T>& value, std::memory_order order = std::memory_order_seq_cst)
+{
+    return internal::AtomicFetchOpImpl(AstAtomicExprType::FETCH_AND, ptr, value, order);
+}
+
+template<typename T>
+Value<T> AtomicFetchOr(const Value<T*>& ptr, const Value<T>& value, std::memory_order order = std::memory_order_seq_cst)
+{
+    return internal::AtomicFetchOpImpl(AstAtomicExprType::FETCH_OR, ptr, value, order);
+}
+
+// Strong compare-exchange: if *ptr == expected, set *ptr = desired.
+// Returns the old value of *ptr, so the exchange happened iff the return value equals 'expected'.
+// If the exchange did not happen, the operation is a load with the order derived from 'order'
+// the same way as std::atomic::compare_exchange_strong.
+//
+template<typename T>
+Value<T> AtomicCompareExchange(const Value<T*>& ptr, const Value<T>& expected, const Value<T>& desired,
+                               std::memory_order order = std::memory_order_seq_cst)
+{
+    static_assert(AstTypeHelper::atomic_operand_type<T>::value, "Atomic operations are only supported for non-bool integral types and pointers");
+    return Value<T>(new AstAtomicExpr(AstAtomicExprType::COMPARE_EXCHANGE, internal::GetAstMemoryOrder(order),
+                                      ptr.__pochivm_value_ptr, expected.__pochivm_value_ptr, desired.__pochivm_value_ptr));
+}
+
+// std::atomic_thread_fence. The order may not be relaxed.
+//
+inline Value<void> Fence(std::memory_order order = std::memory_order_seq_cst)
+{
+    return Value<void>(new AstFenceStmt(internal::GetAstMemoryOrder(order)));
+}
+
+}   // namespace PochiVM
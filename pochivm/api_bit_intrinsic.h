@@ -0,0 +1,96 @@
+#pragma once
+
+#include "bit_intrinsic_expr.h"
+#include "api_base.h"
+
+namespace PochiVM
+{
+
+// Bit manipulation and hashing intrinsics on non-bool integral types.
+// See ast_bit_intrinsic_expr_type.h for the exact semantics.
+//
+
+namespace internal
+{
+
+template<typename T>
+Value<T> BitUnaryIntrinsicImpl(AstBitIntrinsicExprType op, const Value<T>& operand)
+{
+    static_assert(AstTypeHelper::bit_intrinsic_operand_type<T>::value, "Bit intrinsics are only supported for non-bool integral types");
+    return Value<T>(new AstBitIntrinsicExpr(op, operand.__pochivm_value_ptr, nullptr /*rhs*/));
+}
+
+template<typename T>
+Value<T> BitBinaryIntrinsicImpl(AstBitIntrinsicExprType op, const Value<T>& lhs, const Value<T>& rhs)
+{
+    static_assert(AstTypeHelper::bit_intrinsic_operand_type<T>::value, "Bit intrinsics are only supported for non-bool integral types");
+    return Value<T>(new AstBitIntrinsicExpr(op, lhs.__pochivm_value_ptr, rhs.__pochivm_value_ptr));
+}
+
+}   // namespace internal
+
+// The number of set bits
+//
+template<typename T>
+Value<T> PopCount(const Value<T>& value)
+{
+    return internal::BitUnaryIntrinsicImpl(AstBitIntrinsicExprType::POPCOUNT, value);
+}
+
+// The number of leading zero bits, the bit width of T if 'value' is 0
+//
+template<typename T>
+Value<T> CountLeadingZeros(const Value<T>& value)
+{
+    return internal::BitUnaryIntrinsicImpl(AstBitIntrinsicExprType::CLZ, value);
+}
+
+// The number of trailing zero bits, the bit width of T if 'value' is 0
+//
+template<typename T>
+Value<T> CountTrailingZeros(const Value<T>& value)
+{
+    return internal::BitUnaryIntrinsicImpl(AstBitIntrinsicExprType::CTZ, value);
+}
+
+// Reverses the byte order
+//
+template<typename T>
+Value<T> ByteSwap(const Value<T>& value)
+{
+    return internal::BitUnaryIntrinsicImpl(AstBitIntrinsicExprType::BSWAP, value);
+}
+
+// Rotates the bits of 'value', the shift is taken modulo the bit width of T
+//
+template<typename T>
+Value<T> RotateLeft(const Value<T>& value, const Value<T>& shift)
+{
+    return internal::BitBinaryIntrinsicImpl(AstBitIntrinsicExprType::ROTL, value, shift);
+}
+
+template<typename T>
+Value<T> RotateRight(const Value<T>& value, const Value<T>& shift)
+{
+    return internal::BitBinaryIntrinsicImpl(AstBitIntrinsicExprType::ROTR, value, shift);
+}
+
+// The high half of the double-width product of 'lhs' and 'rhs'.
+// For unsigned T, MulHi(hash, n) maps a uniformly distributed 'hash' to [0, n) without a division.
+//
+template<typename T>
+Value<T> MulHi(const Value<T>& lhs, const Value<T>& rhs)
+{
+    return internal::BitBinaryIntrinsicImpl(AstBitIntrinsicExprType::MULHI, lhs, rhs);
+}
+
+// Accumulates the bits of 'data' into the CRC-32C checksum 'crc', same as the SSE4.2 'crc32' instruction
+//
+template<typename T>
+Value<uint32_t> Crc32(const Value<uint32_t>& crc, const Value<T>& data)
+{
+    static_assert(AstTypeHelper::bit_intrinsic_operand_type<T>::value, "Bit intrinsics are only supported for non-bool integral types");
+    return Value<uint32_t>(new AstBitIntrinsicExpr(AstBitIntrinsicExprType::CRC32, crc.__pochivm_value_ptr, data.__pochivm_value_ptr));
+}
+
+}   // namespace PochiVM
@@ -214,6 +214,34 @@ FunctionAndParamsTuple<T> NewFunction(const std::string& fnName, Targs... paramN
     return internal::params_user_tuple<T>::build(fn, fn.GetPtr()->GetParamsVector());
 }
 
+// Usage:
+//   auto [ gen, param1, param2 ... ] = NewGenerator<YieldType, Prototype>(fnName, [nameParam1, nameParam2...])
+//   Same as NewFunction, except that the function is a generator producing values of YieldType by Yield(value).
+//   Prototype must return void. A Return() statement finishes the generator.
+//
+// Validate() lowers the generator into two functions, which are then generated by any backend like others:
+//     void fnName(uintptr_t state, Param1, Param2...)    initializes 'state' to run the generator with the given params
+//     bool fnName_next(uintptr_t state, YieldType* out)   runs the generator until the next Yield, storing the value
+//                                                         into 'out'. Returns false if the generator has finished.
+//   where 'state' points to an 8-byte aligned buffer of GetGeneratorStateSize() bytes holding all the variables
+//   of the generator, so a consumer may pull values lazily, and interleave any number of generators.
+//
+// Example:
+//   using FnType = void(*)(int);
+//   auto [gen, n] = NewGenerator<int, FnType>("range", "n");
+//
+template<typename YieldType, typename T, typename... Targs>
+FunctionAndParamsTuple<T> NewGenerator(const std::string& fnName, Targs... paramNames)
+{
+    static_assert(AstTypeHelper::is_primitive_type<YieldType>::value || std::is_pointer<YieldType>::value,
+                  "YieldType must be a primitive or pointer type");
+    static_assert(std::is_same<typename AstTypeHelper::function_type_helper<T>::ReturnType, void>::value,
+                  "the prototype of a generator must return void");
+    FunctionAndParamsTuple<T> result = NewFunction<T>(fnName, paramNames...);
+    std::get<0>(result).GetPtr()->SetGeneratorYieldType(TypeId::Get<YieldType>());
+    return result;
+}
+
 // Declare a variable, with initialization expression
 //
 template<typename T>
@@ -473,6 +501,139 @@ inline Value<void> Return(bool val)
     return Value<void>(new AstReturnStmt(new AstLiteralExpr(TypeId::Get<bool>(), &val)));
 }
 
+// TailCall<FnPrototype>(fn, params...): returns the result of calling a generated function
+// that has the same prototype as the current function (which may return void). Unlike 'Return(Call(...))',
+// the callee runs in place of the current function, so a chain of tail calls of any length (e.g. an interpreter
+// dispatch loop written as one function per opcode) runs in constant stack space:
+// the call is a 'musttail' call in LLVM, and the callee reuses the stack frame of the caller in FastInterp.
+// (DebugInterp is an exception: it simply makes the call and returns.)
+//
+// The caller and callee must be both noexcept or both not, and no C++ object may be alive at the tail call.
+// In FastInterp, a tail call to a function of an earlier generation of the module (see
+// AstModule::StartIncrementalUpdate()) is a normal call, since such functions can only be called through
+// their cdecl interface.
+//
+template<typename T, typename... Targs>
+Value<void> TailCall(const std::string& fnName, Targs... args)
+{
+    auto call = internal::call_expr_construct_helper<T>::call(fnName, args...);
+    return Value<void>(new AstReturnStmt(call.__pochivm_value_ptr, true /*isTailCall*/));
+}
+
+template<typename T, typename... Targs>
+Value<void> TailCall(Function fn, Targs... args)
+{
+    return TailCall<T>(fn.GetPtr()->GetName(), args...);
+}
+
+namespace internal
+{
+
+template<typename T>
+struct batch_function_prototype_helper
+{
+    static_assert(sizeof(T) == 0, "T must be a C-style function pointer type");
+};
+
+template<typename R, typename... Args>
+struct batch_function_prototype_helper<R(*)(Args...)>
+{
+    using type = typename std::conditional<std::is_void<R>::value,
+                                           void(*)(Args*..., size_t),
+                                           void(*)(Args*..., R*, size_t)>::type;
+};
+
+template<typename R, typename... Args>
+struct batch_function_prototype_helper<R(*)(Args...) noexcept>
+{
+    using type = typename std::conditional<std::is_void<R>::value,
+                                           void(*)(Args*..., size_t) noexcept,
+                                           void(*)(Args*..., R*, size_t) noexcept>::type;
+};
+
+}   // namespace internal
+
+// Given the prototype T = R(*)(Args...) of a generated function,
+// BatchFunctionPrototype<T> is the prototype of its batch function, see NewBatchFunction()
+//
+template<typename T>
+using BatchFunctionPrototype = typename internal::batch_function_prototype_helper<T>::type;
+
+namespace internal
+{
+
+template<typename T, size_t... i>
+void SetBatchFunctionBody(const Function& fn,
+                          const FunctionAndParamsTuple<BatchFunctionPrototype<T>>& batchFnAndParams,
+                          std::index_sequence<i...>)
+{
+    using R = typename AstTypeHelper::function_type_helper<T>::ReturnType;
+    Function batchFn = std::get<0>(batchFnAndParams);
+    auto n = std::get<std::tuple_size<FunctionAndParamsTuple<BatchFunctionPrototype<T>>>::value - 1>(batchFnAndParams);
+    auto k = batchFn.NewVariable<size_t>("k");
+    if constexpr(std::is_void<R>::value)
+    {
+        batchFn.SetBody(
+            For(Declare(k, static_cast<size_t>(0)), k < n, Increment(k)).Do(
+                Call<T>(fn, std::get<i + 1>(batchFnAndParams)[k]...)
+            )
+        );
+    }
+    else
+    {
+        auto out = std::get<sizeof...(i) + 1>(batchFnAndParams);
+        batchFn.SetBody(
+            For(Declare(k, static_cast<size_t>(0)), k < n, Increment(k)).Do(
+                Assign(out[k], Call<T>(fn, std::get<i + 1>(batchFnAndParams)[k]...))
+            )
+        );
+    }
+}
+
+}   // namespace internal
+
+// NewBatchFunction<T>(fn, batchFnName): creates a generated function named 'batchFnName',
+// which calls the generated function 'fn' of prototype T = R(*)(Args...) on each element of arrays of inputs:
+//     void batchFnName(Args*... args, R* out, size_t n)
+//         for k in [0, n): out[k] = fn(args[0][k], args[1][k], ...)
+// (or 'void batchFnName(Args*... args, size_t n)' if R is void). See BatchFunctionPrototype<T>.
+//
+// The loop runs in generated code, so a caller invoking a generated predicate or key extractor on many values
+// from C++ pays the overhead of calling into generated code (e.g. FastInterpFunction::operator()) once per batch,
+// instead of once per element. The batch function is noexcept if 'fn' is. If 'fn' throws, the exception
+// propagates out of the batch function, with the results of the preceding elements already written to 'out'.
+// The input arrays are only read.
+//
+// Example:
+//   using FnPrototype = bool(*)(int, int) noexcept;
+//   auto [fn, a, b] = NewFunction<FnPrototype>("a_less_than_b");
+//   fn.SetBody(Return(a < b));
+//   NewBatchFunction<FnPrototype>(fn, "a_less_than_b_batch");
+//   ...
+//   auto batchFn = module->GetFastInterpGeneratedFunction<BatchFunctionPrototype<FnPrototype>>("a_less_than_b_batch");
+//   batchFn(as, bs, results, n);
+//
+template<typename T>
+Function NewBatchFunction(const Function& fn, const std::string& batchFnName)
+{
+    static_assert(AstTypeHelper::is_function_prototype<T>::value,
+                  "T must be a C-style function pointer type");
+    using FnInfo = AstTypeHelper::function_type_helper<T>;
+    FunctionAndParamsTuple<BatchFunctionPrototype<T>> batchFnAndParams = NewFunction<BatchFunctionPrototype<T>>(batchFnName);
+    internal::SetBatchFunctionBody<T>(fn, batchFnAndParams, std::make_index_sequence<FnInfo::numArgs>());
+    return std::get<0>(batchFnAndParams);
+}
+
+// Yield(expr): produce a value from a generator, see NewGenerator()
+//
+template<typename T>
+Value<void> Yield(const Value<T>& val)
+{
+    static_assert(AstTypeHelper::is_primitive_type<T>::value || std::is_pointer<T>::value,
+                  "Only primitive and pointer types may be yielded");
+    return Value<void>(new AstYieldStmt(val.__pochivm_value_ptr));
+}
+
 // CallDestructor<T>(T* ptr): manually call the destructor to destruct the object at 'ptr'
 //
 template<typename T>
@@ -484,7 +645,33 @@ Value<void> CallDestructor(const Value<T*>& val)
 
 inline void NewModule(const std::string& name)
 {
-    thread_pochiVMContext->m_curModule = new AstModule(name);
+    AstModule* oldModule = thread_pochiVMContext->m_curModule;
+    if (oldModule != nullptr && oldModule->IsAttachedToCurrentThread())
+    {
+        oldModule->DetachFromCurrentThread();
+    }
+    (new AstModule(name))->AttachToCurrentThread();
+}
+
+// Detach the module being built by the current thread, so that it can be handed to another thread.
+// The other thread continues building it after AttachModule(). See PochiVMContext for the thread-safety model.
+//
+inline AstModule* WARN_UNUSED DetachModule()
+{
+    AstModule* module = thread_pochiVMContext->m_curModule;
+    TestAssert(module != nullptr);
+    module->DetachFromCurrentThread();
+    return module;
+}
+
+// Make 'module' the module being built by the current thread. The thread must not be building another module.
+// Fires if the module is still attached to another thread.
+//
+inline void AttachModule(AstModule* module)
+{
+    TestAssert(module != nullptr);
+    TestAssert(thread_pochiVMContext->m_curModule == nullptr || !thread_pochiVMContext->m_curModule->IsAttachedToCurrentThread());
+    module->AttachToCurrentThread();
 }
 
 inline Value<uintptr_t> GetGeneratedFunctionPointer(const std::string& fnName)
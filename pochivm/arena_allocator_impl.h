@@ -0,0 +1,211 @@
+#pragma once
+
+#include "common.h"
+#include "global_codegen_memory_pool.h"
+#include "fastinterp/simple_constexpr_power_helper.h"
+
+namespace PochiVM
+{
+
+// The bump allocator shared by TempArenaAllocator (codegen) and MiniDbBackend::QueryExecutionTempAllocator
+// (query execution), which only differ in the memory pool they take their memory from and in their interface.
+//
+// Small allocations are carved out of memory chunks from 'pool', which are only returned to the pool by Reset().
+// Allocations larger than x_maxSmallAllocationSize are large objects, which get their own memory from the pool,
+// and are returned to it as soon as they are freed.
+//
+template<GlobalCodegenMemoryPool& pool>
+class ArenaAllocatorImpl
+{
+public:
+    ArenaAllocatorImpl()
+        : m_listHead(0)
+        , m_currentAddress(8)
+        , m_currentAddressEnd(0)
+        , m_lastAllocation(0)
+        , m_largeObjectListHead(nullptr)
+    { }
+
+    ~ArenaAllocatorImpl()
+    {
+        FreeAllMemoryChunks();
+    }
+
+    void Reset()
+    {
+        FreeAllMemoryChunks();
+    }
+
+    // Allocate() throws MemoryLimitExceededError if the allocator would hold more than 'bytes' of memory.
+    // 0 (the default) for no limit.
+    //
+    void SetMemoryLimit(size_t bytes)
+    {
+        m_accounting.SetMemoryLimit(bytes);
+    }
+
+    MemoryAllocatorStats GetStats() const
+    {
+        return m_accounting.GetStats();
+    }
+
+    static constexpr size_t x_maxSmallAllocationSize = GlobalCodegenMemoryPool::x_memoryChunkSize - 4096;
+
+    uintptr_t WARN_UNUSED Allocate(size_t alignment, size_t size)
+    {
+        if (unlikely(size > x_maxSmallAllocationSize))
+        {
+            TestAssert(alignment <= 4096);
+            return AllocateLargeObject(size);
+        }
+        AlignCurrentAddress(alignment);
+        if (m_currentAddress + size > m_currentAddressEnd)
+        {
+            GetNewMemoryChunk();
+            AlignCurrentAddress(alignment);
+            TestAssert(m_currentAddress + size <= m_currentAddressEnd);
+        }
+        TestAssert(m_currentAddress % alignment == 0);
+        uintptr_t result = m_currentAddress;
+        m_currentAddress += size;
+        TestAssert(m_currentAddress <= m_currentAddressEnd);
+        m_lastAllocation = result;
+        return result;
+    }
+
+    // 'size' must be the size 'address' was allocated (or last reallocated) with.
+    // A large object is returned to the pool. Otherwise the memory is only reclaimed right away
+    // if it is the last allocation, and by Reset() if not.
+    //
+    void Free(uintptr_t address, size_t size)
+    {
+        if (size > x_maxSmallAllocationSize)
+        {
+            FreeLargeObject(address, size);
+        }
+        else if (address == m_lastAllocation && address + size == m_currentAddress)
+        {
+            m_currentAddress = address;
+            m_lastAllocation = 0;
+        }
+    }
+
+    // Resize an allocation, 'oldSize' must be the size 'address' was allocated (or last reallocated) with.
+    // The last allocation is resized in place if its chunk has room, and a large object if it stays in its size class.
+    // Otherwise the contents are moved to a new allocation, and 'address' is freed as by Free().
+    //
+    uintptr_t WARN_UNUSED Reallocate(uintptr_t address, size_t alignment, size_t oldSize, size_t newSize)
+    {
+        if (oldSize > x_maxSmallAllocationSize)
+        {
+            if (newSize > x_maxSmallAllocationSize &&
+                GlobalCodegenMemoryPool::GetLargeObjectAllocationSize(newSize) ==
+                    GlobalCodegenMemoryPool::GetLargeObjectAllocationSize(oldSize))
+            {
+                return address;
+            }
+        }
+        else if (newSize <= x_maxSmallAllocationSize && address == m_lastAllocation &&
+                 address + oldSize == m_currentAddress && address + newSize <= m_currentAddressEnd)
+        {
+            m_currentAddress = address + newSize;
+            return address;
+        }
+        uintptr_t result = Allocate(alignment, newSize);
+        memcpy(reinterpret_cast<void*>(result), reinterpret_cast<void*>(address), std::min(oldSize, newSize));
+        Free(address, oldSize);
+        return result;
+    }
+
+private:
+    // The list of live large objects. The nodes are allocated from the chunks.
+    //
+    struct LargeObjectNode
+    {
+        LargeObjectNode* m_next;
+        uintptr_t m_address;
+        size_t m_size;
+    };
+
+    uintptr_t WARN_UNUSED AllocateLargeObject(size_t size)
+    {
+        LargeObjectNode* node = reinterpret_cast<LargeObjectNode*>(Allocate(alignof(LargeObjectNode), sizeof(LargeObjectNode)));
+        size_t allocSize = GlobalCodegenMemoryPool::GetLargeObjectAllocationSize(size);
+        m_accounting.CheckMemoryLimit(allocSize);
+        node->m_address = pool.GetLargeObject(size);
+        node->m_size = size;
+        node->m_next = m_largeObjectListHead;
+        m_largeObjectListHead = node;
+        m_accounting.AddLargeAllocation(allocSize);
+        return node->m_address;
+    }
+
+    void FreeLargeObject(uintptr_t address, size_t size)
+    {
+        LargeObjectNode** cur = &m_largeObjectListHead;
+        while ((*cur)->m_address != address)
+        {
+            cur = &(*cur)->m_next;
+            TestAssert(*cur != nullptr);
+        }
+        *cur = (*cur)->m_next;
+        pool.FreeLargeObject(address, size);
+        m_accounting.RemoveLargeAllocation(GlobalCodegenMemoryPool::GetLargeObjectAllocationSize(size));
+    }
+
+    void GetNewMemoryChunk()
+    {
+        m_accounting.CheckMemoryLimit(GlobalCodegenMemoryPool::x_memoryChunkSize);
+        uintptr_t address = pool.GetMemoryChunk();
+        m_accounting.AddChunk();
+        AppendToList(address);
+        // the first 8 bytes of the region is used as linked list
+        //
+        m_currentAddress = address + 8;
+        m_currentAddressEnd = address + GlobalCodegenMemoryPool::x_memoryChunkSize;
+    }
+
+    void AlignCurrentAddress(size_t alignment)
+    {
+        TestAssert(alignment <= 4096 && math::is_power_of_2(static_cast<int>(alignment)));
+        size_t mask = alignment - 1;
+        m_currentAddress += mask;
+        m_currentAddress &= ~mask;
+    }
+
+    void AppendToList(uintptr_t address)
+    {
+        *reinterpret_cast<uintptr_t*>(address) = m_listHead;
+        m_listHead = address;
+    }
+
+    void FreeAllMemoryChunks()
+    {
+        // The nodes live in the chunks, so free the large objects first
+        //
+        while (m_largeObjectListHead != nullptr)
+        {
+            pool.FreeLargeObject(m_largeObjectListHead->m_address, m_largeObjectListHead->m_size);
+            m_largeObjectListHead = m_largeObjectListHead->m_next;
+        }
+        while (m_listHead != 0)
+        {
+            uintptr_t next = *reinterpret_cast<uintptr_t*>(m_listHead);
+            pool.FreeMemoryChunk(m_listHead);
+            m_listHead = next;
+        }
+        m_currentAddress = 8;
+        m_currentAddressEnd = 0;
+        m_lastAllocation = 0;
+        m_accounting.Reset();
+    }
+
+    uintptr_t m_listHead;
+    uintptr_t m_currentAddress;
+    uintptr_t m_currentAddressEnd;
+    uintptr_t m_lastAllocation;
+    LargeObjectNode* m_largeObjectListHead;
+    MemoryAllocatorAccounting m_accounting;
+};
+
+}   // namespace PochiVM
@@ -114,6 +114,10 @@ public:
     virtual FastInterpSnippet WARN_UNUSED PrepareForFastInterp(FISpillLocation spillLoc) override final;
     virtual void FastInterpSetupSpillLocation() override final;
 
+    AstArithmeticExprType GetOp() const { return m_op; }
+    AstNodeBase* GetLhs() const { return m_lhs; }
+    AstNodeBase* GetRhs() const { return m_rhs; }
+
     enum FIShape : int16_t
     {
         INVALID,
@@ -265,6 +269,10 @@ public:
     virtual FastInterpSnippet WARN_UNUSED PrepareForFastInterp(FISpillLocation spillLoc) override final;
     virtual void FastInterpSetupSpillLocation() override final;
 
+    AstComparisonExprType GetOp() const { return m_op; }
+    AstNodeBase* GetLhs() const { return m_lhs; }
+    AstNodeBase* GetRhs() const { return m_rhs; }
+
     enum FIShape : int16_t
     {
         INVALID,
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "common.h"
+
+// This file is used by both pochivm and fastinterp
+//
+
+namespace PochiVM
+{
+
+enum class AstAtomicExprType
+{
+    LOAD,
+    STORE,
+    FETCH_ADD,
+    FETCH_SUB,
+    FETCH_AND,
+    FETCH_OR,
+    COMPARE_EXCHANGE,
+    X_END_OF_ENUM
+};
+
+// Same meaning as the std::memory_order of the same name
+//
+enum class AstMemoryOrder
+{
+    RELAXED,
+    ACQUIRE,
+    RELEASE,
+    ACQ_REL,
+    SEQ_CST,
+    X_END_OF_ENUM
+};
+
+inline constexpr bool IsAtomicFetchOp(AstAtomicExprType op)
+{
+    return op == AstAtomicExprType::FETCH_ADD || op == AstAtomicExprType::FETCH_SUB ||
+           op == AstAtomicExprType::FETCH_AND || op == AstAtomicExprType::FETCH_OR;
+}
+
+// Whether 'order' is a valid memory order for 'op', following the rules of std::atomic
+//
+inline constexpr bool IsValidMemoryOrderForAtomicOp(AstAtomicExprType op, AstMemoryOrder order)
+{
+    if (op == AstAtomicExprType::LOAD)
+    {
+        return order != AstMemoryOrder::RELEASE && order != AstMemoryOrder::ACQ_REL;
+    }
+    if (op == AstAtomicExprType::STORE)
+    {
+        return order != AstMemoryOrder::ACQUIRE && order != AstMemoryOrder::ACQ_REL;
+    }
+    return true;
+}
+
+// The memory order used when a compare-exchange fails (which performs only a load),
+// derived from the order of the successful case the same way std::atomic::compare_exchange_strong does
+//
+inline constexpr AstMemoryOrder GetCompareExchangeFailureOrder(AstMemoryOrder order)
+{
+    if (order == AstMemoryOrder::ACQ_REL) { return AstMemoryOrder::ACQUIRE; }
+    if (order == AstMemoryOrder::RELEASE) { return AstMemoryOrder::RELAXED; }
+    return order;
+}
+
+}   // namespace PochiVM
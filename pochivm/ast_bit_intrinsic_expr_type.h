@@ -0,0 +1,250 @@
+#pragma once
+
+#include <array>
+
+#include "common.h"
+
+// This file is used by both pochivm and fastinterp
+//
+
+namespace PochiVM
+{
+
+// Bit manipulation and hashing intrinsics on non-bool integral types
+//    POPCOUNT: T -> T, the number of set bits
+//    CLZ, CTZ: T -> T, the number of leading/trailing zero bits, which is the bit width of T if the operand is 0
+//    BSWAP:    T -> T, reverses the byte order
+//    ROTL, ROTR: T, T (shift) -> T, rotates the bits left/right, the shift is taken modulo the bit width of T
+//    MULHI:    T, T -> T, the high half of the double-width product (signed or unsigned, following T)
+//    CRC32:    uint32_t (crc), T (data) -> uint32_t, accumulates 'data' into a CRC-32C (Castagnoli) checksum,
+//              same as the SSE4.2 'crc32' instruction. On hosts without SSE4.2, a table-driven software
+//              implementation is used instead.
+//
+enum class AstBitIntrinsicExprType
+{
+    POPCOUNT,
+    CLZ,
+    CTZ,
+    BSWAP,
+    ROTL,
+    ROTR,
+    MULHI,
+    CRC32,
+    X_END_OF_ENUM
+};
+
+inline constexpr bool IsUnaryBitIntrinsic(AstBitIntrinsicExprType op)
+{
+    return op == AstBitIntrinsicExprType::POPCOUNT || op == AstBitIntrinsicExprType::CLZ ||
+           op == AstBitIntrinsicExprType::CTZ || op == AstBitIntrinsicExprType::BSWAP;
+}
+
+// The implementations, shared by the debug interpreter, constant folding and the FastInterp boilerplates.
+// Except CRC32, they are written in portable C++ that the compiler recognizes, so they compile to
+// the corresponding instruction when the target has one (e.g. 'popcnt' requires '-mpopcnt').
+// CRC32 see below.
+//
+template<typename T>
+T BitIntrinsicPopCount(T x)
+{
+    using U = typename std::make_unsigned<T>::type;
+    return static_cast<T>(__builtin_popcountll(static_cast<uint64_t>(static_cast<U>(x))));
+}
+
+template<typename T>
+T BitIntrinsicCountLeadingZeros(T x)
+{
+    using U = typename std::make_unsigned<T>::type;
+    constexpr int numBits = static_cast<int>(sizeof(T) * 8);
+    U u = static_cast<U>(x);
+    if (u == 0) { return static_cast<T>(numBits); }
+    return static_cast<T>(__builtin_clzll(static_cast<uint64_t>(u)) - (64 - numBits));
+}
+
+template<typename T>
+T BitIntrinsicCountTrailingZeros(T x)
+{
+    using U = typename std::make_unsigned<T>::type;
+    constexpr int numBits = static_cast<int>(sizeof(T) * 8);
+    U u = static_cast<U>(x);
+    if (u == 0) { return static_cast<T>(numBits); }
+    return static_cast<T>(__builtin_ctzll(static_cast<uint64_t>(u)));
+}
+
+template<typename T>
+T BitIntrinsicByteSwap(T x)
+{
+    if constexpr(sizeof(T) == 1)
+    {
+        return x;
+    }
+    else if constexpr(sizeof(T) == 2)
+    {
+        return static_cast<T>(__builtin_bswap16(static_cast<uint16_t>(x)));
+    }
+    else if constexpr(sizeof(T) == 4)
+    {
+        return static_cast<T>(__builtin_bswap32(static_cast<uint32_t>(x)));
+    }
+    else
+    {
+        static_assert(sizeof(T) == 8);
+        return static_cast<T>(__builtin_bswap64(static_cast<uint64_t>(x)));
+    }
+}
+
+template<typename T>
+T BitIntrinsicRotateLeft(T x, T shift)
+{
+    using U = typename std::make_unsigned<T>::type;
+    constexpr U numBits = static_cast<U>(sizeof(T) * 8);
+    constexpr U mask = static_cast<U>(numBits - 1);
+    U u = static_cast<U>(x);
+    U s = static_cast<U>(static_cast<U>(shift) & mask);
+    U r = static_cast<U>((numBits - s) & mask);
+    return static_cast<T>(static_cast<U>((u << s) | (u >> r)));
+}
+
+template<typename T>
+T BitIntrinsicRotateRight(T x, T shift)
+{
+    using U = typename std::make_unsigned<T>::type;
+    constexpr U numBits = static_cast<U>(sizeof(T) * 8);
+    constexpr U mask = static_cast<U>(numBits - 1);
+    U u = static_cast<U>(x);
+    U s = static_cast<U>(static_cast<U>(shift) & mask);
+    U r = static_cast<U>((numBits - s) & mask);
+    return static_cast<T>(static_cast<U>((u >> s) | (u << r)));
+}
+
+template<typename T>
+T BitIntrinsicMulHi(T lhs, T rhs)
+{
+    if constexpr(sizeof(T) == 8)
+    {
+        using W = typename std::conditional<std::is_signed<T>::value, __int128_t, __uint128_t>::type;
+        return static_cast<T>((static_cast<W>(lhs) * static_cast<W>(rhs)) >> 64);
+    }
+    else
+    {
+        using W = typename std::conditional<std::is_signed<T>::value, int64_t, uint64_t>::type;
+        return static_cast<T>((static_cast<W>(lhs) * static_cast<W>(rhs)) >> (sizeof(T) * 8));
+    }
+}
+
+// The CRC32 instruction is emitted by inline assembly, since the project is not built with '-msse4.2'.
+// It must only be executed if BitIntrinsicUseHardwareCrc32() is true.
+//
+template<typename T>
+uint32_t BitIntrinsicCrc32Hardware(uint32_t crc, T data) noexcept
+{
+    if constexpr(sizeof(T) == 1)
+    {
+        asm("crc32b %1, %0" : "+r"(crc) : "rm"(static_cast<uint8_t>(data)));
+        return crc;
+    }
+    else if constexpr(sizeof(T) == 2)
+    {
+        asm("crc32w %1, %0" : "+r"(crc) : "rm"(static_cast<uint16_t>(data)));
+        return crc;
+    }
+    else if constexpr(sizeof(T) == 4)
+    {
+        asm("crc32l %1, %0" : "+r"(crc) : "rm"(static_cast<uint32_t>(data)));
+        return crc;
+    }
+    else
+    {
+        static_assert(sizeof(T) == 8);
+        // The 64-bit form operates on a 64-bit register, whose high half is zeroed
+        //
+        uint64_t crc64 = crc;
+        asm("crc32q %1, %0" : "+r"(crc64) : "rm"(static_cast<uint64_t>(data)));
+        return static_cast<uint32_t>(crc64);
+    }
+}
+
+namespace internal
+{
+
+// The reflected CRC-32C polynomial, one table entry per byte value
+//
+constexpr std::array<uint32_t, 256> MakeCrc32cTable()
+{
+    std::array<uint32_t, 256> table {};
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+        {
+            c = (c & 1) ? ((c >> 1) ^ 0x82F63B78U) : (c >> 1);
+        }
+        table[i] = c;
+    }
+    return table;
+}
+
+}   // namespace internal
+
+inline constexpr std::array<uint32_t, 256> x_crc32cTable = internal::MakeCrc32cTable();
+
+// Same result as BitIntrinsicCrc32Hardware: the instruction consumes the bytes of 'data' from the lowest one
+//
+template<typename T>
+uint32_t BitIntrinsicCrc32Software(uint32_t crc, T data) noexcept
+{
+    using U = typename std::make_unsigned<T>::type;
+    uint64_t bytes = static_cast<uint64_t>(static_cast<U>(data));
+    for (size_t i = 0; i < sizeof(T); i++)
+    {
+        crc = x_crc32cTable[(crc ^ static_cast<uint32_t>(bytes)) & 0xFFU] ^ (crc >> 8);
+        bytes >>= 8;
+    }
+    return crc;
+}
+
+// True if the host supports SSE4.2 and the software implementation is not forced.
+// Decides how generated code computes CRC32, so it must not change while code is being generated.
+// Defined in bit_intrinsic_expr.cpp, it is not available to the FastInterp boilerplates.
+//
+bool BitIntrinsicUseHardwareCrc32();
+
+// For tests: use the software implementation even if the host supports SSE4.2
+//
+void BitIntrinsicForceSoftwareCrc32(bool value);
+
+template<typename T>
+uint32_t BitIntrinsicCrc32(uint32_t crc, T data)
+{
+    if (likely(BitIntrinsicUseHardwareCrc32()))
+    {
+        return BitIntrinsicCrc32Hardware(crc, data);
+    }
+    else
+    {
+        return BitIntrinsicCrc32Software(crc, data);
+    }
+}
+
+// Evaluates a unary intrinsic, or a binary intrinsic other than CRC32
+//
+template<typename T>
+T EvaluateBitIntrinsic(AstBitIntrinsicExprType op, T lhs, T rhs)
+{
+    switch (op)
+    {
+    case AstBitIntrinsicExprType::POPCOUNT: { return BitIntrinsicPopCount(lhs); }
+    case AstBitIntrinsicExprType::CLZ: { return BitIntrinsicCountLeadingZeros(lhs); }
+    case AstBitIntrinsicExprType::CTZ: { return BitIntrinsicCountTrailingZeros(lhs); }
+    case AstBitIntrinsicExprType::BSWAP: { return BitIntrinsicByteSwap(lhs); }
+    case AstBitIntrinsicExprType::ROTL: { return BitIntrinsicRotateLeft(lhs, rhs); }
+    case AstBitIntrinsicExprType::ROTR: { return BitIntrinsicRotateRight(lhs, rhs); }
+    case AstBitIntrinsicExprType::MULHI: { return BitIntrinsicMulHi(lhs, rhs); }
+    case AstBitIntrinsicExprType::CRC32:
+    case AstBitIntrinsicExprType::X_END_OF_ENUM: { break; }
+    }   /*switch*/
+    TestAssert(false);
+    __builtin_unreachable();
+}
+
+}   // namespace PochiVM
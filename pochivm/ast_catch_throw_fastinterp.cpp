@@ -61,6 +61,7 @@ FastInterpSnippet WARN_UNUSED AstThrowStmt::PrepareForFastInterp(FISpillLocation
         FastInterpBoilerplateInstance* inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
                     FastInterpBoilerplateLibrary<FIThrowExceptionImpl>::SelectBoilerplateBluePrint(
                         true /*isQuickAccess*/));
+        inst->MarkAsColdPathEntry();
         inst->PopulateBoilerplateFnPtrPlaceholder(1, enterCppInst);
         snippet = snippet.AddContinuation(inst);
 
@@ -127,6 +128,7 @@ FastInterpSnippet WARN_UNUSED AstThrowStmt::PrepareForFastInterp(FISpillLocation
         FastInterpBoilerplateInstance* inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
                     FastInterpBoilerplateLibrary<FIThrowExceptionImpl>::SelectBoilerplateBluePrint(
                         false /*isQuickAccess*/));
+        inst->MarkAsColdPathEntry();
         inst->PopulateConstantPlaceholder<uint64_t>(0, offset);
         inst->PopulateBoilerplateFnPtrPlaceholder(1, enterCppInst);
         snippet = snippet.AddContinuation(inst);
@@ -137,7 +139,7 @@ FastInterpSnippet WARN_UNUSED AstThrowStmt::PrepareForFastInterp(FISpillLocation
         FastInterpBoilerplateInstance* cleanup = thread_pochiVMContext->m_scopedVariableManager.FIGenerateEHEntryPointForCurrentPosition();
         inst->PopulateBoilerplateFnPtrPlaceholder(0, cleanup);
 
-        thread_pochiVMContext->m_fastInterpStackFrameManager->PopLocalVar(variable.GetTypeId().RemovePointer());
+        thread_pochiVMContext->m_fastInterpStackFrameManager->PopLocalVar(variable.GetTypeId().RemovePointer(), offset);
 
         return FastInterpSnippet {
             snippet.m_entry, FIGetNoopBoilerplate()
@@ -0,0 +1,310 @@
+#pragma once
+
+#include "function_proto.h"
+#include "arith_expr.h"
+#include "cast_expr.h"
+#include "common_expr.h"
+#include "logical_operator.h"
+#include "lang_constructs.h"
+#include "atomic_expr.h"
+#include "bit_intrinsic_expr.h"
+
+namespace PochiVM
+{
+
+// Deep-copies a piece of AST into function 'owner', remapping every variable to a fresh variable of 'owner'.
+// Used by AST-level transformations (inlining, OSR continuations), which need to copy code since
+// an AST node cannot appear twice in the tree.
+//
+// Only a subset of node types is supported: primitive and pointer expressions, variables without
+// non-trivial constructors or destructors, control flow statements and function calls that do not use sret.
+// Callers must check that the code to clone only consists of such nodes, see IsCloneSupported().
+//
+class AstCloneHelper
+{
+public:
+    AstCloneHelper(AstFunction* owner)
+        : m_owner(owner)
+        , m_varMap()
+    { }
+
+    virtual ~AstCloneHelper() = default;
+
+    // Returns whether 'node' (not including its children) may be cloned by this class
+    //
+    static bool IsCloneSupported(AstNodeBase* node)
+    {
+        switch (static_cast<int>(node->GetAstNodeType()))
+        {
+        case AstNodeType::AstArithmeticExpr:
+        case AstNodeType::AstComparisonExpr:
+        case AstNodeType::AstStaticCastExpr:
+        case AstNodeType::AstReinterpretCastExpr:
+        case AstNodeType::AstDereferenceExpr:
+        case AstNodeType::AstLiteralExpr:
+        case AstNodeType::AstAssignExpr:
+        case AstNodeType::AstDereferenceVariableExpr:
+        case AstNodeType::AstBlock:
+        case AstNodeType::AstScope:
+        case AstNodeType::AstIfStatement:
+        case AstNodeType::AstWhileLoop:
+        case AstNodeType::AstForLoop:
+        case AstNodeType::AstBreakOrContinueStmt:
+        case AstNodeType::AstReturnStmt:
+        case AstNodeType::AstLogicalAndOrExpr:
+        case AstNodeType::AstLogicalNotExpr:
+        case AstNodeType::AstPointerArithmeticExpr:
+        case AstNodeType::AstAtomicExpr:
+        case AstNodeType::AstFenceStmt:
+        case AstNodeType::AstBitIntrinsicExpr:
+        {
+            return true;
+        }
+        case AstNodeType::AstVariable:
+        {
+            return !node->GetTypeId().RemovePointer().IsCppClassType();
+        }
+        case AstNodeType::AstDeclareVariable:
+        {
+            return assert_cast<AstDeclareVariable*>(node)->m_callExpr == nullptr;
+        }
+        case AstNodeType::AstCallExpr:
+        {
+            AstCallExpr* e = assert_cast<AstCallExpr*>(node);
+            return !e->IsCppFunction() || !e->GetCppFunctionMetadata()->m_isUsingSret;
+        }
+        default:
+        {
+            return false;
+        }
+        }   /*switch*/
+    }
+
+    AstVariable* MapVariable(AstVariable* var)
+    {
+        auto it = m_varMap.find(var);
+        if (it != m_varMap.end())
+        {
+            return it->second;
+        }
+        AstVariable* newVar = new AstVariable(var->GetTypeId(), m_owner, m_owner->GetNextVarSuffix(), var->GetVarNameNoSuffix());
+        m_varMap[var] = newVar;
+        return newVar;
+    }
+
+    AstScope* CloneScope(AstScope* scope)
+    {
+        return assert_cast<AstScope*>(Clone(scope));
+    }
+
+    AstBlock* CloneBlock(AstBlock* block)
+    {
+        return assert_cast<AstBlock*>(Clone(block));
+    }
+
+    AstNodeBase* Clone(AstNodeBase* node)
+    {
+        TestAssert(IsCloneSupported(node));
+        switch (static_cast<int>(node->GetAstNodeType()))
+        {
+        case AstNodeType::AstArithmeticExpr:
+        {
+            AstArithmeticExpr* e = assert_cast<AstArithmeticExpr*>(node);
+            return new AstArithmeticExpr(e->GetOp(), Clone(e->GetLhs()), Clone(e->GetRhs()));
+        }
+        case AstNodeType::AstComparisonExpr:
+        {
+            AstComparisonExpr* e = assert_cast<AstComparisonExpr*>(node);
+            return new AstComparisonExpr(e->GetOp(), Clone(e->GetLhs()), Clone(e->GetRhs()));
+        }
+        case AstNodeType::AstStaticCastExpr:
+        {
+            AstStaticCastExpr* e = assert_cast<AstStaticCastExpr*>(node);
+            return new AstStaticCastExpr(Clone(e->GetOperand()), e->GetTypeId());
+        }
+        case AstNodeType::AstReinterpretCastExpr:
+        {
+            AstReinterpretCastExpr* e = assert_cast<AstReinterpretCastExpr*>(node);
+            return new AstReinterpretCastExpr(Clone(e->GetOperand()), e->GetTypeId());
+        }
+        case AstNodeType::AstDereferenceExpr:
+        {
+            AstDereferenceExpr* e = assert_cast<AstDereferenceExpr*>(node);
+            return new AstDereferenceExpr(Clone(e->GetOperand()));
+        }
+        case AstNodeType::AstLiteralExpr:
+        {
+            // The literal value is stored at the lowest bytes
+            //
+            AstLiteralExpr* e = assert_cast<AstLiteralExpr*>(node);
+            uint64_t value = e->GetAsU64();
+            return new AstLiteralExpr(e->GetTypeId(), &value);
+        }
+        case AstNodeType::AstAssignExpr:
+        {
+            AstAssignExpr* e = assert_cast<AstAssignExpr*>(node);
+            return new AstAssignExpr(Clone(e->GetDst()), Clone(e->GetSrc()));
+        }
+        case AstNodeType::AstVariable:
+        {
+            return CloneVariable(assert_cast<AstVariable*>(node));
+        }
+        case AstNodeType::AstDeclareVariable:
+        {
+            return CloneDeclareVariable(assert_cast<AstDeclareVariable*>(node));
+        }
+        case AstNodeType::AstDereferenceVariableExpr:
+        {
+            return CloneDereferenceVariableExpr(assert_cast<AstDereferenceVariableExpr*>(node));
+        }
+        case AstNodeType::AstBlock:
+        {
+            std::vector<AstNodeBase*> contents;
+            for (AstNodeBase* stmt : assert_cast<AstBlock*>(node)->GetContents())
+            {
+                contents.push_back(Clone(stmt));
+            }
+            return new AstBlock(contents);
+        }
+        case AstNodeType::AstScope:
+        {
+            std::vector<AstNodeBase*> contents;
+            for (AstNodeBase* stmt : assert_cast<AstScope*>(node)->GetContents())
+            {
+                contents.push_back(Clone(stmt));
+            }
+            return new AstScope(contents);
+        }
+        case AstNodeType::AstIfStatement:
+        {
+            AstIfStatement* e = assert_cast<AstIfStatement*>(node);
+            AstIfStatement* result = new AstIfStatement(Clone(e->GetCondClause()), CloneScope(e->GetThenClause()));
+            if (e->HasElseClause())
+            {
+                result->SetElseClause(CloneScope(e->GetElseClause()));
+            }
+            return result;
+        }
+        case AstNodeType::AstWhileLoop:
+        {
+            AstWhileLoop* e = assert_cast<AstWhileLoop*>(node);
+            return new AstWhileLoop(Clone(e->GetCondClause()), CloneScope(e->GetBody()));
+        }
+        case AstNodeType::AstForLoop:
+        {
+            AstForLoop* e = assert_cast<AstForLoop*>(node);
+            AstBlock* initBlock = CloneBlock(e->GetInitBlock());
+            AstNodeBase* cond = Clone(e->GetCondClause());
+            AstScope* body = CloneScope(e->GetBody());
+            AstBlock* stepBlock = CloneBlock(e->GetStepBlock());
+            return new AstForLoop(initBlock, cond, stepBlock, body);
+        }
+        case AstNodeType::AstBreakOrContinueStmt:
+        {
+            AstBreakOrContinueStmt* e = assert_cast<AstBreakOrContinueStmt*>(node);
+            return new AstBreakOrContinueStmt(e->IsBreakStatement());
+        }
+        case AstNodeType::AstReturnStmt:
+        {
+            return CloneReturnStmt(assert_cast<AstReturnStmt*>(node));
+        }
+        case AstNodeType::AstLogicalAndOrExpr:
+        {
+            AstLogicalAndOrExpr* e = assert_cast<AstLogicalAndOrExpr*>(node);
+            return new AstLogicalAndOrExpr(e->m_isAnd, Clone(e->m_lhs), Clone(e->m_rhs));
+        }
+        case AstNodeType::AstLogicalNotExpr:
+        {
+            AstLogicalNotExpr* e = assert_cast<AstLogicalNotExpr*>(node);
+            return new AstLogicalNotExpr(Clone(e->m_op));
+        }
+        case AstNodeType::AstPointerArithmeticExpr:
+        {
+            AstPointerArithmeticExpr* e = assert_cast<AstPointerArithmeticExpr*>(node);
+            return new AstPointerArithmeticExpr(Clone(e->m_base), Clone(e->m_index), e->m_isAddition);
+        }
+        case AstNodeType::AstAtomicExpr:
+        {
+            AstAtomicExpr* e = assert_cast<AstAtomicExpr*>(node);
+            AstNodeBase* ptr = Clone(e->GetPtr());
+            AstNodeBase* expected = (e->GetExpected() == nullptr) ? nullptr : Clone(e->GetExpected());
+            AstNodeBase* value = (e->GetValue() == nullptr) ? nullptr : Clone(e->GetValue());
+            return new AstAtomicExpr(e->GetOp(), e->GetMemoryOrder(), ptr, expected, value);
+        }
+        case AstNodeType::AstFenceStmt:
+        {
+            return new AstFenceStmt(assert_cast<AstFenceStmt*>(node)->GetMemoryOrder());
+        }
+        case AstNodeType::AstBitIntrinsicExpr:
+        {
+            AstBitIntrinsicExpr* e = assert_cast<AstBitIntrinsicExpr*>(node);
+            AstNodeBase* lhs = Clone(e->GetLhs());
+            AstNodeBase* rhs = (e->GetRhs() == nullptr) ? nullptr : Clone(e->GetRhs());
+            return new AstBitIntrinsicExpr(e->GetOp(), lhs, rhs);
+        }
+        case AstNodeType::AstCallExpr:
+        {
+            AstCallExpr* e = assert_cast<AstCallExpr*>(node);
+            std::vector<AstNodeBase*> params;
+            for (AstNodeBase* param : e->GetParams())
+            {
+                params.push_back(Clone(param));
+            }
+            if (e->IsCppFunction())
+            {
+                return new AstCallExpr(e->GetCppFunctionMetadata(), params);
+            }
+            else
+            {
+                return new AstCallExpr(e->GetFnName(), params, e->GetTypeId());
+            }
+        }
+        default:
+        {
+            TestAssert(false);
+            __builtin_unreachable();
+        }
+        }   /*switch*/
+    }
+
+protected:
+    // Override to change how return statements are cloned. By default it is cloned as-is.
+    //
+    virtual AstNodeBase* CloneReturnStmt(AstReturnStmt* node)
+    {
+        return new AstReturnStmt(node->m_retVal == nullptr ? nullptr : Clone(node->m_retVal), node->IsTailCall());
+    }
+
+    // Override to change how variables are cloned. By default each variable is mapped to a fresh variable of 'owner'.
+    // An override of CloneVariable() that does not return an AstVariable must also override the other two.
+    //
+    virtual AstNodeBase* CloneVariable(AstVariable* var)
+    {
+        return MapVariable(var);
+    }
+
+    virtual AstNodeBase* CloneDeclareVariable(AstDeclareVariable* node)
+    {
+        AstVariable* var = MapVariable(node->m_variable);
+        if (node->m_assignExpr == nullptr)
+        {
+            return new AstDeclareVariable(var);
+        }
+        else
+        {
+            return new AstDeclareVariable(var, new AstAssignExpr(var, Clone(node->m_assignExpr->GetSrc())));
+        }
+    }
+
+    virtual AstNodeBase* CloneDereferenceVariableExpr(AstDereferenceVariableExpr* node)
+    {
+        return new AstDereferenceVariableExpr(MapVariable(node->GetOperand()));
+    }
+
+    AstFunction* m_owner;
+
+private:
+    std::unordered_map<AstVariable*, AstVariable*> m_varMap;
+};
+
+}   // namespace PochiVM
@@ -47,7 +47,11 @@ public:
         AstRvalueToConstPrimitiveRefExpr,
         AstExceptionAddressPlaceholder,
         AstPointerArithmeticExpr,
-        AstGeneratedFunctionPointerExpr
+        AstGeneratedFunctionPointerExpr,
+        AstYieldStmt,
+        AstAtomicExpr,
+        AstFenceStmt,
+        AstBitIntrinsicExpr
     };
 
     AstNodeType() {}
@@ -89,6 +93,10 @@ public:
         case AstNodeType::AstExceptionAddressPlaceholder: return "AstExceptionAddressPlaceholder";
         case AstNodeType::AstPointerArithmeticExpr: return "AstPointerArithmeticExpr";
         case AstNodeType::AstGeneratedFunctionPointerExpr: return "AstGeneratedFunctionPointerExpr";
+        case AstNodeType::AstYieldStmt: return "AstYieldStmt";
+        case AstNodeType::AstAtomicExpr: return "AstAtomicExpr";
+        case AstNodeType::AstFenceStmt: return "AstFenceStmt";
+        case AstNodeType::AstBitIntrinsicExpr: return "AstBitIntrinsicExpr";
         }
         __builtin_unreachable();
     }
@@ -110,6 +118,13 @@ public:
     }
     virtual ~AstNodeBase() {}
 
+    // AST nodes are allocated from the arena of the current module, and freed in bulk when the module
+    // is destroyed (see AstModule::AllocateAstNodeMemory). A node must never be deleted individually.
+    //
+    static void* operator new(size_t size);
+    static void* operator new(size_t /*size*/, void* ptr) { return ptr; }
+    static void operator delete(void* /*ptr*/) { }
+
     // TODO: outdated
     // EmitIR() is the wrapper which handles the case that the node (which must be variable
     // node, const variable node or literal node) gets used multiple times in AST.
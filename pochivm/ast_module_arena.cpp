@@ -0,0 +1,99 @@
+#include "function_proto.h"
+#include "pochivm_context.h"
+
+namespace PochiVM
+{
+
+// The header in front of each AST node allocated in a module arena.
+// Its size keeps the node aligned to the default new alignment.
+//
+static constexpr size_t x_astNodeHeaderSize = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+static_assert(x_astNodeHeaderSize >= sizeof(uintptr_t));
+
+void* AstNodeBase::operator new(size_t size)
+{
+    // The node is owned by the current module, and freed with it. AstNodeBase::operator delete is a no-op,
+    // so a node created outside of any module would never be freed. Without a module there is also
+    // nowhere to allocate from, so this is checked in release builds as well.
+    //
+    ReleaseAssert(thread_pochiVMContext != nullptr && thread_pochiVMContext->m_curModule != nullptr &&
+               "AST nodes may only be created while a module is current");
+    return thread_pochiVMContext->m_curModule->AllocateAstNodeMemory(size);
+}
+
+void* AstModule::AllocateAstNodeMemory(size_t size)
+{
+    uintptr_t header;
+    if (unlikely(m_allocateAstNodesFromHeap))
+    {
+        header = reinterpret_cast<uintptr_t>(::operator new(x_astNodeHeaderSize + size));
+    }
+    else
+    {
+        header = reinterpret_cast<uintptr_t>(
+                    m_astAllocator.Allocate(__STDCPP_DEFAULT_NEW_ALIGNMENT__, x_astNodeHeaderSize + size));
+    }
+    *reinterpret_cast<uintptr_t*>(header) = m_astNodeListHead;
+    m_astNodeListHead = header;
+    return reinterpret_cast<void*>(header + x_astNodeHeaderSize);
+}
+
+void AstModule::DestroyAllFunctions()
+{
+    // The destructors only release memory owned by the nodes (e.g. the std::vector of an AstBlock).
+    // All AST node classes have AstNodeBase as their first base class, so the node starts right after its header.
+    //
+    while (m_astNodeListHead != 0)
+    {
+        uintptr_t next = *reinterpret_cast<uintptr_t*>(m_astNodeListHead);
+        AstNodeBase* node = reinterpret_cast<AstNodeBase*>(m_astNodeListHead + x_astNodeHeaderSize);
+        node->~AstNodeBase();
+        if (m_allocateAstNodesFromHeap)
+        {
+            ::operator delete(reinterpret_cast<void*>(m_astNodeListHead));
+        }
+        m_astNodeListHead = next;
+    }
+    // The keys of m_functions point into the function names, so it must be cleared first
+    //
+    m_functions.clear();
+    m_nextFnNameSuffix.clear();
+    for (AstFunction* fn : m_functionList)
+    {
+        fn->~AstFunction();
+    }
+    m_functionList.clear();
+    m_curGenFunctionList.clear();
+    m_functionListSorted = true;
+    m_astAllocator.Reset();
+}
+
+AstModule::~AstModule()
+{
+    // A module may only be destroyed by the thread it is attached to (if any)
+    //
+    TestAssert(m_attachedContext.load() == nullptr || IsAttachedToCurrentThread());
+
+    DestroyAllFunctions();
+
+    // The OSR entries are read by the FastInterp programs, so they must outlive them
+    //
+    FreeFastInterpPrograms();
+    for (FastInterpOsrEntry* entry : m_fastInterpOsrEntries)
+    {
+        delete entry;
+    }
+    m_fastInterpOsrEntries.clear();
+    for (FastInterpOsrEntry* entry : m_oldFastInterpOsrEntries)
+    {
+        delete entry;
+    }
+    m_oldFastInterpOsrEntries.clear();
+
+    if (thread_pochiVMContext != nullptr && thread_pochiVMContext->m_curModule == this)
+    {
+        thread_pochiVMContext->m_curModule = nullptr;
+    }
+}
+
+}   // namespace PochiVM
@@ -0,0 +1,1048 @@
+#include "function_proto.h"
+#include "arith_expr.h"
+#include "cast_expr.h"
+#include "common_expr.h"
+#include "logical_operator.h"
+#include "lang_constructs.h"
+#include "atomic_expr.h"
+#include "bit_intrinsic_expr.h"
+
+namespace PochiVM
+{
+
+// The binary serialization format of AstModule.
+//
+// A module that takes long to build (e.g. generated from a large query plan) can be serialized once
+// and rebuilt by later runs by Deserialize(), which only allocates the nodes, skipping all the logic
+// of the code that built the module in the first place.
+//
+// All integers are encoded as LEB128 varints, and strings as their length followed by the bytes. The layout is:
+//
+//     magic, format version, number of C++ class types, number of functions
+//     for each function:
+//         name, return TypeId, isNoExcept, number of params, (TypeId, name) for each param
+//         number of statements in the function body, then each statement
+//
+// A node is encoded in pre-order: its AstNodeType, its own fields, then its children.
+// A variable is encoded as an index into the variables of the function (params first). The first reference
+// to a variable assigns it the next index, and is followed by its TypeId and name. C++ functions are
+// referenced in the same way by an index into a per-module table of their mangled symbol names, which
+// are the only identity of a C++ function that is stable across builds of the runtime library.
+// They are resolved against AstCppFunctionMetadataTable, which is generated with the runtime library.
+//
+// Limitations:
+//   (1) The TypeIds of C++ classes are only meaningful for the runtime library the data is produced with.
+//       As a sanity check, the data is rejected if the number of C++ class types does not match.
+//   (2) Literals are stored as raw bits, so a pointer literal is only meaningful in the same process.
+//   (3) Only the AST nodes supported by AstCloneHelper, plus a few simple expressions, can be serialized.
+//       In particular, no C++ objects with constructors or destructors, no exceptions, and no calls to
+//       C++ functions returning a C++ class by value (sret): such a call only exists as the initializer of
+//       a variable declaration, whose construction protocol is not serialized. Serialize() rejects them.
+//   (4) The data is checked for truncation and inconsistent references, but is otherwise trusted.
+//       It must have been produced by Serialize() of a trusted build. In particular, the operand types of
+//       the nodes are not checked here: the node constructors only check them by TestAssert, so data with
+//       mismatched types is undefined behavior in release builds, not a Deserialize() error.
+//
+
+static constexpr uint32_t x_astSerializationMagic = 0x4d565050;   // "PPVM"
+static constexpr uint32_t x_astSerializationFormatVersion = 1;
+
+namespace {
+
+class AstModuleSerializer
+{
+public:
+    AstModuleSerializer(std::vector<uint8_t>& out)
+        : m_out(out)
+        , m_varIndex()
+        , m_cppFunctionIndex()
+    { }
+
+    void WriteVarUInt(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            m_out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        m_out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void WriteString(const char* s, size_t len)
+    {
+        WriteVarUInt(len);
+        m_out.insert(m_out.end(), s, s + len);
+    }
+
+    void WriteTypeId(TypeId typeId)
+    {
+        WriteVarUInt(typeId.value);
+    }
+
+    bool WARN_UNUSED SerializeFunction(AstFunction* fn)
+    {
+        WriteString(fn->GetName().data(), fn->GetName().length());
+        WriteTypeId(fn->GetReturnType());
+        WriteVarUInt(fn->GetIsNoExcept() ? 1 : 0);
+        WriteVarUInt(fn->GetNumParams());
+        m_varIndex.clear();
+        for (AstVariable* param : fn->GetParamsVector())
+        {
+            const char* name = param->GetVarNameNoSuffix();
+            WriteTypeId(param->GetTypeId().RemovePointer());
+            WriteString(name, strlen(name));
+            uint32_t index = static_cast<uint32_t>(m_varIndex.size());
+            m_varIndex[param] = index;
+        }
+        const std::vector<AstNodeBase*>& body = fn->GetFunctionBody()->GetContents();
+        WriteVarUInt(body.size());
+        for (AstNodeBase* stmt : body)
+        {
+            CHECK_ERR(SerializeNode(fn, stmt));
+        }
+        RETURN_TRUE;
+    }
+
+private:
+    void WriteVariable(AstVariable* var)
+    {
+        auto it = m_varIndex.find(var);
+        if (it != m_varIndex.end())
+        {
+            WriteVarUInt(it->second);
+            return;
+        }
+        uint32_t index = static_cast<uint32_t>(m_varIndex.size());
+        m_varIndex[var] = index;
+        const char* name = var->GetVarNameNoSuffix();
+        WriteVarUInt(index);
+        WriteTypeId(var->GetTypeId());
+        WriteString(name, strlen(name));
+    }
+
+    void WriteCppFunction(const CppFunctionMetadata* md)
+    {
+        auto it = m_cppFunctionIndex.find(md);
+        if (it != m_cppFunctionIndex.end())
+        {
+            WriteVarUInt(it->second);
+            return;
+        }
+        uint32_t index = static_cast<uint32_t>(m_cppFunctionIndex.size());
+        m_cppFunctionIndex[md] = index;
+        const char* symbol = md->m_bitcodeData->m_symbolName;
+        WriteVarUInt(index);
+        WriteString(symbol, strlen(symbol));
+        WriteVarUInt(md->m_functionOrdinal);
+    }
+
+    bool WARN_UNUSED SerializeChildren(AstFunction* fn, const std::vector<AstNodeBase*>& nodes)
+    {
+        WriteVarUInt(nodes.size());
+        for (AstNodeBase* node : nodes)
+        {
+            CHECK_ERR(SerializeNode(fn, node));
+        }
+        RETURN_TRUE;
+    }
+
+    bool WARN_UNUSED SerializeNode(AstFunction* fn, AstNodeBase* node)
+    {
+        AstNodeType nodeType = node->GetAstNodeType();
+        bool isSupported = IsSerializationSupported(node);
+        CHECK_REPORT_ERR(isSupported, "Function %s: AST node %s is not supported by module serialization",
+                         fn->GetName().c_str(), nodeType.ToString());
+
+        WriteVarUInt(static_cast<uint64_t>(static_cast<int>(nodeType)));
+        switch (static_cast<int>(nodeType))
+        {
+        case AstNodeType::AstArithmeticExpr:
+        {
+            AstArithmeticExpr* e = assert_cast<AstArithmeticExpr*>(node);
+            WriteVarUInt(static_cast<uint64_t>(e->GetOp()));
+            CHECK_ERR(SerializeNode(fn, e->GetLhs()));
+            CHECK_ERR(SerializeNode(fn, e->GetRhs()));
+            break;
+        }
+        case AstNodeType::AstComparisonExpr:
+        {
+            AstComparisonExpr* e = assert_cast<AstComparisonExpr*>(node);
+            WriteVarUInt(static_cast<uint64_t>(e->GetOp()));
+            CHECK_ERR(SerializeNode(fn, e->GetLhs()));
+            CHECK_ERR(SerializeNode(fn, e->GetRhs()));
+            break;
+        }
+        case AstNodeType::AstStaticCastExpr:
+        {
+            AstStaticCastExpr* e = assert_cast<AstStaticCastExpr*>(node);
+            WriteTypeId(e->GetTypeId());
+            CHECK_ERR(SerializeNode(fn, e->GetOperand()));
+            break;
+        }
+        case AstNodeType::AstReinterpretCastExpr:
+        {
+            AstReinterpretCastExpr* e = assert_cast<AstReinterpretCastExpr*>(node);
+            WriteTypeId(e->GetTypeId());
+            CHECK_ERR(SerializeNode(fn, e->GetOperand()));
+            break;
+        }
+        case AstNodeType::AstDereferenceExpr:
+        {
+            CHECK_ERR(SerializeNode(fn, assert_cast<AstDereferenceExpr*>(node)->GetOperand()));
+            break;
+        }
+        case AstNodeType::AstLiteralExpr:
+        {
+            AstLiteralExpr* e = assert_cast<AstLiteralExpr*>(node);
+            WriteTypeId(e->GetTypeId());
+            WriteVarUInt(e->GetAsU64());
+            break;
+        }
+        case AstNodeType::AstAssignExpr:
+        {
+            AstAssignExpr* e = assert_cast<AstAssignExpr*>(node);
+            CHECK_ERR(SerializeNode(fn, e->GetDst()));
+            CHECK_ERR(SerializeNode(fn, e->GetSrc()));
+            break;
+        }
+        case AstNodeType::AstNullptrExpr:
+        {
+            WriteTypeId(node->GetTypeId());
+            break;
+        }
+        case AstNodeType::AstVariable:
+        {
+            WriteVariable(assert_cast<AstVariable*>(node));
+            break;
+        }
+        case AstNodeType::AstDeclareVariable:
+        {
+            AstDeclareVariable* e = assert_cast<AstDeclareVariable*>(node);
+            WriteVariable(e->m_variable);
+            if (e->m_assignExpr == nullptr)
+            {
+                WriteVarUInt(0);
+            }
+            else
+            {
+                WriteVarUInt(1);
+                CHECK_ERR(SerializeNode(fn, e->m_assignExpr->GetSrc()));
+            }
+            break;
+        }
+        case AstNodeType::AstDereferenceVariableExpr:
+        {
+            WriteVariable(assert_cast<AstDereferenceVariableExpr*>(node)->GetOperand());
+            break;
+        }
+        case AstNodeType::AstBlock:
+        {
+            CHECK_ERR(SerializeChildren(fn, assert_cast<AstBlock*>(node)->GetContents()));
+            break;
+        }
+        case AstNodeType::AstScope:
+        {
+            CHECK_ERR(SerializeChildren(fn, assert_cast<AstScope*>(node)->GetContents()));
+            break;
+        }
+        case AstNodeType::AstIfStatement:
+        {
+            AstIfStatement* e = assert_cast<AstIfStatement*>(node);
+            WriteVarUInt(e->HasElseClause() ? 1 : 0);
+            CHECK_ERR(SerializeNode(fn, e->GetCondClause()));
+            CHECK_ERR(SerializeNode(fn, e->GetThenClause()));
+            if (e->HasElseClause())
+            {
+                CHECK_ERR(SerializeNode(fn, e->GetElseClause()));
+            }
+            break;
+        }
+        case AstNodeType::AstWhileLoop:
+        {
+            AstWhileLoop* e = assert_cast<AstWhileLoop*>(node);
+            CHECK_ERR(SerializeNode(fn, e->GetCondClause()));
+            CHECK_ERR(SerializeNode(fn, e->GetBody()));
+            break;
+        }
+        case AstNodeType::AstForLoop:
+        {
+            AstForLoop* e = assert_cast<AstForLoop*>(node);
+            CHECK_ERR(SerializeNode(fn, e->GetInitBlock()));
+            CHECK_ERR(SerializeNode(fn, e->GetCondClause()));
+            CHECK_ERR(SerializeNode(fn, e->GetStepBlock()));
+            CHECK_ERR(SerializeNode(fn, e->GetBody()));
+            break;
+        }
+        case AstNodeType::AstBreakOrContinueStmt:
+        {
+            WriteVarUInt(assert_cast<AstBreakOrContinueStmt*>(node)->IsBreakStatement() ? 1 : 0);
+            break;
+        }
+        case AstNodeType::AstCallExpr:
+        {
+            AstCallExpr* e = assert_cast<AstCallExpr*>(node);
+            if (e->IsCppFunction())
+            {
+                WriteVarUInt(1);
+                WriteCppFunction(e->GetCppFunctionMetadata());
+            }
+            else
+            {
+                WriteVarUInt(0);
+                WriteString(e->GetFnName().data(), e->GetFnName().length());
+                WriteTypeId(e->GetTypeId());
+            }
+            CHECK_ERR(SerializeChildren(fn, e->GetParams()));
+            break;
+        }
+        case AstNodeType::AstReturnStmt:
+        {
+            // 0: no return value, 1: with return value, 2: tail call
+            //
+            AstReturnStmt* e = assert_cast<AstReturnStmt*>(node);
+            if (e->m_retVal == nullptr)
+            {
+                WriteVarUInt(0);
+            }
+            else
+            {
+                WriteVarUInt(e->IsTailCall() ? 2 : 1);
+                CHECK_ERR(SerializeNode(fn, e->m_retVal));
+            }
+            break;
+        }
+        case AstNodeType::AstLogicalAndOrExpr:
+        {
+            AstLogicalAndOrExpr* e = assert_cast<AstLogicalAndOrExpr*>(node);
+            WriteVarUInt(e->m_isAnd ? 1 : 0);
+            CHECK_ERR(SerializeNode(fn, e->m_lhs));
+            CHECK_ERR(SerializeNode(fn, e->m_rhs));
+            break;
+        }
+        case AstNodeType::AstLogicalNotExpr:
+        {
+            CHECK_ERR(SerializeNode(fn, assert_cast<AstLogicalNotExpr*>(node)->m_op));
+            break;
+        }
+        case AstNodeType::AstRvalueToConstPrimitiveRefExpr:
+        {
+            CHECK_ERR(SerializeNode(fn, assert_cast<AstRvalueToConstPrimitiveRefExpr*>(node)->m_operand));
+            break;
+        }
+        case AstNodeType::AstPointerArithmeticExpr:
+        {
+            AstPointerArithmeticExpr* e = assert_cast<AstPointerArithmeticExpr*>(node);
+            WriteVarUInt(e->m_isAddition ? 1 : 0);
+            CHECK_ERR(SerializeNode(fn, e->m_base));
+            CHECK_ERR(SerializeNode(fn, e->m_index));
+            break;
+        }
+        case AstNodeType::AstGeneratedFunctionPointerExpr:
+        {
+            const std::string& target = assert_cast<AstGeneratedFunctionPointerExpr*>(node)->GetFnName();
+            WriteString(target.data(), target.length());
+            break;
+        }
+        case AstNodeType::AstAtomicExpr:
+        {
+            AstAtomicExpr* e = assert_cast<AstAtomicExpr*>(node);
+            WriteVarUInt(static_cast<uint64_t>(e->GetOp()));
+            WriteVarUInt(static_cast<uint64_t>(e->GetMemoryOrder()));
+            CHECK_ERR(SerializeNode(fn, e->GetPtr()));
+            if (e->GetExpected() != nullptr)
+            {
+                CHECK_ERR(SerializeNode(fn, e->GetExpected()));
+            }
+            if (e->GetValue() != nullptr)
+            {
+                CHECK_ERR(SerializeNode(fn, e->GetValue()));
+            }
+            break;
+        }
+        case AstNodeType::AstFenceStmt:
+        {
+            WriteVarUInt(static_cast<uint64_t>(assert_cast<AstFenceStmt*>(node)->GetMemoryOrder()));
+            break;
+        }
+        case AstNodeType::AstBitIntrinsicExpr:
+        {
+            AstBitIntrinsicExpr* e = assert_cast<AstBitIntrinsicExpr*>(node);
+            WriteVarUInt(static_cast<uint64_t>(e->GetOp()));
+            CHECK_ERR(SerializeNode(fn, e->GetLhs()));
+            if (e->GetRhs() != nullptr)
+            {
+                CHECK_ERR(SerializeNode(fn, e->GetRhs()));
+            }
+            break;
+        }
+        default:
+        {
+            TestAssert(false);
+            __builtin_unreachable();
+        }
+        }   /*switch*/
+        RETURN_TRUE;
+    }
+
+    // Returns whether 'node' (not including its children) may be serialized
+    //
+    static bool IsSerializationSupported(AstNodeBase* node)
+    {
+        switch (static_cast<int>(node->GetAstNodeType()))
+        {
+        case AstNodeType::AstArithmeticExpr:
+        case AstNodeType::AstComparisonExpr:
+        case AstNodeType::AstStaticCastExpr:
+        case AstNodeType::AstReinterpretCastExpr:
+        case AstNodeType::AstDereferenceExpr:
+        case AstNodeType::AstLiteralExpr:
+        case AstNodeType::AstAssignExpr:
+        case AstNodeType::AstNullptrExpr:
+        case AstNodeType::AstDereferenceVariableExpr:
+        case AstNodeType::AstBlock:
+        case AstNodeType::AstScope:
+        case AstNodeType::AstIfStatement:
+        case AstNodeType::AstWhileLoop:
+        case AstNodeType::AstForLoop:
+        case AstNodeType::AstBreakOrContinueStmt:
+        case AstNodeType::AstReturnStmt:
+        case AstNodeType::AstLogicalAndOrExpr:
+        case AstNodeType::AstLogicalNotExpr:
+        case AstNodeType::AstRvalueToConstPrimitiveRefExpr:
+        case AstNodeType::AstPointerArithmeticExpr:
+        case AstNodeType::AstGeneratedFunctionPointerExpr:
+        case AstNodeType::AstAtomicExpr:
+        case AstNodeType::AstFenceStmt:
+        case AstNodeType::AstBitIntrinsicExpr:
+        {
+            return true;
+        }
+        case AstNodeType::AstVariable:
+        {
+            return !node->GetTypeId().RemovePointer().IsCppClassType();
+        }
+        case AstNodeType::AstDeclareVariable:
+        {
+            return assert_cast<AstDeclareVariable*>(node)->m_callExpr == nullptr;
+        }
+        case AstNodeType::AstCallExpr:
+        {
+            AstCallExpr* e = assert_cast<AstCallExpr*>(node);
+            return !e->IsCppFunction() || !e->GetCppFunctionMetadata()->m_isUsingSret;
+        }
+        default:
+        {
+            return false;
+        }
+        }   /*switch*/
+    }
+
+    std::vector<uint8_t>& m_out;
+    // The index of each variable of the function being serialized
+    //
+    std::unordered_map<AstVariable*, uint32_t> m_varIndex;
+    // The index of each C++ function referenced so far
+    //
+    std::unordered_map<const CppFunctionMetadata*, uint32_t> m_cppFunctionIndex;
+};
+
+}   // anonymous namespace
+
+class AstModuleDeserializer
+{
+public:
+    AstModuleDeserializer(AstModule* module, const uint8_t* data, size_t size)
+        : m_module(module)
+        , m_cur(data)
+        , m_end(data + size)
+        , m_vars()
+        , m_cppFunctions()
+    { }
+
+    bool WARN_UNUSED Run()
+    {
+        uint64_t magic, version, numCppClassTypes, numFunctions;
+        CHECK_ERR(ReadVarUInt(magic));
+        CHECK_REPORT_ERR(magic == x_astSerializationMagic, "Module deserialization: bad magic number");
+        CHECK_ERR(ReadVarUInt(version));
+        CHECK_REPORT_ERR(version == x_astSerializationFormatVersion,
+                         "Module deserialization: unsupported format version %llu (expects %u)",
+                         static_cast<unsigned long long>(version), x_astSerializationFormatVersion);
+        CHECK_ERR(ReadVarUInt(numCppClassTypes));
+        CHECK_REPORT_ERR(numCppClassTypes == static_cast<uint64_t>(AstTypeHelper::x_num_cpp_class_types),
+                         "Module deserialization: data is produced with a different runtime library "
+                         "(%llu C++ class types, expects %d)",
+                         static_cast<unsigned long long>(numCppClassTypes), AstTypeHelper::x_num_cpp_class_types);
+        CHECK_ERR(ReadVarUInt(numFunctions));
+        for (uint64_t i = 0; i < numFunctions; i++)
+        {
+            CHECK_ERR(DeserializeFunction());
+        }
+        CHECK_REPORT_ERR(m_cur == m_end, "Module deserialization: unexpected trailing data");
+        RETURN_TRUE;
+    }
+
+private:
+    bool WARN_UNUSED ReadVarUInt(uint64_t& value /*out*/)
+    {
+        value = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7)
+        {
+            CHECK_REPORT_ERR(m_cur < m_end, "Module deserialization: unexpected end of data");
+            uint8_t byte = *m_cur;
+            m_cur++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                RETURN_TRUE;
+            }
+        }
+        REPORT_ERR("Module deserialization: malformed integer");
+        return false;
+    }
+
+    bool WARN_UNUSED ReadBool(bool& value /*out*/)
+    {
+        uint64_t v;
+        CHECK_ERR(ReadVarUInt(v));
+        CHECK_REPORT_ERR(v <= 1, "Module deserialization: malformed boolean");
+        value = (v == 1);
+        RETURN_TRUE;
+    }
+
+    bool WARN_UNUSED ReadString(std::string& value /*out*/)
+    {
+        uint64_t len;
+        CHECK_ERR(ReadVarUInt(len));
+        CHECK_REPORT_ERR(len <= static_cast<uint64_t>(m_end - m_cur), "Module deserialization: unexpected end of data");
+        value.assign(reinterpret_cast<const char*>(m_cur), len);
+        m_cur += len;
+        RETURN_TRUE;
+    }
+
+    // The variable names are not owned by AstVariable, so they are copied into the arena of the module
+    //
+    bool WARN_UNUSED ReadArenaString(const char*& value /*out*/)
+    {
+        uint64_t len;
+        CHECK_ERR(ReadVarUInt(len));
+        CHECK_REPORT_ERR(len <= static_cast<uint64_t>(m_end - m_cur), "Module deserialization: unexpected end of data");
+        char* s = reinterpret_cast<char*>(m_module->m_astAllocator.Allocate(1 /*alignment*/, len + 1));
+        memcpy(s, m_cur, len);
+        s[len] = '\0';
+        m_cur += len;
+        value = s;
+        RETURN_TRUE;
+    }
+
+    bool WARN_UNUSED ReadTypeId(TypeId& value /*out*/)
+    {
+        uint64_t v;
+        CHECK_ERR(ReadVarUInt(v));
+        value = TypeId(v);
+        CHECK_REPORT_ERR(!value.IsInvalid(), "Module deserialization: malformed TypeId %llu", static_cast<unsigned long long>(v));
+        RETURN_TRUE;
+    }
+
+    bool WARN_UNUSED ReadVariable(AstFunction* fn, AstVariable*& var /*out*/)
+    {
+        uint64_t index;
+        CHECK_ERR(ReadVarUInt(index));
+        if (index < m_vars.size())
+        {
+            var = m_vars[index];
+            RETURN_TRUE;
+        }
+        CHECK_REPORT_ERR(index == m_vars.size(), "Module deserialization: function %s: bad variable index %llu",
+                         fn->GetName().c_str(), static_cast<unsigned long long>(index));
+        TypeId typeId;
+        const char* name;
+        CHECK_ERR(ReadTypeId(typeId));
+        CHECK_REPORT_ERR(typeId.IsPointerType(), "Module deserialization: function %s: bad variable type", fn->GetName().c_str());
+        CHECK_ERR(ReadArenaString(name));
+        var = new AstVariable(typeId, fn, fn->GetNextVarSuffix(), name);
+        m_vars.push_back(var);
+        RETURN_TRUE;
+    }
+
+    bool WARN_UNUSED ReadCppFunction(const CppFunctionMetadata*& md /*out*/)
+    {
+        uint64_t index;
+        CHECK_ERR(ReadVarUInt(index));
+        if (index < m_cppFunctions.size())
+        {
+            md = m_cppFunctions[index];
+            RETURN_TRUE;
+        }
+        CHECK_REPORT_ERR(index == m_cppFunctions.size(), "Module deserialization: bad C++ function index %llu",
+                         static_cast<unsigned long long>(index));
+        std::string symbol;
+        uint64_t ordinal;
+        CHECK_ERR(ReadString(symbol));
+        CHECK_ERR(ReadVarUInt(ordinal));
+        // The ordinal is only a hint: it is the same unless the runtime library is rebuilt
+        //
+        md = nullptr;
+        if (ordinal < static_cast<uint64_t>(AstTypeHelper::x_num_cpp_functions) &&
+            symbol == AstCppFunctionMetadataTable[ordinal]->m_bitcodeData->m_symbolName)
+        {
+            md = AstCppFunctionMetadataTable[ordinal];
+        }
+        for (int i = 0; md == nullptr && i < AstTypeHelper::x_num_cpp_functions; i++)
+        {
+            if (symbol == AstCppFunctionMetadataTable[i]->m_bitcodeData->m_symbolName)
+            {
+                md = AstCppFunctionMetadataTable[i];
+            }
+        }
+        CHECK_REPORT_ERR(md != nullptr, "Module deserialization: C++ function %s is unknown to the runtime library",
+                         symbol.c_str());
+        CHECK_REPORT_ERR(!md->m_isUsingSret, "Module deserialization: C++ function %s uses sret", symbol.c_str());
+        m_cppFunctions.push_back(md);
+        RETURN_TRUE;
+    }
+
+    bool WARN_UNUSED DeserializeFunction()
+    {
+        std::string name;
+        TypeId returnType;
+        bool isNoExcept;
+        uint64_t numParams;
+        CHECK_ERR(ReadString(name));
+        CHECK_REPORT_ERR(m_module->GetAstFunction(name) == nullptr, "Module deserialization: duplicate function %s", name.c_str());
+        CHECK_ERR(ReadTypeId(returnType));
+        CHECK_ERR(ReadBool(isNoExcept));
+        CHECK_ERR(ReadVarUInt(numParams));
+
+        AstFunction* fn = m_module->NewAstFunction(name);
+        fn->SetReturnType(returnType);
+        fn->SetIsNoExcept(isNoExcept);
+        for (uint64_t i = 0; i < numParams; i++)
+        {
+            TypeId paramType;
+            const char* paramName;
+            CHECK_ERR(ReadTypeId(paramType));
+            CHECK_ERR(ReadArenaString(paramName));
+            fn->AddParam(paramType, paramName);
+        }
+        m_vars = fn->GetParamsVector();
+
+        uint64_t numStmts;
+        CHECK_ERR(ReadVarUInt(numStmts));
+        for (uint64_t i = 0; i < numStmts; i++)
+        {
+            AstNodeBase* stmt;
+            CHECK_ERR(DeserializeStatement(fn, stmt));
+            fn->GetFunctionBody()->Append(stmt);
+        }
+        RETURN_TRUE;
+    }
+
+    bool WARN_UNUSED DeserializeStatement(AstFunction* fn, AstNodeBase*& node /*out*/)
+    {
+        CHECK_ERR(DeserializeNode(fn, node));
+        CHECK_REPORT_ERR(node->GetTypeId().IsVoid(), "Module deserialization: function %s: expression %s used as a statement",
+                         fn->GetName().c_str(), node->GetAstNodeType().ToString());
+        RETURN_TRUE;
+    }
+
+    bool WARN_UNUSED DeserializeStatementList(AstFunction* fn, std::vector<AstNodeBase*>& contents /*out*/)
+    {
+        uint64_t num;
+        CHECK_ERR(ReadVarUInt(num));
+        CHECK_REPORT_ERR(num <= static_cast<uint64_t>(m_end - m_cur), "Module deserialization: unexpected end of data");
+        contents.resize(num);
+        for (uint64_t i = 0; i < num; i++)
+        {
+            CHECK_ERR(DeserializeStatement(fn, contents[i]));
+        }
+        RETURN_TRUE;
+    }
+
+    template<typename T>
+    bool WARN_UNUSED DeserializeNodeOfType(AstFunction* fn, AstNodeType expectedType, T*& node /*out*/)
+    {
+        AstNodeBase* result;
+        CHECK_ERR(DeserializeNode(fn, result));
+        CHECK_REPORT_ERR(result->GetAstNodeType() == expectedType, "Module deserialization: function %s: expects %s, got %s",
+                         fn->GetName().c_str(), expectedType.ToString(), result->GetAstNodeType().ToString());
+        node = assert_cast<T*>(result);
+        RETURN_TRUE;
+    }
+
+    bool WARN_UNUSED DeserializeNode(AstFunction* fn, AstNodeBase*& node /*out*/)
+    {
+        uint64_t tag;
+        CHECK_ERR(ReadVarUInt(tag));
+        switch (tag)
+        {
+        case AstNodeType::AstArithmeticExpr:
+        {
+            uint64_t op;
+            AstNodeBase *lhs, *rhs;
+            CHECK_ERR(ReadVarUInt(op));
+            CHECK_REPORT_ERR(op < static_cast<uint64_t>(AstArithmeticExprType::X_END_OF_ENUM), "Module deserialization: bad operator");
+            CHECK_ERR(DeserializeNode(fn, lhs));
+            CHECK_ERR(DeserializeNode(fn, rhs));
+            node = new AstArithmeticExpr(static_cast<AstArithmeticExprType>(op), lhs, rhs);
+            break;
+        }
+        case AstNodeType::AstComparisonExpr:
+        {
+            uint64_t op;
+            AstNodeBase *lhs, *rhs;
+            CHECK_ERR(ReadVarUInt(op));
+            CHECK_REPORT_ERR(op < static_cast<uint64_t>(AstComparisonExprType::X_END_OF_ENUM), "Module deserialization: bad operator");
+            CHECK_ERR(DeserializeNode(fn, lhs));
+            CHECK_ERR(DeserializeNode(fn, rhs));
+            node = new AstComparisonExpr(static_cast<AstComparisonExprType>(op), lhs, rhs);
+            break;
+        }
+        case AstNodeType::AstStaticCastExpr:
+        {
+            TypeId typeId;
+            AstNodeBase* operand;
+            CHECK_ERR(ReadTypeId(typeId));
+            CHECK_ERR(DeserializeNode(fn, operand));
+            node = new AstStaticCastExpr(operand, typeId);
+            break;
+        }
+        case AstNodeType::AstReinterpretCastExpr:
+        {
+            TypeId typeId;
+            AstNodeBase* operand;
+            CHECK_ERR(ReadTypeId(typeId));
+            CHECK_ERR(DeserializeNode(fn, operand));
+            node = new AstReinterpretCastExpr(operand, typeId);
+            break;
+        }
+        case AstNodeType::AstDereferenceExpr:
+        {
+            AstNodeBase* operand;
+            CHECK_ERR(DeserializeNode(fn, operand));
+            node = new AstDereferenceExpr(operand);
+            break;
+        }
+        case AstNodeType::AstLiteralExpr:
+        {
+            // The literal value is stored at the lowest bytes
+            //
+            TypeId typeId;
+            uint64_t value;
+            CHECK_ERR(ReadTypeId(typeId));
+            CHECK_ERR(ReadVarUInt(value));
+            CHECK_REPORT_ERR(typeId.IsPrimitiveType() || typeId.IsPointerType(), "Module deserialization: bad literal type");
+            node = new AstLiteralExpr(typeId, &value);
+            break;
+        }
+        case AstNodeType::AstAssignExpr:
+        {
+            AstNodeBase *dst, *src;
+            CHECK_ERR(DeserializeNode(fn, dst));
+            CHECK_ERR(DeserializeNode(fn, src));
+            node = new AstAssignExpr(dst, src);
+            break;
+        }
+        case AstNodeType::AstNullptrExpr:
+        {
+            TypeId typeId;
+            CHECK_ERR(ReadTypeId(typeId));
+            node = new AstNullptrExpr(typeId);
+            break;
+        }
+        case AstNodeType::AstVariable:
+        {
+            AstVariable* var;
+            CHECK_ERR(ReadVariable(fn, var));
+            node = var;
+            break;
+        }
+        case AstNodeType::AstDeclareVariable:
+        {
+            AstVariable* var;
+            bool hasAssignExpr;
+            CHECK_ERR(ReadVariable(fn, var));
+            CHECK_ERR(ReadBool(hasAssignExpr));
+            if (hasAssignExpr)
+            {
+                AstNodeBase* src;
+                CHECK_ERR(DeserializeNode(fn, src));
+                node = new AstDeclareVariable(var, new AstAssignExpr(var, src));
+            }
+            else
+            {
+                node = new AstDeclareVariable(var);
+            }
+            break;
+        }
+        case AstNodeType::AstDereferenceVariableExpr:
+        {
+            AstVariable* var;
+            CHECK_ERR(ReadVariable(fn, var));
+            node = new AstDereferenceVariableExpr(var);
+            break;
+        }
+        case AstNodeType::AstBlock:
+        {
+            std::vector<AstNodeBase*> contents;
+            CHECK_ERR(DeserializeStatementList(fn, contents));
+            node = new AstBlock(contents);
+            break;
+        }
+        case AstNodeType::AstScope:
+        {
+            std::vector<AstNodeBase*> contents;
+            CHECK_ERR(DeserializeStatementList(fn, contents));
+            node = new AstScope(contents);
+            break;
+        }
+        case AstNodeType::AstIfStatement:
+        {
+            bool hasElseClause;
+            AstNodeBase* cond;
+            AstScope* thenClause;
+            CHECK_ERR(ReadBool(hasElseClause));
+            CHECK_ERR(DeserializeNode(fn, cond));
+            CHECK_ERR(DeserializeNodeOfType(fn, AstNodeType::AstScope, thenClause));
+            AstIfStatement* result = new AstIfStatement(cond, thenClause);
+            if (hasElseClause)
+            {
+                AstScope* elseClause;
+                CHECK_ERR(DeserializeNodeOfType(fn, AstNodeType::AstScope, elseClause));
+                result->SetElseClause(elseClause);
+            }
+            node = result;
+            break;
+        }
+        case AstNodeType::AstWhileLoop:
+        {
+            AstNodeBase* cond;
+            AstScope* body;
+            CHECK_ERR(DeserializeNode(fn, cond));
+            CHECK_ERR(DeserializeNodeOfType(fn, AstNodeType::AstScope, body));
+            node = new AstWhileLoop(cond, body);
+            break;
+        }
+        case AstNodeType::AstForLoop:
+        {
+            AstBlock *initBlock, *stepBlock;
+            AstNodeBase* cond;
+            AstScope* body;
+            CHECK_ERR(DeserializeNodeOfType(fn, AstNodeType::AstBlock, initBlock));
+            CHECK_ERR(DeserializeNode(fn, cond));
+            CHECK_ERR(DeserializeNodeOfType(fn, AstNodeType::AstBlock, stepBlock));
+            CHECK_ERR(DeserializeNodeOfType(fn, AstNodeType::AstScope, body));
+            node = new AstForLoop(initBlock, cond, stepBlock, body);
+            break;
+        }
+        case AstNodeType::AstBreakOrContinueStmt:
+        {
+            bool isBreak;
+            CHECK_ERR(ReadBool(isBreak));
+            node = new AstBreakOrContinueStmt(isBreak);
+            break;
+        }
+        case AstNodeType::AstCallExpr:
+        {
+            bool isCppFunction;
+            const CppFunctionMetadata* md = nullptr;
+            std::string fnName;
+            TypeId returnType;
+            CHECK_ERR(ReadBool(isCppFunction));
+            if (isCppFunction)
+            {
+                CHECK_ERR(ReadCppFunction(md));
+            }
+            else
+            {
+                CHECK_ERR(ReadString(fnName));
+                CHECK_ERR(ReadTypeId(returnType));
+            }
+            uint64_t numParams;
+            CHECK_ERR(ReadVarUInt(numParams));
+            CHECK_REPORT_ERR(numParams <= static_cast<uint64_t>(m_end - m_cur), "Module deserialization: unexpected end of data");
+            std::vector<AstNodeBase*> params(numParams);
+            for (uint64_t i = 0; i < numParams; i++)
+            {
+                CHECK_ERR(DeserializeNode(fn, params[i]));
+            }
+            if (isCppFunction)
+            {
+                CHECK_REPORT_ERR(numParams == md->m_numParams, "Module deserialization: call to C++ function %s: wrong number of parameters",
+                                 md->m_bitcodeData->m_symbolName);
+                node = new AstCallExpr(md, params);
+            }
+            else
+            {
+                node = new AstCallExpr(fnName, params, returnType);
+            }
+            break;
+        }
+        case AstNodeType::AstReturnStmt:
+        {
+            uint64_t kind;
+            AstNodeBase* retVal = nullptr;
+            CHECK_ERR(ReadVarUInt(kind));
+            CHECK_REPORT_ERR(kind <= 2, "Module deserialization: function %s: malformed return statement", fn->GetName().c_str());
+            if (kind > 0)
+            {
+                CHECK_ERR(DeserializeNode(fn, retVal));
+            }
+            if (kind == 2)
+            {
+                CHECK_REPORT_ERR(retVal->GetAstNodeType() == AstNodeType::AstCallExpr &&
+                                 !assert_cast<AstCallExpr*>(retVal)->IsCppFunction(),
+                                 "Module deserialization: function %s: malformed tail call", fn->GetName().c_str());
+            }
+            node = new AstReturnStmt(retVal, kind == 2 /*isTailCall*/);
+            break;
+        }
+        case AstNodeType::AstLogicalAndOrExpr:
+        {
+            bool isAnd;
+            AstNodeBase *lhs, *rhs;
+            CHECK_ERR(ReadBool(isAnd));
+            CHECK_ERR(DeserializeNode(fn, lhs));
+            CHECK_ERR(DeserializeNode(fn, rhs));
+            node = new AstLogicalAndOrExpr(isAnd, lhs, rhs);
+            break;
+        }
+        case AstNodeType::AstLogicalNotExpr:
+        {
+            AstNodeBase* operand;
+            CHECK_ERR(DeserializeNode(fn, operand));
+            node = new AstLogicalNotExpr(operand);
+            break;
+        }
+        case AstNodeType::AstRvalueToConstPrimitiveRefExpr:
+        {
+            AstNodeBase* operand;
+            CHECK_ERR(DeserializeNode(fn, operand));
+            node = new AstRvalueToConstPrimitiveRefExpr(operand);
+            break;
+        }
+        case AstNodeType::AstPointerArithmeticExpr:
+        {
+            bool isAddition;
+            AstNodeBase *base, *index;
+            CHECK_ERR(ReadBool(isAddition));
+            CHECK_ERR(DeserializeNode(fn, base));
+            CHECK_ERR(DeserializeNode(fn, index));
+            node = new AstPointerArithmeticExpr(base, index, isAddition);
+            break;
+        }
+        case AstNodeType::AstGeneratedFunctionPointerExpr:
+        {
+            std::string target;
+            CHECK_ERR(ReadString(target));
+            node = new AstGeneratedFunctionPointerExpr(target);
+            break;
+        }
+        case AstNodeType::AstAtomicExpr:
+        {
+            uint64_t op, order;
+            CHECK_ERR(ReadVarUInt(op));
+            CHECK_ERR(ReadVarUInt(order));
+            CHECK_REPORT_ERR(op < static_cast<uint64_t>(AstAtomicExprType::X_END_OF_ENUM) &&
+                             order < static_cast<uint64_t>(AstMemoryOrder::X_END_OF_ENUM) &&
+                             IsValidMemoryOrderForAtomicOp(static_cast<AstAtomicExprType>(op), static_cast<AstMemoryOrder>(order)),
+                             "Module deserialization: bad atomic operation");
+            AstNodeBase* ptr;
+            AstNodeBase* expected = nullptr;
+            AstNodeBase* value = nullptr;
+            CHECK_ERR(DeserializeNode(fn, ptr));
+            if (static_cast<AstAtomicExprType>(op) == AstAtomicExprType::COMPARE_EXCHANGE)
+            {
+                CHECK_ERR(DeserializeNode(fn, expected));
+            }
+            if (static_cast<AstAtomicExprType>(op) != AstAtomicExprType::LOAD)
+            {
+                CHECK_ERR(DeserializeNode(fn, value));
+            }
+            node = new AstAtomicExpr(static_cast<AstAtomicExprType>(op), static_cast<AstMemoryOrder>(order), ptr, expected, value);
+            break;
+        }
+        case AstNodeType::AstFenceStmt:
+        {
+            uint64_t order;
+            CHECK_ERR(ReadVarUInt(order));
+            CHECK_REPORT_ERR(order < static_cast<uint64_t>(AstMemoryOrder::X_END_OF_ENUM) && order != static_cast<uint64_t>(AstMemoryOrder::RELAXED),
+                             "Module deserialization: bad memory order");
+            node = new AstFenceStmt(static_cast<AstMemoryOrder>(order));
+            break;
+        }
+        case AstNodeType::AstBitIntrinsicExpr:
+        {
+            uint64_t op;
+            CHECK_ERR(ReadVarUInt(op));
+            CHECK_REPORT_ERR(op < static_cast<uint64_t>(AstBitIntrinsicExprType::X_END_OF_ENUM),
+                             "Module deserialization: bad bit intrinsic operator");
+            AstNodeBase* lhs;
+            AstNodeBase* rhs = nullptr;
+            CHECK_ERR(DeserializeNode(fn, lhs));
+            if (!IsUnaryBitIntrinsic(static_cast<AstBitIntrinsicExprType>(op)))
+            {
+                CHECK_ERR(DeserializeNode(fn, rhs));
+            }
+            node = new AstBitIntrinsicExpr(static_cast<AstBitIntrinsicExprType>(op), lhs, rhs);
+            break;
+        }
+        default:
+        {
+            REPORT_ERR("Module deserialization: function %s: bad AST node type %llu",
+                       fn->GetName().c_str(), static_cast<unsigned long long>(tag));
+            return false;
+        }
+        }   /*switch*/
+        RETURN_TRUE;
+    }
+
+    AstModule* m_module;
+    const uint8_t* m_cur;
+    const uint8_t* m_end;
+    // The variables of the function being deserialized, by index
+    //
+    std::vector<AstVariable*> m_vars;
+    // The C++ functions referenced so far, by index
+    //
+    std::vector<const CppFunctionMetadata*> m_cppFunctions;
+};
+
+bool WARN_UNUSED AstModule::Serialize(std::vector<uint8_t>& out /*inout*/)
+{
+    assert(!thread_errorContext->HasError());
+    size_t oldSize = out.size();
+    AstModuleSerializer serializer(out);
+    serializer.WriteVarUInt(x_astSerializationMagic);
+    serializer.WriteVarUInt(x_astSerializationFormatVersion);
+    serializer.WriteVarUInt(static_cast<uint64_t>(AstTypeHelper::x_num_cpp_class_types));
+    serializer.WriteVarUInt(m_functionList.size());
+    for (AstFunction* fn : m_functionList)
+    {
+        if (!serializer.SerializeFunction(fn))
+        {
+            out.resize(oldSize);
+            RETURN_FALSE;
+        }
+    }
+    RETURN_TRUE;
+}
+
+bool WARN_UNUSED AstModule::Deserialize(const uint8_t* data, size_t size)
+{
+    TestAssert(thread_pochiVMContext->m_curModule == this);
+    TestAssert(m_functionList.empty() && m_generation == 0);
+    assert(!thread_errorContext->HasError());
+    AstModuleDeserializer deserializer(this, data, size);
+    if (!deserializer.Run())
+    {
+        // Do not leave a half-built module behind: the functions deserialized so far may have
+        // incomplete bodies, and would fail (or worse, pass) validation
+        //
+        DestroyAllFunctions();
+        RETURN_FALSE;
+    }
+    RETURN_TRUE;
+}
+
+}   // namespace PochiVM
@@ -9,6 +9,7 @@
 #include "constexpr_array_concat_helper.h"
 #include "get_mem_fn_address_helper.h"
 #include "cxx2a_bit_cast_helper.h"
+#include "cpp_function_attribute.h"
 #include "pochivm_context.h"
 #include "fastinterp/fastinterp_tpl_return_type.h"
 
@@ -368,6 +369,9 @@ struct CppFunctionMetadata
     // The unique ordinal, starting from 0
     //
     size_t m_functionOrdinal;
+    // The hints given at registration on how generated code should call the function
+    //
+    CppFunctionAttribute m_attributes;
 };
 
 class AstNodeBase;
@@ -891,6 +895,21 @@ struct primitive_or_pointer_type: std::integral_constant<bool,
      || is_primitive_type<T>::value
 > {};
 
+// The types supported by atomic operations: non-bool integral types and pointers
+//
+template<typename T>
+struct atomic_operand_type: std::integral_constant<bool,
+        std::is_pointer<T>::value
+     || (is_primitive_int_type<T>::value && !std::is_same<T, bool>::value)
+> {};
+
+// The types supported by bit manipulation intrinsics: non-bool integral types
+//
+template<typename T>
+struct bit_intrinsic_operand_type: std::integral_constant<bool,
+        is_primitive_int_type<T>::value && !std::is_same<T, bool>::value
+> {};
+
 namespace internal
 {
 
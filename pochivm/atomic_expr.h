@@ -0,0 +1,175 @@
+#pragma once
+
+#include "ast_expr_base.h"
+#include "ast_atomic_expr_type.h"
+
+namespace PochiVM
+{
+
+// An atomic operation on a non-bool integral or pointer value in memory:
+//    LOAD:             T* -> T
+//    STORE:            T*, T (value) -> void
+//    FETCH_ADD/SUB/AND/OR: T*, T (value) -> T (the old value), T must be integral
+//    COMPARE_EXCHANGE: T*, T (expected), T (value) -> T (the old value)
+//       The value is stored only if the old value equals 'expected', so the operation
+//       succeeded iff the returned value equals 'expected'.
+//
+class AstAtomicExpr : public AstNodeBase
+{
+public:
+    AstAtomicExpr(AstAtomicExprType op, AstMemoryOrder order, AstNodeBase* ptr, AstNodeBase* expected, AstNodeBase* value)
+        : AstNodeBase(AstNodeType::AstAtomicExpr,
+                      (op == AstAtomicExprType::STORE) ? TypeId::Get<void>() : ptr->GetTypeId().RemovePointer())
+        , m_op(op), m_order(order), m_fiIsPtrSpill(false), m_fiIsExpectedSpill(false)
+        , m_ptr(ptr), m_expected(expected), m_value(value)
+    {
+        TestAssert(m_ptr->GetTypeId().IsPointerType());
+        TestAssert(IsValidOperandType(GetValueType()));
+        TestAssert(IsValidMemoryOrderForAtomicOp(m_op, m_order));
+        TestAssertIff(m_op == AstAtomicExprType::LOAD, m_value == nullptr);
+        TestAssertIff(m_op == AstAtomicExprType::COMPARE_EXCHANGE, m_expected != nullptr);
+        TestAssertImp(m_value != nullptr, m_value->GetTypeId() == GetValueType());
+        TestAssertImp(m_expected != nullptr, m_expected->GetTypeId() == GetValueType());
+        TestAssertImp(IsAtomicFetchOp(m_op), GetValueType().IsPrimitiveIntType());
+    }
+
+    static bool IsValidOperandType(TypeId typeId)
+    {
+        return (typeId.IsPrimitiveIntType() && !typeId.IsBool()) || typeId.IsPointerType();
+    }
+
+    // The type of the value in memory
+    //
+    TypeId GetValueType() const
+    {
+        return m_ptr->GetTypeId().RemovePointer();
+    }
+
+    AstAtomicExprType GetOp() const { return m_op; }
+    AstMemoryOrder GetMemoryOrder() const { return m_order; }
+    AstNodeBase* GetPtr() const { return m_ptr; }
+    AstNodeBase* GetExpected() const { return m_expected; }
+    AstNodeBase* GetValue() const { return m_value; }
+
+    // The debug interpreter always uses sequentially-consistent ordering, which is valid for any requested order
+    //
+    template<typename T>
+    void InterpImpl(T* out)
+    {
+        T* ptr;
+        m_ptr->DebugInterp(&ptr);
+        if (m_op == AstAtomicExprType::LOAD)
+        {
+            *out = __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+            return;
+        }
+        T expected = T();
+        if (m_op == AstAtomicExprType::COMPARE_EXCHANGE)
+        {
+            m_expected->DebugInterp(&expected);
+        }
+        T value;
+        m_value->DebugInterp(&value);
+        if (m_op == AstAtomicExprType::STORE)
+        {
+            __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+        }
+        else if (m_op == AstAtomicExprType::COMPARE_EXCHANGE)
+        {
+            __atomic_compare_exchange_n(ptr, &expected, value, false /*weak*/, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+            // On failure 'expected' is updated to the old value, and on success it already equals the old value
+            //
+            *out = expected;
+        }
+        else
+        {
+            if constexpr(std::is_pointer<T>::value)
+            {
+                TestAssert(false);
+            }
+            else
+            {
+                switch (m_op)
+                {
+                case AstAtomicExprType::FETCH_ADD: { *out = __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST); break; }
+                case AstAtomicExprType::FETCH_SUB: { *out = __atomic_fetch_sub(ptr, value, __ATOMIC_SEQ_CST); break; }
+                case AstAtomicExprType::FETCH_AND: { *out = __atomic_fetch_and(ptr, value, __ATOMIC_SEQ_CST); break; }
+                case AstAtomicExprType::FETCH_OR: { *out = __atomic_fetch_or(ptr, value, __ATOMIC_SEQ_CST); break; }
+                default: { TestAssert(false); __builtin_unreachable(); }
+                }   /*switch*/
+            }
+        }
+    }
+
+    GEN_CLASS_METHOD_SELECTOR(SelectImpl, AstAtomicExpr, InterpImpl, AstTypeHelper::atomic_operand_type)
+
+    virtual void SetupDebugInterpImpl() override final
+    {
+        m_debugInterpFn = SelectImpl(GetValueType());
+    }
+
+    // Children are evaluated in the order of pointer, expected, value
+    //
+    virtual void ForEachChildren(FunctionRef<void(AstNodeBase*)> fn) override final
+    {
+        fn(m_ptr);
+        if (m_expected != nullptr) { fn(m_expected); }
+        if (m_value != nullptr) { fn(m_value); }
+    }
+
+    virtual llvm::Value* WARN_UNUSED EmitIRImpl() override final;
+
+    virtual FastInterpSnippet WARN_UNUSED PrepareForFastInterp(FISpillLocation spillLoc) override final;
+    virtual void FastInterpSetupSpillLocation() override final;
+
+private:
+    AstAtomicExprType m_op;
+    AstMemoryOrder m_order;
+    bool m_fiIsPtrSpill;
+    bool m_fiIsExpectedSpill;
+
+    AstNodeBase* m_ptr;
+    // Only used by COMPARE_EXCHANGE
+    //
+    AstNodeBase* m_expected;
+    // Not used by LOAD
+    //
+    AstNodeBase* m_value;
+};
+
+// A memory fence (std::atomic_thread_fence)
+//
+class AstFenceStmt : public AstNodeBase
+{
+public:
+    AstFenceStmt(AstMemoryOrder order)
+        : AstNodeBase(AstNodeType::AstFenceStmt, TypeId::Get<void>())
+        , m_order(order)
+    {
+        TestAssert(m_order != AstMemoryOrder::RELAXED);
+    }
+
+    AstMemoryOrder GetMemoryOrder() const { return m_order; }
+
+    void InterpImpl(void* /*out*/)
+    {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+
+    virtual void SetupDebugInterpImpl() override final
+    {
+        m_debugInterpFn = AstTypeHelper::GetClassMethodPtr(&AstFenceStmt::InterpImpl);
+    }
+
+    virtual void ForEachChildren(FunctionRef<void(AstNodeBase*)> /*fn*/) override final { }
+
+    virtual llvm::Value* WARN_UNUSED EmitIRImpl() override final;
+
+    virtual FastInterpSnippet WARN_UNUSED PrepareForFastInterp(FISpillLocation spillLoc) override final;
+    virtual void FastInterpSetupSpillLocation() override final { }
+
+private:
+    AstMemoryOrder m_order;
+};
+
+}   // namespace PochiVM
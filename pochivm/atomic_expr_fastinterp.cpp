@@ -0,0 +1,136 @@
+#include "atomic_expr.h"
+#include "fastinterp_ast_helper.hpp"
+
+namespace PochiVM
+{
+
+void AstAtomicExpr::FastInterpSetupSpillLocation()
+{
+    if (m_op == AstAtomicExprType::LOAD)
+    {
+        thread_pochiVMContext->m_fastInterpStackFrameManager->ReserveTemp(m_ptr->GetTypeId());
+        m_ptr->FastInterpSetupSpillLocation();
+        return;
+    }
+
+    // The operands are evaluated in the order of pointer, expected, value,
+    // the pointer and the expected value are kept on the operand stack (or spilled) while the later operands are evaluated.
+    //
+    thread_pochiVMContext->m_fastInterpStackFrameManager->PushTemp(m_ptr->GetTypeId());
+    if (m_expected != nullptr)
+    {
+        thread_pochiVMContext->m_fastInterpStackFrameManager->PushTemp(GetValueType());
+    }
+    thread_pochiVMContext->m_fastInterpStackFrameManager->ReserveTemp(GetValueType());
+    m_value->FastInterpSetupSpillLocation();
+    if (m_expected != nullptr)
+    {
+        FISpillLocation expectedSpillLoc = thread_pochiVMContext->m_fastInterpStackFrameManager->PopTemp(GetValueType());
+        m_fiIsExpectedSpill = !expectedSpillLoc.IsNoSpill();
+        m_expected->FastInterpSetupSpillLocation();
+    }
+    FISpillLocation ptrSpillLoc = thread_pochiVMContext->m_fastInterpStackFrameManager->PopTemp(m_ptr->GetTypeId());
+    m_fiIsPtrSpill = !ptrSpillLoc.IsNoSpill();
+    m_ptr->FastInterpSetupSpillLocation();
+}
+
+FastInterpSnippet WARN_UNUSED AstAtomicExpr::PrepareForFastInterp(FISpillLocation spillLoc)
+{
+    TestAssertImp(m_op == AstAtomicExprType::STORE, spillLoc.IsNoSpill());
+    FastInterpTypeId operandType = GetValueType().GetOneLevelPtrFastInterpTypeId();
+
+    if (m_op == AstAtomicExprType::LOAD)
+    {
+        TestAssert(thread_pochiVMContext->m_fastInterpStackFrameManager->CanReserveWithoutSpill(m_ptr->GetTypeId()));
+        FastInterpSnippet snippet = m_ptr->PrepareForFastInterp(x_FINoSpill);
+        FastInterpBoilerplateInstance* inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
+                    FastInterpBoilerplateLibrary<FIAtomicLoadImpl>::SelectBoilerplateBluePrint(
+                        operandType,
+                        !spillLoc.IsNoSpill(),
+                        thread_pochiVMContext->m_fastInterpStackFrameManager->GetNumNoSpillIntegral(),
+                        FIOpaqueParamsHelper::GetMaxOFP()));
+        spillLoc.PopulatePlaceholderIfSpill(inst, 0);
+        return snippet.AddContinuation(inst);
+    }
+
+    thread_pochiVMContext->m_fastInterpStackFrameManager->PushTemp(m_ptr->GetTypeId(), m_fiIsPtrSpill);
+    if (m_expected != nullptr)
+    {
+        thread_pochiVMContext->m_fastInterpStackFrameManager->PushTemp(GetValueType(), m_fiIsExpectedSpill);
+    }
+    TestAssert(thread_pochiVMContext->m_fastInterpStackFrameManager->CanReserveWithoutSpill(GetValueType()));
+    FastInterpSnippet snippet = m_value->PrepareForFastInterp(x_FINoSpill);
+    FISpillLocation expectedSpillLoc;
+    if (m_expected != nullptr)
+    {
+        expectedSpillLoc = thread_pochiVMContext->m_fastInterpStackFrameManager->PopTemp(GetValueType());
+        TestAssertIff(m_fiIsExpectedSpill, !expectedSpillLoc.IsNoSpill());
+        FastInterpSnippet expectedSnippet = m_expected->PrepareForFastInterp(expectedSpillLoc);
+        snippet = expectedSnippet.AddContinuation(snippet);
+    }
+    FISpillLocation ptrSpillLoc = thread_pochiVMContext->m_fastInterpStackFrameManager->PopTemp(m_ptr->GetTypeId());
+    TestAssertIff(m_fiIsPtrSpill, !ptrSpillLoc.IsNoSpill());
+    FastInterpSnippet ptrSnippet = m_ptr->PrepareForFastInterp(ptrSpillLoc);
+    snippet = ptrSnippet.AddContinuation(snippet);
+
+    FINumOpaqueIntegralParams numOIP = thread_pochiVMContext->m_fastInterpStackFrameManager->GetNumNoSpillIntegral();
+    FastInterpBoilerplateInstance* inst;
+    if (m_op == AstAtomicExprType::STORE)
+    {
+        inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
+                    FastInterpBoilerplateLibrary<FIAtomicStoreImpl>::SelectBoilerplateBluePrint(
+                        operandType,
+                        ptrSpillLoc.IsNoSpill(),
+                        m_order == AstMemoryOrder::SEQ_CST /*isSeqCst*/,
+                        numOIP,
+                        FIOpaqueParamsHelper::GetMaxOFP()));
+    }
+    else if (m_op == AstAtomicExprType::COMPARE_EXCHANGE)
+    {
+        inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
+                    FastInterpBoilerplateLibrary<FIAtomicCompareExchangeImpl>::SelectBoilerplateBluePrint(
+                        operandType,
+                        ptrSpillLoc.IsNoSpill(),
+                        expectedSpillLoc.IsNoSpill(),
+                        !spillLoc.IsNoSpill(),
+                        numOIP,
+                        FIOpaqueParamsHelper::GetMaxOFP()));
+        spillLoc.PopulatePlaceholderIfSpill(inst, 0);
+        expectedSpillLoc.PopulatePlaceholderIfSpill(inst, 2);
+    }
+    else
+    {
+        TestAssert(IsAtomicFetchOp(m_op));
+        inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
+                    FastInterpBoilerplateLibrary<FIAtomicFetchOpImpl>::SelectBoilerplateBluePrint(
+                        operandType,
+                        m_op,
+                        ptrSpillLoc.IsNoSpill(),
+                        !spillLoc.IsNoSpill(),
+                        numOIP,
+                        FIOpaqueParamsHelper::GetMaxOFP()));
+        spillLoc.PopulatePlaceholderIfSpill(inst, 0);
+    }
+    ptrSpillLoc.PopulatePlaceholderIfSpill(inst, 1);
+    return snippet.AddContinuation(inst);
+}
+
+FastInterpSnippet WARN_UNUSED AstFenceStmt::PrepareForFastInterp(FISpillLocation TESTBUILD_ONLY(spillLoc))
+{
+    TestAssert(spillLoc.IsNoSpill());
+    if (m_order != AstMemoryOrder::SEQ_CST)
+    {
+        // Acquire and release fences need no instruction on x86-64.
+        // A boilerplate boundary already prevents the compiler from reordering memory accesses across it.
+        //
+        FastInterpBoilerplateInstance* inst = FIGetNoopBoilerplate();
+        return FastInterpSnippet { inst, inst };
+    }
+    FastInterpBoilerplateInstance* inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
+                FastInterpBoilerplateLibrary<FISeqCstFenceImpl>::SelectBoilerplateBluePrint(
+                    FIOpaqueParamsHelper::GetMaxOIP(),
+                    FIOpaqueParamsHelper::GetMaxOFP()));
+    return FastInterpSnippet { inst, inst };
+}
+
+}   // namespace PochiVM
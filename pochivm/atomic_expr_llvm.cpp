@@ -0,0 +1,97 @@
+#include "atomic_expr.h"
+#include "error_context.h"
+#include "ast_type_helper.hpp"
+#include "llvm_ast_helper.hpp"
+#include "function_proto.h"
+
+namespace PochiVM
+{
+
+using namespace llvm;
+
+static AtomicOrdering GetLLVMAtomicOrdering(AstMemoryOrder order)
+{
+    switch (order)
+    {
+    case AstMemoryOrder::RELAXED: { return AtomicOrdering::Monotonic; }
+    case AstMemoryOrder::ACQUIRE: { return AtomicOrdering::Acquire; }
+    case AstMemoryOrder::RELEASE: { return AtomicOrdering::Release; }
+    case AstMemoryOrder::ACQ_REL: { return AtomicOrdering::AcquireRelease; }
+    case AstMemoryOrder::SEQ_CST: { return AtomicOrdering::SequentiallyConsistent; }
+    case AstMemoryOrder::X_END_OF_ENUM: { break; }
+    }   /*switch*/
+    TestAssert(false);
+    __builtin_unreachable();
+}
+
+Value* WARN_UNUSED AstAtomicExpr::EmitIRImpl()
+{
+    Value* ptr = m_ptr->EmitIR();
+    Value* expected = (m_expected != nullptr) ? m_expected->EmitIR() : nullptr;
+    Value* value = (m_value != nullptr) ? m_value->EmitIR() : nullptr;
+
+    AtomicOrdering ordering = GetLLVMAtomicOrdering(m_order);
+    // LLVM requires atomic loads and stores to specify their alignment.
+    // All operand types are naturally aligned.
+    //
+    MaybeAlign alignment(GetValueType().Size());
+
+    switch (m_op)
+    {
+    case AstAtomicExprType::LOAD:
+    {
+        LoadInst* inst = thread_llvmContext->m_builder->CreateLoad(ptr);
+        inst->setAtomic(ordering);
+        inst->setAlignment(alignment);
+        return inst;
+    }
+    case AstAtomicExprType::STORE:
+    {
+        StoreInst* inst = thread_llvmContext->m_builder->CreateStore(value, ptr);
+        inst->setAtomic(ordering);
+        inst->setAlignment(alignment);
+        return nullptr;
+    }
+    case AstAtomicExprType::FETCH_ADD:
+    {
+        return thread_llvmContext->m_builder->CreateAtomicRMW(AtomicRMWInst::Add, ptr, value, ordering);
+    }
+    case AstAtomicExprType::FETCH_SUB:
+    {
+        return thread_llvmContext->m_builder->CreateAtomicRMW(AtomicRMWInst::Sub, ptr, value, ordering);
+    }
+    case AstAtomicExprType::FETCH_AND:
+    {
+        return thread_llvmContext->m_builder->CreateAtomicRMW(AtomicRMWInst::And, ptr, value, ordering);
+    }
+    case AstAtomicExprType::FETCH_OR:
+    {
+        return thread_llvmContext->m_builder->CreateAtomicRMW(AtomicRMWInst::Or, ptr, value, ordering);
+    }
+    case AstAtomicExprType::COMPARE_EXCHANGE:
+    {
+        // cmpxchg yields { old value, success flag }, we only need the old value
+        //
+        Value* inst = thread_llvmContext->m_builder->CreateAtomicCmpXchg(
+                    ptr, expected, value, ordering,
+                    GetLLVMAtomicOrdering(GetCompareExchangeFailureOrder(m_order)));
+        Value* oldValue = thread_llvmContext->m_builder->CreateExtractValue(inst, { 0 });
+        TestAssert(AstTypeHelper::llvm_value_has_type(GetValueType(), oldValue));
+        return oldValue;
+    }
+    case AstAtomicExprType::X_END_OF_ENUM:
+    {
+        break;
+    }
+    }   /*switch*/
+    TestAssert(false);
+    __builtin_unreachable();
+}
+
+Value* WARN_UNUSED AstFenceStmt::EmitIRImpl()
+{
+    thread_llvmContext->m_builder->CreateFence(GetLLVMAtomicOrdering(m_order));
+    return nullptr;
+}
+
+}   // namespace PochiVM
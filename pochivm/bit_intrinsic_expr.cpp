@@ -0,0 +1,35 @@
+#include <atomic>
+
+#include "ast_bit_intrinsic_expr_type.h"
+
+namespace PochiVM
+{
+
+namespace
+{
+
+bool HostSupportsSse42()
+{
+    // Also needed if we are called from a static initializer, before the CPU model is initialized
+    //
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+}
+
+const bool x_hostSupportsSse42 = HostSupportsSse42();
+
+std::atomic<bool> g_forceSoftwareCrc32(false);
+
+}   // anonymous namespace
+
+bool BitIntrinsicUseHardwareCrc32()
+{
+    return x_hostSupportsSse42 && !g_forceSoftwareCrc32.load(std::memory_order_relaxed);
+}
+
+void BitIntrinsicForceSoftwareCrc32(bool value)
+{
+    g_forceSoftwareCrc32.store(value, std::memory_order_relaxed);
+}
+
+}   // namespace PochiVM
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "ast_expr_base.h"
+#include "ast_bit_intrinsic_expr_type.h"
+
+namespace PochiVM
+{
+
+// A bit manipulation or hashing intrinsic on non-bool integral types,
+// see ast_bit_intrinsic_expr_type.h for the semantics of each operator.
+//    Unary operators: T -> T, 'rhs' is nullptr
+//    Binary operators: T, T -> T, except CRC32: uint32_t, T -> uint32_t
+//
+class AstBitIntrinsicExpr : public AstNodeBase
+{
+public:
+    AstBitIntrinsicExpr(AstBitIntrinsicExprType op, AstNodeBase* lhs, AstNodeBase* rhs)
+        : AstNodeBase(AstNodeType::AstBitIntrinsicExpr,
+                      (op == AstBitIntrinsicExprType::CRC32) ? TypeId::Get<uint32_t>() : lhs->GetTypeId())
+        , m_op(op), m_fiIsLhsSpill(false), m_lhs(lhs), m_rhs(rhs)
+    {
+        TestAssert(m_op != AstBitIntrinsicExprType::X_END_OF_ENUM);
+        TestAssert(IsValidOperandType(GetOperandType()));
+        TestAssertIff(IsUnaryBitIntrinsic(m_op), m_rhs == nullptr);
+        TestAssertImp(m_op == AstBitIntrinsicExprType::CRC32, m_lhs->GetTypeId().IsType<uint32_t>());
+        TestAssertImp(m_op != AstBitIntrinsicExprType::CRC32 && m_rhs != nullptr, m_lhs->GetTypeId() == m_rhs->GetTypeId());
+    }
+
+    static bool IsValidOperandType(TypeId typeId)
+    {
+        return typeId.IsPrimitiveIntType() && !typeId.IsBool();
+    }
+
+    // The type that selects the implementation: the type of the data operand for CRC32, the type of lhs otherwise
+    //
+    TypeId GetOperandType() const
+    {
+        return (m_op == AstBitIntrinsicExprType::CRC32) ? m_rhs->GetTypeId() : m_lhs->GetTypeId();
+    }
+
+    template<typename T>
+    void InterpImpl(T* out)
+    {
+        T lhs, rhs = T();
+        m_lhs->DebugInterp(&lhs);
+        if (m_rhs != nullptr)
+        {
+            m_rhs->DebugInterp(&rhs);
+        }
+        *out = EvaluateBitIntrinsic(m_op, lhs, rhs);
+    }
+
+    GEN_CLASS_METHOD_SELECTOR(SelectImpl, AstBitIntrinsicExpr, InterpImpl, AstTypeHelper::bit_intrinsic_operand_type)
+
+    template<typename T>
+    void Crc32Impl(uint32_t* out)
+    {
+        uint32_t crc;
+        T data;
+        m_lhs->DebugInterp(&crc);
+        m_rhs->DebugInterp(&data);
+        *out = BitIntrinsicCrc32(crc, data);
+    }
+
+    GEN_CLASS_METHOD_SELECTOR(SelectCrc32Impl, AstBitIntrinsicExpr, Crc32Impl, AstTypeHelper::bit_intrinsic_operand_type)
+
+    virtual void SetupDebugInterpImpl() override final
+    {
+        if (m_op == AstBitIntrinsicExprType::CRC32)
+        {
+            m_debugInterpFn = SelectCrc32Impl(GetOperandType());
+        }
+        else
+        {
+            m_debugInterpFn = SelectImpl(GetOperandType());
+        }
+    }
+
+    virtual void ForEachChildren(FunctionRef<void(AstNodeBase*)> fn) override final
+    {
+        fn(m_lhs);
+        if (m_rhs != nullptr) { fn(m_rhs); }
+    }
+
+    virtual llvm::Value* WARN_UNUSED EmitIRImpl() override final;
+
+    virtual FastInterpSnippet WARN_UNUSED PrepareForFastInterp(FISpillLocation spillLoc) override final;
+    virtual void FastInterpSetupSpillLocation() override final;
+
+    AstBitIntrinsicExprType GetOp() const { return m_op; }
+    AstNodeBase* GetLhs() const { return m_lhs; }
+    AstNodeBase* GetRhs() const { return m_rhs; }
+
+    AstBitIntrinsicExprType m_op;
+    bool m_fiIsLhsSpill;
+
+    AstNodeBase* m_lhs;
+    // nullptr for unary operators
+    //
+    AstNodeBase* m_rhs;
+};
+
+}   // namespace PochiVM
@@ -0,0 +1,78 @@
+#include "bit_intrinsic_expr.h"
+#include "fastinterp_ast_helper.hpp"
+
+namespace PochiVM
+{
+
+void AstBitIntrinsicExpr::FastInterpSetupSpillLocation()
+{
+    if (m_rhs == nullptr)
+    {
+        thread_pochiVMContext->m_fastInterpStackFrameManager->ReserveTemp(m_lhs->GetTypeId());
+        m_lhs->FastInterpSetupSpillLocation();
+        return;
+    }
+
+    thread_pochiVMContext->m_fastInterpStackFrameManager->PushTemp(m_lhs->GetTypeId());
+    thread_pochiVMContext->m_fastInterpStackFrameManager->ReserveTemp(m_rhs->GetTypeId());
+    m_rhs->FastInterpSetupSpillLocation();
+    FISpillLocation spillLoc = thread_pochiVMContext->m_fastInterpStackFrameManager->PopTemp(m_lhs->GetTypeId());
+    m_fiIsLhsSpill = !spillLoc.IsNoSpill();
+    m_lhs->FastInterpSetupSpillLocation();
+}
+
+FastInterpSnippet WARN_UNUSED AstBitIntrinsicExpr::PrepareForFastInterp(FISpillLocation spillLoc)
+{
+    FastInterpTypeId operandType = GetOperandType().GetDefaultFastInterpTypeId();
+
+    if (m_rhs == nullptr)
+    {
+        TestAssert(thread_pochiVMContext->m_fastInterpStackFrameManager->CanReserveWithoutSpill(m_lhs->GetTypeId()));
+        FastInterpSnippet snippet = m_lhs->PrepareForFastInterp(x_FINoSpill);
+        FastInterpBoilerplateInstance* inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
+                    FastInterpBoilerplateLibrary<FIBitUnaryIntrinsicImpl>::SelectBoilerplateBluePrint(
+                        operandType,
+                        m_op,
+                        !spillLoc.IsNoSpill(),
+                        thread_pochiVMContext->m_fastInterpStackFrameManager->GetNumNoSpillIntegral(),
+                        FIOpaqueParamsHelper::GetMaxOFP()));
+        spillLoc.PopulatePlaceholderIfSpill(inst, 0);
+        return snippet.AddContinuation(inst);
+    }
+
+    thread_pochiVMContext->m_fastInterpStackFrameManager->PushTemp(m_lhs->GetTypeId(), m_fiIsLhsSpill);
+    TestAssert(thread_pochiVMContext->m_fastInterpStackFrameManager->CanReserveWithoutSpill(m_rhs->GetTypeId()));
+    FastInterpSnippet rhs = m_rhs->PrepareForFastInterp(x_FINoSpill);
+    FISpillLocation lhsSpillLoc = thread_pochiVMContext->m_fastInterpStackFrameManager->PopTemp(m_lhs->GetTypeId());
+    TestAssertIff(m_fiIsLhsSpill, !lhsSpillLoc.IsNoSpill());
+    FastInterpSnippet lhs = m_lhs->PrepareForFastInterp(lhsSpillLoc);
+
+    FastInterpBoilerplateInstance* inst;
+    if (m_op == AstBitIntrinsicExprType::CRC32 && !BitIntrinsicUseHardwareCrc32())
+    {
+        inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
+                    FastInterpBoilerplateLibrary<FIBitCrc32SoftwareImpl>::SelectBoilerplateBluePrint(
+                        operandType,
+                        lhsSpillLoc.IsNoSpill(),
+                        !spillLoc.IsNoSpill(),
+                        thread_pochiVMContext->m_fastInterpStackFrameManager->GetNumNoSpillIntegral(),
+                        FIOpaqueParamsHelper::GetMaxOFP()));
+        inst->PopulateConstantPlaceholder<const uint32_t*>(2, x_crc32cTable.data());
+    }
+    else
+    {
+        inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
+                    FastInterpBoilerplateLibrary<FIBitBinaryIntrinsicImpl>::SelectBoilerplateBluePrint(
+                        operandType,
+                        m_op,
+                        lhsSpillLoc.IsNoSpill(),
+                        !spillLoc.IsNoSpill(),
+                        thread_pochiVMContext->m_fastInterpStackFrameManager->GetNumNoSpillIntegral(),
+                        FIOpaqueParamsHelper::GetMaxOFP()));
+    }
+    lhsSpillLoc.PopulatePlaceholderIfSpill(inst, 1);
+    spillLoc.PopulatePlaceholderIfSpill(inst, 0);
+    return lhs.AddContinuation(rhs).AddContinuation(inst);
+}
+
+}   // namespace PochiVM
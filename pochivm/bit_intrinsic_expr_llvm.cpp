@@ -0,0 +1,180 @@
+#include "bit_intrinsic_expr.h"
+#include "error_context.h"
+#include "ast_type_helper.hpp"
+#include "llvm_ast_helper.hpp"
+
+#include "llvm/IR/InlineAsm.h"
+
+namespace PochiVM
+{
+
+using namespace llvm;
+
+// The SSE4.2 'llvm.x86.sse42.crc32.*' intrinsics fail instruction selection unless the target has SSE4.2,
+// but generated code is compiled for the baseline x86-64 target (see ast_bit_intrinsic_expr_type.h).
+// So we emit the instruction as inline assembly, which the assembler accepts regardless of the target features.
+// Only used if BitIntrinsicUseHardwareCrc32() is true.
+//
+static Value* WARN_UNUSED EmitCrc32Hardware(Value* crc, Value* data, TypeId dataType)
+{
+    if (dataType.Size() == 8)
+    {
+        // The 64-bit form operates on a 64-bit register, whose high half is zeroed
+        //
+        Type* i64 = thread_llvmContext->m_builder->getInt64Ty();
+        FunctionType* fnType = FunctionType::get(i64, { i64, i64 }, false /*isVarArg*/);
+        InlineAsm* inlineAsm = InlineAsm::get(fnType, "crc32q $2, $0", "=r,0,r", false /*hasSideEffects*/);
+        Value* crc64 = thread_llvmContext->m_builder->CreateZExt(crc, i64);
+        Value* result = thread_llvmContext->m_builder->CreateCall(fnType, inlineAsm, { crc64, data });
+        return thread_llvmContext->m_builder->CreateTrunc(result, thread_llvmContext->m_builder->getInt32Ty());
+    }
+
+    const char* asmString;
+    switch (dataType.Size())
+    {
+    case 1: { asmString = "crc32b $2, $0"; break; }
+    case 2: { asmString = "crc32w $2, $0"; break; }
+    case 4: { asmString = "crc32l $2, $0"; break; }
+    default: { TestAssert(false); __builtin_unreachable(); }
+    }   /*switch*/
+    Type* i32 = thread_llvmContext->m_builder->getInt32Ty();
+    FunctionType* fnType = FunctionType::get(i32, { i32, data->getType() }, false /*isVarArg*/);
+    InlineAsm* inlineAsm = InlineAsm::get(fnType, asmString, "=r,0,r", false /*hasSideEffects*/);
+    return thread_llvmContext->m_builder->CreateCall(fnType, inlineAsm, { crc, data });
+}
+
+// Same algorithm as BitIntrinsicCrc32Software: one lookup into 'x_crc32cTable' per byte of 'data',
+// starting from the lowest byte. The table is a private constant global of the module.
+//
+static Value* WARN_UNUSED EmitCrc32Software(Value* crc, Value* data, TypeId dataType)
+{
+    const char* const tableName = "__pochivm_crc32c_table";
+    Module* module = thread_llvmContext->m_module;
+    Type* i32 = thread_llvmContext->m_builder->getInt32Ty();
+    Type* i64 = thread_llvmContext->m_builder->getInt64Ty();
+    ArrayType* tableType = ArrayType::get(i32, x_crc32cTable.size());
+    GlobalVariable* table = module->getNamedGlobal(tableName);
+    if (table == nullptr)
+    {
+        Constant* init = ConstantDataArray::get(
+                    *thread_llvmContext->m_llvmContext, ArrayRef<uint32_t>(x_crc32cTable.data(), x_crc32cTable.size()));
+        table = new GlobalVariable(*module, tableType, true /*isConstant*/,
+                                   GlobalValue::LinkageTypes::PrivateLinkage, init, tableName);
+        table->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+    }
+    TestAssert(table->getValueType() == tableType);
+
+    Value* bytes = thread_llvmContext->m_builder->CreateZExt(data, i64);
+    for (size_t i = 0; i < dataType.Size(); i++)
+    {
+        Value* byte = thread_llvmContext->m_builder->CreateTrunc(
+                    thread_llvmContext->m_builder->CreateLShr(bytes, static_cast<uint64_t>(i * 8)), i32);
+        Value* index = thread_llvmContext->m_builder->CreateAnd(
+                    thread_llvmContext->m_builder->CreateXor(crc, byte), static_cast<uint64_t>(0xFF));
+        Value* addr = thread_llvmContext->m_builder->CreateInBoundsGEP(
+                    tableType, table, { thread_llvmContext->m_builder->getInt64(0),
+                                        thread_llvmContext->m_builder->CreateZExt(index, i64) });
+        Value* entry = thread_llvmContext->m_builder->CreateLoad(i32, addr);
+        crc = thread_llvmContext->m_builder->CreateXor(
+                    entry, thread_llvmContext->m_builder->CreateLShr(crc, static_cast<uint64_t>(8)));
+    }
+    return crc;
+}
+
+// Computes the high half of the double-width product
+//
+static Value* WARN_UNUSED EmitMulHi(Value* lhs, Value* rhs, TypeId typeId)
+{
+    unsigned numBits = static_cast<unsigned>(typeId.Size() * 8);
+    Type* wideType = thread_llvmContext->m_builder->getIntNTy(numBits * 2);
+    Value* wideLhs;
+    Value* wideRhs;
+    if (typeId.IsSigned())
+    {
+        wideLhs = thread_llvmContext->m_builder->CreateSExt(lhs, wideType);
+        wideRhs = thread_llvmContext->m_builder->CreateSExt(rhs, wideType);
+    }
+    else
+    {
+        wideLhs = thread_llvmContext->m_builder->CreateZExt(lhs, wideType);
+        wideRhs = thread_llvmContext->m_builder->CreateZExt(rhs, wideType);
+    }
+    Value* product = thread_llvmContext->m_builder->CreateMul(wideLhs, wideRhs);
+    // Only the low 'numBits' bits of the shifted value are kept, so a logical shift works for both signed and unsigned
+    //
+    Value* high = thread_llvmContext->m_builder->CreateLShr(product, numBits);
+    return thread_llvmContext->m_builder->CreateTrunc(high, lhs->getType());
+}
+
+Value* WARN_UNUSED AstBitIntrinsicExpr::EmitIRImpl()
+{
+    // Important to evaluate left side first: it may have side effects
+    //
+    Value* lhs = m_lhs->EmitIR();
+    Value* rhs = (m_rhs != nullptr) ? m_rhs->EmitIR() : nullptr;
+
+    TypeId typeId = GetOperandType();
+    Value* inst = nullptr;
+    switch (m_op)
+    {
+    case AstBitIntrinsicExprType::POPCOUNT:
+    {
+        inst = thread_llvmContext->m_builder->CreateUnaryIntrinsic(Intrinsic::ctpop, lhs);
+        break;
+    }
+    case AstBitIntrinsicExprType::CLZ:
+    case AstBitIntrinsicExprType::CTZ:
+    {
+        // The second parameter 'is_zero_undef' is false: the result is the bit width if the operand is 0
+        //
+        Intrinsic::ID id = (m_op == AstBitIntrinsicExprType::CLZ) ? Intrinsic::ctlz : Intrinsic::cttz;
+        inst = thread_llvmContext->m_builder->CreateIntrinsic(
+                    id, { lhs->getType() } /*types*/, { lhs, thread_llvmContext->m_builder->getFalse() } /*args*/);
+        break;
+    }
+    case AstBitIntrinsicExprType::BSWAP:
+    {
+        // llvm.bswap requires an even number of bytes, and swapping a single byte is a no-op
+        //
+        inst = (typeId.Size() == 1) ? lhs : thread_llvmContext->m_builder->CreateUnaryIntrinsic(Intrinsic::bswap, lhs);
+        break;
+    }
+    case AstBitIntrinsicExprType::ROTL:
+    case AstBitIntrinsicExprType::ROTR:
+    {
+        // A rotate is a funnel shift with both inputs being the value to rotate.
+        // Funnel shifts take the shift amount modulo the bit width.
+        //
+        Intrinsic::ID id = (m_op == AstBitIntrinsicExprType::ROTL) ? Intrinsic::fshl : Intrinsic::fshr;
+        inst = thread_llvmContext->m_builder->CreateIntrinsic(id, { lhs->getType() } /*types*/, { lhs, lhs, rhs } /*args*/);
+        break;
+    }
+    case AstBitIntrinsicExprType::MULHI:
+    {
+        inst = EmitMulHi(lhs, rhs, typeId);
+        break;
+    }
+    case AstBitIntrinsicExprType::CRC32:
+    {
+        if (BitIntrinsicUseHardwareCrc32())
+        {
+            inst = EmitCrc32Hardware(lhs, rhs, typeId);
+        }
+        else
+        {
+            inst = EmitCrc32Software(lhs, rhs, typeId);
+        }
+        break;
+    }
+    case AstBitIntrinsicExprType::X_END_OF_ENUM:
+    {
+        TestAssert(false);
+        __builtin_unreachable();
+    }
+    }   /*switch*/
+
+    TestAssert(AstTypeHelper::llvm_value_has_type(GetTypeId(), inst));
+    return inst;
+}
+
+}   // namespace PochiVM
@@ -0,0 +1,43 @@
+#include "bitcode_data.h"
+#include "common.h"
+
+#include "llvm/Support/Compression.h"
+#include "llvm/Support/Error.h"
+
+namespace PochiVM
+{
+
+const uint8_t* DecompressBitcodeData(const BitcodeData* bitcode)
+{
+    ReleaseAssert(bitcode->IsCompressed());
+
+    // one more char for the trailing '\0', same as the uncompressed bitcode stubs
+    //
+    uint8_t* buffer = new uint8_t[bitcode->m_length + 1];
+    size_t length = bitcode->m_length;
+    llvm::Error err = llvm::zlib::uncompress(
+                llvm::StringRef(reinterpret_cast<const char*>(bitcode->m_bitcode), bitcode->m_compressedLength),
+                reinterpret_cast<char*>(buffer), length /*inout*/);
+    if (err)
+    {
+        fprintf(stderr, "[INTERNAL ERROR] Failed to decompress bitcode stub for symbol %s: %s\n",
+                bitcode->m_symbolName, llvm::toString(std::move(err)).c_str());
+        abort();
+    }
+    ReleaseAssert(length == bitcode->m_length);
+    buffer[length] = 0;
+
+    // Another thread may have decompressed the same stub concurrently, in which case we use its result
+    //
+    const uint8_t* expected = nullptr;
+    if (!bitcode->m_decompressedBitcode.compare_exchange_strong(expected, buffer,
+                                                                std::memory_order_acq_rel, std::memory_order_acquire))
+    {
+        delete [] buffer;
+        ReleaseAssert(expected != nullptr);
+        return expected;
+    }
+    return buffer;
+}
+
+}   // namespace PochiVM
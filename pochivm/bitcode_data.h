@@ -2,15 +2,56 @@
 
 #include <cstdlib>
 #include <cstdint>
+#include <atomic>
 
 namespace PochiVM
 {
 
+struct BitcodeData;
+
+// Decompress the bitcode of a compressed BitcodeData and cache the result in it.
+// Thread-safe. Defined in bitcode_data.cpp, which is part of the 'runtime_bc' library.
+//
+const uint8_t* DecompressBitcodeData(const BitcodeData* bitcode);
+
+// The bitcode stub of a symbol in the runtime library.
+//
+// If the project is built with POCHIVM_COMPRESS_RUNTIME_BITCODE, the stubs are stored zlib-compressed,
+// all in one section ('pochivm_compressed_bc') of the executable. A stub is only decompressed the first
+// time it is needed (that is, when a generated function calls the symbol), and the decompressed bitcode
+// is cached until the program exits. Use GetBitcode() to access the bitcode, never m_bitcode directly.
+//
 struct BitcodeData
 {
+    const uint8_t* GetBitcode() const
+    {
+        if (m_compressedLength == 0)
+        {
+            return m_bitcode;
+        }
+        const uint8_t* result = m_decompressedBitcode.load(std::memory_order_acquire);
+        if (__builtin_expect(result != nullptr, 1))
+        {
+            return result;
+        }
+        return DecompressBitcodeData(this);
+    }
+
+    bool IsCompressed() const { return m_compressedLength != 0; }
+
     const char* m_symbolName;
+    // The bitcode, or the compressed bitcode if m_compressedLength is not 0
+    //
     const uint8_t* m_bitcode;
+    // The length of the bitcode (after decompression)
+    //
     size_t m_length;
+    // The length of the compressed bitcode, 0 if the bitcode is not compressed
+    //
+    size_t m_compressedLength;
+    // The decompressed bitcode, nullptr if not decompressed yet
+    //
+    mutable std::atomic<const uint8_t*> m_decompressedBitcode;
 };
 
 }   // namespace PochiVM
@@ -81,6 +81,16 @@ public:
     virtual void FastInterpSetupSpillLocation() override final;
     virtual FastInterpSnippet WARN_UNUSED PrepareForFastInterp(FISpillLocation spillLoc) override final;
 
+    AstNodeBase* GetOperand() const { return m_operand; }
+
+    // Replace the operand by an equivalent expression of the same type (used by AST transformations)
+    //
+    void SetOperand(AstNodeBase* operand)
+    {
+        TestAssert(operand->GetTypeId() == m_operand->GetTypeId());
+        m_operand = operand;
+    }
+
 private:
     AstNodeBase* m_operand;
 };
@@ -122,6 +132,8 @@ public:
     virtual void FastInterpSetupSpillLocation() override final;
     virtual FastInterpSnippet WARN_UNUSED PrepareForFastInterp(FISpillLocation spillLoc) override final;
 
+    AstNodeBase* GetOperand() const { return m_operand; }
+
     AstNodeBase* m_operand;
 };
 
@@ -2,6 +2,7 @@
 
 #include "common.h"
 #include "global_codegen_memory_pool.h"
+#include "arena_allocator_impl.h"
 #include "fastinterp/simple_constexpr_power_helper.h"
 
 namespace PochiVM
@@ -12,81 +13,53 @@ inline GlobalCodegenMemoryPool g_codegenMemoryPool;
 class TempArenaAllocator
 {
 public:
-    TempArenaAllocator()
-        : m_listHead(0)
-        , m_currentAddress(8)
-        , m_currentAddressEnd(0)
-    { }
-
-    ~TempArenaAllocator()
-    {
-        FreeAllMemoryChunks();
-    }
-
     void Reset()
     {
-        FreeAllMemoryChunks();
+        m_impl.Reset();
     }
 
-    void* WARN_UNUSED Allocate(size_t alignment, size_t size)
+    // Allocate() throws MemoryLimitExceededError if the allocator would hold more than 'bytes' of memory.
+    // 0 (the default) for no limit.
+    //
+    void SetMemoryLimit(size_t bytes)
     {
-        // TODO: support large size allocation
-        //
-        TestAssert(size <= g_codegenMemoryPool.x_memoryChunkSize - 4096);
-        AlignCurrentAddress(alignment);
-        if (m_currentAddress + size > m_currentAddressEnd)
-        {
-            GetNewMemoryChunk();
-            AlignCurrentAddress(alignment);
-            TestAssert(m_currentAddress + size <= m_currentAddressEnd);
-        }
-        TestAssert(m_currentAddress % alignment == 0);
-        uintptr_t result = m_currentAddress;
-        m_currentAddress += size;
-        TestAssert(m_currentAddress <= m_currentAddressEnd);
-        return reinterpret_cast<void*>(result);
+        m_impl.SetMemoryLimit(bytes);
     }
 
-private:
-    void GetNewMemoryChunk()
+    MemoryAllocatorStats GetStats() const
     {
-        uintptr_t address = g_codegenMemoryPool.GetMemoryChunk();
-        AppendToList(address);
-        // the first 8 bytes of the region is used as linked list
-        //
-        m_currentAddress = address + 8;
-        m_currentAddressEnd = address + g_codegenMemoryPool.x_memoryChunkSize;
+        return m_impl.GetStats();
     }
 
-    void AlignCurrentAddress(size_t alignment)
+    // Allocations larger than this are large objects, which get their own memory from the pool
+    //
+    static constexpr size_t x_maxSmallAllocationSize = ArenaAllocatorImpl<g_codegenMemoryPool>::x_maxSmallAllocationSize;
+
+    void* WARN_UNUSED Allocate(size_t alignment, size_t size)
     {
-        TestAssert(alignment <= 4096 && math::is_power_of_2(static_cast<int>(alignment)));
-        size_t mask = alignment - 1;
-        m_currentAddress += mask;
-        m_currentAddress &= ~mask;
+        return reinterpret_cast<void*>(m_impl.Allocate(alignment, size));
     }
 
-    void AppendToList(uintptr_t address)
+    // 'size' must be the size 'ptr' was allocated (or last reallocated) with.
+    // A large object is returned to the pool. Otherwise the memory is only reclaimed right away
+    // if it is the last allocation, and by Reset() if not.
+    //
+    void Free(void* ptr, size_t size)
     {
-        *reinterpret_cast<uintptr_t*>(address) = m_listHead;
-        m_listHead = address;
+        m_impl.Free(reinterpret_cast<uintptr_t>(ptr), size);
     }
 
-    void FreeAllMemoryChunks()
+    // Resize an allocation, 'oldSize' must be the size 'ptr' was allocated (or last reallocated) with.
+    // The last allocation is resized in place if its chunk has room, and a large object if it stays in its size class.
+    // Otherwise the contents are moved to a new allocation, and 'ptr' is freed as by Free().
+    //
+    void* WARN_UNUSED Reallocate(void* ptr, size_t alignment, size_t oldSize, size_t newSize)
     {
-        while (m_listHead != 0)
-        {
-            uintptr_t next = *reinterpret_cast<uintptr_t*>(m_listHead);
-            g_codegenMemoryPool.FreeMemoryChunk(m_listHead);
-            m_listHead = next;
-        }
-        m_currentAddress = 8;
-        m_currentAddressEnd = 0;
+        return reinterpret_cast<void*>(m_impl.Reallocate(reinterpret_cast<uintptr_t>(ptr), alignment, oldSize, newSize));
     }
 
-    uintptr_t m_listHead;
-    uintptr_t m_currentAddress;
-    uintptr_t m_currentAddressEnd;
+private:
+    ArenaAllocatorImpl<g_codegenMemoryPool> m_impl;
 };
 
 static_assert(math::is_power_of_2(__STDCPP_DEFAULT_NEW_ALIGNMENT__), "std default new alignment is not a power of 2");
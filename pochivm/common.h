@@ -30,6 +30,7 @@
 #include <tuple>
 #include <time.h>
 #include <unordered_set>
+#include <string_view>
 #include <typeinfo>
 #include "function_ref.h"
 
@@ -52,6 +52,14 @@ public:
         return m_operand;
     }
 
+    // Replace the operand by an equivalent expression of the same type (used by AST transformations)
+    //
+    void SetOperand(AstNodeBase* operand)
+    {
+        TestAssert(operand->GetTypeId() == m_operand->GetTypeId());
+        m_operand = operand;
+    }
+
 private:
     AstNodeBase* m_operand;
 };
@@ -248,6 +256,21 @@ public:
     GEN_CLASS_METHOD_SELECTOR(SelectImpl, AstAssignExpr, InterpImpl, AstTypeHelper::primitive_or_pointer_type)
 
     AstNodeBase* GetDst() const { return m_dst; }
+    AstNodeBase* GetSrc() const { return m_src; }
+
+    // Replace an operand by an equivalent expression of the same type (used by AST transformations)
+    //
+    void SetDst(AstNodeBase* dst)
+    {
+        TestAssert(dst->GetTypeId() == m_dst->GetTypeId());
+        m_dst = dst;
+    }
+
+    void SetSrc(AstNodeBase* src)
+    {
+        TestAssert(src->GetTypeId() == m_src->GetTypeId());
+        m_src = src;
+    }
 
     virtual void SetupDebugInterpImpl() override final
     {
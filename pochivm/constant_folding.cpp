@@ -0,0 +1,626 @@
+#include "function_proto.h"
+#include "arith_expr.h"
+#include "cast_expr.h"
+#include "common_expr.h"
+#include "logical_operator.h"
+#include "lang_constructs.h"
+#include "bit_intrinsic_expr.h"
+
+namespace PochiVM
+{
+
+// AST-level constant folding, run by PrepareForFastInterp() if enabled.
+//
+// FastInterp generates code for each AST node separately, so an expression over literals such as
+// 'Literal<size_t>(8) * (Literal<size_t>(1) + Literal<size_t>(2))' is evaluated at runtime, and
+// it also prevents its parent from using the cheap literal operand shapes (see AstFIOperandShape).
+// This pass simplifies the AST in place:
+//   (1) Arithmetic, comparison, logical, static-cast and bit intrinsic expressions over literals are evaluated.
+//       Integer arithmetic wraps around, as the generated code does. Division by zero, signed division
+//       overflow and floating-point-to-integer conversions are not folded (they are undefined behavior).
+//   (2) Algebraic identities are simplified: 'x + 0', 'x - 0', 'x * 1', 'x / 1', 'p + 0' (pointer arithmetic),
+//       'true && x', 'false || x', '!!x', etc. 'x * 0', 'x % 1', 'x && false' and 'x || true' are only
+//       simplified if 'x' has no side effect. For floating point, only 'x * 1' and 'x / 1' are simplified.
+//   (3) Literal propagation: a variable initialized by a (folded) literal and never written or
+//       address-taken afterwards is replaced by the literal.
+//   (4) Dead branches are removed: an if-statement with a literal condition is replaced by the taken branch,
+//       and a while-loop with a 'false' condition is removed. Since this may make the code after a return,
+//       break or continue statement unreachable, such code is removed as well (it is not allowed by Validate()).
+//
+
+namespace {
+
+bool IsLiteral(AstNodeBase* expr)
+{
+    return expr->GetAstNodeType() == AstNodeType::AstLiteralExpr;
+}
+
+template<typename T>
+T GetLiteralValue(AstNodeBase* expr)
+{
+    TestAssert(IsLiteral(expr) && expr->GetTypeId() == TypeId::Get<T>());
+    T result;
+    assert_cast<AstLiteralExpr*>(expr)->InterpImpl<T>(&result);
+    return result;
+}
+
+template<typename T>
+AstLiteralExpr* WARN_UNUSED NewLiteral(T value)
+{
+    return new AstLiteralExpr(TypeId::Get<T>(), &value);
+}
+
+AstLiteralExpr* WARN_UNUSED CopyLiteral(AstNodeBase* expr)
+{
+    // The literal value is stored at the lowest bytes
+    //
+    TestAssert(IsLiteral(expr));
+    uint64_t value = assert_cast<AstLiteralExpr*>(expr)->GetAsU64();
+    return new AstLiteralExpr(expr->GetTypeId(), &value);
+}
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wfloat-equal"
+
+// Returns whether 'expr' is a primitive-typed literal equal to 'value'
+//
+bool IsLiteralEqualTo(AstNodeBase* expr, int value)
+{
+    if (!IsLiteral(expr))
+    {
+        return false;
+    }
+    TypeId typeId = expr->GetTypeId();
+#define F(type) if (typeId.IsType<type>()) { return GetLiteralValue<type>(expr) == static_cast<type>(value); }
+FOR_EACH_PRIMITIVE_TYPE
+#undef F
+    return false;
+}
+
+template<typename T>
+AstNodeBase* WARN_UNUSED TryEvaluateArithmetic(AstArithmeticExprType op, T lhs, T rhs)
+{
+    T result;
+    if constexpr(std::is_floating_point<T>::value)
+    {
+        if (op == AstArithmeticExprType::ADD) { result = lhs + rhs; }
+        else if (op == AstArithmeticExprType::SUB) { result = lhs - rhs; }
+        else if (op == AstArithmeticExprType::MUL) { result = lhs * rhs; }
+        else if (op == AstArithmeticExprType::DIV) { result = lhs / rhs; }
+        else { TestAssert(false); return nullptr; }
+    }
+    else
+    {
+        // Evaluate in uint64_t, which wraps around on overflow
+        //
+        uint64_t a = static_cast<uint64_t>(lhs);
+        uint64_t b = static_cast<uint64_t>(rhs);
+        if (op == AstArithmeticExprType::ADD) { result = static_cast<T>(a + b); }
+        else if (op == AstArithmeticExprType::SUB) { result = static_cast<T>(a - b); }
+        else if (op == AstArithmeticExprType::MUL) { result = static_cast<T>(a * b); }
+        else
+        {
+            TestAssert(op == AstArithmeticExprType::DIV || op == AstArithmeticExprType::MOD);
+            if (rhs == 0)
+            {
+                return nullptr;
+            }
+            if (std::is_signed<T>::value && lhs == std::numeric_limits<T>::min() && rhs == static_cast<T>(-1))
+            {
+                return nullptr;
+            }
+            if (op == AstArithmeticExprType::DIV)
+            {
+                result = static_cast<T>(lhs / rhs);
+            }
+            else
+            {
+                result = static_cast<T>(lhs % rhs);
+            }
+        }
+    }
+    return NewLiteral<T>(result);
+}
+
+template<typename T>
+bool EvaluateComparison(AstComparisonExprType op, T lhs, T rhs)
+{
+    if (op == AstComparisonExprType::EQUAL) { return lhs == rhs; }
+    else if (op == AstComparisonExprType::NOT_EQUAL) { return lhs != rhs; }
+    else if (op == AstComparisonExprType::LESS_THAN) { return lhs < rhs; }
+    else if (op == AstComparisonExprType::LESS_EQUAL) { return lhs <= rhs; }
+    else if (op == AstComparisonExprType::GREATER_THAN) { return lhs > rhs; }
+    else
+    {
+        TestAssert(op == AstComparisonExprType::GREATER_EQUAL);
+        return lhs >= rhs;
+    }
+}
+
+#pragma clang diagnostic pop
+
+template<typename SrcT, typename DstT>
+AstNodeBase* WARN_UNUSED TryEvaluateStaticCastImpl(SrcT value)
+{
+    if constexpr(!AstTypeHelper::may_static_cast<SrcT, DstT>::value)
+    {
+        return nullptr;
+    }
+    else if constexpr(std::is_floating_point<SrcT>::value && (std::is_integral<DstT>::value || sizeof(DstT) < sizeof(SrcT)))
+    {
+        // Undefined behavior if the value is out of range of the destination type
+        //
+        return nullptr;
+    }
+    else
+    {
+        return NewLiteral<DstT>(static_cast<DstT>(value));
+    }
+}
+
+template<typename SrcT>
+AstNodeBase* WARN_UNUSED TryEvaluateStaticCast(SrcT value, TypeId dstType)
+{
+#define F(type) if (dstType.IsType<type>()) { return TryEvaluateStaticCastImpl<SrcT, type>(value); }
+FOR_EACH_PRIMITIVE_TYPE
+#undef F
+    return nullptr;
+}
+
+bool HasSideEffect(AstNodeBase* expr)
+{
+    bool result = false;
+    TraverseAstTree(expr, [&](AstNodeBase* cur, AstNodeBase* /*parent*/, FunctionRef<void(void)> Recurse)
+    {
+        AstNodeType nodeType = cur->GetAstNodeType();
+        if (nodeType == AstNodeType::AstCallExpr || nodeType == AstNodeType::AstAssignExpr || nodeType == AstNodeType::AstThrowStmt ||
+            nodeType == AstNodeType::AstAtomicExpr || nodeType == AstNodeType::AstFenceStmt)
+        {
+            result = true;
+            return;
+        }
+        Recurse();
+    });
+    return result;
+}
+
+class ConstantFolder
+{
+public:
+    ConstantFolder(AstFunction* fn)
+        : m_fn(fn)
+        , m_propagationCandidates()
+        , m_literalVars()
+    { }
+
+    void Run()
+    {
+        FindPropagationCandidates();
+        FoldStatementList(m_fn->GetFunctionBody()->GetContents());
+    }
+
+private:
+    // A variable may be replaced by its initial value if all its uses other than
+    // the declaration are loads. Whether the initial value is a literal is only known after folding.
+    //
+    void FindPropagationCandidates()
+    {
+        std::unordered_set<AstNodeBase*> declAssigns;
+        std::unordered_set<AstVariable*> rejected;
+        m_fn->TraverseFunctionBody([&](AstNodeBase* cur, AstNodeBase* parent, FunctionRef<void(void)> Recurse)
+        {
+            if (cur->GetAstNodeType() == AstNodeType::AstDeclareVariable)
+            {
+                AstDeclareVariable* decl = assert_cast<AstDeclareVariable*>(cur);
+                if (decl->m_assignExpr != nullptr)
+                {
+                    declAssigns.insert(decl->m_assignExpr);
+                }
+            }
+            else if (cur->GetAstNodeType() == AstNodeType::AstVariable)
+            {
+                AstVariable* var = assert_cast<AstVariable*>(cur);
+                TestAssert(parent != nullptr);
+                bool ok;
+                if (parent->GetAstNodeType() == AstNodeType::AstDereferenceVariableExpr ||
+                    parent->GetAstNodeType() == AstNodeType::AstDeclareVariable)
+                {
+                    ok = true;
+                }
+                else if (parent->GetAstNodeType() == AstNodeType::AstAssignExpr)
+                {
+                    ok = declAssigns.count(parent) && assert_cast<AstAssignExpr*>(parent)->GetDst() == cur;
+                }
+                else
+                {
+                    ok = false;
+                }
+                if (ok)
+                {
+                    m_propagationCandidates.insert(var);
+                }
+                else
+                {
+                    rejected.insert(var);
+                }
+            }
+            Recurse();
+        });
+        for (AstVariable* var : rejected)
+        {
+            m_propagationCandidates.erase(var);
+        }
+    }
+
+    void FoldStatementList(std::vector<AstNodeBase*>& contents)
+    {
+        std::vector<AstNodeBase*> result;
+        for (AstNodeBase* stmt : contents)
+        {
+            AstNodeBase* newStmt = FoldStatement(stmt);
+            result.push_back(newStmt);
+            if (IsTerminatingStatement(newStmt, true /*treatBreakContinueAsTerminating*/))
+            {
+                break;
+            }
+        }
+        contents = result;
+    }
+
+    AstNodeBase* WARN_UNUSED FoldStatement(AstNodeBase* stmt)
+    {
+        switch (static_cast<int>(stmt->GetAstNodeType()))
+        {
+        case AstNodeType::AstBlock:
+        {
+            FoldStatementList(assert_cast<AstBlock*>(stmt)->GetContents());
+            return stmt;
+        }
+        case AstNodeType::AstScope:
+        {
+            FoldStatementList(assert_cast<AstScope*>(stmt)->GetContents());
+            return stmt;
+        }
+        case AstNodeType::AstIfStatement:
+        {
+            AstIfStatement* ifStmt = assert_cast<AstIfStatement*>(stmt);
+            ifStmt->SetCondClause(FoldExpr(ifStmt->GetCondClause()));
+            FoldStatementList(ifStmt->GetThenClause()->GetContents());
+            if (ifStmt->HasElseClause())
+            {
+                FoldStatementList(ifStmt->GetElseClause()->GetContents());
+            }
+            if (IsLiteral(ifStmt->GetCondClause()))
+            {
+                if (GetLiteralValue<bool>(ifStmt->GetCondClause()))
+                {
+                    return ifStmt->GetThenClause();
+                }
+                else if (ifStmt->HasElseClause())
+                {
+                    return ifStmt->GetElseClause();
+                }
+                else
+                {
+                    return new AstBlock(std::vector<AstNodeBase*>());
+                }
+            }
+            return stmt;
+        }
+        case AstNodeType::AstWhileLoop:
+        {
+            AstWhileLoop* loop = assert_cast<AstWhileLoop*>(stmt);
+            loop->SetCondClause(FoldExpr(loop->GetCondClause()));
+            FoldStatementList(loop->GetBody()->GetContents());
+            if (IsLiteral(loop->GetCondClause()) && !GetLiteralValue<bool>(loop->GetCondClause()))
+            {
+                return new AstBlock(std::vector<AstNodeBase*>());
+            }
+            return stmt;
+        }
+        case AstNodeType::AstForLoop:
+        {
+            AstForLoop* loop = assert_cast<AstForLoop*>(stmt);
+            FoldStatementList(loop->GetInitBlock()->GetContents());
+            loop->SetCondClause(FoldExpr(loop->GetCondClause()));
+            FoldStatementList(loop->GetStepBlock()->GetContents());
+            FoldStatementList(loop->GetBody()->GetContents());
+            return stmt;
+        }
+        case AstNodeType::AstReturnStmt:
+        {
+            AstReturnStmt* ret = assert_cast<AstReturnStmt*>(stmt);
+            if (ret->m_retVal != nullptr)
+            {
+                ret->m_retVal = FoldExpr(ret->m_retVal);
+            }
+            return stmt;
+        }
+        case AstNodeType::AstDeclareVariable:
+        {
+            AstDeclareVariable* decl = assert_cast<AstDeclareVariable*>(stmt);
+            if (decl->m_assignExpr != nullptr)
+            {
+                decl->m_assignExpr->SetSrc(FoldExpr(decl->m_assignExpr->GetSrc()));
+                if (IsLiteral(decl->m_assignExpr->GetSrc()) && m_propagationCandidates.count(decl->m_variable))
+                {
+                    m_literalVars[decl->m_variable] = decl->m_assignExpr->GetSrc();
+                }
+            }
+            else if (decl->m_callExpr != nullptr)
+            {
+                FoldCallParams(decl->m_callExpr);
+            }
+            return stmt;
+        }
+        case AstNodeType::AstAssignExpr:
+        {
+            AstAssignExpr* assign = assert_cast<AstAssignExpr*>(stmt);
+            assign->SetDst(FoldExpr(assign->GetDst()));
+            assign->SetSrc(FoldExpr(assign->GetSrc()));
+            return stmt;
+        }
+        case AstNodeType::AstCallExpr:
+        {
+            FoldCallParams(assert_cast<AstCallExpr*>(stmt));
+            return stmt;
+        }
+        default:
+        {
+            return stmt;
+        }
+        }   /*switch*/
+    }
+
+    void FoldCallParams(AstCallExpr* callExpr)
+    {
+        for (size_t i = 0; i < callExpr->GetParams().size(); i++)
+        {
+            callExpr->SetParam(i, FoldExpr(callExpr->GetParams()[i]));
+        }
+    }
+
+    // Returns the simplified expression, which may be 'expr' itself
+    //
+    AstNodeBase* WARN_UNUSED FoldExpr(AstNodeBase* expr)
+    {
+        switch (static_cast<int>(expr->GetAstNodeType()))
+        {
+        case AstNodeType::AstDereferenceVariableExpr:
+        {
+            AstVariable* var = assert_cast<AstDereferenceVariableExpr*>(expr)->GetOperand();
+            auto it = m_literalVars.find(var);
+            if (it != m_literalVars.end())
+            {
+                return CopyLiteral(it->second);
+            }
+            return expr;
+        }
+        case AstNodeType::AstArithmeticExpr:
+        {
+            AstArithmeticExpr* e = assert_cast<AstArithmeticExpr*>(expr);
+            e->m_lhs = FoldExpr(e->m_lhs);
+            e->m_rhs = FoldExpr(e->m_rhs);
+            return FoldArithmetic(e);
+        }
+        case AstNodeType::AstComparisonExpr:
+        {
+            AstComparisonExpr* e = assert_cast<AstComparisonExpr*>(expr);
+            e->m_lhs = FoldExpr(e->m_lhs);
+            e->m_rhs = FoldExpr(e->m_rhs);
+            if (IsLiteral(e->m_lhs) && IsLiteral(e->m_rhs))
+            {
+                TypeId typeId = e->m_lhs->GetTypeId();
+#define F(type) if (typeId.IsType<type>()) {                                                            \
+                    return NewLiteral<bool>(EvaluateComparison<type>(                                  \
+                        e->GetOp(), GetLiteralValue<type>(e->m_lhs), GetLiteralValue<type>(e->m_rhs)));     \
+                }
+FOR_EACH_PRIMITIVE_TYPE
+#undef F
+            }
+            return expr;
+        }
+        case AstNodeType::AstStaticCastExpr:
+        {
+            AstStaticCastExpr* e = assert_cast<AstStaticCastExpr*>(expr);
+            e->SetOperand(FoldExpr(e->GetOperand()));
+            AstNodeBase* operand = e->GetOperand();
+            if (IsLiteral(operand) && operand->GetTypeId().IsPrimitiveType() && e->GetTypeId().IsPrimitiveType())
+            {
+                AstNodeBase* result = nullptr;
+                TypeId typeId = operand->GetTypeId();
+#define F(type) if (typeId.IsType<type>()) { result = TryEvaluateStaticCast<type>(GetLiteralValue<type>(operand), e->GetTypeId()); }
+FOR_EACH_PRIMITIVE_TYPE
+#undef F
+                if (result != nullptr)
+                {
+                    return result;
+                }
+            }
+            return expr;
+        }
+        case AstNodeType::AstReinterpretCastExpr:
+        {
+            AstReinterpretCastExpr* e = assert_cast<AstReinterpretCastExpr*>(expr);
+            e->m_operand = FoldExpr(e->m_operand);
+            return expr;
+        }
+        case AstNodeType::AstDereferenceExpr:
+        {
+            AstDereferenceExpr* e = assert_cast<AstDereferenceExpr*>(expr);
+            e->SetOperand(FoldExpr(e->GetOperand()));
+            return expr;
+        }
+        case AstNodeType::AstPointerArithmeticExpr:
+        {
+            AstPointerArithmeticExpr* e = assert_cast<AstPointerArithmeticExpr*>(expr);
+            e->m_base = FoldExpr(e->m_base);
+            e->m_index = FoldExpr(e->m_index);
+            if (IsLiteralEqualTo(e->m_index, 0))
+            {
+                return e->m_base;
+            }
+            return expr;
+        }
+        case AstNodeType::AstLogicalAndOrExpr:
+        {
+            AstLogicalAndOrExpr* e = assert_cast<AstLogicalAndOrExpr*>(expr);
+            e->m_lhs = FoldExpr(e->m_lhs);
+            e->m_rhs = FoldExpr(e->m_rhs);
+            // 'x && y' is 'y' if x is true, and short-circuits to 'x' if x is false. Similar for 'x || y'.
+            //
+            if (IsLiteral(e->m_lhs))
+            {
+                return (GetLiteralValue<bool>(e->m_lhs) == e->m_isAnd) ? e->m_rhs : e->m_lhs;
+            }
+            if (IsLiteral(e->m_rhs))
+            {
+                if (GetLiteralValue<bool>(e->m_rhs) == e->m_isAnd)
+                {
+                    return e->m_lhs;
+                }
+                else if (!HasSideEffect(e->m_lhs))
+                {
+                    return e->m_rhs;
+                }
+            }
+            return expr;
+        }
+        case AstNodeType::AstLogicalNotExpr:
+        {
+            AstLogicalNotExpr* e = assert_cast<AstLogicalNotExpr*>(expr);
+            e->m_op = FoldExpr(e->m_op);
+            if (IsLiteral(e->m_op))
+            {
+                return NewLiteral<bool>(!GetLiteralValue<bool>(e->m_op));
+            }
+            if (e->m_op->GetAstNodeType() == AstNodeType::AstLogicalNotExpr)
+            {
+                return assert_cast<AstLogicalNotExpr*>(e->m_op)->m_op;
+            }
+            return expr;
+        }
+        case AstNodeType::AstBitIntrinsicExpr:
+        {
+            AstBitIntrinsicExpr* e = assert_cast<AstBitIntrinsicExpr*>(expr);
+            e->m_lhs = FoldExpr(e->m_lhs);
+            if (e->m_rhs != nullptr)
+            {
+                e->m_rhs = FoldExpr(e->m_rhs);
+            }
+            if (IsLiteral(e->m_lhs) && (e->m_rhs == nullptr || IsLiteral(e->m_rhs)))
+            {
+                TypeId typeId = e->GetOperandType();
+                if (e->GetOp() == AstBitIntrinsicExprType::CRC32)
+                {
+#define F(type) if (typeId.IsType<type>()) {                                                            \
+                    return NewLiteral<uint32_t>(BitIntrinsicCrc32<type>(                                \
+                        GetLiteralValue<uint32_t>(e->m_lhs), GetLiteralValue<type>(e->m_rhs)));         \
+                }
+FOR_EACH_PRIMITIVE_INT_TYPE_EXCEPT_BOOL
+#undef F
+                }
+                else
+                {
+#define F(type) if (typeId.IsType<type>()) {                                                            \
+                    type rhs = (e->m_rhs == nullptr) ? type() : GetLiteralValue<type>(e->m_rhs);        \
+                    return NewLiteral<type>(EvaluateBitIntrinsic<type>(                                 \
+                        e->GetOp(), GetLiteralValue<type>(e->m_lhs), rhs));                             \
+                }
+FOR_EACH_PRIMITIVE_INT_TYPE_EXCEPT_BOOL
+#undef F
+                }
+            }
+            return expr;
+        }
+        case AstNodeType::AstCallExpr:
+        {
+            FoldCallParams(assert_cast<AstCallExpr*>(expr));
+            return expr;
+        }
+        default:
+        {
+            return expr;
+        }
+        }   /*switch*/
+    }
+
+    AstNodeBase* WARN_UNUSED FoldArithmetic(AstArithmeticExpr* e)
+    {
+        AstArithmeticExprType op = e->GetOp();
+        TypeId typeId = e->GetTypeId();
+        if (IsLiteral(e->m_lhs) && IsLiteral(e->m_rhs))
+        {
+            AstNodeBase* result = nullptr;
+#define F(type) if (typeId.IsType<type>()) {                                                            \
+                result = TryEvaluateArithmetic<type>(op, GetLiteralValue<type>(e->m_lhs), GetLiteralValue<type>(e->m_rhs)); \
+            }
+FOR_EACH_PRIMITIVE_INT_TYPE_EXCEPT_BOOL
+FOR_EACH_PRIMITIVE_FLOAT_TYPE
+#undef F
+            if (result != nullptr)
+            {
+                return result;
+            }
+            return e;
+        }
+
+        if (op == AstArithmeticExprType::MUL)
+        {
+            if (IsLiteralEqualTo(e->m_rhs, 1)) { return e->m_lhs; }
+            if (IsLiteralEqualTo(e->m_lhs, 1)) { return e->m_rhs; }
+        }
+        if (op == AstArithmeticExprType::DIV)
+        {
+            if (IsLiteralEqualTo(e->m_rhs, 1)) { return e->m_lhs; }
+        }
+        if (typeId.IsFloatingPoint())
+        {
+            // 'x + 0' is not 'x' if x is -0.0, and 'x * 0' is not 0 if x is NaN or infinity
+            //
+            return e;
+        }
+        if (op == AstArithmeticExprType::ADD)
+        {
+            if (IsLiteralEqualTo(e->m_rhs, 0)) { return e->m_lhs; }
+            if (IsLiteralEqualTo(e->m_lhs, 0)) { return e->m_rhs; }
+        }
+        else if (op == AstArithmeticExprType::SUB)
+        {
+            if (IsLiteralEqualTo(e->m_rhs, 0)) { return e->m_lhs; }
+        }
+        else if (op == AstArithmeticExprType::MUL)
+        {
+            if (IsLiteralEqualTo(e->m_rhs, 0) && !HasSideEffect(e->m_lhs)) { return e->m_rhs; }
+            if (IsLiteralEqualTo(e->m_lhs, 0) && !HasSideEffect(e->m_rhs)) { return e->m_lhs; }
+        }
+        else if (op == AstArithmeticExprType::MOD)
+        {
+            if (IsLiteralEqualTo(e->m_rhs, 1) && !HasSideEffect(e->m_lhs))
+            {
+                uint64_t zero = 0;
+                return new AstLiteralExpr(typeId, &zero);
+            }
+        }
+        return e;
+    }
+
+    AstFunction* m_fn;
+    std::unordered_set<AstVariable*> m_propagationCandidates;
+    // Variables known to hold a literal value => the literal
+    //
+    std::unordered_map<AstVariable*, AstNodeBase*> m_literalVars;
+};
+
+}   // anonymous namespace
+
+void AstModule::FoldConstants()
+{
+    for (AstFunction* fn : GetFunctionList())
+    {
+        ConstantFolder folder(fn);
+        folder.Run();
+    }
+}
+
+}   // namespace PochiVM
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+
+// This file is used by both pochivm and the runtime library builder
+//
+
+namespace PochiVM
+{
+
+// Optional hints on how generated code should call a C++ function, given when the function is registered
+// in pochivm_register_runtime.cpp. Combine them with '|', e.g.
+//    RegisterFreeFn<&f>(CppFunctionAttribute::AlwaysInline | CppFunctionAttribute::Pure);
+//
+//    AlwaysInline: always inline the function into the generated code (in LLVM mode with optimizations).
+//    AddressOnly:  never inline the function, the generated code calls it through its address.
+//                  Its bitcode is not imported into the generated module at all, which also makes EmitIR() faster.
+//    Pure:         the function accesses no memory, so its result depends only on its parameters
+//                  (GCC's '__attribute__((const))'). Not allowed if the function takes a 'const T&' of primitive
+//                  type or returns a C++ object, since the call then goes through memory.
+//    ReadOnly:     the function may read memory but never writes memory (GCC's '__attribute__((pure))').
+//                  Not allowed if the function returns a C++ object.
+//    Hot:          the function is called frequently
+//    Cold:         the function is rarely called (e.g. error reporting), so calls to it are unlikely paths.
+//
+// Pure and ReadOnly are promises made by the user: the behavior is undefined if the function breaks them.
+// The attributes are ignored by the debug interpreter.
+//
+enum class CppFunctionAttribute : uint32_t
+{
+    None = 0,
+    AlwaysInline = 1U << 0,
+    AddressOnly = 1U << 1,
+    Pure = 1U << 2,
+    ReadOnly = 1U << 3,
+    Hot = 1U << 4,
+    Cold = 1U << 5,
+    X_END_OF_ENUM = 1U << 6
+};
+
+constexpr CppFunctionAttribute operator|(CppFunctionAttribute lhs, CppFunctionAttribute rhs)
+{
+    return static_cast<CppFunctionAttribute>(static_cast<uint32_t>(lhs) | static_cast<uint32_t>(rhs));
+}
+
+constexpr bool HasCppFunctionAttribute(CppFunctionAttribute attrs, CppFunctionAttribute attr)
+{
+    return (static_cast<uint32_t>(attrs) & static_cast<uint32_t>(attr)) != 0;
+}
+
+// Returns nullptr if the combination of attributes is valid for the function, otherwise the reason why not.
+// 'isUsingWrapper' and 'isUsingSret' describe how the function is called, see ReflectionHelper::RawFnTypeNamesInfo.
+//
+constexpr const char* GetCppFunctionAttributeConflict(CppFunctionAttribute attrs, bool isUsingWrapper, bool isUsingSret)
+{
+    if (static_cast<uint32_t>(attrs) >= static_cast<uint32_t>(CppFunctionAttribute::X_END_OF_ENUM))
+    {
+        return "unknown attribute";
+    }
+    if (HasCppFunctionAttribute(attrs, CppFunctionAttribute::AlwaysInline) &&
+        HasCppFunctionAttribute(attrs, CppFunctionAttribute::AddressOnly))
+    {
+        return "AlwaysInline and AddressOnly are mutually exclusive";
+    }
+    if (HasCppFunctionAttribute(attrs, CppFunctionAttribute::Pure) &&
+        HasCppFunctionAttribute(attrs, CppFunctionAttribute::ReadOnly))
+    {
+        return "Pure already implies ReadOnly";
+    }
+    if (HasCppFunctionAttribute(attrs, CppFunctionAttribute::Hot) &&
+        HasCppFunctionAttribute(attrs, CppFunctionAttribute::Cold))
+    {
+        return "Hot and Cold are mutually exclusive";
+    }
+    if (HasCppFunctionAttribute(attrs, CppFunctionAttribute::Pure) && isUsingWrapper)
+    {
+        return "Pure is not allowed, since the function is called through a wrapper that accesses memory "
+               "(it takes a 'const T&' of primitive type or returns a C++ object)";
+    }
+    if (HasCppFunctionAttribute(attrs, CppFunctionAttribute::ReadOnly) && isUsingSret)
+    {
+        return "ReadOnly is not allowed, since the function returns a C++ object";
+    }
+    return nullptr;
+}
+
+}   // namespace PochiVM
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <limits>
+#include "common.h"
+#include "fastinterp/fastinterp_function_alignment.h"
+
+namespace PochiVM
+{
+
+// An optional per-thread stack used to hold the FastInterp stack frame of a generated function
+// when it is called from C++ (FastInterpFunction and GeneratedFunctionPointer).
+//
+// By default, the stack frame is allocated on the C stack using alloca. This is the fastest option,
+// but a deep recursion between C++ and generated code (e.g. generated comparators passed to std::sort
+// which in turn call other generated functions) may silently overflow the C stack.
+// If an interpreter stack is installed for the current thread (see AutoThreadFastInterpInterpStack),
+// stack frames are instead allocated from a list of mmap'ed segments, and a clear error is reported
+// if the configured limit is exceeded.
+//
+class FastInterpInterpStack : NonCopyable, NonMovable
+{
+public:
+    static constexpr size_t x_default_segment_size = 1024 * 1024;
+    static constexpr size_t x_default_max_size = 256 * 1024 * 1024;
+
+    // The position in the stack before a frame is pushed, used to pop the frame
+    //
+    struct Position
+    {
+        uint32_t m_segmentOrd;
+        uint32_t m_offset;
+    };
+
+    FastInterpInterpStack(size_t segmentSize = x_default_segment_size, size_t maxSize = x_default_max_size)
+        : m_segments()
+        , m_curSegmentOrd(0)
+        , m_curOffset(0)
+        , m_totalSize(0)
+        , m_segmentSize((segmentSize + 4095) / 4096 * 4096)
+        , m_maxSize(maxSize)
+        , m_usedSize(0)
+        , m_peakUsedSize(0)
+    {
+        ReleaseAssert(m_segmentSize > 0 && m_segmentSize <= std::numeric_limits<uint32_t>::max());
+        ReleaseAssert(m_segmentSize <= m_maxSize);
+    }
+
+    ~FastInterpInterpStack()
+    {
+        TestAssert(m_usedSize == 0);
+        for (Segment& segment : m_segments)
+        {
+            munmap(reinterpret_cast<void*>(segment.m_base), segment.m_size);
+        }
+    }
+
+    // Allocate a stack frame of 'size' bytes, aligned to x_fastinterp_function_stack_alignment.
+    // 'pos' is populated with the information needed to pop the frame.
+    //
+    uintptr_t WARN_UNUSED Push(uint32_t size, Position& pos /*out*/) noexcept
+    {
+        size = RoundUpFrameSize(size);
+        pos.m_segmentOrd = m_curSegmentOrd;
+        pos.m_offset = m_curOffset;
+        if (unlikely(m_usedSize + size > m_maxSize))
+        {
+            ReportOverflow(size);
+        }
+        if (unlikely(m_curSegmentOrd >= m_segments.size() || m_curOffset + size > m_segments[m_curSegmentOrd].m_size))
+        {
+            AdvanceSegment(size);
+        }
+        Segment& segment = m_segments[m_curSegmentOrd];
+        TestAssert(m_curOffset + size <= segment.m_size);
+        uintptr_t result = segment.m_base + m_curOffset;
+        m_curOffset += size;
+        m_usedSize += size;
+        m_peakUsedSize = std::max(m_peakUsedSize, m_usedSize);
+        return result;
+    }
+
+    // Pop the last frame allocated. Frames must be popped in LIFO order.
+    //
+    void Pop(uint32_t size, const Position& pos) noexcept
+    {
+        size = RoundUpFrameSize(size);
+        TestAssert(m_usedSize >= size);
+        TestAssert(pos.m_segmentOrd <= m_curSegmentOrd);
+        m_usedSize -= size;
+        m_curSegmentOrd = pos.m_segmentOrd;
+        m_curOffset = pos.m_offset;
+    }
+
+    // Total bytes currently allocated to stack frames
+    //
+    size_t GetUsedSize() const { return m_usedSize; }
+    // Highest value of GetUsedSize() ever
+    //
+    size_t GetPeakUsedSize() const { return m_peakUsedSize; }
+    // Total bytes of the segments mapped by this stack
+    //
+    size_t GetReservedSize() const { return m_totalSize; }
+
+private:
+    static uint32_t RoundUpFrameSize(uint32_t size)
+    {
+        constexpr uint32_t alignment = static_cast<uint32_t>(x_fastinterp_function_stack_alignment);
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    struct Segment
+    {
+        uintptr_t m_base;
+        size_t m_size;
+    };
+
+    void AdvanceSegment(uint32_t size) noexcept
+    {
+        // The current segment (if any) cannot hold the frame. The unused tail of the current segment
+        // is wasted until the frame is popped, since we require each frame to be contiguous.
+        //
+        if (m_curSegmentOrd < m_segments.size())
+        {
+            m_curSegmentOrd++;
+        }
+        TestAssert(m_curSegmentOrd <= m_segments.size());
+        // Reuse the next segment if it is large enough. Otherwise release it (and all segments after it,
+        // which are unused since we are at the top of the stack), and map a larger one.
+        //
+        if (m_curSegmentOrd < m_segments.size() && m_segments[m_curSegmentOrd].m_size < size)
+        {
+            for (size_t i = m_curSegmentOrd; i < m_segments.size(); i++)
+            {
+                munmap(reinterpret_cast<void*>(m_segments[i].m_base), m_segments[i].m_size);
+                m_totalSize -= m_segments[i].m_size;
+            }
+            m_segments.resize(m_curSegmentOrd);
+        }
+        if (m_curSegmentOrd == m_segments.size())
+        {
+            size_t length = std::max(m_segmentSize, (static_cast<size_t>(size) + 4095) / 4096 * 4096);
+            void* addr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (addr == MAP_FAILED)
+            {
+                ReportOverflow(size);
+            }
+            m_segments.push_back(Segment { reinterpret_cast<uintptr_t>(addr), length });
+            m_totalSize += length;
+        }
+        m_curOffset = 0;
+    }
+
+    void NO_RETURN ReportOverflow(uint32_t size) noexcept
+    {
+        fprintf(stderr, "[FASTINTERP RUNTIME] Interpreter stack overflow: failed to allocate a stack frame of %u bytes "
+                "(%llu bytes in use, limit %llu bytes). Aborting.\n",
+                static_cast<unsigned int>(size),
+                static_cast<unsigned long long>(m_usedSize),
+                static_cast<unsigned long long>(m_maxSize));
+        fflush(stderr);
+        abort();
+    }
+
+    std::vector<Segment> m_segments;
+    uint32_t m_curSegmentOrd;
+    uint32_t m_curOffset;
+    size_t m_totalSize;
+    size_t m_segmentSize;
+    size_t m_maxSize;
+    size_t m_usedSize;
+    size_t m_peakUsedSize;
+};
+
+inline thread_local FastInterpInterpStack* thread_pochiVMFastInterpInterpStack = nullptr;
+
+// Install an interpreter stack for the current thread.
+// While it is alive, generated FastInterp functions called from C++ in this thread use it for their stack frames.
+//
+class AutoThreadFastInterpInterpStack
+{
+public:
+    AutoThreadFastInterpInterpStack(size_t segmentSize = FastInterpInterpStack::x_default_segment_size,
+                                    size_t maxSize = FastInterpInterpStack::x_default_max_size)
+    {
+        TestAssert(thread_pochiVMFastInterpInterpStack == nullptr);
+        m_stack = new FastInterpInterpStack(segmentSize, maxSize);
+        ReleaseAssert(m_stack != nullptr);
+        thread_pochiVMFastInterpInterpStack = m_stack;
+    }
+
+    ~AutoThreadFastInterpInterpStack()
+    {
+        TestAssert(thread_pochiVMFastInterpInterpStack == m_stack);
+        delete m_stack;
+        thread_pochiVMFastInterpInterpStack = nullptr;
+    }
+
+private:
+    FastInterpInterpStack* m_stack;
+};
+#define AutoThreadFastInterpInterpStack(...) static_assert(false, "Wrong use of 'auto'-pattern!");
+
+// Allocate a stack frame from the interpreter stack of the current thread, and free it when out of scope.
+// Only used when an interpreter stack is installed.
+//
+class FastInterpInterpStackFrameHolder : NonCopyable, NonMovable
+{
+public:
+    FastInterpInterpStackFrameHolder(FastInterpInterpStack* stack, uint32_t size) noexcept
+        : m_stack(stack), m_size(size)
+    {
+        m_stackframe = m_stack->Push(m_size, m_pos);
+    }
+
+    ~FastInterpInterpStackFrameHolder()
+    {
+        m_stack->Pop(m_size, m_pos);
+    }
+
+    uintptr_t Get() const { return m_stackframe; }
+
+private:
+    FastInterpInterpStack* m_stack;
+    uint32_t m_size;
+    FastInterpInterpStack::Position m_pos;
+    uintptr_t m_stackframe;
+};
+
+// Push and pop the stack frame of a generated function called from generated code, used by the
+// FICallExprInterpStackImpl boilerplate (see AstModule::SetFastInterpCallFramesOnInterpStack()).
+// The position to restore on pop is stored right after the frame, so the boilerplate does not need
+// to keep it in its native stack frame.
+//
+inline uint64_t GetFastInterpInterpStackCallFramePosOffset(uint64_t size) noexcept
+{
+    constexpr uint64_t alignment = alignof(FastInterpInterpStack::Position);
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+inline uintptr_t FastInterpInterpStackPushCallFrame(uint64_t size) noexcept
+{
+    FastInterpInterpStack* stack = thread_pochiVMFastInterpInterpStack;
+    if (unlikely(stack == nullptr))
+    {
+        fprintf(stderr, "[FASTINTERP RUNTIME] The module puts the stack frames of calls on the interpreter stack, "
+                "but no interpreter stack is installed for the current thread. Aborting.\n");
+        fflush(stderr);
+        abort();
+    }
+    uint64_t posOffset = GetFastInterpInterpStackCallFramePosOffset(size);
+    FastInterpInterpStack::Position pos;
+    uintptr_t result = stack->Push(static_cast<uint32_t>(posOffset + sizeof(FastInterpInterpStack::Position)), pos /*out*/);
+    *reinterpret_cast<FastInterpInterpStack::Position*>(result + posOffset) = pos;
+    return result;
+}
+
+inline void FastInterpInterpStackPopCallFrame(uint64_t size, uintptr_t stackframe) noexcept
+{
+    FastInterpInterpStack* stack = thread_pochiVMFastInterpInterpStack;
+    TestAssert(stack != nullptr);
+    uint64_t posOffset = GetFastInterpInterpStackCallFramePosOffset(size);
+    FastInterpInterpStack::Position pos = *reinterpret_cast<FastInterpInterpStack::Position*>(stackframe + posOffset);
+    stack->Pop(static_cast<uint32_t>(posOffset + sizeof(FastInterpInterpStack::Position)), pos);
+}
+
+}   // namespace PochiVM
@@ -0,0 +1,216 @@
+#include "fastinterp_local_var_liveness.h"
+#include "fastinterp_ast_helper.hpp"
+#include "function_proto.h"
+#include "lang_constructs.h"
+
+namespace PochiVM
+{
+
+namespace {
+
+class LiveRangeComputer
+{
+public:
+    LiveRangeComputer()
+        : m_scopeStack()
+        , m_declScopeDepth()
+        , m_lastUse()
+        , m_pinned()
+        , m_declOrder()
+    { }
+
+    void Run(AstFunction* fn, std::unordered_map<AstNodeBase*, std::vector<AstVariable*>>& releasePoints /*out*/)
+    {
+        ProcessScope(fn->GetFunctionBody());
+        TestAssert(m_scopeStack.empty());
+        for (AstVariable* var : m_declOrder)
+        {
+            if (!m_pinned.count(var))
+            {
+                TestAssert(m_lastUse.count(var));
+                releasePoints[m_lastUse[var]].push_back(var);
+            }
+        }
+    }
+
+private:
+    void ProcessScope(AstNodeBase* scope)
+    {
+        m_scopeStack.push_back(nullptr);
+        ProcessStatementList(assert_cast<AstScope*>(scope)->GetContents());
+        m_scopeStack.pop_back();
+    }
+
+    // Statements in nested blocks are statements of the enclosing scope
+    //
+    void ProcessStatementList(const std::vector<AstNodeBase*>& contents)
+    {
+        for (AstNodeBase* stmt : contents)
+        {
+            if (stmt->GetAstNodeType() == AstNodeType::AstBlock)
+            {
+                ProcessStatementList(assert_cast<AstBlock*>(stmt)->GetContents());
+            }
+            else
+            {
+                ProcessStatement(stmt);
+            }
+        }
+    }
+
+    void MarkUse(AstVariable* var)
+    {
+        auto it = m_declScopeDepth.find(var);
+        if (it != m_declScopeDepth.end())
+        {
+            TestAssert(it->second < m_scopeStack.size());
+            m_lastUse[var] = m_scopeStack[it->second];
+        }
+    }
+
+    void ProcessStatement(AstNodeBase* stmt)
+    {
+        TestAssert(!m_scopeStack.empty());
+        m_scopeStack.back() = stmt;
+        TraverseAstTree(stmt, [&](AstNodeBase* cur, AstNodeBase* parent, FunctionRef<void(void)> Recurse)
+        {
+            switch (static_cast<int>(cur->GetAstNodeType()))
+            {
+            case AstNodeType::AstScope:
+            {
+                ProcessScope(cur);
+                return;
+            }
+            case AstNodeType::AstDeclareVariable:
+            {
+                AstVariable* var = assert_cast<AstDeclareVariable*>(cur)->m_variable;
+                TestAssert(!m_declScopeDepth.count(var));
+                m_declOrder.push_back(var);
+                if (cur != stmt)
+                {
+                    // Only happens for for-loop init-block, whose variables belong to the for-loop scope
+                    //
+                    m_pinned.insert(var);
+                }
+                else
+                {
+                    m_declScopeDepth[var] = m_scopeStack.size() - 1;
+                    m_lastUse[var] = stmt;
+                }
+                if (var->GetTypeId().RemovePointer().IsCppClassType())
+                {
+                    m_pinned.insert(var);
+                }
+                break;
+            }
+            case AstNodeType::AstVariable:
+            {
+                AstVariable* var = assert_cast<AstVariable*>(cur);
+                TestAssert(parent != nullptr);
+                bool isLoadOrStore;
+                switch (static_cast<int>(parent->GetAstNodeType()))
+                {
+                case AstNodeType::AstDeclareVariable:
+                case AstNodeType::AstDereferenceVariableExpr:
+                case AstNodeType::AstDereferenceExpr:
+                {
+                    isLoadOrStore = true;
+                    break;
+                }
+                case AstNodeType::AstAssignExpr:
+                {
+                    isLoadOrStore = (assert_cast<AstAssignExpr*>(parent)->GetDst() == cur);
+                    break;
+                }
+                default:
+                {
+                    isLoadOrStore = false;
+                    break;
+                }
+                }   /*switch*/
+                if (!isLoadOrStore)
+                {
+                    m_pinned.insert(var);
+                }
+                MarkUse(var);
+                break;
+            }
+            case AstNodeType::AstWhileLoop:
+            case AstNodeType::AstForLoop:
+            {
+                // The OSR back-edge of the loop updates its counter variable, which is not visible in the AST
+                //
+                FastInterpOsrEntry* osrEntry;
+                if (cur->GetAstNodeType() == AstNodeType::AstWhileLoop)
+                {
+                    osrEntry = assert_cast<AstWhileLoop*>(cur)->GetFastInterpOsrEntry();
+                }
+                else
+                {
+                    osrEntry = assert_cast<AstForLoop*>(cur)->GetFastInterpOsrEntry();
+                }
+                if (osrEntry != nullptr)
+                {
+                    MarkUse(osrEntry->GetCounterVariable());
+                }
+                break;
+            }
+            default:
+            {
+                break;
+            }
+            }   /*switch*/
+            Recurse();
+        });
+    }
+
+    // For each scope being processed, the statement of the scope currently being processed
+    //
+    std::vector<AstNodeBase*> m_scopeStack;
+    std::unordered_map<AstVariable*, size_t> m_declScopeDepth;
+    std::unordered_map<AstVariable*, AstNodeBase*> m_lastUse;
+    // Variables that must be kept until the end of their scope
+    //
+    std::unordered_set<AstVariable*> m_pinned;
+    std::vector<AstVariable*> m_declOrder;
+};
+
+}   // anonymous namespace
+
+void FILocalVarLiveness::Compute(AstFunction* fn)
+{
+    m_releasePoints.clear();
+    m_released.clear();
+    if (!m_enabled)
+    {
+        return;
+    }
+    LiveRangeComputer computer;
+    computer.Run(fn, m_releasePoints);
+}
+
+void FILocalVarLiveness::ReleaseAfterStatement(AstNodeBase* stmt)
+{
+    auto it = m_releasePoints.find(stmt);
+    if (it == m_releasePoints.end())
+    {
+        return;
+    }
+    for (AstVariable* var : it->second)
+    {
+        TestAssert(!m_released.count(var));
+        m_released.insert(var);
+        thread_pochiVMContext->m_fastInterpStackFrameManager->PopLocalVar(var->GetTypeId().RemovePointer(), var->GetFastInterpOffset());
+    }
+}
+
+void FILocalVarLiveness::ReleaseAtScopeEnd(AstVariable* var)
+{
+    if (m_released.count(var))
+    {
+        return;
+    }
+    thread_pochiVMContext->m_fastInterpStackFrameManager->PopLocalVar(var->GetTypeId().RemovePointer(), var->GetFastInterpOffset());
+}
+
+}   // namespace PochiVM
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "common.h"
+
+namespace PochiVM
+{
+
+class AstFunction;
+class AstNodeBase;
+class AstVariable;
+
+// Computes when the stack frame slot of a local variable may be released in FastInterp mode.
+//
+// Without this, a variable occupies its slot until the end of its scope. Generated code often declares
+// many short-lived variables in the same scope (e.g. one per hash table probe), so the stack frame would
+// grow with the number of declarations. Here we compute a simple live range for each variable instead:
+// the slot is released after the last statement of its declaring scope that references the variable.
+//
+// Blocks are not scopes, so the statements of a nested block are considered statements of the enclosing scope.
+// A reference nested in a loop (or any other compound statement) extends the live range to the end of the
+// whole compound statement, so a variable is never released while a later iteration may still read it.
+//
+// A variable is conservatively kept until the end of its scope if it is of CPP class type (its destructor
+// runs at scope end), if its address may escape (it is used by anything other than a load or store),
+// or if it is declared in a for-loop init-block.
+//
+class FILocalVarLiveness : NonCopyable, NonMovable
+{
+public:
+    FILocalVarLiveness()
+        : m_enabled(false)
+        , m_releasePoints()
+        , m_released()
+    { }
+
+    void SetEnabled(bool value)
+    {
+        m_enabled = value;
+    }
+
+    // Compute the live ranges for the variables in the function. Must be called before the function is generated.
+    //
+    void Compute(AstFunction* fn);
+
+    // Release the variables whose live range ends at 'stmt'.
+    // Must be called after each statement of a statement list is generated.
+    //
+    void ReleaseAfterStatement(AstNodeBase* stmt);
+
+    // Release a variable when its scope ends, if it has not been released yet
+    //
+    void ReleaseAtScopeEnd(AstVariable* var);
+
+private:
+    bool m_enabled;
+    std::unordered_map<AstNodeBase*, std::vector<AstVariable*>> m_releasePoints;
+    std::unordered_set<AstVariable*> m_released;
+};
+
+}   // namespace PochiVM
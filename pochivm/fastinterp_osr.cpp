@@ -0,0 +1,318 @@
+#include "ast_clone_helper.h"
+
+namespace PochiVM
+{
+
+// On-stack replacement (OSR) from FastInterp loops into LLVM-compiled code.
+//
+// A generated function such as a query pipeline scanning a large table may spend all its time in a single
+// invocation of a single loop. Replacing the function's entry point by LLVM-compiled code never helps it,
+// since it never returns. Instead, we make the back-edges of such loops OSR points: after enough iterations,
+// the FastInterp code calls a compiled 'continuation' with its own stack frame, and the continuation executes
+// the rest of the function. See FastInterpOsrEntry and the FIOsrBackEdgeImpl boilerplate for the runtime part.
+//
+// Since the FastInterp stack frame layout is explicit (every variable lives at a fixed offset),
+// the state transfer can be done by the continuation itself at AST level. For an OSR point at loop L:
+//
+//     R continuation(uintptr_t sf)
+//     {
+//         Declare(v1', *(T1*)(sf + offset(v1)));  ...  // for each variable v_i live at the back-edge of L
+//         {
+//             { L'; <statements after L in its scope> }
+//             <statements after that scope in its parent scope> ...
+//         }
+//     }
+//
+// where all variables are remapped to fresh ones (v_i -> v_i'). L' is L for a while-loop. For a for-loop,
+// L' is L with an empty init-block (the back-edge is after the step-block, and the variables declared in
+// the init-block are loaded like the others).
+//
+// To keep the transformation obviously correct, only loops not nested in any other control flow statement
+// are eligible, and the function must:
+//   (1) Never throw, since the continuation is called from FastInterp code using the noexcept convention.
+//   (2) Only use primitive and pointer types, so no destructor needs to run for the FastInterp frame,
+//       and only consist of AST nodes supported by AstCloneHelper.
+//   (3) Never take the address of a local variable, since the continuation works on copies of the variables.
+//       Pointers into the FastInterp stack frame would otherwise see stale values.
+//   (4) Have no tail calls, since the prototype of the continuation is different from the function.
+//
+
+namespace {
+
+std::vector<AstNodeBase*>& GetStatementList(AstNodeBase* node)
+{
+    if (node->GetAstNodeType() == AstNodeType::AstBlock)
+    {
+        return assert_cast<AstBlock*>(node)->GetContents();
+    }
+    else
+    {
+        TestAssert(node->GetAstNodeType() == AstNodeType::AstScope);
+        return assert_cast<AstScope*>(node)->GetContents();
+    }
+}
+
+bool IsOsrEligibleFunction(AstFunction* fn)
+{
+    if (!fn->GetIsNoExceptForCodegen())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < fn->GetNumParams(); i++)
+    {
+        if (fn->GetParamType(i).IsCppClassType())
+        {
+            return false;
+        }
+    }
+
+    bool ok = true;
+    fn->TraverseFunctionBody([&](AstNodeBase* cur, AstNodeBase* parent, FunctionRef<void(void)> Recurse)
+    {
+        if (!ok)
+        {
+            return;
+        }
+        if (!AstCloneHelper::IsCloneSupported(cur))
+        {
+            ok = false;
+            return;
+        }
+        if (cur->GetAstNodeType() == AstNodeType::AstReturnStmt && assert_cast<AstReturnStmt*>(cur)->IsTailCall())
+        {
+            ok = false;
+            return;
+        }
+        if (cur->GetAstNodeType() == AstNodeType::AstVariable)
+        {
+            // The only uses of a variable that do not take its address
+            //
+            TestAssert(parent != nullptr);
+            bool isAddressTaken = true;
+            switch (static_cast<int>(parent->GetAstNodeType()))
+            {
+            case AstNodeType::AstDeclareVariable:
+            case AstNodeType::AstDereferenceVariableExpr:
+            case AstNodeType::AstDereferenceExpr:
+            {
+                isAddressTaken = false;
+                break;
+            }
+            case AstNodeType::AstAssignExpr:
+            {
+                isAddressTaken = (assert_cast<AstAssignExpr*>(parent)->GetDst() != cur);
+                break;
+            }
+            default:
+            {
+                break;
+            }
+            }   /*switch*/
+            if (isAddressTaken)
+            {
+                ok = false;
+                return;
+            }
+        }
+        Recurse();
+    });
+    return ok;
+}
+
+// Collect the variables declared by the statements in 'contents'.
+// Blocks are not variable scopes, so variables declared in a nested block are also collected.
+//
+void CollectDeclaredVariables(const std::vector<AstNodeBase*>& contents, size_t end, std::vector<AstVariable*>& result /*inout*/)
+{
+    TestAssert(end <= contents.size());
+    for (size_t i = 0; i < end; i++)
+    {
+        AstNodeBase* stmt = contents[i];
+        if (stmt->GetAstNodeType() == AstNodeType::AstDeclareVariable)
+        {
+            result.push_back(assert_cast<AstDeclareVariable*>(stmt)->m_variable);
+        }
+        else if (stmt->GetAstNodeType() == AstNodeType::AstBlock)
+        {
+            const std::vector<AstNodeBase*>& blockContents = assert_cast<AstBlock*>(stmt)->GetContents();
+            CollectDeclaredVariables(blockContents, blockContents.size(), result);
+        }
+    }
+}
+
+class OsrLoopInstrumenter
+{
+public:
+    OsrLoopInstrumenter(AstFunction* fn, uint64_t threshold, std::vector<FastInterpOsrEntry*>& entries /*inout*/)
+        : m_fn(fn)
+        , m_threshold(threshold)
+        , m_entries(entries)
+        , m_path()
+    { }
+
+    void Run()
+    {
+        ProcessStatementList(m_fn->GetFunctionBody());
+        TestAssert(m_path.empty());
+    }
+
+private:
+    void ProcessStatementList(AstNodeBase* container)
+    {
+        std::vector<AstNodeBase*>& contents = GetStatementList(container);
+        for (size_t i = 0; i < contents.size(); i++)
+        {
+            AstNodeBase* stmt = contents[i];
+            AstNodeType nodeType = stmt->GetAstNodeType();
+            if (nodeType == AstNodeType::AstBlock || nodeType == AstNodeType::AstScope)
+            {
+                m_path.push_back(std::make_pair(container, i));
+                ProcessStatementList(stmt);
+                m_path.pop_back();
+            }
+            else if (nodeType == AstNodeType::AstWhileLoop || nodeType == AstNodeType::AstForLoop)
+            {
+                // Replace the loop by 'Block { Declare(counter, 0); loop }'
+                //
+                AstVariable* counter = new AstVariable(TypeId::Get<uint64_t*>(), m_fn, m_fn->GetNextVarSuffix(), "osr_counter");
+                uint64_t zero = 0;
+                AstBlock* wrapper = new AstBlock({
+                    new AstDeclareVariable(counter, new AstAssignExpr(counter, new AstLiteralExpr(TypeId::Get<uint64_t>(), &zero))),
+                    stmt
+                });
+                contents[i] = wrapper;
+
+                std::vector<std::pair<AstNodeBase*, size_t>> path = m_path;
+                path.push_back(std::make_pair(container, i));
+                path.push_back(std::make_pair(wrapper, 1));
+                FastInterpOsrEntry* entry = new FastInterpOsrEntry(m_fn, stmt, counter, m_threshold, path);
+                if (nodeType == AstNodeType::AstWhileLoop)
+                {
+                    assert_cast<AstWhileLoop*>(stmt)->SetFastInterpOsrEntry(entry);
+                }
+                else
+                {
+                    assert_cast<AstForLoop*>(stmt)->SetFastInterpOsrEntry(entry);
+                }
+                m_entries.push_back(entry);
+            }
+        }
+    }
+
+    AstFunction* m_fn;
+    uint64_t m_threshold;
+    std::vector<FastInterpOsrEntry*>& m_entries;
+    std::vector<std::pair<AstNodeBase*, size_t>> m_path;
+};
+
+AstNodeBase* WARN_UNUSED CloneLoopForContinuation(AstCloneHelper& cloner, AstNodeBase* loop)
+{
+    if (loop->GetAstNodeType() == AstNodeType::AstWhileLoop)
+    {
+        return cloner.Clone(loop);
+    }
+    else
+    {
+        AstForLoop* forLoop = assert_cast<AstForLoop*>(loop);
+        AstNodeBase* cond = cloner.Clone(forLoop->GetCondClause());
+        AstScope* body = cloner.CloneScope(forLoop->GetBody());
+        AstBlock* stepBlock = cloner.CloneBlock(forLoop->GetStepBlock());
+        return new AstForLoop(new AstBlock(std::vector<AstNodeBase*>()), cond, stepBlock, body);
+    }
+}
+
+}   // anonymous namespace
+
+void AstModule::InstrumentFastInterpOsrLoops()
+{
+    TestAssert(m_fastInterpOsrThreshold > 0 && m_fastInterpOsrEntries.empty());
+    for (AstFunction* fn : GetFunctionList())
+    {
+        if (IsOsrEligibleFunction(fn))
+        {
+            OsrLoopInstrumenter instrumenter(fn, m_fastInterpOsrThreshold, m_fastInterpOsrEntries);
+            instrumenter.Run();
+        }
+    }
+}
+
+void AstModule::CreateFastInterpOsrContinuations()
+{
+    for (FastInterpOsrEntry* entry : m_fastInterpOsrEntries)
+    {
+        AstFunction* fn = entry->GetFunction();
+        const std::vector<std::pair<AstNodeBase*, size_t>>& path = entry->GetPath();
+        TestAssert(path.size() >= 2 && path[0].first == fn->GetFunctionBody());
+
+        // Find all variables live at the back-edge of the loop
+        //
+        std::vector<AstVariable*> liveVars = fn->GetParamsVector();
+        for (const std::pair<AstNodeBase*, size_t>& item : path)
+        {
+            CollectDeclaredVariables(GetStatementList(item.first), item.second, liveVars);
+        }
+        if (entry->GetLoop()->GetAstNodeType() == AstNodeType::AstForLoop)
+        {
+            const std::vector<AstNodeBase*>& initBlock = assert_cast<AstForLoop*>(entry->GetLoop())->GetInitBlock()->GetContents();
+            CollectDeclaredVariables(initBlock, initBlock.size(), liveVars);
+        }
+
+        std::string name = GetNextAvailableFnName("__pochivm_osr_" + fn->GetName() + "_");
+        AstFunction* continuation = NewAstFunction(name);
+        continuation->SetReturnType(fn->GetReturnType());
+        continuation->AddParam(TypeId::Get<uintptr_t>(), "osr_stackframe");
+        continuation->SetIsNoExcept(true);
+        AstVariable* stackframe = continuation->GetParamsVector()[0];
+
+        // Load the live variables from the FastInterp stack frame
+        //
+        AstCloneHelper cloner(continuation);
+        std::vector<AstNodeBase*> body;
+        for (AstVariable* var : liveVars)
+        {
+            if (var == entry->GetCounterVariable())
+            {
+                continue;
+            }
+            uint64_t offset = var->GetFastInterpOffset();
+            AstNodeBase* addr = new AstReinterpretCastExpr(
+                        new AstArithmeticExpr(AstArithmeticExprType::ADD,
+                                              new AstDereferenceVariableExpr(stackframe),
+                                              new AstLiteralExpr(TypeId::Get<uint64_t>(), &offset)),
+                        var->GetTypeId());
+            AstVariable* newVar = cloner.MapVariable(var);
+            body.push_back(new AstDeclareVariable(newVar, new AstAssignExpr(newVar, new AstDereferenceExpr(addr))));
+        }
+
+        // Clone the rest of the function starting from the loop, from the innermost scope to the outermost one
+        //
+        std::vector<AstNodeBase*> stmts { CloneLoopForContinuation(cloner, entry->GetLoop()) };
+        for (size_t k = path.size(); k-- > 0;)
+        {
+            const std::vector<AstNodeBase*>& contents = GetStatementList(path[k].first);
+            for (size_t i = path[k].second + 1; i < contents.size(); i++)
+            {
+                stmts.push_back(cloner.Clone(contents[i]));
+            }
+            if (k > 0)
+            {
+                AstNodeBase* wrapped;
+                if (path[k].first->GetAstNodeType() == AstNodeType::AstBlock)
+                {
+                    wrapped = new AstBlock(stmts);
+                }
+                else
+                {
+                    wrapped = new AstScope(stmts);
+                }
+                stmts = std::vector<AstNodeBase*> { wrapped };
+            }
+        }
+        body.insert(body.end(), stmts.begin(), stmts.end());
+        continuation->SetFunctionBody(new AstBlock(body));
+
+        entry->SetContinuationFnName(name);
+    }
+}
+
+}   // namespace PochiVM
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "common.h"
+
+namespace PochiVM
+{
+
+class AstFunction;
+class AstNodeBase;
+class AstVariable;
+
+// An on-stack-replacement point of a loop in a FastInterp generated function.
+// See AstModule::SetFastInterpOsrThreshold() for the overall design.
+//
+// The back-edge of the loop counts the iterations executed in the current invocation.
+// Once the count reaches the threshold, it checks if a compiled continuation has been published.
+// If so, it calls the continuation with its own stack frame, and returns whatever the continuation returns.
+// The continuation is a generated function with prototype 'R(uintptr_t stackframe)', where R is the
+// return type of the function containing the loop. It loads the live variables from the FastInterp
+// stack frame, and executes the rest of the function starting from the next iteration of the loop.
+// Otherwise the counter is reset, so the check is done again after another 'threshold' iterations.
+//
+class FastInterpOsrEntry : NonCopyable, NonMovable
+{
+public:
+    FastInterpOsrEntry(AstFunction* fn,
+                       AstNodeBase* loop,
+                       AstVariable* counter,
+                       uint64_t threshold,
+                       const std::vector<std::pair<AstNodeBase*, size_t>>& path)
+        : m_fn(fn)
+        , m_loop(loop)
+        , m_counter(counter)
+        , m_threshold(threshold)
+        , m_path(path)
+        , m_continuationFnName()
+        , m_compiledContinuation(0)
+    { }
+
+    AstFunction* GetFunction() const { return m_fn; }
+    AstNodeBase* GetLoop() const { return m_loop; }
+    AstVariable* GetCounterVariable() const { return m_counter; }
+    uint64_t GetThreshold() const { return m_threshold; }
+
+    // The statement lists enclosing the loop, from the function body to the innermost one.
+    // Each element is a AstScope or AstBlock, and the index of the statement containing the loop in it.
+    //
+    const std::vector<std::pair<AstNodeBase*, size_t>>& GetPath() const { return m_path; }
+
+    // The name of the generated continuation function.
+    // Only available after AstModule::PrepareForFastInterp() is called.
+    //
+    const std::string& GetContinuationFnName() const
+    {
+        TestAssert(m_continuationFnName != "");
+        return m_continuationFnName;
+    }
+
+    void SetContinuationFnName(const std::string& name)
+    {
+        TestAssert(m_continuationFnName == "" && name != "");
+        m_continuationFnName = name;
+    }
+
+    // Publish the compiled (LLVM) version of the continuation function, so that FastInterp code executing
+    // the loop will transfer to it. May be called from any thread, at any time while the module is alive:
+    // the entry is owned by the module and freed with it (see AstModule::SetFastInterpOsrThreshold()).
+    //
+    void SetCompiledContinuation(void* fnAddress)
+    {
+        TestAssert(fnAddress != nullptr);
+        __atomic_store_n(&m_compiledContinuation, reinterpret_cast<uintptr_t>(fnAddress), __ATOMIC_RELEASE);
+    }
+
+    bool IsCompiledContinuationAvailable() const
+    {
+        return __atomic_load_n(&m_compiledContinuation, __ATOMIC_ACQUIRE) != 0;
+    }
+
+    // The address read by the FastInterp back-edge boilerplate
+    //
+    uintptr_t* GetCompiledContinuationSlot()
+    {
+        return &m_compiledContinuation;
+    }
+
+private:
+    AstFunction* m_fn;
+    AstNodeBase* m_loop;
+    AstVariable* m_counter;
+    uint64_t m_threshold;
+    std::vector<std::pair<AstNodeBase*, size_t>> m_path;
+    std::string m_continuationFnName;
+    uintptr_t m_compiledContinuation;
+};
+
+}   // namespace PochiVM
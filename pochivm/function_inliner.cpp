@@ -0,0 +1,636 @@
+#include "ast_clone_helper.h"
+
+namespace PochiVM
+{
+
+// AST-level inlining of small generated functions.
+//
+// FastInterp has no cross-function optimization, so every call between generated functions pays for
+// a full FastInterp call (stack frame setup, parameter passing, return). For tiny helper functions
+// (e.g. the hash and compare functions of a hash table, called once per probe), this overhead dominates.
+// This pass copies the bodies of such functions into their callers before FastInterp code generation.
+//
+// To keep the transformation obviously correct, we only inline 'pure leaf' functions:
+//   (1) The function calls no other function (generated or C++), and contains no throw.
+//   (2) The function only writes to its own local variables (or parameters), so it has no side effects.
+//   (3) The function has no return statement inside a loop.
+// And we only inline calls in expressions which otherwise have no side effects either
+// (no function calls other than inlinable ones, no assignments), so that evaluating the inlined
+// function bodies before the rest of the expression does not change program behavior.
+// The short-circuiting semantics of logical operators are preserved.
+//
+// A call 'f(args)' is replaced by the following code inserted before the statement containing the call:
+//     Declare(ret);
+//     {
+//         Declare(p1, arg1); Declare(p2, arg2); ...
+//         <cloned body of f, with each 'Return(x)' replaced by 'Assign(ret, x)'>
+//     }
+// and the call expression itself is replaced by a dereference of 'ret'. If 'f' has more than one return
+// statement, or its only return statement is not the last statement, the cloned body is additionally
+// wrapped by a 'While(true)' loop, and each 'Return(x)' becomes 'Assign(ret, x); Break();'
+//
+// The callers are modified in place rather than cloned, since the pass runs on every PrepareForFastInterp()
+// and cloning every function would defeat the purpose of a fast codegen path. So the inlined AST is what
+// EmitIR() or DebugInterp sees if they are run on the same module afterwards (see SetFastInterpInlineThreshold).
+//
+
+namespace {
+
+struct InlinableCalleeInfo
+{
+    AstFunction* m_fn;
+    // Whether the cloned body needs to be wrapped by a 'While(true)' loop, see comments above
+    //
+    bool m_needLoopForReturn;
+};
+
+// Check if 'fn' may be inlined, see comments at beginning of file.
+//
+bool WARN_UNUSED IsInlinableCallee(AstFunction* fn, size_t maxCalleeNodes, InlinableCalleeInfo& info /*out*/)
+{
+    // A function without return value and side effects is useless, not worth the effort.
+    //
+    if (fn->GetReturnType().IsVoid())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < fn->GetNumParams(); i++)
+    {
+        if (fn->GetParamType(i).IsCppClassType())
+        {
+            return false;
+        }
+    }
+
+    bool ok = true;
+    size_t numNodes = 0;
+    size_t numReturns = 0;
+    size_t loopDepth = 0;
+    fn->TraverseFunctionBody([&](AstNodeBase* cur, AstNodeBase* /*parent*/, FunctionRef<void(void)> Recurse)
+    {
+        if (!ok)
+        {
+            return;
+        }
+        numNodes++;
+        switch (static_cast<int>(cur->GetAstNodeType()))
+        {
+        case AstNodeType::AstArithmeticExpr:
+        case AstNodeType::AstComparisonExpr:
+        case AstNodeType::AstStaticCastExpr:
+        case AstNodeType::AstReinterpretCastExpr:
+        case AstNodeType::AstDereferenceExpr:
+        case AstNodeType::AstLiteralExpr:
+        case AstNodeType::AstDereferenceVariableExpr:
+        case AstNodeType::AstBlock:
+        case AstNodeType::AstScope:
+        case AstNodeType::AstIfStatement:
+        case AstNodeType::AstBreakOrContinueStmt:
+        case AstNodeType::AstLogicalAndOrExpr:
+        case AstNodeType::AstLogicalNotExpr:
+        case AstNodeType::AstPointerArithmeticExpr:
+        case AstNodeType::AstBitIntrinsicExpr:
+        {
+            break;
+        }
+        case AstNodeType::AstVariable:
+        {
+            if (cur->GetTypeId().RemovePointer().IsCppClassType())
+            {
+                ok = false;
+                return;
+            }
+            break;
+        }
+        case AstNodeType::AstDeclareVariable:
+        {
+            if (assert_cast<AstDeclareVariable*>(cur)->m_callExpr != nullptr)
+            {
+                ok = false;
+                return;
+            }
+            break;
+        }
+        case AstNodeType::AstAssignExpr:
+        {
+            // Writing to anything other than a local variable is a side effect
+            //
+            if (assert_cast<AstAssignExpr*>(cur)->GetDst()->GetAstNodeType() != AstNodeType::AstVariable)
+            {
+                ok = false;
+                return;
+            }
+            break;
+        }
+        case AstNodeType::AstReturnStmt:
+        {
+            if (loopDepth > 0)
+            {
+                ok = false;
+                return;
+            }
+            numReturns++;
+            break;
+        }
+        case AstNodeType::AstWhileLoop:
+        case AstNodeType::AstForLoop:
+        {
+            loopDepth++;
+            Recurse();
+            loopDepth--;
+            return;
+        }
+        default:
+        {
+            ok = false;
+            return;
+        }
+        }   /*switch*/
+        Recurse();
+    });
+
+    if (!ok || numNodes > maxCalleeNodes)
+    {
+        return false;
+    }
+    info.m_fn = fn;
+    // If there is only one return statement and all paths end with a Return, the return statement must be
+    // the last statement executed, so we can simply fall through after it. Otherwise we need the loop.
+    //
+    info.m_needLoopForReturn = !(numReturns == 1 &&
+                                 IsTerminatingStatement(fn->GetFunctionBody(), false /*treatBreakContinueAsTerminating*/));
+    return true;
+}
+
+AstLiteralExpr* CreateBoolLiteral(bool value)
+{
+    return new AstLiteralExpr(TypeId::Get<bool>(), &value);
+}
+
+// Clone the body of a callee into the caller, remapping all callee variables to fresh variables of the caller
+//
+class InlinedBodyCloner : public AstCloneHelper
+{
+public:
+    InlinedBodyCloner(AstFunction* caller, AstVariable* retVar, bool needLoopForReturn)
+        : AstCloneHelper(caller)
+        , m_retVar(retVar)
+        , m_needLoopForReturn(needLoopForReturn)
+    { }
+
+protected:
+    virtual AstNodeBase* CloneReturnStmt(AstReturnStmt* node) override final
+    {
+        // An inlinable callee calls no other functions, so it has no tail calls
+        //
+        TestAssert(node->m_retVal != nullptr && !node->IsTailCall());
+        AstNodeBase* assign = new AstAssignExpr(m_retVar, Clone(node->m_retVal));
+        if (m_needLoopForReturn)
+        {
+            return new AstBlock({ assign, new AstBreakOrContinueStmt(true /*isBreak*/) });
+        }
+        else
+        {
+            return assign;
+        }
+    }
+
+private:
+    AstVariable* m_retVar;
+    bool m_needLoopForReturn;
+};
+
+// Rewrite the body of a function, inlining all calls to inlinable functions in eligible positions
+//
+class CallerRewriter
+{
+public:
+    CallerRewriter(AstFunction* caller,
+                   const std::unordered_map<AstFunction*, InlinableCalleeInfo>& callees)
+        : m_caller(caller)
+        , m_callees(callees)
+    { }
+
+    void Run()
+    {
+        RewriteStatementList(m_caller->GetFunctionBody()->GetContents());
+    }
+
+private:
+    const InlinableCalleeInfo* GetInlinableCallee(AstNodeBase* node)
+    {
+        if (node->GetAstNodeType() != AstNodeType::AstCallExpr)
+        {
+            return nullptr;
+        }
+        AstCallExpr* callExpr = assert_cast<AstCallExpr*>(node);
+        if (callExpr->IsCppFunction())
+        {
+            return nullptr;
+        }
+        AstFunction* callee = callExpr->GetCalleeAstFunction();
+        TestAssert(callee != nullptr);
+        auto it = m_callees.find(callee);
+        if (it == m_callees.end())
+        {
+            return nullptr;
+        }
+        // An inlinable function calls no function, so it cannot be the caller
+        //
+        TestAssert(callee != m_caller);
+        return &it->second;
+    }
+
+    // Returns true if 'expr' only consists of side-effect-free nodes and calls to inlinable functions,
+    // and there is at least one such call. Only these expressions are rewritten.
+    //
+    bool ShouldRewriteExpr(AstNodeBase* expr)
+    {
+        bool ok = true;
+        bool hasInlinableCall = false;
+        TraverseAstTree(expr, [&](AstNodeBase* cur, AstNodeBase* /*parent*/, FunctionRef<void(void)> Recurse)
+        {
+            if (!ok)
+            {
+                return;
+            }
+            switch (static_cast<int>(cur->GetAstNodeType()))
+            {
+            case AstNodeType::AstArithmeticExpr:
+            case AstNodeType::AstComparisonExpr:
+            case AstNodeType::AstStaticCastExpr:
+            case AstNodeType::AstReinterpretCastExpr:
+            case AstNodeType::AstDereferenceExpr:
+            case AstNodeType::AstLiteralExpr:
+            case AstNodeType::AstVariable:
+            case AstNodeType::AstDereferenceVariableExpr:
+            case AstNodeType::AstLogicalAndOrExpr:
+            case AstNodeType::AstLogicalNotExpr:
+            case AstNodeType::AstPointerArithmeticExpr:
+            case AstNodeType::AstBitIntrinsicExpr:
+            {
+                break;
+            }
+            case AstNodeType::AstCallExpr:
+            {
+                if (GetInlinableCallee(cur) == nullptr)
+                {
+                    ok = false;
+                    return;
+                }
+                hasInlinableCall = true;
+                break;
+            }
+            default:
+            {
+                ok = false;
+                return;
+            }
+            }   /*switch*/
+            Recurse();
+        });
+        return ok && hasInlinableCall;
+    }
+
+    bool ContainsInlinableCall(AstNodeBase* expr)
+    {
+        bool found = false;
+        TraverseAstTree(expr, [&](AstNodeBase* cur, AstNodeBase* /*parent*/, FunctionRef<void(void)> Recurse)
+        {
+            if (found)
+            {
+                return;
+            }
+            if (GetInlinableCallee(cur) != nullptr)
+            {
+                found = true;
+                return;
+            }
+            Recurse();
+        });
+        return found;
+    }
+
+    // Returns an expression equivalent to 'expr' but with no inlinable calls,
+    // with the inlined function bodies appended to 'prelude'.
+    // 'expr' must have passed ShouldRewriteExpr().
+    //
+    AstNodeBase* WARN_UNUSED RewriteExpr(AstNodeBase* expr, std::vector<AstNodeBase*>& prelude /*inout*/)
+    {
+        if (!ContainsInlinableCall(expr))
+        {
+            return expr;
+        }
+        switch (static_cast<int>(expr->GetAstNodeType()))
+        {
+        case AstNodeType::AstCallExpr:
+        {
+            return EmitInlinedCall(assert_cast<AstCallExpr*>(expr), prelude);
+        }
+        case AstNodeType::AstArithmeticExpr:
+        {
+            AstArithmeticExpr* e = assert_cast<AstArithmeticExpr*>(expr);
+            AstNodeBase* lhs = RewriteExpr(e->GetLhs(), prelude);
+            AstNodeBase* rhs = RewriteExpr(e->GetRhs(), prelude);
+            return new AstArithmeticExpr(e->GetOp(), lhs, rhs);
+        }
+        case AstNodeType::AstComparisonExpr:
+        {
+            AstComparisonExpr* e = assert_cast<AstComparisonExpr*>(expr);
+            AstNodeBase* lhs = RewriteExpr(e->GetLhs(), prelude);
+            AstNodeBase* rhs = RewriteExpr(e->GetRhs(), prelude);
+            return new AstComparisonExpr(e->GetOp(), lhs, rhs);
+        }
+        case AstNodeType::AstStaticCastExpr:
+        {
+            AstStaticCastExpr* e = assert_cast<AstStaticCastExpr*>(expr);
+            return new AstStaticCastExpr(RewriteExpr(e->GetOperand(), prelude), e->GetTypeId());
+        }
+        case AstNodeType::AstReinterpretCastExpr:
+        {
+            AstReinterpretCastExpr* e = assert_cast<AstReinterpretCastExpr*>(expr);
+            return new AstReinterpretCastExpr(RewriteExpr(e->GetOperand(), prelude), e->GetTypeId());
+        }
+        case AstNodeType::AstDereferenceExpr:
+        {
+            AstDereferenceExpr* e = assert_cast<AstDereferenceExpr*>(expr);
+            return new AstDereferenceExpr(RewriteExpr(e->GetOperand(), prelude));
+        }
+        case AstNodeType::AstPointerArithmeticExpr:
+        {
+            AstPointerArithmeticExpr* e = assert_cast<AstPointerArithmeticExpr*>(expr);
+            AstNodeBase* base = RewriteExpr(e->m_base, prelude);
+            AstNodeBase* index = RewriteExpr(e->m_index, prelude);
+            return new AstPointerArithmeticExpr(base, index, e->m_isAddition);
+        }
+        case AstNodeType::AstBitIntrinsicExpr:
+        {
+            AstBitIntrinsicExpr* e = assert_cast<AstBitIntrinsicExpr*>(expr);
+            AstNodeBase* lhs = RewriteExpr(e->GetLhs(), prelude);
+            AstNodeBase* rhs = (e->GetRhs() == nullptr) ? nullptr : RewriteExpr(e->GetRhs(), prelude);
+            return new AstBitIntrinsicExpr(e->GetOp(), lhs, rhs);
+        }
+        case AstNodeType::AstLogicalNotExpr:
+        {
+            AstLogicalNotExpr* e = assert_cast<AstLogicalNotExpr*>(expr);
+            return new AstLogicalNotExpr(RewriteExpr(e->m_op, prelude));
+        }
+        case AstNodeType::AstLogicalAndOrExpr:
+        {
+            AstLogicalAndOrExpr* e = assert_cast<AstLogicalAndOrExpr*>(expr);
+            AstNodeBase* lhs = RewriteExpr(e->m_lhs, prelude);
+            if (!ContainsInlinableCall(e->m_rhs))
+            {
+                return new AstLogicalAndOrExpr(e->m_isAnd, lhs, e->m_rhs);
+            }
+            // The inlined calls in rhs must only be executed if lhs does not short-circuit:
+            //     Declare(tmp, lhs); If(tmp) { <inlined calls in rhs>; Assign(tmp, rhs); }   (for '&&')
+            //     Declare(tmp, lhs); If(!tmp) { <inlined calls in rhs>; Assign(tmp, rhs); }  (for '||')
+            //
+            AstVariable* tmp = new AstVariable(TypeId::Get<bool*>(), m_caller, m_caller->GetNextVarSuffix(), "inlined_cond");
+            prelude.push_back(new AstDeclareVariable(tmp, new AstAssignExpr(tmp, lhs)));
+            std::vector<AstNodeBase*> rhsPrelude;
+            AstNodeBase* rhs = RewriteExpr(e->m_rhs, rhsPrelude);
+            rhsPrelude.push_back(new AstAssignExpr(tmp, rhs));
+            AstNodeBase* cond = new AstDereferenceVariableExpr(tmp);
+            if (!e->m_isAnd)
+            {
+                cond = new AstLogicalNotExpr(cond);
+            }
+            prelude.push_back(new AstIfStatement(cond, new AstScope(rhsPrelude)));
+            return new AstDereferenceVariableExpr(tmp);
+        }
+        default:
+        {
+            // ShouldRewriteExpr() should have rejected the expression
+            //
+            TestAssert(false);
+            __builtin_unreachable();
+        }
+        }   /*switch*/
+    }
+
+    AstNodeBase* WARN_UNUSED EmitInlinedCall(AstCallExpr* callExpr, std::vector<AstNodeBase*>& prelude /*inout*/)
+    {
+        const InlinableCalleeInfo* info = GetInlinableCallee(callExpr);
+        TestAssert(info != nullptr);
+        AstFunction* callee = info->m_fn;
+
+        const std::vector<AstNodeBase*>& params = callExpr->GetParams();
+        TestAssert(params.size() == callee->GetNumParams());
+        std::vector<AstNodeBase*> args;
+        for (AstNodeBase* param : params)
+        {
+            args.push_back(RewriteExpr(param, prelude));
+        }
+
+        AstVariable* retVar = new AstVariable(callee->GetReturnType().AddPointer(), m_caller, m_caller->GetNextVarSuffix(), "inlined_ret");
+        prelude.push_back(new AstDeclareVariable(retVar));
+
+        InlinedBodyCloner cloner(m_caller, retVar, info->m_needLoopForReturn);
+        std::vector<AstNodeBase*> inlinedStmts;
+        for (size_t i = 0; i < callee->GetNumParams(); i++)
+        {
+            AstVariable* var = cloner.MapVariable(callee->GetParamsVector()[i]);
+            inlinedStmts.push_back(new AstDeclareVariable(var, new AstAssignExpr(var, args[i])));
+        }
+        AstScope* body = cloner.CloneScope(callee->GetFunctionBody());
+        if (!info->m_needLoopForReturn)
+        {
+            inlinedStmts.push_back(body);
+        }
+        else
+        {
+            std::vector<AstNodeBase*> loopBody { body };
+            // If the end of function body is reachable, we must break out of the loop there as well.
+            // Otherwise an extra Break would be unreachable code.
+            //
+            if (!IsTerminatingStatement(callee->GetFunctionBody(), false /*treatBreakContinueAsTerminating*/))
+            {
+                loopBody.push_back(new AstBreakOrContinueStmt(true /*isBreak*/));
+            }
+            inlinedStmts.push_back(new AstWhileLoop(CreateBoolLiteral(true), new AstScope(loopBody)));
+        }
+        prelude.push_back(new AstScope(inlinedStmts));
+        return new AstDereferenceVariableExpr(retVar);
+    }
+
+    static AstNodeBase* WARN_UNUSED WrapWithPrelude(std::vector<AstNodeBase*>& prelude, AstNodeBase* stmt)
+    {
+        TestAssert(prelude.size() > 0);
+        prelude.push_back(stmt);
+        return new AstBlock(prelude);
+    }
+
+    void RewriteStatementList(std::vector<AstNodeBase*>& contents)
+    {
+        for (size_t i = 0; i < contents.size(); i++)
+        {
+            contents[i] = RewriteStatement(contents[i]);
+        }
+    }
+
+    AstNodeBase* WARN_UNUSED RewriteStatement(AstNodeBase* stmt)
+    {
+        switch (static_cast<int>(stmt->GetAstNodeType()))
+        {
+        case AstNodeType::AstBlock:
+        {
+            RewriteStatementList(assert_cast<AstBlock*>(stmt)->GetContents());
+            return stmt;
+        }
+        case AstNodeType::AstScope:
+        {
+            RewriteStatementList(assert_cast<AstScope*>(stmt)->GetContents());
+            return stmt;
+        }
+        case AstNodeType::AstForLoop:
+        {
+            // The condition and the step block are executed after 'Continue', and declarations in
+            // the init block must stay in the init block, so we only look at the body.
+            //
+            RewriteStatementList(assert_cast<AstForLoop*>(stmt)->GetBody()->GetContents());
+            return stmt;
+        }
+        case AstNodeType::AstIfStatement:
+        {
+            AstIfStatement* ifStmt = assert_cast<AstIfStatement*>(stmt);
+            RewriteStatementList(ifStmt->GetThenClause()->GetContents());
+            if (ifStmt->HasElseClause())
+            {
+                RewriteStatementList(ifStmt->GetElseClause()->GetContents());
+            }
+            if (!ShouldRewriteExpr(ifStmt->GetCondClause()))
+            {
+                return stmt;
+            }
+            std::vector<AstNodeBase*> prelude;
+            AstNodeBase* cond = RewriteExpr(ifStmt->GetCondClause(), prelude);
+            AstIfStatement* result = new AstIfStatement(cond, ifStmt->GetThenClause());
+            if (ifStmt->HasElseClause())
+            {
+                result->SetElseClause(ifStmt->GetElseClause());
+            }
+            return WrapWithPrelude(prelude, result);
+        }
+        case AstNodeType::AstWhileLoop:
+        {
+            // While(cond) { body } is rewritten to
+            //     While(true) { <inlined calls>; If(!cond) { Break(); } { body } }
+            // which has the same semantics even if 'body' contains Continue statements.
+            //
+            AstWhileLoop* loop = assert_cast<AstWhileLoop*>(stmt);
+            RewriteStatementList(loop->GetBody()->GetContents());
+            if (!ShouldRewriteExpr(loop->GetCondClause()))
+            {
+                return stmt;
+            }
+            std::vector<AstNodeBase*> loopBody;
+            AstNodeBase* cond = RewriteExpr(loop->GetCondClause(), loopBody);
+            loopBody.push_back(new AstIfStatement(new AstLogicalNotExpr(cond),
+                                                  new AstScope({ new AstBreakOrContinueStmt(true /*isBreak*/) })));
+            loopBody.push_back(loop->GetBody());
+            return new AstWhileLoop(CreateBoolLiteral(true), new AstScope(loopBody));
+        }
+        case AstNodeType::AstDeclareVariable:
+        {
+            AstDeclareVariable* decl = assert_cast<AstDeclareVariable*>(stmt);
+            if (decl->m_assignExpr == nullptr || !ShouldRewriteExpr(decl->m_assignExpr->GetSrc()))
+            {
+                return stmt;
+            }
+            std::vector<AstNodeBase*> prelude;
+            AstNodeBase* value = RewriteExpr(decl->m_assignExpr->GetSrc(), prelude);
+            decl->m_assignExpr = new AstAssignExpr(decl->m_variable, value);
+            return WrapWithPrelude(prelude, decl);
+        }
+        case AstNodeType::AstAssignExpr:
+        {
+            AstAssignExpr* assign = assert_cast<AstAssignExpr*>(stmt);
+            bool rewriteSrc = ShouldRewriteExpr(assign->GetSrc());
+            bool rewriteDst = ShouldRewriteExpr(assign->GetDst());
+            if (!rewriteSrc && !rewriteDst)
+            {
+                return stmt;
+            }
+            // Both sides must be free of side effects, since we change their evaluation order
+            //
+            if ((!rewriteSrc && ContainsAnyCall(assign->GetSrc())) || (!rewriteDst && ContainsAnyCall(assign->GetDst())))
+            {
+                return stmt;
+            }
+            std::vector<AstNodeBase*> prelude;
+            AstNodeBase* src = RewriteExpr(assign->GetSrc(), prelude);
+            AstNodeBase* dst = RewriteExpr(assign->GetDst(), prelude);
+            return WrapWithPrelude(prelude, new AstAssignExpr(dst, src));
+        }
+        case AstNodeType::AstReturnStmt:
+        {
+            AstReturnStmt* ret = assert_cast<AstReturnStmt*>(stmt);
+            // The call of a tail call must stay in place, so we do not inline into it
+            //
+            if (ret->m_retVal == nullptr || ret->IsTailCall() || !ShouldRewriteExpr(ret->m_retVal))
+            {
+                return stmt;
+            }
+            std::vector<AstNodeBase*> prelude;
+            ret->m_retVal = RewriteExpr(ret->m_retVal, prelude);
+            return WrapWithPrelude(prelude, ret);
+        }
+        default:
+        {
+            return stmt;
+        }
+        }   /*switch*/
+    }
+
+    static bool ContainsAnyCall(AstNodeBase* expr)
+    {
+        bool found = false;
+        TraverseAstTree(expr, [&](AstNodeBase* cur, AstNodeBase* /*parent*/, FunctionRef<void(void)> Recurse)
+        {
+            if (cur->GetAstNodeType() == AstNodeType::AstCallExpr)
+            {
+                found = true;
+            }
+            if (!found)
+            {
+                Recurse();
+            }
+        });
+        return found;
+    }
+
+    AstFunction* m_caller;
+    const std::unordered_map<AstFunction*, InlinableCalleeInfo>& m_callees;
+};
+
+}   // anonymous namespace
+
+void AstModule::InlineSmallFunctions(size_t maxCalleeNodes)
+{
+    std::unordered_map<AstFunction*, InlinableCalleeInfo> callees;
+    for (AstFunction* fn : GetFunctionList())
+    {
+        InlinableCalleeInfo info;
+        if (IsInlinableCallee(fn, maxCalleeNodes, info /*out*/))
+        {
+            callees[fn] = info;
+        }
+    }
+    if (callees.empty())
+    {
+        return;
+    }
+
+    // Inlinable functions call no other function, so the result does not depend on the order we process callers,
+    // and the inlined code never needs to be processed again.
+    //
+    for (AstFunction* fn : GetFunctionList())
+    {
+        CallerRewriter rewriter(fn, callees);
+        rewriter.Run();
+    }
+}
+
+}   // namespace PochiVM
@@ -6,6 +6,7 @@
 #include "bitcode_data.h"
 #include "fastinterp/fastinterp_tpl_return_type.h"
 #include "pochivm_function_pointer.h"
+#include "codegen_arena_allocator.h"
 
 #include "generated/pochivm_runtime_cpp_typeinfo.generated.h"
 
@@ -26,6 +27,8 @@ class ThreadSafeModule;
 namespace PochiVM
 {
 
+class FastInterpGeneratedProgram;
+
 namespace internal
 {
 
@@ -66,9 +69,13 @@ private:
         , m_debugInterpStoreRetValFn(nullptr)
         , m_llvmEntryBlock(nullptr)
         , m_isNoExcept(false)
+        , m_isNoExceptInferred(false)
         , m_fastInterpStackFrameSize(static_cast<uint32_t>(-1))
         , m_fastInterpStackFrameSizeCategory(FIStackframeSizeCategory::X_END_OF_ENUM)
         , m_fastInterpCppEntryPoint(nullptr)
+        , m_moduleGeneration(0)
+        , m_generatorYieldType()
+        , m_generatorStateSize(static_cast<uint32_t>(-1))
     { }
 
 public:
@@ -80,7 +87,10 @@ public:
     // We need to emit all the function definitions before generating any function body,
     // otherwise cross invocation (A calling B and B calling A) would inevitably fail.
     //
-    void EmitDefinition();
+    // If 'isDeclarationOnly', the function is only declared in the current LLVM module, for calls from
+    // functions added in a later generation of an incremental update (see AstModule::StartIncrementalUpdate()).
+    //
+    void EmitDefinition(bool isDeclarationOnly);
 
     // Emit the function body
     //
@@ -197,6 +207,35 @@ public:
         return m_isNoExcept;
     }
 
+    // Whether the function is not declared noexcept, but is proven by AstModule::InferNoExcept() that it never throws
+    //
+    void SetIsNoExceptInferred(bool isNoExceptInferred)
+    {
+        TestAssertImp(isNoExceptInferred, !m_isNoExcept);
+        m_isNoExceptInferred = isNoExceptInferred;
+    }
+
+    bool GetIsNoExceptInferred() const
+    {
+        return m_isNoExceptInferred;
+    }
+
+    // Whether the function may be generated using the noexcept calling convention.
+    // This is true if the function is either declared noexcept, or inferred to never throw.
+    // Note that only the declared property is part of the function prototype seen by the user.
+    //
+    bool GetIsNoExceptForCodegen() const
+    {
+        return m_isNoExcept || m_isNoExceptInferred;
+    }
+
+    // False for functions added to the module after PrepareForFastInterp() (e.g. OSR continuations)
+    //
+    bool IsFastInterpGenerated() const
+    {
+        return m_fastInterpStackFrameSize != static_cast<uint32_t>(-1);
+    }
+
     uint32_t GetFastInterpStackFrameSize() const
     {
         TestAssert(m_fastInterpStackFrameSize != static_cast<uint32_t>(-1));
@@ -295,6 +334,46 @@ public:
         return m_fastInterpCppEntryPoint;
     }
 
+    // The generation of the module in which this function was added. See AstModule::StartIncrementalUpdate().
+    //
+    uint32_t GetModuleGeneration() const
+    {
+        return m_moduleGeneration;
+    }
+
+    // Make this function a generator producing values of type 'yieldType' by Yield statements.
+    // See AstModule::LowerGenerator() for how a generator is invoked.
+    //
+    void SetGeneratorYieldType(TypeId yieldType)
+    {
+        TestAssert(m_generatorYieldType.IsInvalid());
+        TestAssert(yieldType.IsPrimitiveType() || yieldType.IsPointerType());
+        m_generatorYieldType = yieldType;
+    }
+
+    bool IsGenerator() const
+    {
+        return !m_generatorYieldType.IsInvalid();
+    }
+
+    TypeId GetGeneratorYieldType() const
+    {
+        return m_generatorYieldType;
+    }
+
+    bool IsGeneratorLowered() const
+    {
+        return m_generatorStateSize != static_cast<uint32_t>(-1);
+    }
+
+    // The size of the state buffer that must be passed to the lowered generator functions
+    //
+    uint32_t GetGeneratorStateSize() const
+    {
+        TestAssert(IsGeneratorLowered());
+        return m_generatorStateSize;
+    }
+
 private:
 
     void DebugInterpSetParam(uintptr_t newStackFrameBase, size_t i, AstNodeBase* param)
@@ -304,6 +383,11 @@ private:
         m_debugInterpStoreParamFns[i](reinterpret_cast<void*>(addr), param);
     }
 
+    // Validate a TailCall statement in this function. 'varScope' is the variable scope map of Validate().
+    //
+    bool WARN_UNUSED ValidateTailCall(AstCallExpr* callExpr,
+                                      const std::unordered_map<AstVariable*, AstNodeBase*>& varScope);
+
     // Function parameters in LLVM are RValues. However, we make them LValues here,
     // same as normal variables. In LLVM, we emit a header block to assign RValue parameters
     // to these LValues (same as what clang++ does). In interp mode, these are already stored
@@ -341,9 +425,15 @@ private:
     llvm::BasicBlock* m_llvmEntryBlock;
 
     bool m_isNoExcept;
+    bool m_isNoExceptInferred;
     uint32_t m_fastInterpStackFrameSize;
     FIStackframeSizeCategory m_fastInterpStackFrameSizeCategory;
     void* m_fastInterpCppEntryPoint;
+    uint32_t m_moduleGeneration;
+    // The type of the values produced by the Yield statements if the function is a generator, invalid otherwise
+    //
+    TypeId m_generatorYieldType;
+    uint32_t m_generatorStateSize;
 };
 
 namespace internal
@@ -484,8 +574,27 @@ public:
     AstModule(const std::string& name)
         : m_moduleName(name)
         , m_functions()
+        , m_functionList()
+        , m_curGenFunctionList()
+        , m_generation(0)
+        , m_nextFnNameSuffix()
         , m_llvmContext(nullptr)
         , m_llvmModule(nullptr)
+        , m_noExceptInferenceEnabled(false)
+        , m_fastInterpInlineThreshold(0)
+        , m_fastInterpConstantFolding(false)
+        , m_fastInterpOsrThreshold(0)
+        , m_fastInterpCompactStackFrame(false)
+        , m_fastInterpCallFramesOnInterpStack(false)
+        , m_fastInterpColdPathLayout(false)
+        , m_fastInterpOsrEntries()
+        , m_oldFastInterpOsrEntries()
+        , m_fastInterpPrograms()
+        , m_attachedContext(nullptr)
+        , m_astAllocator()
+        , m_astNodeListHead(0)
+        , m_allocateAstNodesFromHeap(false)
+        , m_functionListSorted(true)
 #ifdef TESTBUILD
         , m_validated(false)
         , m_debugInterpPrepared(false)
@@ -495,12 +604,48 @@ public:
 #endif
     { }
 
+    // Destroys all AST nodes and functions of the module. Their memory is returned to the
+    // global codegen memory pool in whole chunks. The FastInterp generated code is also owned by the module,
+    // so it is freed as well. The LLVM generated code is owned by the JIT, not the module.
+    //
+    ~AstModule();
+
+    // Make this module the module being built by the current thread (see PochiVMContext for the thread-safety model).
+    // Fires if the module is attached to another thread. Use NewModule(), AttachModule() and DetachModule() instead.
+    //
+    void AttachToCurrentThread()
+    {
+        PochiVMContext* expected = nullptr;
+        ReleaseAssert(m_attachedContext.compare_exchange_strong(expected, thread_pochiVMContext));
+        thread_pochiVMContext->m_curModule = this;
+    }
+
+    void DetachFromCurrentThread()
+    {
+        PochiVMContext* expected = thread_pochiVMContext;
+        ReleaseAssert(m_attachedContext.compare_exchange_strong(expected, nullptr));
+        TestAssert(thread_pochiVMContext->m_curModule == this);
+        thread_pochiVMContext->m_curModule = nullptr;
+    }
+
+    bool IsAttachedToCurrentThread() const
+    {
+        return m_attachedContext.load() == thread_pochiVMContext;
+    }
+
     AstFunction* NewAstFunction(const std::string& name)
     {
+        TestAssert(thread_pochiVMContext->m_curModule == this);
         // TODO: this should throw
         TestAssert(!m_functions.count(name));
-        AstFunction* ret = new AstFunction(name);
-        m_functions[name] = ret;
+        AstFunction* ret = new (m_astAllocator) AstFunction(name);
+        // The name is interned: the key refers to the name owned by the function
+        //
+        m_functions[std::string_view(ret->GetName())] = ret;
+        ret->m_moduleGeneration = m_generation;
+        m_functionList.push_back(ret);
+        m_curGenFunctionList.push_back(ret);
+        m_functionListSorted = false;
         return ret;
     }
 
@@ -517,30 +662,105 @@ public:
         }
     }
 
+    // Returns 'prefix' followed by a number, such that no function of that name exists.
+    // Each call returns a different name. Amortized O(1): the next number is remembered per prefix,
+    // so only names taken by functions created directly by the user may have to be skipped.
+    //
     std::string GetNextAvailableFnName(const std::string& prefix)
     {
-        int i = 0;
+        uint64_t& i = m_nextFnNameSuffix[prefix];
         while (true)
         {
             std::string candidate = prefix + std::to_string(i);
+            i++;
             if (!m_functions.count(candidate))
             {
                 return candidate;
             }
-            i++;
         }
     }
 
+    size_t GetNumFunctions() const
+    {
+        return m_functionList.size();
+    }
+
+    // Start adding functions to a module that has already been built.
+    //
+    // The functions added afterwards form a new generation of the module. Validate(), the DebugInterp and
+    // FastInterp preparation and EmitIR() may then be called again, and only process the new generation.
+    // The new functions may call the functions of the earlier generations, which are not rebuilt:
+    //   (1) In FastInterp, they are called through their already generated code, which the module keeps alive.
+    //   (2) In LLVM, EmitIR() only declares them, so the resulted LLVM module must be added to the same
+    //       JIT session as the modules of the earlier generations.
+    // The earlier generations are never modified, so the options that transform the AST (e.g. inlining)
+    // only apply to the new functions, and a call to an earlier function is never inlined.
+    //
+    // The module must have been validated, and the IR of the last generation (if emitted) must have been
+    // taken by GetThreadSafeModule().
+    //
+    void StartIncrementalUpdate()
+    {
+        TestAssert(m_validated);
+        TestAssert(m_llvmModule == nullptr && m_llvmContext == nullptr);
+        m_generation++;
+        m_curGenFunctionList.clear();
+        // The prototypes belong to the LLVM modules of the earlier generations, which are owned by the JIT now
+        //
+        for (AstFunction* fn : m_functionList)
+        {
+            fn->m_generatedPrototype = nullptr;
+        }
+        // The FastInterp programs of the earlier generations are kept, and their back-edges still read
+        // the FastInterpOsrEntry objects, so they are freed together with the module
+        //
+        m_oldFastInterpOsrEntries.insert(m_oldFastInterpOsrEntries.end(), m_fastInterpOsrEntries.begin(), m_fastInterpOsrEntries.end());
+        m_fastInterpOsrEntries.clear();
+        m_functionListSorted = true;
+#ifdef TESTBUILD
+        m_validated = false;
+        m_debugInterpPrepared = false;
+        m_fastInterpPrepared = false;
+        m_irEmitted = false;
+        m_irOptimized = false;
+#endif
+    }
+
+    // The number of StartIncrementalUpdate() calls on this module
+    //
+    uint32_t GetGeneration() const
+    {
+        return m_generation;
+    }
+
+    // Serialize the AST of all functions of the module into a compact, versioned binary format
+    // (see ast_module_serialization.cpp), appending to 'out'. The AST is serialized as-is, so this is
+    // usually called right after the module is built, before any backend transforms it.
+    // Returns false and sets error if the module contains an AST node not supported by the format.
+    //
+    bool WARN_UNUSED Serialize(std::vector<uint8_t>& out /*inout*/);
+
+    // Rebuild the functions serialized by Serialize() into this module, which must be empty and being built
+    // by the current thread. The module can then be validated and prepared for any backend, as if it had been
+    // built by the API. C++ functions are looked up by symbol name in AstCppFunctionMetadataTable, so the module
+    // does not need to have been built in this process. The data must be the output of Serialize() by a trusted
+    // build of the same runtime library: only truncation and inconsistent references are detected, while e.g.
+    // mismatched operand types of an AST node are not (see limitation (4) in ast_module_serialization.cpp).
+    // Returns false and sets error if the data is truncated, has an inconsistent reference or an unsupported
+    // format version, or references a C++ function unknown to the runtime library. The module is then left empty.
+    //
+    bool WARN_UNUSED Deserialize(const uint8_t* data, size_t size);
+
     void PrepareForDebugInterp()
     {
         TestAssert(!m_debugInterpPrepared);
+        TestAssert(thread_pochiVMContext->m_curModule == this);
 #ifdef TESTBUILD
         m_debugInterpPrepared = true;
 #endif
         AstTraverseColorMark::ClearAll();
-        for (auto iter = m_functions.begin(); iter != m_functions.end(); iter++)
+        for (AstFunction* fn : GetFunctionList())
         {
-            AstFunction* fn = iter->second;
             fn->PrepareForDebugInterp();
         }
     }
@@ -559,19 +779,182 @@ public:
     bool WARN_UNUSED Validate()
     {
         TestAssert(!m_validated);
+        TestAssert(thread_pochiVMContext->m_curModule == this);
 #ifdef TESTBUILD
         m_validated = true;
 #endif
         assert(!thread_errorContext->HasError());
         AstTraverseColorMark::ClearAll();
-        for (auto iter = m_functions.begin(); iter != m_functions.end(); iter++)
+        // The generators are validated in their original form, then lowered into plain functions,
+        // so the other functions are validated against the prototypes of the lowered functions.
+        //
+        std::vector<AstFunction*> generators;
+        for (AstFunction* fn : GetFunctionList())
+        {
+            if (fn->IsGenerator())
+            {
+                generators.push_back(fn);
+            }
+        }
+        for (AstFunction* fn : generators)
+        {
+            CHECK_ERR(fn->Validate());
+            CHECK_ERR(LowerGenerator(fn));
+        }
+        if (!generators.empty())
+        {
+            AstTraverseColorMark::ClearAll();
+        }
+        for (AstFunction* fn : GetFunctionList())
         {
-            AstFunction* fn = iter->second;
             CHECK_ERR(fn->Validate());
         }
+        if (m_noExceptInferenceEnabled)
+        {
+            InferNoExcept();
+        }
         RETURN_TRUE;
     }
 
+    // If enabled, Validate() additionally runs a whole-module analysis to find the functions that are
+    // not declared noexcept but can never throw, so they can be generated without exception checks
+    // (noexcept-convention boilerplates in FastInterp, 'call' instead of 'invoke' in LLVM).
+    // Must be set before Validate(). Disabled by default, since it changes the generated IR.
+    //
+    void SetNoExceptInferenceEnabled(bool enabled)
+    {
+        TestAssert(!m_validated);
+        m_noExceptInferenceEnabled = enabled;
+    }
+
+    // If set to a non-zero value, PrepareForFastInterp() first inlines calls to small generated functions
+    // (at most 'maxCalleeNodes' AST nodes) into their callers at AST level, saving the FastInterp call overhead.
+    // Only callees that have no side effects and call no other functions are inlined, see function_inliner.cpp.
+    // Must be set before PrepareForFastInterp(). Disabled by default.
+    // Note that the inlining rewrites the callers' AST in place: if this module is lowered with EmitIR()
+    // or prepared for DebugInterp afterwards, those backends see the inlined AST, not the original one.
+    // Their results are unchanged, but benchmarks comparing the backends should build a separate module
+    // for each. For the same reason, it must not be used if the module has already been prepared
+    // for DebugInterp, since DebugInterp has already bound the original AST nodes.
+    //
+    void SetFastInterpInlineThreshold(size_t maxCalleeNodes)
+    {
+        TestAssert(!m_fastInterpPrepared);
+        m_fastInterpInlineThreshold = maxCalleeNodes;
+    }
+
+    // If true, PrepareForFastInterp() folds constant expressions, propagates variables initialized by literals,
+    // and removes branches with a constant condition before generating code (after inlining, if enabled),
+    // see constant_folding.cpp. Must be set before PrepareForFastInterp(). Disabled by default.
+    // Note that the folding modifies the AST, so it is also visible to other backends if they are run on
+    // this module afterwards. In particular, it must not be used if the module has already been prepared
+    // for DebugInterp, since DebugInterp has already bound the original AST nodes.
+    //
+    void SetFastInterpConstantFolding(bool enabled)
+    {
+        TestAssert(!m_fastInterpPrepared);
+        m_fastInterpConstantFolding = enabled;
+    }
+
+    // If set to a non-zero value, PrepareForFastInterp() makes eligible loops on-stack-replacement points,
+    // so that a long-running FastInterp function can continue in LLVM-compiled code without returning first.
+    //
+    // The back-edge of such a loop counts its iterations. Every 'numBackEdges' iterations, it checks if
+    // the compiled continuation of the loop has been published, and if so, transfers to it.
+    // PrepareForFastInterp() adds one continuation function per OSR point to this module (listed by
+    // GetFastInterpOsrEntries()). They are not available in FastInterp. The user is expected to compile
+    // the module with LLVM (EmitIR(), OptimizeIR() and JIT, possibly in a background thread), then publish
+    // the continuations by FastInterpOsrEntry::SetCompiledContinuation(). The FastInterp code may keep running
+    // meanwhile, but no other operation may be done on this module until the LLVM compilation completes.
+    //
+    // The FastInterpOsrEntry objects are owned by the module and freed when it is destroyed. Publishing a
+    // continuation to an entry of a destroyed module is a caller error: the background compilation must
+    // complete (or be abandoned without publishing) before the module is deleted.
+    //
+    // A loop is eligible if it is a while-loop or for-loop that is not nested in any other control flow
+    // statement, in a function that can never throw (see GetIsNoExceptForCodegen()), only uses primitive
+    // and pointer types, and never takes the address of a local variable.
+    //
+    // Must be set before PrepareForFastInterp(). Disabled by default. Note that the OSR points add a
+    // counter variable to the AST, so it is visible to the other backends if they are run on this module.
+    //
+    void SetFastInterpOsrThreshold(uint64_t numBackEdges)
+    {
+        TestAssert(!m_fastInterpPrepared);
+        m_fastInterpOsrThreshold = numBackEdges;
+    }
+
+    const std::vector<FastInterpOsrEntry*>& GetFastInterpOsrEntries() const
+    {
+        return m_fastInterpOsrEntries;
+    }
+
+    // If true, FastInterp releases the stack frame slot of a local variable after its last use
+    // instead of at the end of its scope, and packs variables and spilled temporaries into the free space
+    // of the stack frame (see FILocalVarLiveness and FIStackFramePlanner). Otherwise, the stack frame
+    // is laid out as a stack of scopes (the default). Must be set before PrepareForFastInterp().
+    //
+    void SetFastInterpCompactStackFrame(bool value)
+    {
+        TestAssert(!m_fastInterpPrepared);
+        m_fastInterpCompactStackFrame = value;
+    }
+
+    // If true, a call from a FastInterp generated function allocates the stack frame of the callee from the
+    // interpreter stack of the current thread (see FastInterpInterpStack) instead of the C stack. Only the small
+    // native frame of the call operator stays on the C stack, so a deep recursion in generated code is bounded by
+    // the (configurable) interpreter stack limit, which reports a clear error when exceeded, instead of silently
+    // overflowing the C stack. The generated functions must then only be run by threads with an interpreter
+    // stack installed (AutoThreadFastInterpInterpStack). Calls are slightly slower, so this is disabled by default.
+    // Must be set before PrepareForFastInterp().
+    //
+    void SetFastInterpCallFramesOnInterpStack(bool value)
+    {
+        TestAssert(!m_fastInterpPrepared);
+        m_fastInterpCallFramesOnInterpStack = value;
+    }
+
+    bool GetFastInterpCallFramesOnInterpStack() const
+    {
+        return m_fastInterpCallFramesOnInterpStack;
+    }
+
+    // If true, FastInterp places the code only reachable through a cold path (e.g. exception propagation)
+    // after all the hot code of the module, instead of next to the code that branches to it.
+    // Disabled by default. Must be set before PrepareForFastInterp().
+    //
+    void SetFastInterpColdPathLayout(bool value)
+    {
+        TestAssert(!m_fastInterpPrepared);
+        m_fastInterpColdPathLayout = value;
+    }
+
+    // If true, the AST nodes of the module are allocated one by one with ::operator new instead of from
+    // the module arena. They are still freed when the module is destroyed. Only useful as a baseline for
+    // benchmarking the arena. Must be set before any node is created.
+    //
+    void SetAllocateAstNodesFromHeap(bool value)
+    {
+        TestAssert(m_astNodeListHead == 0);
+        m_allocateAstNodesFromHeap = value;
+    }
+
+    // The sum of the FastInterp stack frame sizes of all functions in the module.
+    // Only available after PrepareForFastInterp(). For diagnostics.
+    //
+    uint64_t GetFastInterpTotalStackFrameSize() const
+    {
+        uint64_t result = 0;
+        for (AstFunction* fn : m_functionList)
+        {
+            if (fn->IsFastInterpGenerated())
+            {
+                result += fn->GetFastInterpStackFrameSize();
+            }
+        }
+        return result;
+    }
+
     llvm::Module* GetBuiltLLVMModule() const
     {
         assert(m_llvmModule != nullptr);
@@ -631,6 +1014,65 @@ public:
     }
 
 private:
+    // The functions of the current generation of the module (all functions, unless the module has been
+    // incrementally updated), sorted by name. This is the order the IR dump expected outputs are generated with,
+    // and it is the same in test and release builds, so both generate the same code.
+    // The list is sorted lazily, once after functions are added.
+    //
+    const std::vector<AstFunction*>& GetFunctionList()
+    {
+        if (!m_functionListSorted)
+        {
+            std::sort(m_curGenFunctionList.begin(), m_curGenFunctionList.end(),
+                      [](AstFunction* a, AstFunction* b) { return a->GetName() < b->GetName(); });
+            m_functionListSorted = true;
+        }
+        return m_curGenFunctionList;
+    }
+
+    // Allocate memory for an AST node in the arena of this module. See AstNodeBase::operator new.
+    //
+    // Each node is prefixed by a header which links all nodes of the module into a list,
+    // so that the destructors can be run (and, if allocated from the heap, the memory freed)
+    // when the module is destroyed.
+    //
+    void* WARN_UNUSED AllocateAstNodeMemory(size_t size);
+
+    // Destroy all functions and AST nodes of the module, and release the arena
+    //
+    void DestroyAllFunctions();
+
+    friend class AstNodeBase;
+    // Allocates the variable names of the deserialized functions in m_astAllocator
+    //
+    friend class AstModuleDeserializer;
+
+    // Lower generator 'fn' into a pair of plain functions, see generator_lowering.cpp for the protocol.
+    // Returns false and sets error if the generator uses a construct that is not supported in generators.
+    //
+    bool WARN_UNUSED LowerGenerator(AstFunction* fn);
+
+    // Infer the functions that can never throw. See SetNoExceptInferenceEnabled().
+    //
+    void InferNoExcept();
+
+    // Inline small generated functions into their callers. See SetFastInterpInlineThreshold().
+    //
+    void InlineSmallFunctions(size_t maxCalleeNodes);
+
+    // Fold constant expressions and remove dead branches. See SetFastInterpConstantFolding().
+    //
+    void FoldConstants();
+
+    // Make eligible loops OSR points, and create their continuation functions.
+    // See SetFastInterpOsrThreshold(). The former is called before FastInterp code generation, the latter after.
+    //
+    void InstrumentFastInterpOsrLoops();
+    void CreateFastInterpOsrContinuations();
+
+    // Free the FastInterp generated programs, called by the destructor
+    //
+    void FreeFastInterpPrograms();
 
     template<typename T>
     struct FastInterpCallFunction
@@ -659,7 +1101,7 @@ private:
             return FastInterpFunction<R(*)(Args...)>(
                         fn->GetFastInterpCppEntryPoint(),
                         fn->GetFastInterpStackFrameSize(),
-                        fn->GetIsNoExcept());
+                        fn->GetIsNoExceptForCodegen());
         }
     };
 
@@ -689,17 +1131,45 @@ private:
     };
 
     std::string m_moduleName;
-    // We are using std::map (not std::unordered_map) so that the iteration order is deterministic.
-    // This is required to make tests happy (so IR dump output is deterministic).
-    // The perf hit should be small. TODO: consider use std::unordered_map in release?
+    // Function name => function. The keys refer to the names owned by the AstFunction objects.
+    // Never iterated, since the order is not deterministic: use GetFunctionList() instead.
     //
-#ifdef TESTBUILD
-    std::map<std::string, AstFunction*> m_functions;
-#else
-    std::unordered_map<std::string, AstFunction*> m_functions;
-#endif
+    std::unordered_map<std::string_view, AstFunction*> m_functions;
+    // All functions in creation order, and the functions of the current generation
+    //
+    std::vector<AstFunction*> m_functionList;
+    std::vector<AstFunction*> m_curGenFunctionList;
+    uint32_t m_generation;
+    // Prefix => the next number to try in GetNextAvailableFnName()
+    //
+    std::unordered_map<std::string, uint64_t> m_nextFnNameSuffix;
     llvm::LLVMContext* m_llvmContext;
     llvm::Module* m_llvmModule;
+    bool m_noExceptInferenceEnabled;
+    size_t m_fastInterpInlineThreshold;
+    bool m_fastInterpConstantFolding;
+    uint64_t m_fastInterpOsrThreshold;
+    bool m_fastInterpCompactStackFrame;
+    bool m_fastInterpCallFramesOnInterpStack;
+    bool m_fastInterpColdPathLayout;
+    // The OSR points of the current generation, and of the earlier generations. Owned by the module.
+    //
+    std::vector<FastInterpOsrEntry*> m_fastInterpOsrEntries;
+    std::vector<FastInterpOsrEntry*> m_oldFastInterpOsrEntries;
+    // The FastInterp generated programs, one for each generation prepared for FastInterp
+    //
+    std::vector<FastInterpGeneratedProgram*> m_fastInterpPrograms;
+    // The context of the thread this module is attached to, see AttachToCurrentThread()
+    //
+    std::atomic<PochiVMContext*> m_attachedContext;
+    // Owns the memory of all AST nodes and functions of the module
+    //
+    TempArenaAllocator m_astAllocator;
+    uintptr_t m_astNodeListHead;
+    // See SetAllocateAstNodesFromHeap()
+    //
+    bool m_allocateAstNodesFromHeap;
+    bool m_functionListSorted;
 #ifdef TESTBUILD
     bool m_validated;
     bool m_debugInterpPrepared;
@@ -760,11 +1230,13 @@ public:
         , m_params(params)
         , m_isCppFunction(false)
         , m_cppFunctionMd(nullptr)
+        , m_callee(nullptr)
         , m_interpFunction(nullptr)
         , m_debugInterpStoreParamFns()
         , m_sretAddress(nullptr)
         , m_fastInterpSretVar(nullptr)
         , m_fastInterpSpillNewSfAddrAt(static_cast<uint32_t>(-1))
+        , m_isTailCall(false)
     { }
 
     AstCallExpr(const CppFunctionMetadata* cppFunctionMd,
@@ -774,11 +1246,13 @@ public:
         , m_params(params)
         , m_isCppFunction(true)
         , m_cppFunctionMd(cppFunctionMd)
+        , m_callee(nullptr)
         , m_interpFunction(nullptr)
         , m_debugInterpStoreParamFns()
         , m_sretAddress(nullptr)
         , m_fastInterpSretVar(nullptr)
         , m_fastInterpSpillNewSfAddrAt(static_cast<uint32_t>(-1))
+        , m_isTailCall(false)
     {
         assert(m_cppFunctionMd != nullptr);
         TestAssert(params.size() == static_cast<size_t>(m_cppFunctionMd->m_numParams));
@@ -833,7 +1307,7 @@ public:
     {
         if (!m_isCppFunction)
         {
-            AstFunction* fn = thread_pochiVMContext->m_curModule->GetAstFunction(m_fnName);
+            AstFunction* fn = GetCalleeAstFunction();
             CHECK_REPORT_ERR(fn != nullptr, "Call to undefined function %s", m_fnName.c_str());
             CHECK_ERR(fn->CheckParamTypes(m_params));
             CHECK_REPORT_ERR(fn->GetReturnType() == GetTypeId(),
@@ -868,19 +1342,61 @@ public:
         return m_isCppFunction;
     }
 
+    const std::string& GetFnName() const
+    {
+        assert(!IsCppFunction());
+        return m_fnName;
+    }
+
     const CppFunctionMetadata* GetCppFunctionMetadata() const
     {
         assert(IsCppFunction());
         return m_cppFunctionMd;
     }
 
+    // The generated function being called, or nullptr if it does not exist (yet).
+    // The function is looked up by name in the current module once, and cached afterwards,
+    // so the many passes over a large module do not repeatedly hash the name.
+    //
+    AstFunction* GetCalleeAstFunction()
+    {
+        assert(!IsCppFunction());
+        if (m_callee == nullptr)
+        {
+            m_callee = thread_pochiVMContext->m_curModule->GetAstFunction(m_fnName);
+        }
+        return m_callee;
+    }
+
     const std::vector<AstNodeBase*>& GetParams() const
     {
         return m_params;
     }
 
+    // Replace a parameter by an equivalent expression of the same type (used by AST transformations)
+    //
+    void SetParam(size_t i, AstNodeBase* param)
+    {
+        TestAssert(i < m_params.size() && param->GetTypeId() == m_params[i]->GetTypeId());
+        m_params[i] = param;
+    }
+
     void SetSretAddress(llvm::Value* address);
 
+    // Whether this is the call of a TailCall statement, see AstReturnStmt.
+    // Set by AstReturnStmt, which owns the call.
+    //
+    void SetIsTailCall()
+    {
+        TestAssert(!m_isCppFunction);
+        m_isTailCall = true;
+    }
+
+    bool IsTailCall() const
+    {
+        return m_isTailCall;
+    }
+
     void SetFastInterpSretVariable(AstVariable* variable)
     {
         TestAssert(m_isCppFunction && m_cppFunctionMd->m_isUsingSret);
@@ -893,7 +1409,7 @@ public:
     {
         if (!m_isCppFunction)
         {
-            m_interpFunction = thread_pochiVMContext->m_curModule->GetAstFunction(m_fnName);
+            m_interpFunction = GetCalleeAstFunction();
             TestAssert(m_interpFunction != nullptr);
             m_debugInterpFn = AstTypeHelper::GetClassMethodPtr(&AstCallExpr::InterpImplGeneratedFunction);
         }
@@ -927,6 +1443,9 @@ private:
     std::vector<AstNodeBase*> m_params;
     bool m_isCppFunction;
     const CppFunctionMetadata* m_cppFunctionMd;
+    // Cached result of GetCalleeAstFunction()
+    //
+    AstFunction* m_callee;
     // Function to call, only populated in interp mode and for non-cpp function
     //
     AstFunction* m_interpFunction;
@@ -943,6 +1462,9 @@ private:
     FISpillLocation m_fastInterpSpillLoc;
     uint32_t m_fastInterpSpillNewSfAddrAt;
     FastInterpBoilerplateInstance* m_fastInterpInst;
+    // In LLVM mode, the call is emitted as 'musttail'
+    //
+    bool m_isTailCall;
 };
 
 class AstDeclareVariable : public AstNodeBase
@@ -1048,15 +1570,29 @@ public:
     bool m_isCtor;
 };
 
+// A return statement.
+//
+// If 'isTailCall', 'retVal' is a call to a generated function with the same prototype as the current function
+// (which may return void), and the callee runs in place of the current function instead of below it:
+// the call is emitted as 'musttail' in LLVM mode, and the callee reuses the stack frame of the current
+// function in FastInterp mode, so a chain of tail calls of any length runs in constant stack space.
+// See AstFunction::Validate() for the restrictions. DebugInterp simply evaluates the call and returns.
+//
 class AstReturnStmt : public AstNodeBase
 {
 public:
-    AstReturnStmt(AstNodeBase* retVal)
+    AstReturnStmt(AstNodeBase* retVal, bool isTailCall = false)
         : AstNodeBase(AstNodeType::AstReturnStmt, TypeId::Get<void>())
         , m_retVal(retVal)
+        , m_isTailCall(isTailCall)
     {
-        TestAssertImp(m_retVal != nullptr,
+        TestAssertImp(m_retVal != nullptr && !m_isTailCall,
                       m_retVal->GetTypeId().IsPrimitiveType() || m_retVal->GetTypeId().IsPointerType());
+        TestAssertImp(m_isTailCall, m_retVal != nullptr && m_retVal->GetAstNodeType() == AstNodeType::AstCallExpr);
+        if (m_isTailCall)
+        {
+            GetTailCallExpr()->SetIsTailCall();
+        }
     }
 
     virtual llvm::Value* WARN_UNUSED EmitIRImpl() override final;
@@ -1077,12 +1613,24 @@ public:
         *out = InterpControlSignal::Return;
     }
 
+    void InterpImplTailCallVoid(InterpControlSignal* out)
+    {
+        m_retVal->DebugInterp(nullptr /*out*/);
+        assert(*out == InterpControlSignal::None);
+        *out = InterpControlSignal::Return;
+    }
+
     virtual void SetupDebugInterpImpl() override final
     {
         if (m_retVal == nullptr)
         {
             m_debugInterpFn = AstTypeHelper::GetClassMethodPtr(&AstReturnStmt::InterpImplVoid);
         }
+        else if (m_retVal->GetTypeId().IsVoid())
+        {
+            TestAssert(m_isTailCall);
+            m_debugInterpFn = AstTypeHelper::GetClassMethodPtr(&AstReturnStmt::InterpImplTailCallVoid);
+        }
         else
         {
             m_debugInterpFn = SelectImpl(m_retVal->GetTypeId());
@@ -1100,7 +1648,69 @@ public:
     virtual FastInterpSnippet WARN_UNUSED PrepareForFastInterp(FISpillLocation spillLoc) override final;
     virtual void FastInterpSetupSpillLocation() override final;
 
+    bool IsTailCall() const
+    {
+        return m_isTailCall;
+    }
+
+    AstCallExpr* GetTailCallExpr() const
+    {
+        TestAssert(m_isTailCall);
+        return assert_cast<AstCallExpr*>(m_retVal);
+    }
+
     AstNodeBase* m_retVal;
+
+private:
+    // Whether the tail call reuses the stack frame in FastInterp mode. This is the case unless the callee
+    // belongs to an earlier generation of the module, which can only be called through its cdecl interface.
+    //
+    bool IsFastInterpFrameReusingTailCall();
+
+    FastInterpSnippet WARN_UNUSED PrepareFrameReusingTailCallForFastInterp();
+
+    bool m_isTailCall;
+};
+
+// Yield(value) in a generator. Generators are lowered into plain functions in AstModule::Validate()
+// (see generator_lowering.cpp), so this node never reaches any backend.
+//
+class AstYieldStmt : public AstNodeBase
+{
+public:
+    AstYieldStmt(AstNodeBase* value)
+        : AstNodeBase(AstNodeType::AstYieldStmt, TypeId::Get<void>())
+        , m_value(value)
+    {
+        TestAssert(m_value->GetTypeId().IsPrimitiveType() || m_value->GetTypeId().IsPointerType());
+    }
+
+    virtual llvm::Value* WARN_UNUSED EmitIRImpl() override final
+    {
+        ReleaseAssert(false && "unexpected AstYieldStmt: generators must be lowered in Validate()");
+    }
+
+    virtual void SetupDebugInterpImpl() override final
+    {
+        ReleaseAssert(false && "unexpected AstYieldStmt: generators must be lowered in Validate()");
+    }
+
+    virtual void ForEachChildren(FunctionRef<void(AstNodeBase*)> fn) override final
+    {
+        fn(m_value);
+    }
+
+    virtual void FastInterpSetupSpillLocation() override final
+    {
+        ReleaseAssert(false && "unexpected AstYieldStmt: generators must be lowered in Validate()");
+    }
+
+    virtual FastInterpSnippet WARN_UNUSED PrepareForFastInterp(FISpillLocation /*spillLoc*/) override final
+    {
+        ReleaseAssert(false && "unexpected AstYieldStmt: generators must be lowered in Validate()");
+    }
+
+    AstNodeBase* m_value;
 };
 
 inline void AstFunction::PrepareForDebugInterp()
@@ -1187,6 +1797,155 @@ inline void AstFunction::PrepareForDebugInterp()
     m_debugInterpStackFrameSize = size;
 }
 
+inline void AstModule::InferNoExcept()
+{
+    // A function that is not declared noexcept may throw if it contains a throw statement,
+    // or a call to a C++ function not declared noexcept, or a call to a generated function that may throw.
+    // We find the functions that may throw locally, then propagate backwards along the call graph.
+    //
+    std::unordered_map<AstFunction*, std::vector<AstFunction*>> callers;
+    std::unordered_set<AstFunction*> mayThrow;
+    std::vector<AstFunction*> worklist;
+    for (AstFunction* fn : GetFunctionList())
+    {
+        fn->SetIsNoExceptInferred(false);
+        if (fn->GetIsNoExcept())
+        {
+            continue;
+        }
+        bool mayThrowLocally = false;
+        fn->TraverseFunctionBody([&](AstNodeBase* cur, AstNodeBase* /*parent*/, FunctionRef<void(void)> Recurse)
+        {
+            if (cur->GetAstNodeType() == AstNodeType::AstThrowStmt)
+            {
+                mayThrowLocally = true;
+            }
+            else if (cur->GetAstNodeType() == AstNodeType::AstCallExpr)
+            {
+                AstCallExpr* callExpr = assert_cast<AstCallExpr*>(cur);
+                if (callExpr->IsCppFunction())
+                {
+                    if (!callExpr->GetCppFunctionMetadata()->m_isNoExcept)
+                    {
+                        mayThrowLocally = true;
+                    }
+                }
+                else
+                {
+                    AstFunction* callee = callExpr->GetCalleeAstFunction();
+                    TestAssert(callee != nullptr);
+                    if (callee->GetModuleGeneration() < m_generation)
+                    {
+                        // The callee belongs to an earlier generation, so its property is already final
+                        //
+                        if (!callee->GetIsNoExceptForCodegen())
+                        {
+                            mayThrowLocally = true;
+                        }
+                    }
+                    else
+                    {
+                        callers[callee].push_back(fn);
+                        // The caller and callee of a tail call must use the same return value convention
+                        // (see AstReturnStmt), so if the caller may throw, the callee is treated as such as well.
+                        // Validate() has checked that neither of them is declared noexcept.
+                        //
+                        if (callExpr->IsTailCall())
+                        {
+                            TestAssert(!callee->GetIsNoExcept());
+                            callers[fn].push_back(callee);
+                        }
+                    }
+                }
+            }
+            Recurse();
+        });
+        if (mayThrowLocally)
+        {
+            mayThrow.insert(fn);
+            worklist.push_back(fn);
+        }
+    }
+
+    while (!worklist.empty())
+    {
+        AstFunction* fn = worklist.back();
+        worklist.pop_back();
+        auto it = callers.find(fn);
+        if (it == callers.end())
+        {
+            continue;
+        }
+        for (AstFunction* caller : it->second)
+        {
+            if (!mayThrow.count(caller))
+            {
+                mayThrow.insert(caller);
+                worklist.push_back(caller);
+            }
+        }
+    }
+
+    for (AstFunction* fn : GetFunctionList())
+    {
+        if (!fn->GetIsNoExcept() && !mayThrow.count(fn))
+        {
+            fn->SetIsNoExceptInferred(true);
+        }
+    }
+}
+
+inline bool WARN_UNUSED AstFunction::ValidateTailCall(AstCallExpr* callExpr,
+                                                       const std::unordered_map<AstVariable*, AstNodeBase*>& varScope)
+{
+    CHECK_REPORT_ERR(!IsGenerator(), "Function %s: use of 'TailCall' statement in a generator is unsupported",
+                     m_name.c_str());
+    // If the callee does not exist, the error is reported when validating the call expression
+    //
+    AstFunction* callee = callExpr->GetCalleeAstFunction();
+    if (callee == nullptr)
+    {
+        RETURN_TRUE;
+    }
+    // The callee takes over the stack frame (and in LLVM, the argument registers and stack slots)
+    // of the current function, and returns to our caller, so the prototypes must be identical.
+    //
+    CHECK_REPORT_ERR(callee->GetReturnType() == GetReturnType(),
+                     "Function %s: tail call to function %s: return type does not match, expects %s got %s",
+                     m_name.c_str(), callee->m_name.c_str(),
+                     GetReturnType().Print().c_str(), callee->GetReturnType().Print().c_str());
+    CHECK_REPORT_ERR(callee->GetNumParams() == GetNumParams(),
+                     "Function %s: tail call to function %s: the callee must have the same parameter types as the caller, "
+                     "expects %d parameters got %d",
+                     m_name.c_str(), callee->m_name.c_str(), int(GetNumParams()), int(callee->GetNumParams()));
+    for (size_t i = 0; i < GetNumParams(); i++)
+    {
+        CHECK_REPORT_ERR(callee->GetParamType(i) == GetParamType(i),
+                         "Function %s: tail call to function %s: the callee must have the same parameter types as the caller, "
+                         "parameter %d expects %s got %s",
+                         m_name.c_str(), callee->m_name.c_str(), int(i),
+                         GetParamType(i).Print().c_str(), callee->GetParamType(i).Print().c_str());
+    }
+    // The return value convention depends on whether the function may throw,
+    // and a noexcept function must catch the exceptions thrown by its callees.
+    //
+    CHECK_REPORT_ERR(callee->GetIsNoExcept() == GetIsNoExcept(),
+                     "Function %s: tail call to function %s: the caller and callee must be both noexcept or both not",
+                     m_name.c_str(), callee->m_name.c_str());
+    // Nothing may happen after the call, so no destructor may be pending
+    //
+    for (auto it = varScope.begin(); it != varScope.end(); it++)
+    {
+        AstVariable* v = it->first;
+        AstNodeBase* scope = it->second;
+        CHECK_REPORT_ERR(scope == nullptr || !scope->GetColorMark().IsColorA() ||
+                         !v->GetTypeId().RemovePointer().IsCppClassType(),
+                         "Function %s: tail call to function %s: variable %s_%u of C++ class type is still alive",
+                         m_name.c_str(), callee->m_name.c_str(), v->GetVarNameNoSuffix(), v->GetVarSuffix());
+    }
+    RETURN_TRUE;
+}
+
 inline bool WARN_UNUSED AstFunction::Validate()
 {
     TestAssert(!thread_errorContext->HasError());
@@ -1475,6 +2234,15 @@ inline bool WARN_UNUSED AstFunction::Validate()
                     return;
                 }
             }
+            else if (r->IsTailCall())
+            {
+                if (!ValidateTailCall(r->GetTailCallExpr(), varScope))
+                {
+                    assert(thread_errorContext->HasError());
+                    success = false;
+                    return;
+                }
+            }
             else
             {
                 if (GetReturnType().IsVoid())
@@ -1498,6 +2266,30 @@ inline bool WARN_UNUSED AstFunction::Validate()
             }
         }
 
+        if (nodeType == AstNodeType::AstYieldStmt)
+        {
+            // Check the function is a generator, and the value matches the generator prototype
+            //
+            AstYieldStmt* y = assert_cast<AstYieldStmt*>(cur);
+            if (!IsGenerator())
+            {
+                REPORT_ERR("Function %s: use of 'Yield' statement in a function that is not a generator",
+                           m_name.c_str());
+                success = false;
+                return;
+            }
+            if (y->m_value->GetTypeId() != GetGeneratorYieldType())
+            {
+                REPORT_ERR("Function %s: yield type does not match generator prototype. "
+                           "Yield statement yielded %s, expects %s",
+                           m_name.c_str(),
+                           y->m_value->GetTypeId().Print().c_str(),
+                           GetGeneratorYieldType().Print().c_str());
+                success = false;
+                return;
+            }
+        }
+
         if (nodeType == AstNodeType::AstBreakOrContinueStmt)
         {
             if (loopStack.size() == 0)
@@ -1530,6 +2322,13 @@ inline bool WARN_UNUSED AstFunction::Validate()
                 success = false;
                 return;
             }
+            if (nodeType == AstNodeType::AstYieldStmt)
+            {
+                REPORT_ERR("Function %s: use of 'Yield' statement inside for-loop init-block or step-block is unsupported",
+                           m_name.c_str());
+                success = false;
+                return;
+            }
             if (nodeType == AstNodeType::AstForLoop || nodeType == AstNodeType::AstWhileLoop)
             {
                 REPORT_ERR("Function %s: use of %s inside a for-loop init-block or step-block is unsupported",
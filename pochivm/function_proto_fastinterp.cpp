@@ -3,6 +3,8 @@
 #include "codegen_context.hpp"
 #include "destructor_helper.h"
 #include "scoped_variable_manager.h"
+#include "fastinterp_local_var_liveness.h"
+#include "fastinterp_interp_stack.h"
 
 namespace PochiVM
 {
@@ -106,24 +108,143 @@ FastInterpSnippet WARN_UNUSED AstDeclareVariable::PrepareForFastInterp(FISpillLo
     return result;
 }
 
+bool AstReturnStmt::IsFastInterpFrameReusingTailCall()
+{
+    if (!m_isTailCall)
+    {
+        return false;
+    }
+    AstFunction* callee = GetTailCallExpr()->GetCalleeAstFunction();
+    TestAssert(callee != nullptr);
+    return callee->GetModuleGeneration() == thread_pochiVMContext->m_curModule->GetGeneration();
+}
+
 void AstReturnStmt::FastInterpSetupSpillLocation()
 {
-    if (m_retVal != nullptr)
+    if (IsFastInterpFrameReusingTailCall())
+    {
+        // Each argument is evaluated into a local variable, see PrepareFrameReusingTailCallForFastInterp()
+        //
+        for (AstNodeBase* param : GetTailCallExpr()->GetParams())
+        {
+            thread_pochiVMContext->m_fastInterpStackFrameManager->ReserveTemp(param->GetTypeId());
+            param->FastInterpSetupSpillLocation();
+        }
+    }
+    else if (m_retVal != nullptr)
     {
-        thread_pochiVMContext->m_fastInterpStackFrameManager->ReserveTemp(m_retVal->GetTypeId());
+        if (!m_retVal->GetTypeId().IsVoid())
+        {
+            thread_pochiVMContext->m_fastInterpStackFrameManager->ReserveTemp(m_retVal->GetTypeId());
+        }
         m_retVal->FastInterpSetupSpillLocation();
     }
 }
 
+FastInterpSnippet WARN_UNUSED AstReturnStmt::PrepareFrameReusingTailCallForFastInterp()
+{
+    AstFunction* caller = thread_llvmContext->m_curFunction;
+    AstCallExpr* callExpr = GetTailCallExpr();
+    AstFunction* callee = callExpr->GetCalleeAstFunction();
+    const std::vector<AstNodeBase*>& params = callExpr->GetParams();
+    // Validate() and InferNoExcept() guarantee that the callee returns to our caller in the convention it expects,
+    // and the parameter slots of the callee are the same as ours. The stack frame is large enough for the callee,
+    // see AstModule::PrepareForFastInterp().
+    //
+    TestAssert(callee->GetIsNoExceptForCodegen() == caller->GetIsNoExceptForCodegen());
+    TestAssert(params.size() == caller->GetNumParams());
+
+    // The arguments may read our parameters, so they cannot be stored into the parameter slots as they are evaluated.
+    // Instead, each argument is evaluated into a local variable, then all of them are moved into the parameter slots,
+    // and finally we jump to the entry point of the callee with the current stack frame.
+    //
+    FastInterpSnippet result { nullptr, nullptr };
+    std::vector<uint64_t> offsets;
+    for (AstNodeBase* param : params)
+    {
+        uint64_t offset = thread_pochiVMContext->m_fastInterpStackFrameManager->PushLocalVar(param->GetTypeId());
+        FISpillLocation sloc;
+        sloc.SetSpillLocation(static_cast<uint32_t>(offset));
+
+        TestAssert(thread_pochiVMContext->m_fastInterpStackFrameManager->CanReserveWithoutSpill(param->GetTypeId()));
+        FastInterpSnippet snippet = param->PrepareForFastInterp(sloc);
+        result = result.AddContinuation(snippet);
+        offsets.push_back(offset);
+    }
+
+    for (size_t index = 0; index < params.size(); index++)
+    {
+        FastInterpBoilerplateInstance* inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
+                    FastInterpBoilerplateLibrary<FITailCallMoveParamImpl>::SelectBoilerplateBluePrint(
+                        params[index]->GetTypeId().GetOneLevelPtrFastInterpTypeId()));
+        inst->PopulateConstantPlaceholder<uint64_t>(0, offsets[index]);
+        inst->PopulateConstantPlaceholder<uint64_t>(1, (index + 1) * 8);
+        result = result.AddContinuation(inst);
+    }
+
+    for (size_t index = 0; index < params.size(); index++)
+    {
+        thread_pochiVMContext->m_fastInterpStackFrameManager->PopLocalVar(params[index]->GetTypeId(), offsets[index]);
+    }
+
+    if (result.IsEmpty())
+    {
+        // No parameters, we still need an operator to jump to the callee
+        //
+        FastInterpBoilerplateInstance* inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
+                    FastInterpBoilerplateLibrary<FINoopImpl>::SelectBoilerplateBluePrint(
+                        FIOpaqueParamsHelper::GetMaxOIP(),
+                        FIOpaqueParamsHelper::GetMaxOFP()));
+        result = result.AddContinuation(inst);
+    }
+
+    TestAssert(result.m_tail != nullptr);
+    thread_pochiVMContext->m_fastInterpEngine->PopulateBoilerplateFnPtrPlaceholderAsFunctionEntryPoint(
+                result.m_tail, callee, 0 /*ordinal*/);
+    thread_pochiVMContext->m_fastInterpTailCallList.push_back(std::make_pair(caller, callee));
+    return FastInterpSnippet {
+        result.m_entry, nullptr
+    };
+}
+
 FastInterpSnippet WARN_UNUSED AstReturnStmt::PrepareForFastInterp(FISpillLocation TESTBUILD_ONLY(spillLoc))
 {
     TestAssert(spillLoc.IsNoSpill());
     thread_pochiVMContext->m_fastInterpStackFrameManager->AssertNoTemp();
 
-    bool isNoExcept = thread_llvmContext->m_curFunction->GetIsNoExcept();
+    bool isNoExcept = thread_llvmContext->m_curFunction->GetIsNoExceptForCodegen();
 
     FastInterpSnippet dtors = thread_pochiVMContext->m_scopedVariableManager.FIGenerateDestructorSequenceUntilScope(nullptr /*everything*/);
 
+    if (m_isTailCall)
+    {
+        // Validate() guarantees there is no destructor to run
+        //
+        TestAssert(dtors.IsEmpty());
+        if (IsFastInterpFrameReusingTailCall())
+        {
+            return PrepareFrameReusingTailCallForFastInterp();
+        }
+        // Otherwise it is just a normal call followed by a return.
+        // A call returning a value is handled by the general return path below.
+        //
+        if (m_retVal->GetTypeId().IsVoid())
+        {
+            FastInterpSnippet callOp = m_retVal->PrepareForFastInterp(x_FINoSpill);
+            FastInterpBoilerplateInstance* inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
+                        FastInterpBoilerplateLibrary<FIOutlinedReturnImpl>::SelectBoilerplateBluePrint(
+                            TypeId::Get<void>().GetDefaultFastInterpTypeId(),
+                            isNoExcept,
+                            false /*exceptionThrown*/,
+                            thread_pochiVMContext->m_fastInterpStackFrameManager->GetNumNoSpillIntegral(),
+                            thread_pochiVMContext->m_fastInterpStackFrameManager->GetNumNoSpillFloat()));
+            FastInterpSnippet snippet = callOp.AddContinuation(inst);
+            return FastInterpSnippet {
+                snippet.m_entry, nullptr
+            };
+        }
+    }
+
     // Case 1: return void
     //
     if (m_retVal == nullptr)
@@ -209,7 +330,7 @@ FastInterpSnippet WARN_UNUSED AstReturnStmt::PrepareForFastInterp(FISpillLocatio
         inst->PopulateConstantPlaceholder<uint64_t>(0, offset);
         snippet = snippet.AddContinuation(inst);
 
-        thread_pochiVMContext->m_fastInterpStackFrameManager->PopLocalVar(m_retVal->GetTypeId());
+        thread_pochiVMContext->m_fastInterpStackFrameManager->PopLocalVar(m_retVal->GetTypeId(), offset);
 
         return FastInterpSnippet {
             snippet.m_entry, nullptr
@@ -245,6 +366,43 @@ void AstCallExpr::FastInterpSetupSpillLocation()
     std::ignore = newsfSpillLoc;
 }
 
+// Instantiate the operator that allocates the callee stack frame and transfers control to the parameter-populating chain.
+// If 'isStackframeSizeKnown' is false, 'sfCategory' is a dummy and AstCallExpr::FastInterpFixStackFrameSize() fixes it.
+//
+static FastInterpBoilerplateInstance* WARN_UNUSED FIInstantiateCallOp(TypeId returnType,
+                                                                     bool spillReturnValue,
+                                                                     bool isCalleeNoExcept,
+                                                                     FIStackframeSizeCategory sfCategory,
+                                                                     bool isStackframeSizeKnown)
+{
+    FastInterpBoilerplateInstance* inst;
+    if (thread_pochiVMContext->m_curModule->GetFastInterpCallFramesOnInterpStack())
+    {
+        inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
+                FastInterpBoilerplateLibrary<FICallExprInterpStackImpl>::SelectBoilerplateBluePrint(
+                    returnType.GetOneLevelPtrFastInterpTypeId(),
+                    spillReturnValue,
+                    isCalleeNoExcept));
+        inst->PopulateConstantPlaceholder<uint64_t>(2, reinterpret_cast<uint64_t>(&FastInterpInterpStackPushCallFrame));
+        inst->PopulateConstantPlaceholder<uint64_t>(3, reinterpret_cast<uint64_t>(&FastInterpInterpStackPopCallFrame));
+        if (isStackframeSizeKnown)
+        {
+            inst->PopulateConstantPlaceholder<uint64_t>(
+                        1, static_cast<uint64_t>(FIStackframeSizeCategoryHelper::x_size_list[static_cast<int>(sfCategory)]));
+        }
+    }
+    else
+    {
+        inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
+                FastInterpBoilerplateLibrary<FICallExprImpl>::SelectBoilerplateBluePrint(
+                    returnType.GetOneLevelPtrFastInterpTypeId(),
+                    spillReturnValue,
+                    isCalleeNoExcept,
+                    sfCategory));
+    }
+    return inst;
+}
+
 FastInterpSnippet WARN_UNUSED AstCallExpr::PrepareForFastInterp(FISpillLocation spillLoc)
 {
     AstFunction* astCallee = nullptr;
@@ -253,27 +411,46 @@ FastInterpSnippet WARN_UNUSED AstCallExpr::PrepareForFastInterp(FISpillLocation
     TypeId calleeReturnType;
     size_t trueNumParams;
     FastInterpBoilerplateInstance* inst;
+    // A generated function of an earlier generation of the module (see AstModule::StartIncrementalUpdate())
+    // is not part of the program being generated. It is called through its cdecl interface instead,
+    // the same way as a C++ function.
+    //
+    bool isCalleePrebuilt = false;
     if (!m_isCppFunction)
     {
-        astCallee = thread_pochiVMContext->m_curModule->GetAstFunction(m_fnName);
+        astCallee = GetCalleeAstFunction();
         TestAssert(astCallee != nullptr);
-        isCalleeNoExcept = astCallee->GetIsNoExcept();
+        isCalleeNoExcept = astCallee->GetIsNoExceptForCodegen();
         calleeReturnType = astCallee->GetReturnType();
         trueNumParams = astCallee->GetNumParams();
-        // For generated function, we do not know the stack frame size right now.
-        // We will fix it in the end after all functions are compiled,
-        // at that time all stack frame sizes are known.
-        //
-        inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
-                FastInterpBoilerplateLibrary<FICallExprImpl>::SelectBoilerplateBluePrint(
-                    calleeReturnType.GetOneLevelPtrFastInterpTypeId(),
-                    !spillLoc.IsNoSpill(),
-                    isCalleeNoExcept,
-                    static_cast<FIStackframeSizeCategory>(0)));
-        spillLoc.PopulatePlaceholderIfSpill(inst, 0);
-        m_fastInterpSpillLoc = spillLoc;
-        m_fastInterpInst = inst;
-        thread_pochiVMContext->m_fastInterpFnCallFixList.push_back(std::make_pair(astCallee, this));
+        isCalleePrebuilt = (astCallee->GetModuleGeneration() < thread_pochiVMContext->m_curModule->GetGeneration());
+        if (isCalleePrebuilt)
+        {
+            TestAssert(astCallee->GetFastInterpCppEntryPoint() != nullptr);
+            cppInterpCallee = astCallee->GetFastInterpCppEntryPoint();
+            inst = FIInstantiateCallOp(calleeReturnType,
+                                       !spillLoc.IsNoSpill(),
+                                       isCalleeNoExcept,
+                                       astCallee->GetFastInterpStackSizeCategory(),
+                                       true /*isStackframeSizeKnown*/);
+            spillLoc.PopulatePlaceholderIfSpill(inst, 0);
+        }
+        else
+        {
+            // For generated function, we do not know the stack frame size right now.
+            // We will fix it in the end after all functions are compiled,
+            // at that time all stack frame sizes are known.
+            //
+            inst = FIInstantiateCallOp(calleeReturnType,
+                                       !spillLoc.IsNoSpill(),
+                                       isCalleeNoExcept,
+                                       static_cast<FIStackframeSizeCategory>(0),
+                                       false /*isStackframeSizeKnown*/);
+            spillLoc.PopulatePlaceholderIfSpill(inst, 0);
+            m_fastInterpSpillLoc = spillLoc;
+            m_fastInterpInst = inst;
+            thread_pochiVMContext->m_fastInterpFnCallFixList.push_back(std::make_pair(astCallee, this));
+        }
     }
     else
     {
@@ -289,12 +466,11 @@ FastInterpSnippet WARN_UNUSED AstCallExpr::PrepareForFastInterp(FISpillLocation
         // For C++ function, the stack frame size only depends on how many parameters it has
         //
         FIStackframeSizeCategory sfCategory = GetStackFrameSizeCategoryForCppFunctionCall(trueNumParams);
-        inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
-                FastInterpBoilerplateLibrary<FICallExprImpl>::SelectBoilerplateBluePrint(
-                    calleeReturnType.GetOneLevelPtrFastInterpTypeId(),
-                    !spillLoc.IsNoSpill(),
-                    isCalleeNoExcept,
-                    sfCategory));
+        inst = FIInstantiateCallOp(calleeReturnType,
+                                   !spillLoc.IsNoSpill(),
+                                   isCalleeNoExcept,
+                                   sfCategory,
+                                   true /*isStackframeSizeKnown*/);
         spillLoc.PopulatePlaceholderIfSpill(inst, 0);
     }
 
@@ -460,7 +636,7 @@ FastInterpSnippet WARN_UNUSED AstCallExpr::PrepareForFastInterp(FISpillLocation
     // After all parameters are populated, transfer control to new function
     //
     TestAssert(callOp.m_tail != nullptr);
-    if (!m_isCppFunction)
+    if (!m_isCppFunction && !isCalleePrebuilt)
     {
         // For generated function, we just attach the entry point of the function as our continuation
         //
@@ -470,7 +646,8 @@ FastInterpSnippet WARN_UNUSED AstCallExpr::PrepareForFastInterp(FISpillLocation
     }
     else
     {
-        // For CPP function, we need another operator which transfers control to the interp entry point
+        // For CPP function (or prebuilt generated function), we need another operator
+        // which transfers control to the interp entry point
         //
         FastInterpBoilerplateInstance* entryInst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
                     FastInterpBoilerplateLibrary<FICallExprEnterCppFnImpl>::SelectBoilerplateBluePrint(
@@ -484,7 +661,16 @@ FastInterpSnippet WARN_UNUSED AstCallExpr::PrepareForFastInterp(FISpillLocation
     // Entry from current function to callOp
     //
     TestAssert(callOp.m_entry != nullptr);
-    callOp.m_entry->SetAlignmentLog2(4);
+    if (m_isCppFunction && HasCppFunctionAttribute(m_cppFunctionMd->m_attributes, CppFunctionAttribute::Cold))
+    {
+        // The C++ function is registered as rarely called, move the call sequence out of the hot code
+        //
+        callOp.m_entry->MarkAsColdPathEntry();
+    }
+    else
+    {
+        callOp.m_entry->SetAlignmentLog2(4);
+    }
     inst->PopulateBoilerplateFnPtrPlaceholder(1, callOp.m_entry);
 
     // After call is complete, if the callee is not noexcept, we need to check for exception
@@ -533,6 +719,7 @@ void AstFunction::PrepareForFastInterp()
 
     m_body->FastInterpSetupSpillLocation();
     thread_pochiVMContext->m_fastInterpStackFrameManager->AssertEmpty();
+    thread_pochiVMContext->m_fastInterpLocalVarLiveness->Compute(this);
 
     FastInterpSnippet body = m_body->PrepareForFastInterp(x_FINoSpill);
     if (body.m_tail != nullptr)
@@ -547,7 +734,7 @@ void AstFunction::PrepareForFastInterp()
             FastInterpBoilerplateInstance* inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
                         FastInterpBoilerplateLibrary<FIOutlinedReturnImpl>::SelectBoilerplateBluePrint(
                             TypeId::Get<void>().GetDefaultFastInterpTypeId(),
-                            GetIsNoExcept(),
+                            GetIsNoExceptForCodegen(),
                             false /*exceptionThrown*/,
                             FIOpaqueParamsHelper::GetMaxOIP(),
                             FIOpaqueParamsHelper::GetMaxOFP()));
@@ -557,6 +744,7 @@ void AstFunction::PrepareForFastInterp()
         {
             FastInterpBoilerplateInstance* inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
                         FastInterpBoilerplateLibrary<FIAbortTrapImpl>::SelectBoilerplateBluePrint(true));
+            inst->MarkAsColdPathEntry();
             body = body.AddContinuation(FastInterpSnippet { inst, nullptr });
         }
     }
@@ -583,17 +771,26 @@ void AstFunction::PrepareForFastInterp()
 void AstCallExpr::FastInterpFixStackFrameSize(AstFunction* target)
 {
     FIStackframeSizeCategory sfsCat = target->GetFastInterpStackSizeCategory();
+    if (thread_pochiVMContext->m_curModule->GetFastInterpCallFramesOnInterpStack())
+    {
+        // The frame size is a constant placeholder of FICallExprInterpStackImpl, see FIInstantiateCallOp()
+        //
+        m_fastInterpInst->PopulateConstantPlaceholder<uint64_t>(
+                    1, static_cast<uint64_t>(FIStackframeSizeCategoryHelper::x_size_list[static_cast<int>(sfsCat)]));
+        return;
+    }
     m_fastInterpInst->ReplaceBluePrint(
                 FastInterpBoilerplateLibrary<FICallExprImpl>::SelectBoilerplateBluePrint(
                     target->GetReturnType().GetOneLevelPtrFastInterpTypeId(),
                     !m_fastInterpSpillLoc.IsNoSpill(),
-                    target->GetIsNoExcept(),
+                    target->GetIsNoExceptForCodegen(),
                     sfsCat));
 }
 
 void AstModule::PrepareForFastInterp()
 {
     TestAssert(!m_fastInterpPrepared);
+    TestAssert(thread_pochiVMContext->m_curModule == this);
 #ifdef TESTBUILD
     m_fastInterpPrepared = true;
 #endif
@@ -606,17 +803,68 @@ void AstModule::PrepareForFastInterp()
     {
         thread_pochiVMContext->m_fastInterpEngine = new FastInterpCodegenEngine();
     }
+    if (thread_pochiVMContext->m_fastInterpLocalVarLiveness == nullptr)
+    {
+        thread_pochiVMContext->m_fastInterpLocalVarLiveness = new FILocalVarLiveness();
+    }
+    thread_pochiVMContext->m_fastInterpStackFrameManager->SetCompactLayout(m_fastInterpCompactStackFrame);
+    thread_pochiVMContext->m_fastInterpLocalVarLiveness->SetEnabled(m_fastInterpCompactStackFrame);
 
     thread_pochiVMContext->m_fastInterpEngine->Reset();
+    thread_pochiVMContext->m_fastInterpEngine->SetColdPathLayoutEnabled(m_fastInterpColdPathLayout);
     thread_pochiVMContext->m_fastInterpFnCallFixList.clear();
+    thread_pochiVMContext->m_fastInterpTailCallList.clear();
+
+    if (m_fastInterpInlineThreshold > 0)
+    {
+        TestAssert(m_validated && !m_debugInterpPrepared);
+        InlineSmallFunctions(m_fastInterpInlineThreshold);
+    }
+
+    if (m_fastInterpConstantFolding)
+    {
+        TestAssert(m_validated && !m_debugInterpPrepared);
+        FoldConstants();
+    }
+
+    if (m_fastInterpOsrThreshold > 0)
+    {
+        TestAssert(m_validated);
+        InstrumentFastInterpOsrLoops();
+    }
 
     AstTraverseColorMark::ClearAll();
-    for (auto iter = m_functions.begin(); iter != m_functions.end(); iter++)
+    for (AstFunction* fn : GetFunctionList())
     {
-        AstFunction* fn = iter->second;
         fn->PrepareForFastInterp();
     }
 
+    // A tail call runs the callee in the stack frame of the caller (see AstReturnStmt), so the stack frame
+    // of a function must also fit every function it may tail call, directly or through other tail calls.
+    // The sizes only grow, so this converges.
+    //
+    {
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (auto iter = thread_pochiVMContext->m_fastInterpTailCallList.begin();
+                 iter != thread_pochiVMContext->m_fastInterpTailCallList.end(); iter++)
+            {
+                AstFunction* caller = iter->first;
+                AstFunction* callee = iter->second;
+                if (caller->m_fastInterpStackFrameSize < callee->m_fastInterpStackFrameSize)
+                {
+                    // The stack frame size category must not have been computed yet
+                    //
+                    TestAssert(caller->m_fastInterpStackFrameSizeCategory == FIStackframeSizeCategory::X_END_OF_ENUM);
+                    caller->m_fastInterpStackFrameSize = callee->m_fastInterpStackFrameSize;
+                    changed = true;
+                }
+            }
+        }
+    }
+
     for (auto iter = thread_pochiVMContext->m_fastInterpFnCallFixList.begin();
          iter != thread_pochiVMContext->m_fastInterpFnCallFixList.end(); iter++)
     {
@@ -626,22 +874,42 @@ void AstModule::PrepareForFastInterp()
     }
 
     {
+        // The program is owned by the module, so that the module can be handed to another thread.
+        // The programs of the earlier generations are kept, since the new program may call into them.
+        //
         std::unique_ptr<FastInterpGeneratedProgram> gp = thread_pochiVMContext->m_fastInterpEngine->Materialize();
-        if (thread_pochiVMContext->m_fastInterpGeneratedProgram != nullptr)
-        {
-            delete thread_pochiVMContext->m_fastInterpGeneratedProgram;
-            thread_pochiVMContext->m_fastInterpGeneratedProgram = nullptr;
-        }
-        thread_pochiVMContext->m_fastInterpGeneratedProgram = gp.release();
+        // Materialize() only fails if it cannot mmap or mprotect the executable code section.
+        // Every point of the codegen that reserves memory (e.g. g_codegenMemoryPool) treats
+        // running out of memory as fatal, and at this point the module is already half-lowered
+        // (stack frame sizes and fix lists are consumed), so there is no state to fall back to.
+        //
+        ReleaseAssert(gp != nullptr && "Out Of Memory");
+        m_fastInterpPrograms.push_back(gp.release());
     }
 
-    for (auto iter = m_functions.begin(); iter != m_functions.end(); iter++)
+    for (AstFunction* fn : GetFunctionList())
     {
-        AstFunction* fn = iter->second;
-        fn->SetFastInterpCppEntryPoint(thread_pochiVMContext->m_fastInterpGeneratedProgram->GetGeneratedFunctionAddress(fn));
+        fn->SetFastInterpCppEntryPoint(m_fastInterpPrograms.back()->GetGeneratedFunctionAddress(fn));
+    }
+
+    // The continuations read the live variables from the FastInterp stack frame,
+    // so they can only be created after the stack frame layout is known.
+    //
+    if (m_fastInterpOsrEntries.size() > 0)
+    {
+        CreateFastInterpOsrContinuations();
     }
 }
 
+void AstModule::FreeFastInterpPrograms()
+{
+    for (FastInterpGeneratedProgram* gp : m_fastInterpPrograms)
+    {
+        delete gp;
+    }
+    m_fastInterpPrograms.clear();
+}
+
 FastInterpSnippet WARN_UNUSED AstGeneratedFunctionPointerExpr::PrepareForFastInterp(FISpillLocation spillLoc)
 {
     FINumOpaqueIntegralParams numOIP = thread_pochiVMContext->m_fastInterpStackFrameManager->GetNumNoSpillIntegral();
@@ -672,7 +940,20 @@ FastInterpSnippet WARN_UNUSED AstGeneratedFunctionPointerExpr::PrepareForFastInt
     AstFunction* target = thread_pochiVMContext->m_curModule->GetAstFunction(m_fnName);
     TestAssert(target != nullptr);
 
-    thread_pochiVMContext->m_fastInterpEngine->AppendFnPtrFixList(target, inst);
+    if (target->GetModuleGeneration() < thread_pochiVMContext->m_curModule->GetGeneration())
+    {
+        // The target is built by an earlier generation of the module, so its address is already known.
+        // This 'inst' is a FILiteralMcMediumImpl, so we should write to placeholder 1
+        //
+        TestAssert(target->GetFastInterpCppEntryPoint() != nullptr);
+        uint64_t controlValue = GeneratedFunctionPointerImpl::GetControlValueForFastInterpFn(
+                    target, reinterpret_cast<uint64_t>(target->GetFastInterpCppEntryPoint()));
+        inst->PopulateConstantPlaceholder<uint64_t>(1, controlValue);
+    }
+    else
+    {
+        thread_pochiVMContext->m_fastInterpEngine->AppendFnPtrFixList(target, inst);
+    }
     return FastInterpSnippet { inst, inst };
 }
 
@@ -14,7 +14,7 @@ namespace PochiVM
 using namespace llvm;
 using namespace llvm::orc;
 
-void AstFunction::EmitDefinition()
+void AstFunction::EmitDefinition(bool isDeclarationOnly)
 {
     TestAssert(m_generatedPrototype == nullptr);
     Type** args = reinterpret_cast<Type**>(alloca(sizeof(Type*) * m_params.size()));
@@ -44,7 +44,10 @@ void AstFunction::EmitDefinition()
         m_generatedPrototype->addAttribute(AttributeList::AttrIndex::ReturnIndex, Attribute::AttrKind::ZExt);
     }
 
-    m_generatedPrototype->setPersonalityFn(thread_llvmContext->m_personalityFn);
+    if (!isDeclarationOnly)
+    {
+        m_generatedPrototype->setPersonalityFn(thread_llvmContext->m_personalityFn);
+    }
 
     // Set parameter names
     //
@@ -66,7 +69,7 @@ void AstFunction::EmitDefinition()
         }
     }
 
-    if (GetIsNoExcept())
+    if (GetIsNoExceptForCodegen())
     {
         m_generatedPrototype->addFnAttr(Attribute::AttrKind::NoUnwind);
     }
@@ -174,11 +177,137 @@ void AstFunction::EmitIR()
     thread_llvmContext->m_curFunction = nullptr;
 }
 
+// Apply the attributes given at registration (see cpp_function_attribute.h) to a C++ function
+// imported into the generated module. The attributes inferred by clang when the runtime library
+// was compiled are overridden if they conflict.
+//
+static void ApplyCppFunctionAttributes(Function* func, CppFunctionAttribute attrs)
+{
+    if (HasCppFunctionAttribute(attrs, CppFunctionAttribute::AlwaysInline))
+    {
+        func->removeFnAttr(Attribute::AttrKind::OptimizeNone);
+        func->removeFnAttr(Attribute::AttrKind::NoInline);
+        func->addFnAttr(Attribute::AttrKind::AlwaysInline);
+    }
+    if (HasCppFunctionAttribute(attrs, CppFunctionAttribute::AddressOnly))
+    {
+        func->removeFnAttr(Attribute::AttrKind::AlwaysInline);
+        func->removeFnAttr(Attribute::AttrKind::InlineHint);
+        func->addFnAttr(Attribute::AttrKind::NoInline);
+    }
+    if (HasCppFunctionAttribute(attrs, CppFunctionAttribute::Pure))
+    {
+        func->removeFnAttr(Attribute::AttrKind::ReadOnly);
+        func->removeFnAttr(Attribute::AttrKind::WriteOnly);
+        func->removeFnAttr(Attribute::AttrKind::ArgMemOnly);
+        func->removeFnAttr(Attribute::AttrKind::InaccessibleMemOnly);
+        func->removeFnAttr(Attribute::AttrKind::InaccessibleMemOrArgMemOnly);
+        func->addFnAttr(Attribute::AttrKind::ReadNone);
+    }
+    if (HasCppFunctionAttribute(attrs, CppFunctionAttribute::ReadOnly) &&
+        !func->hasFnAttribute(Attribute::AttrKind::ReadNone))
+    {
+        func->removeFnAttr(Attribute::AttrKind::WriteOnly);
+        func->addFnAttr(Attribute::AttrKind::ReadOnly);
+    }
+    // LLVM 10 has no 'hot' attribute. The closest is to make the inliner favor the function.
+    //
+    if (HasCppFunctionAttribute(attrs, CppFunctionAttribute::Hot))
+    {
+        func->removeFnAttr(Attribute::AttrKind::Cold);
+        if (!HasCppFunctionAttribute(attrs, CppFunctionAttribute::AddressOnly))
+        {
+            func->addFnAttr(Attribute::AttrKind::InlineHint);
+        }
+    }
+    // Calls to a cold function are also treated as unlikely paths by the branch probability analysis
+    //
+    if (HasCppFunctionAttribute(attrs, CppFunctionAttribute::Cold))
+    {
+        func->removeFnAttr(Attribute::AttrKind::InlineHint);
+        func->addFnAttr(Attribute::AttrKind::Cold);
+    }
+}
+
+// Declare a C++ function registered with CppFunctionAttribute::AddressOnly, without importing its bitcode.
+// The prototype is built from the metadata, which gives the same LLVM types as the arguments passed by AstCallExpr.
+// The parameter attributes required by the x86-64 SysV ABI (as emitted by clang) are added:
+// integers narrower than 32 bits are extended by the caller, and the sret pointer is marked 'sret noalias'.
+//
+static Function* DeclareCppFunctionFromMetadata(const CppFunctionMetadata* md)
+{
+    const char* symbolName = md->m_bitcodeData->m_symbolName;
+    TestAssert(thread_llvmContext->m_module->getFunction(symbolName) == nullptr);
+    size_t numArgs = md->m_numParams + (md->m_isUsingSret ? 1 : 0);
+    Type** args = reinterpret_cast<Type**>(alloca(sizeof(Type*) * numArgs));
+    size_t index = 0;
+    if (md->m_isUsingSret)
+    {
+        args[index] = AstTypeHelper::llvm_type_of(md->m_returnType.AddPointer());
+        index++;
+    }
+    for (size_t i = 0; i < md->m_numParams; i++)
+    {
+        args[index] = AstTypeHelper::llvm_type_of(md->m_paramTypes[i]);
+        index++;
+    }
+    TestAssert(index == numArgs);
+    Type* returnType = AstTypeHelper::llvm_type_of(md->m_isUsingSret ? TypeId::Get<void>() : md->m_returnType);
+    FunctionType* funcType = FunctionType::get(returnType,
+                                               ArrayRef<Type*>(args, args + numArgs),
+                                               false /*isVariadic*/);
+    Function* func = Function::Create(funcType, Function::ExternalLinkage, symbolName, thread_llvmContext->m_module);
+
+    auto getExtAttr = [](TypeId typeId) -> Attribute::AttrKind
+    {
+        if (typeId.IsBool())
+        {
+            return Attribute::AttrKind::ZExt;
+        }
+        if (typeId.IsPrimitiveIntType() && typeId.Size() < 4)
+        {
+            return typeId.IsSigned() ? Attribute::AttrKind::SExt : Attribute::AttrKind::ZExt;
+        }
+        return Attribute::AttrKind::None;
+    };
+
+    index = 0;
+    if (md->m_isUsingSret)
+    {
+        func->addParamAttr(static_cast<unsigned>(index), Attribute::AttrKind::StructRet);
+        func->addParamAttr(static_cast<unsigned>(index), Attribute::AttrKind::NoAlias);
+        index++;
+    }
+    for (size_t i = 0; i < md->m_numParams; i++)
+    {
+        Attribute::AttrKind ext = getExtAttr(md->m_paramTypes[i]);
+        if (ext != Attribute::AttrKind::None)
+        {
+            func->addParamAttr(static_cast<unsigned>(index), ext);
+        }
+        index++;
+    }
+    if (!md->m_isUsingSret)
+    {
+        Attribute::AttrKind ext = getExtAttr(md->m_returnType);
+        if (ext != Attribute::AttrKind::None)
+        {
+            func->addAttribute(AttributeList::AttrIndex::ReturnIndex, ext);
+        }
+    }
+    if (md->m_isNoExcept)
+    {
+        func->addFnAttr(Attribute::AttrKind::NoUnwind);
+    }
+    return func;
+}
+
 void AstModule::EmitIR()
 {
     // In test build, user should always validate module before emitting IR
     //
     TestAssert(!m_irEmitted && m_validated);
+    TestAssert(thread_pochiVMContext->m_curModule == this);
 #ifdef TESTBUILD
     m_irEmitted = true;
 #endif
@@ -226,7 +355,7 @@ void AstModule::EmitIR()
         {
             TestAssert(bitcode != nullptr);
             SMDiagnostic llvmErr;
-            MemoryBufferRef mb(StringRef(reinterpret_cast<const char*>(bitcode->m_bitcode), bitcode->m_length),
+            MemoryBufferRef mb(StringRef(reinterpret_cast<const char*>(bitcode->GetBitcode()), bitcode->m_length),
                                StringRef(bitcode->m_symbolName));
             std::unique_ptr<Module> bitcodeModule = parseIR(mb, llvmErr, *m_llvmContext);
             // TODO: handle error
@@ -336,6 +465,7 @@ void AstModule::EmitIR()
         //
         std::vector<bool> alreadyLinkedin;
         alreadyLinkedin.resize(AstTypeHelper::x_num_cpp_functions, false /*value*/);
+        std::vector<const CppFunctionMetadata*> addressOnlyFunctions;
         Linker linker(*m_llvmModule);
         auto linkinFunctionByMetadata = [&](const CppFunctionMetadata* metadata)
         {
@@ -344,6 +474,14 @@ void AstModule::EmitIR()
             if (!alreadyLinkedin[metadata->m_functionOrdinal])
             {
                 alreadyLinkedin[metadata->m_functionOrdinal] = true;
+                // The bitcode of a function called only through its address is not needed.
+                // It is declared after all the bitcode stubs are linked in, see below.
+                //
+                if (HasCppFunctionAttribute(metadata->m_attributes, CppFunctionAttribute::AddressOnly))
+                {
+                    addressOnlyFunctions.push_back(metadata);
+                    return;
+                }
                 const BitcodeData* bitcode = metadata->m_bitcodeData;
                 std::unique_ptr<Module> bitcodeModule = getIrModuleFromBitcodeData(bitcode);
                 // linkInModule returns true on error
@@ -356,6 +494,7 @@ void AstModule::EmitIR()
                 TestAssert(func != nullptr);
                 TestAssert(func->getLinkage() == GlobalValue::LinkageTypes::ExternalLinkage);
                 func->setLinkage(GlobalValue::LinkageTypes::AvailableExternallyLinkage);
+                ApplyCppFunctionAttributes(func, metadata->m_attributes);
             }
         };
         // Link in all bitcode stubs needed by a generated function
@@ -402,26 +541,75 @@ void AstModule::EmitIR()
             }
             Recurse();
         };
-        for (auto iter = m_functions.begin(); iter != m_functions.end(); iter++)
+        for (AstFunction* fn : GetFunctionList())
         {
-            AstFunction* fn = iter->second;
             fn->TraverseFunctionBody(linkinBitcodeFn);
         }
+
+        // Declare the functions called only through their address. This must happen after all bitcode stubs
+        // are linked in, so the C++ class types in their prototypes resolve to the imported definitions.
+        // The function may already be declared (or even defined) by the bitcode stub of another function.
+        //
+        for (const CppFunctionMetadata* metadata : addressOnlyFunctions)
+        {
+            Function* func = m_llvmModule->getFunction(metadata->m_bitcodeData->m_symbolName);
+            if (func == nullptr)
+            {
+                func = DeclareCppFunctionFromMetadata(metadata);
+            }
+            ApplyCppFunctionAttributes(func, metadata->m_attributes);
+        }
     }
 
     // Second pass: emit all function prototype.
     //
-    for (auto iter = m_functions.begin(); iter != m_functions.end(); iter++)
+    for (AstFunction* fn : GetFunctionList())
+    {
+        fn->EmitDefinition(false /*isDeclarationOnly*/);
+    }
+
+    // In an incremental update, the functions of the earlier generations used by the new functions are declared.
+    // They are resolved to the code of the earlier generations by the JIT.
+    //
+    if (m_generation > 0)
     {
-        AstFunction* fn = iter->second;
-        fn->EmitDefinition();
+        auto declareFn = [&](AstFunction* fn)
+        {
+            TestAssert(fn != nullptr);
+            if (fn->GetModuleGeneration() < m_generation && fn->m_generatedPrototype == nullptr)
+            {
+                fn->EmitDefinition(true /*isDeclarationOnly*/);
+            }
+        };
+        auto declareCalleesFn = [&](AstNodeBase* cur,
+                                    AstNodeBase* /*parent*/,
+                                    FunctionRef<void(void)> Recurse)
+        {
+            AstNodeType nodeType = cur->GetAstNodeType();
+            if (nodeType == AstNodeType::AstCallExpr)
+            {
+                AstCallExpr* callExpr = assert_cast<AstCallExpr*>(cur);
+                if (!callExpr->IsCppFunction())
+                {
+                    declareFn(callExpr->GetCalleeAstFunction());
+                }
+            }
+            else if (nodeType == AstNodeType::AstGeneratedFunctionPointerExpr)
+            {
+                declareFn(GetAstFunction(assert_cast<AstGeneratedFunctionPointerExpr*>(cur)->GetFnName()));
+            }
+            Recurse();
+        };
+        for (AstFunction* fn : GetFunctionList())
+        {
+            fn->TraverseFunctionBody(declareCalleesFn);
+        }
     }
 
     // Third pass: emit all function bodies.
     //
-    for (auto iter = m_functions.begin(); iter != m_functions.end(); iter++)
+    for (AstFunction* fn : GetFunctionList())
     {
-        AstFunction* fn = iter->second;
         fn->EmitIR();
     }
 
@@ -483,7 +671,7 @@ Value* WARN_UNUSED AstCallExpr::EmitIRImpl()
     AstFunction* calleeAst = nullptr;
     if (!m_isCppFunction)
     {
-        calleeAst = thread_pochiVMContext->m_curModule->GetAstFunction(m_fnName);
+        calleeAst = GetCalleeAstFunction();
         TestAssertIff(calleeAst == nullptr, thread_llvmContext->m_module->getFunction(m_fnName) == nullptr);
         TestAssert(calleeAst != nullptr);
         callee = calleeAst->GetGeneratedPrototype();
@@ -524,11 +712,21 @@ Value* WARN_UNUSED AstCallExpr::EmitIRImpl()
     //
     if (callee->hasFnAttribute(Attribute::AttrKind::NoUnwind) || IsNoLandingPadNeeded())
     {
-        ret = thread_llvmContext->m_builder
+        CallInst* callInst = thread_llvmContext->m_builder
                 ->CreateCall(callee, ArrayRef<Value*>(params, params + callee->arg_size()));
+        if (m_isTailCall)
+        {
+            // The caller (AstReturnStmt) is responsible for emitting the 'ret' right after the call
+            //
+            callInst->setTailCallKind(CallInst::TailCallKind::TCK_MustTail);
+        }
+        ret = callInst;
     }
     else
     {
+        // AstFunction::Validate() guarantees that a tail call never needs a landing pad
+        //
+        TestAssert(!m_isTailCall);
         BasicBlock* unwindDest = EmitEHLandingPadForCurrentPosition();
         BasicBlock* normalDest = BasicBlock::Create(
                     *thread_llvmContext->m_llvmContext,
@@ -589,7 +787,25 @@ Value* WARN_UNUSED AstDeclareVariable::EmitIRImpl()
 Value* WARN_UNUSED AstReturnStmt::EmitIRImpl()
 {
     AstFunction* function = thread_llvmContext->GetCurFunction();
-    if (m_retVal != nullptr)
+    if (m_isTailCall)
+    {
+        // A 'musttail' call must be immediately followed by a 'ret' of its result.
+        // Validate() guarantees there is no destructor to run in between.
+        //
+        TestAssert(thread_pochiVMContext->m_scopedVariableManager.GetNumNontrivialDestructorObjects() == 0);
+        Value* retVal = m_retVal->EmitIR();
+        if (function->GetReturnType().IsVoid())
+        {
+            TestAssert(retVal == nullptr);
+            thread_llvmContext->m_builder->CreateRetVoid();
+        }
+        else
+        {
+            TestAssert(AstTypeHelper::llvm_value_has_type(function->GetReturnType(), retVal));
+            thread_llvmContext->m_builder->CreateRet(retVal);
+        }
+    }
+    else if (m_retVal != nullptr)
     {
         TestAssert(!function->GetReturnType().IsVoid());
         Value* retVal = m_retVal->EmitIR();
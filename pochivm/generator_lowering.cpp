@@ -0,0 +1,493 @@
+#include "ast_clone_helper.h"
+
+namespace PochiVM
+{
+
+// Lowering of generators (see NewGenerator()) into plain functions.
+//
+// The lowering is done at AST level, so FastInterp and LLVM (and DebugInterp) all get the same state machine,
+// without needing to support suspending a stack frame. A generator 'gen' with params p_i becomes:
+//
+//     void gen(uintptr_t state, p_1, ... p_n)       stores the params into 'state', and sets resume point 0
+//     bool gen_next(uintptr_t state, T* out)        the state machine below
+//
+// All variables of the generator live in the state buffer, at fixed offsets after the resume point,
+// so their values (and addresses) survive across Yield statements. The Yield statements are numbered
+// 1 to K in pre-order, and resume point k means 'continue after Yield k'. Since the AST has no goto,
+// gen_next resumes by re-entering the control flow statements on the path to Yield k, guarded by a
+// local flag 'resuming' which is cleared on arriving at Yield k:
+//
+//   (1) A run of statements without Yield before the last statement containing a Yield in a statement list
+//       is wrapped in 'if (!resuming) { ... }'. A statement containing Yields j..k becomes
+//       'if (!resuming || (j <= resumePoint && resumePoint <= k)) { ... }'. The statements after the last
+//       statement containing a Yield are never reached while resuming, so they are left as-is.
+//   (2) A loop containing a Yield gets condition 'resuming || cond', so the condition is not re-evaluated when
+//       resuming into its body. The init-block of such a for-loop is skipped when resuming.
+//   (3) An if-statement containing a Yield selects its branch by the resume point when resuming.
+//   (4) Yield k becomes 'if (!resuming) { *out = value; resumePoint = k; return true; } else { resuming = false; }'.
+//   (5) Return becomes 'resumePoint = finished; return false;', as does falling off the end of the function.
+//
+// Only primitive and pointer variables, and the AST nodes supported by AstCloneHelper are supported in a generator.
+//
+
+namespace {
+
+constexpr uint64_t x_generatorFinished = static_cast<uint64_t>(-1);
+
+AstNodeBase* WARN_UNUSED NewU64Literal(uint64_t value)
+{
+    return new AstLiteralExpr(TypeId::Get<uint64_t>(), &value);
+}
+
+AstNodeBase* WARN_UNUSED NewBoolLiteral(bool value)
+{
+    return new AstLiteralExpr(TypeId::Get<bool>(), &value);
+}
+
+// The address of the slot at 'offset' in the state buffer pointed by variable 'state'
+//
+AstNodeBase* WARN_UNUSED NewStateSlotAddress(AstVariable* state, uint64_t offset, TypeId ptrType)
+{
+    return new AstReinterpretCastExpr(
+                new AstArithmeticExpr(AstArithmeticExprType::ADD,
+                                      new AstDereferenceVariableExpr(state),
+                                      NewU64Literal(offset)),
+                ptrType);
+}
+
+// Clones the code of the generator into gen_next, with all variables replaced by their slots in the state buffer
+//
+class GeneratorBodyCloner : public AstCloneHelper
+{
+public:
+    GeneratorBodyCloner(AstFunction* owner, AstVariable* state, const std::unordered_map<AstVariable*, uint64_t>& offsets)
+        : AstCloneHelper(owner)
+        , m_state(state)
+        , m_offsets(offsets)
+    { }
+
+    AstNodeBase* WARN_UNUSED ResumePointAddress()
+    {
+        return NewStateSlotAddress(m_state, 0 /*offset*/, TypeId::Get<uint64_t*>());
+    }
+
+protected:
+    virtual AstNodeBase* CloneVariable(AstVariable* var) override
+    {
+        TestAssert(m_offsets.count(var));
+        return NewStateSlotAddress(m_state, m_offsets.find(var)->second, var->GetTypeId());
+    }
+
+    virtual AstNodeBase* CloneDeclareVariable(AstDeclareVariable* node) override
+    {
+        if (node->m_assignExpr == nullptr)
+        {
+            return new AstBlock();
+        }
+        else
+        {
+            return new AstAssignExpr(CloneVariable(node->m_variable), Clone(node->m_assignExpr->GetSrc()));
+        }
+    }
+
+    virtual AstNodeBase* CloneDereferenceVariableExpr(AstDereferenceVariableExpr* node) override
+    {
+        return new AstDereferenceExpr(CloneVariable(node->GetOperand()));
+    }
+
+    virtual AstNodeBase* CloneReturnStmt(AstReturnStmt* node) override
+    {
+        TestAssert(node->m_retVal == nullptr);
+        return new AstBlock(std::vector<AstNodeBase*> {
+            new AstAssignExpr(ResumePointAddress(), NewU64Literal(x_generatorFinished)),
+            new AstReturnStmt(NewBoolLiteral(false))
+        });
+    }
+
+private:
+    AstVariable* m_state;
+    const std::unordered_map<AstVariable*, uint64_t>& m_offsets;
+};
+
+// Whether the validator considers the code after 'stmt' unreachable due to a return statement
+//
+bool AlwaysReturns(AstNodeBase* stmt)
+{
+    switch (static_cast<int>(stmt->GetAstNodeType()))
+    {
+    case AstNodeType::AstReturnStmt:
+    {
+        return true;
+    }
+    case AstNodeType::AstBlock:
+    case AstNodeType::AstScope:
+    {
+        const std::vector<AstNodeBase*>& contents = (stmt->GetAstNodeType() == AstNodeType::AstBlock) ?
+                    assert_cast<AstBlock*>(stmt)->GetContents() : assert_cast<AstScope*>(stmt)->GetContents();
+        for (AstNodeBase* s : contents)
+        {
+            if (AlwaysReturns(s))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    case AstNodeType::AstIfStatement:
+    {
+        AstIfStatement* s = assert_cast<AstIfStatement*>(stmt);
+        return s->HasElseClause() && AlwaysReturns(s->GetThenClause()) && AlwaysReturns(s->GetElseClause());
+    }
+    default:
+    {
+        return false;
+    }
+    }   /*switch*/
+}
+
+class GeneratorLowering
+{
+public:
+    GeneratorLowering(AstFunction* generator,
+                      AstFunction* resumeFn,
+                      const std::unordered_map<AstVariable*, uint64_t>& offsets)
+        : m_generator(generator)
+        , m_cloner(resumeFn, resumeFn->GetParamsVector()[0], offsets)
+        , m_out(resumeFn->GetParamsVector()[1])
+        , m_resuming(new AstVariable(TypeId::Get<bool*>(), resumeFn, resumeFn->GetNextVarSuffix(), "resuming"))
+        , m_numYields(0)
+        , m_yieldRange()
+    { }
+
+    AstBlock* WARN_UNUSED Run()
+    {
+        const std::vector<AstNodeBase*>& contents = m_generator->GetFunctionBody()->GetContents();
+        for (AstNodeBase* stmt : contents)
+        {
+            NumberYields(stmt);
+        }
+
+        std::vector<AstNodeBase*> body;
+        body.push_back(new AstIfStatement(
+                           new AstComparisonExpr(AstComparisonExprType::EQUAL, ResumePoint(), NewU64Literal(x_generatorFinished)),
+                           new AstScope(std::vector<AstNodeBase*> { new AstReturnStmt(NewBoolLiteral(false)) })));
+        body.push_back(new AstDeclareVariable(
+                           m_resuming,
+                           new AstAssignExpr(m_resuming, new AstComparisonExpr(AstComparisonExprType::NOT_EQUAL, ResumePoint(), NewU64Literal(0)))));
+        std::vector<AstNodeBase*> lowered = LowerStatementList(contents);
+        body.insert(body.end(), lowered.begin(), lowered.end());
+        bool alwaysReturns = false;
+        for (AstNodeBase* stmt : lowered)
+        {
+            alwaysReturns |= AlwaysReturns(stmt);
+        }
+        if (!alwaysReturns)
+        {
+            body.push_back(new AstAssignExpr(m_cloner.ResumePointAddress(), NewU64Literal(x_generatorFinished)));
+            body.push_back(new AstReturnStmt(NewBoolLiteral(false)));
+        }
+        return new AstBlock(body);
+    }
+
+private:
+    // Number the Yield statements in pre-order, and record the range of Yield statements in each statement
+    //
+    void NumberYields(AstNodeBase* stmt)
+    {
+        uint64_t first = m_numYields + 1;
+        switch (static_cast<int>(stmt->GetAstNodeType()))
+        {
+        case AstNodeType::AstYieldStmt:
+        {
+            m_numYields++;
+            break;
+        }
+        case AstNodeType::AstBlock:
+        {
+            for (AstNodeBase* s : assert_cast<AstBlock*>(stmt)->GetContents())
+            {
+                NumberYields(s);
+            }
+            break;
+        }
+        case AstNodeType::AstScope:
+        {
+            for (AstNodeBase* s : assert_cast<AstScope*>(stmt)->GetContents())
+            {
+                NumberYields(s);
+            }
+            break;
+        }
+        case AstNodeType::AstIfStatement:
+        {
+            AstIfStatement* s = assert_cast<AstIfStatement*>(stmt);
+            NumberYields(s->GetThenClause());
+            if (s->HasElseClause())
+            {
+                NumberYields(s->GetElseClause());
+            }
+            break;
+        }
+        case AstNodeType::AstWhileLoop:
+        {
+            NumberYields(assert_cast<AstWhileLoop*>(stmt)->GetBody());
+            break;
+        }
+        case AstNodeType::AstForLoop:
+        {
+            // The validator disallows Yield in the init-block and step-block
+            //
+            NumberYields(assert_cast<AstForLoop*>(stmt)->GetBody());
+            break;
+        }
+        default:
+        {
+            break;
+        }
+        }   /*switch*/
+        if (m_numYields >= first)
+        {
+            m_yieldRange[stmt] = std::make_pair(first, m_numYields);
+        }
+    }
+
+    bool ContainsYield(AstNodeBase* stmt)
+    {
+        return m_yieldRange.count(stmt);
+    }
+
+    AstNodeBase* WARN_UNUSED ResumePoint()
+    {
+        return new AstDereferenceExpr(m_cloner.ResumePointAddress());
+    }
+
+    AstNodeBase* WARN_UNUSED Resuming()
+    {
+        return new AstDereferenceVariableExpr(m_resuming);
+    }
+
+    AstNodeBase* WARN_UNUSED NotResuming()
+    {
+        return new AstLogicalNotExpr(Resuming());
+    }
+
+    // Whether the resume point is one of the Yield statements in 'stmt'
+    //
+    AstNodeBase* WARN_UNUSED ResumePointIsIn(AstNodeBase* stmt)
+    {
+        TestAssert(ContainsYield(stmt));
+        std::pair<uint64_t, uint64_t> range = m_yieldRange[stmt];
+        return new AstLogicalAndOrExpr(
+                    true /*isAnd*/,
+                    new AstComparisonExpr(AstComparisonExprType::GREATER_EQUAL, ResumePoint(), NewU64Literal(range.first)),
+                    new AstComparisonExpr(AstComparisonExprType::LESS_EQUAL, ResumePoint(), NewU64Literal(range.second)));
+    }
+
+    std::vector<AstNodeBase*> WARN_UNUSED LowerStatementList(const std::vector<AstNodeBase*>& contents)
+    {
+        size_t end = 0;
+        for (size_t i = 0; i < contents.size(); i++)
+        {
+            if (ContainsYield(contents[i]))
+            {
+                end = i + 1;
+            }
+        }
+
+        std::vector<AstNodeBase*> result;
+        std::vector<AstNodeBase*> skippedWhenResuming;
+        for (size_t i = 0; i < end; i++)
+        {
+            AstNodeBase* stmt = contents[i];
+            if (!ContainsYield(stmt))
+            {
+                skippedWhenResuming.push_back(m_cloner.Clone(stmt));
+                continue;
+            }
+            if (!skippedWhenResuming.empty())
+            {
+                result.push_back(new AstIfStatement(NotResuming(), new AstScope(skippedWhenResuming)));
+                skippedWhenResuming.clear();
+            }
+            AstNodeBase* guard = new AstLogicalAndOrExpr(false /*isAnd*/, NotResuming(), ResumePointIsIn(stmt));
+            result.push_back(new AstIfStatement(guard, new AstScope(std::vector<AstNodeBase*> { LowerStatement(stmt) })));
+        }
+        TestAssert(skippedWhenResuming.empty());
+        for (size_t i = end; i < contents.size(); i++)
+        {
+            result.push_back(m_cloner.Clone(contents[i]));
+        }
+        return result;
+    }
+
+    AstScope* WARN_UNUSED LowerScope(AstScope* scope)
+    {
+        return new AstScope(LowerStatementList(scope->GetContents()));
+    }
+
+    // Lower a statement containing Yield statements
+    //
+    AstNodeBase* WARN_UNUSED LowerStatement(AstNodeBase* stmt)
+    {
+        TestAssert(ContainsYield(stmt));
+        switch (static_cast<int>(stmt->GetAstNodeType()))
+        {
+        case AstNodeType::AstYieldStmt:
+        {
+            AstYieldStmt* s = assert_cast<AstYieldStmt*>(stmt);
+            AstIfStatement* result = new AstIfStatement(NotResuming(), new AstScope(std::vector<AstNodeBase*> {
+                new AstAssignExpr(new AstDereferenceVariableExpr(m_out), m_cloner.Clone(s->m_value)),
+                new AstAssignExpr(m_cloner.ResumePointAddress(), NewU64Literal(m_yieldRange[stmt].first)),
+                new AstReturnStmt(NewBoolLiteral(true))
+            }));
+            result->SetElseClause(new AstScope(std::vector<AstNodeBase*> {
+                new AstAssignExpr(m_resuming, NewBoolLiteral(false))
+            }));
+            return result;
+        }
+        case AstNodeType::AstBlock:
+        {
+            return new AstBlock(LowerStatementList(assert_cast<AstBlock*>(stmt)->GetContents()));
+        }
+        case AstNodeType::AstScope:
+        {
+            return LowerScope(assert_cast<AstScope*>(stmt));
+        }
+        case AstNodeType::AstIfStatement:
+        {
+            AstIfStatement* s = assert_cast<AstIfStatement*>(stmt);
+            AstNodeBase* cond = new AstLogicalAndOrExpr(true /*isAnd*/, NotResuming(), m_cloner.Clone(s->GetCondClause()));
+            if (ContainsYield(s->GetThenClause()))
+            {
+                AstNodeBase* resumeIntoThen = new AstLogicalAndOrExpr(true /*isAnd*/, Resuming(), ResumePointIsIn(s->GetThenClause()));
+                cond = new AstLogicalAndOrExpr(false /*isAnd*/, resumeIntoThen, cond);
+            }
+            AstIfStatement* result = new AstIfStatement(cond, LowerScope(s->GetThenClause()));
+            if (s->HasElseClause())
+            {
+                result->SetElseClause(LowerScope(s->GetElseClause()));
+            }
+            return result;
+        }
+        case AstNodeType::AstWhileLoop:
+        {
+            AstWhileLoop* s = assert_cast<AstWhileLoop*>(stmt);
+            AstNodeBase* cond = new AstLogicalAndOrExpr(false /*isAnd*/, Resuming(), m_cloner.Clone(s->GetCondClause()));
+            return new AstWhileLoop(cond, LowerScope(s->GetBody()));
+        }
+        case AstNodeType::AstForLoop:
+        {
+            AstForLoop* s = assert_cast<AstForLoop*>(stmt);
+            std::vector<AstNodeBase*> init;
+            for (AstNodeBase* initStmt : s->GetInitBlock()->GetContents())
+            {
+                init.push_back(m_cloner.Clone(initStmt));
+            }
+            AstBlock* initBlock = new AstBlock();
+            if (!init.empty())
+            {
+                initBlock->Append(new AstIfStatement(NotResuming(), new AstScope(init)));
+            }
+            AstNodeBase* cond = new AstLogicalAndOrExpr(false /*isAnd*/, Resuming(), m_cloner.Clone(s->GetCondClause()));
+            AstBlock* stepBlock = m_cloner.CloneBlock(s->GetStepBlock());
+            return new AstForLoop(initBlock, cond, stepBlock, LowerScope(s->GetBody()));
+        }
+        default:
+        {
+            TestAssert(false);
+            __builtin_unreachable();
+        }
+        }   /*switch*/
+    }
+
+    AstFunction* m_generator;
+    GeneratorBodyCloner m_cloner;
+    AstVariable* m_out;
+    AstVariable* m_resuming;
+    uint64_t m_numYields;
+    // The range of the ordinals of the Yield statements in each statement containing a Yield
+    //
+    std::unordered_map<AstNodeBase*, std::pair<uint64_t, uint64_t>> m_yieldRange;
+};
+
+}   // anonymous namespace
+
+bool WARN_UNUSED AstModule::LowerGenerator(AstFunction* fn)
+{
+    TestAssert(fn->IsGenerator() && !fn->IsGeneratorLowered());
+    TestAssert(fn->GetReturnType().IsVoid());
+
+    // Assign a slot in the state buffer to each variable. The first slot is the resume point.
+    //
+    std::unordered_map<AstVariable*, uint64_t> offsets;
+    uint64_t stateSize = sizeof(uint64_t);
+    auto assignSlot = [&](AstVariable* var)
+    {
+        if (!offsets.count(var))
+        {
+            TestAssert(var->GetTypeId().RemovePointer().Size() <= sizeof(uint64_t));
+            offsets[var] = stateSize;
+            stateSize += sizeof(uint64_t);
+        }
+    };
+    for (AstVariable* param : fn->GetParamsVector())
+    {
+        assignSlot(param);
+    }
+    bool ok = true;
+    fn->TraverseFunctionBody([&](AstNodeBase* cur, AstNodeBase* /*parent*/, FunctionRef<void(void)> Recurse)
+    {
+        if (!ok)
+        {
+            return;
+        }
+        if (cur->GetAstNodeType() != AstNodeType::AstYieldStmt && !AstCloneHelper::IsCloneSupported(cur))
+        {
+            REPORT_ERR("Generator %s: AST node %s is not supported in generators",
+                       fn->GetName().c_str(), cur->GetAstNodeType().ToString());
+            ok = false;
+            return;
+        }
+        if (cur->GetAstNodeType() == AstNodeType::AstVariable)
+        {
+            assignSlot(assert_cast<AstVariable*>(cur));
+        }
+        else if (cur->GetAstNodeType() == AstNodeType::AstDeclareVariable)
+        {
+            assignSlot(assert_cast<AstDeclareVariable*>(cur)->m_variable);
+        }
+        Recurse();
+    });
+    CHECK_ERR(ok);
+
+    std::string resumeFnName = fn->GetName() + "_next";
+    CHECK_REPORT_ERR(GetAstFunction(resumeFnName) == nullptr,
+                     "Generator %s: function name %s is already taken", fn->GetName().c_str(), resumeFnName.c_str());
+    AstFunction* resumeFn = NewAstFunction(resumeFnName);
+    resumeFn->SetReturnType(TypeId::Get<bool>());
+    resumeFn->AddParam(TypeId::Get<uintptr_t>(), "generator_state");
+    resumeFn->AddParam(fn->GetGeneratorYieldType().AddPointer(), "out");
+    resumeFn->SetIsNoExcept(fn->GetIsNoExcept());
+    {
+        GeneratorLowering lowering(fn, resumeFn, offsets);
+        resumeFn->SetFunctionBody(lowering.Run());
+    }
+
+    // Turn the generator itself into the function initializing the state buffer
+    //
+    AstVariable* state = new AstVariable(TypeId::Get<uintptr_t*>(), fn, fn->GetNextVarSuffix(), "generator_state");
+    std::vector<AstNodeBase*> init;
+    init.push_back(new AstAssignExpr(NewStateSlotAddress(state, 0 /*offset*/, TypeId::Get<uint64_t*>()), NewU64Literal(0)));
+    for (AstVariable* param : fn->GetParamsVector())
+    {
+        init.push_back(new AstAssignExpr(NewStateSlotAddress(state, offsets[param], param->GetTypeId()),
+                                         new AstDereferenceVariableExpr(param)));
+    }
+    fn->m_params.insert(fn->m_params.begin(), state);
+    fn->m_body = new AstScope();
+    fn->SetFunctionBody(new AstBlock(init));
+    fn->m_generatorStateSize = static_cast<uint32_t>(stateSize);
+    RETURN_TRUE;
+}
+
+}   // namespace PochiVM
@@ -0,0 +1,704 @@
+#include "global_codegen_memory_pool.h"
+
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <condition_variable>
+#include <set>
+
+namespace PochiVM
+{
+
+namespace internal
+{
+
+// The chunks cached by one thread for each memory pool, in front of the shared free lists of the pool.
+// The fast paths of GetMemoryChunk() and FreeMemoryChunk() only touch the cache of the current thread.
+//
+// All live caches are tracked in a registry, so that a pool being destroyed can take back the chunks
+// other threads still cache for it, and detach their slots: otherwise a thread exiting later would return
+// chunks to a destroyed pool, or a new pool constructed at the same address would get those stale chunks.
+// The registry mutex guards the assignment of slots to pools. The owning thread reads m_pool without it.
+//
+struct MemoryPoolThreadLocalCache
+{
+    static constexpr size_t x_maxPools = 4;
+
+    struct Slot
+    {
+        std::atomic<GlobalCodegenMemoryPool*> m_pool;
+        size_t m_numChunks;
+        uintptr_t m_chunks[GlobalCodegenMemoryPool::x_maxThreadLocalCacheSize];
+    };
+
+    struct Registry
+    {
+        std::mutex m_mutex;
+        std::set<MemoryPoolThreadLocalCache*> m_caches;
+    };
+
+    // Never destroyed: the thread caches and the pools (e.g. g_codegenMemoryPool) may outlive any static object
+    //
+    static Registry& GetRegistry()
+    {
+        static Registry* registry = new Registry();
+        return *registry;
+    }
+
+    MemoryPoolThreadLocalCache()
+    {
+        for (Slot& slot : m_slots)
+        {
+            slot.m_pool.store(nullptr, std::memory_order_relaxed);
+            slot.m_numChunks = 0;
+        }
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.m_mutex);
+        registry.m_caches.insert(this);
+    }
+
+    // Return the cached chunks to their pools
+    //
+    ~MemoryPoolThreadLocalCache()
+    {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.m_mutex);
+        for (Slot& slot : m_slots)
+        {
+            GlobalCodegenMemoryPool* pool = slot.m_pool.load(std::memory_order_relaxed);
+            if (pool != nullptr)
+            {
+                pool->ReturnChunksToSharedFreeList(slot.m_chunks, &slot.m_numChunks, slot.m_numChunks);
+                slot.m_pool.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+        registry.m_caches.erase(this);
+    }
+
+    // Returns nullptr if the thread is already caching chunks for x_maxPools other pools
+    //
+    Slot* GetSlot(GlobalCodegenMemoryPool* pool)
+    {
+        for (Slot& slot : m_slots)
+        {
+            if (slot.m_pool.load(std::memory_order_relaxed) == pool)
+            {
+                return &slot;
+            }
+        }
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.m_mutex);
+        for (Slot& slot : m_slots)
+        {
+            if (slot.m_pool.load(std::memory_order_relaxed) == nullptr)
+            {
+                slot.m_numChunks = 0;
+                slot.m_pool.store(pool, std::memory_order_relaxed);
+                return &slot;
+            }
+        }
+        return nullptr;
+    }
+
+    // Return the chunks cached for 'pool' by this thread to the shared free lists, and free the slot.
+    // The caller must hold the registry mutex.
+    //
+    void DetachPool(GlobalCodegenMemoryPool* pool)
+    {
+        for (Slot& slot : m_slots)
+        {
+            if (slot.m_pool.load(std::memory_order_relaxed) == pool)
+            {
+                pool->ReturnChunksToSharedFreeList(slot.m_chunks, &slot.m_numChunks, slot.m_numChunks);
+                slot.m_pool.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    Slot m_slots[x_maxPools];
+};
+
+thread_local MemoryPoolThreadLocalCache t_memoryPoolThreadLocalCache;
+
+// The background thread of GlobalCodegenMemoryPool::StartBackgroundTrimming()
+//
+struct MemoryPoolTrimThread
+{
+    MemoryPoolTrimThread(GlobalCodegenMemoryPool* pool, uint64_t intervalMillis)
+        : m_mutex()
+        , m_cv()
+        , m_stopRequested(false)
+        , m_thread(&MemoryPoolTrimThread::Run, this, pool, intervalMillis)
+    { }
+
+    ~MemoryPoolTrimThread()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopRequested = true;
+        }
+        m_cv.notify_one();
+        m_thread.join();
+    }
+
+    void Run(GlobalCodegenMemoryPool* pool, uint64_t intervalMillis)
+    {
+        // Lowest priority, so trimming never competes with the threads using the pool.
+        // On Linux the nice value is per-thread. It is fine if this fails.
+        //
+        std::ignore = setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_cv.wait_for(lock, std::chrono::milliseconds(intervalMillis), [this]() { return m_stopRequested; });
+            if (m_stopRequested)
+            {
+                break;
+            }
+            lock.unlock();
+            std::ignore = pool->Trim();
+            lock.lock();
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stopRequested;
+    std::thread m_thread;
+};
+
+}   // namespace internal
+
+const char* MemoryLimitExceededError::what() const noexcept
+{
+    return "PochiVM: memory limit exceeded";
+}
+
+void ThrowMemoryLimitExceededError(size_t memoryLimit, size_t bytesInUse, size_t bytesRequested)
+{
+    throw MemoryLimitExceededError(memoryLimit, bytesInUse, bytesRequested);
+}
+
+GlobalCodegenMemoryPool::~GlobalCodegenMemoryPool()
+{
+    StopBackgroundTrimming();
+    // Take back the chunks cached by all threads, not only the current one
+    //
+    {
+        internal::MemoryPoolThreadLocalCache::Registry& registry = internal::MemoryPoolThreadLocalCache::GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.m_mutex);
+        for (internal::MemoryPoolThreadLocalCache* cache : registry.m_caches)
+        {
+            cache->DetachPool(this);
+        }
+    }
+    // Chunks of MAP_HUGETLB regions cannot be unmapped one by one
+    //
+    if (m_hugePageMode != MemoryPoolHugePageMode::Explicit)
+    {
+        for (ConcurrentQueue<uintptr_t>& freeList : m_freeLists)
+        {
+            uintptr_t address;
+            while (freeList.try_dequeue(address /*out*/))
+            {
+                UnmapChunk(address);
+            }
+        }
+    }
+    for (size_t sizeClass = 0; sizeClass < x_numCachedLargeObjectSizeClasses; sizeClass++)
+    {
+        uintptr_t address;
+        while (m_largeObjectFreeLists[sizeClass].try_dequeue(address /*out*/))
+        {
+            UnmapLargeObject(address, static_cast<size_t>(1) << (sizeClass + x_minLargeObjectSizeLog2));
+        }
+    }
+}
+
+uintptr_t GlobalCodegenMemoryPool::GetMemoryChunk()
+{
+    if (unlikely(!m_hasAllocated.load(std::memory_order_relaxed)))
+    {
+        m_hasAllocated.store(true, std::memory_order_relaxed);
+    }
+    AddBytesInUse(x_memoryChunkSize);
+    m_numChunksInUse.fetch_add(1, std::memory_order_relaxed);
+    if (m_threadLocalCacheSize > 0)
+    {
+        internal::MemoryPoolThreadLocalCache::Slot* slot = internal::t_memoryPoolThreadLocalCache.GetSlot(this);
+        if (likely(slot != nullptr))
+        {
+            if (unlikely(slot->m_numChunks == 0))
+            {
+                RefillThreadLocalCache(slot->m_chunks, &slot->m_numChunks);
+            }
+            if (likely(slot->m_numChunks > 0))
+            {
+                slot->m_numChunks--;
+                return slot->m_chunks[slot->m_numChunks];
+            }
+        }
+    }
+    return GetMemoryChunkFromSharedFreeList();
+}
+
+void GlobalCodegenMemoryPool::FreeMemoryChunk(uintptr_t address)
+{
+    TestAssert(address % 4096 == 0);
+    m_numChunksInUse.fetch_sub(1, std::memory_order_relaxed);
+    m_bytesInUse.fetch_sub(x_memoryChunkSize, std::memory_order_relaxed);
+    if (m_threadLocalCacheSize > 0)
+    {
+        internal::MemoryPoolThreadLocalCache::Slot* slot = internal::t_memoryPoolThreadLocalCache.GetSlot(this);
+        if (likely(slot != nullptr))
+        {
+            if (unlikely(slot->m_numChunks == m_threadLocalCacheSize))
+            {
+                // Keep half of the cache, so a thread alternating between get and free does not flush every time
+                //
+                ReturnChunksToSharedFreeList(slot->m_chunks, &slot->m_numChunks, (m_threadLocalCacheSize + 1) / 2);
+            }
+            slot->m_chunks[slot->m_numChunks] = address;
+            slot->m_numChunks++;
+            return;
+        }
+    }
+    ReturnChunkToSharedFreeList(address);
+}
+
+void GlobalCodegenMemoryPool::AddLargeAllocation(size_t size)
+{
+    AddBytesInUse(size);
+    m_numLargeAllocations.fetch_add(1, std::memory_order_relaxed);
+    m_largeAllocationBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void GlobalCodegenMemoryPool::RemoveLargeAllocation(size_t size)
+{
+    m_numLargeAllocations.fetch_sub(1, std::memory_order_relaxed);
+    m_largeAllocationBytes.fetch_sub(size, std::memory_order_relaxed);
+    m_bytesInUse.fetch_sub(size, std::memory_order_relaxed);
+}
+
+uintptr_t GlobalCodegenMemoryPool::GetLargeObject(size_t size)
+{
+    size_t allocSize = GetLargeObjectAllocationSize(size);
+    AddLargeAllocation(allocSize);
+    size_t sizeLog2 = static_cast<size_t>(__builtin_ctzll(allocSize));
+    if (sizeLog2 <= x_maxCachedLargeObjectSizeLog2)
+    {
+        size_t sizeClass = sizeLog2 - x_minLargeObjectSizeLog2;
+        uintptr_t result;
+        if (m_largeObjectFreeLists[sizeClass].try_dequeue(result /*out*/))
+        {
+            m_largeObjectFreeListSizes[sizeClass].fetch_sub(1, std::memory_order_relaxed);
+            m_cachedLargeObjectBytes.fetch_sub(allocSize, std::memory_order_relaxed);
+            return result;
+        }
+    }
+    return MapLargeObject(allocSize);
+}
+
+void GlobalCodegenMemoryPool::FreeLargeObject(uintptr_t address, size_t size)
+{
+    TestAssert(address % 4096 == 0);
+    size_t allocSize = GetLargeObjectAllocationSize(size);
+    RemoveLargeAllocation(allocSize);
+    size_t sizeLog2 = static_cast<size_t>(__builtin_ctzll(allocSize));
+    if (sizeLog2 <= x_maxCachedLargeObjectSizeLog2)
+    {
+        size_t sizeClass = sizeLog2 - x_minLargeObjectSizeLog2;
+        size_t maxCached = std::max(static_cast<size_t>(1), x_maxCachedLargeObjectBytesPerSizeClass >> sizeLog2);
+        // Like m_freeListSizeApproximations, the size may be slightly exceeded under concurrency
+        //
+        if (m_largeObjectFreeListSizes[sizeClass].load(std::memory_order_relaxed) < maxCached)
+        {
+            if (m_largeObjectFreeLists[sizeClass].enqueue(address))
+            {
+                m_largeObjectFreeListSizes[sizeClass].fetch_add(1, std::memory_order_relaxed);
+                m_cachedLargeObjectBytes.fetch_add(allocSize, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+    UnmapLargeObject(address, allocSize);
+}
+
+uintptr_t GlobalCodegenMemoryPool::MapLargeObject(size_t allocSize)
+{
+    void* mmapResult = mmap(nullptr, allocSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mmapResult == MAP_FAILED)
+    {
+        // Unlike chunks, a large object may be arbitrarily large, so this is not necessarily fatal
+        //
+        RemoveLargeAllocation(allocSize);
+        throw std::bad_alloc();
+    }
+    if (m_hugePageMode != MemoryPoolHugePageMode::None && allocSize >= x_hugePageRegionSize)
+    {
+        std::ignore = madvise(mmapResult, allocSize, MADV_HUGEPAGE);
+    }
+    return reinterpret_cast<uintptr_t>(mmapResult);
+}
+
+void GlobalCodegenMemoryPool::UnmapLargeObject(uintptr_t address, size_t allocSize)
+{
+    int ret = munmap(reinterpret_cast<void*>(address), allocSize);
+    if (unlikely(ret != 0))
+    {
+        int err = errno;
+        fprintf(stderr, "[WARNING] [Memory Pool] munmap failed with error %d(%s)\n", err, strerror(err));
+    }
+}
+
+MemoryPoolStats GlobalCodegenMemoryPool::GetStats() const
+{
+    return MemoryPoolStats {
+        m_bytesInUse.load(std::memory_order_relaxed),
+        m_peakBytesInUse.load(std::memory_order_relaxed),
+        m_numChunksInUse.load(std::memory_order_relaxed),
+        m_numLargeAllocations.load(std::memory_order_relaxed),
+        m_largeAllocationBytes.load(std::memory_order_relaxed),
+        GetNumFreeChunks(),
+        m_numMappedChunks.load(std::memory_order_relaxed),
+        m_cachedLargeObjectBytes.load(std::memory_order_relaxed),
+        m_trimmedBytes.load(std::memory_order_relaxed),
+        m_memoryLimit.load(std::memory_order_relaxed)
+    };
+}
+
+size_t GlobalCodegenMemoryPool::Trim(bool ignoreDelay)
+{
+    std::lock_guard<std::mutex> lock(m_trimMutex);
+    size_t idleBytes = GetIdleBytes();
+    size_t targetIdleBytes = m_trimTargetIdleBytes.load(std::memory_order_relaxed);
+    if (idleBytes <= targetIdleBytes)
+    {
+        m_isIdleAboveTarget = false;
+        return 0;
+    }
+    if (!ignoreDelay)
+    {
+        uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch()).count());
+        if (!m_isIdleAboveTarget)
+        {
+            m_isIdleAboveTarget = true;
+            m_idleAboveTargetSinceMillis = now;
+        }
+        if (now - m_idleAboveTargetSinceMillis < m_trimDelayMillis.load(std::memory_order_relaxed))
+        {
+            return 0;
+        }
+    }
+    m_isIdleAboveTarget = false;
+
+    size_t bytesToTrim = idleBytes - targetIdleBytes;
+    size_t trimmed = TrimLargeObjects(bytesToTrim);
+    if (trimmed < bytesToTrim)
+    {
+        trimmed += TrimChunks(bytesToTrim - trimmed);
+    }
+    m_trimmedBytes.fetch_add(trimmed, std::memory_order_relaxed);
+    return trimmed;
+}
+
+void GlobalCodegenMemoryPool::StartBackgroundTrimming(uint64_t intervalMillis)
+{
+    std::lock_guard<std::mutex> lock(m_trimMutex);
+    TestAssert(m_trimThread == nullptr);
+    m_trimThread = new internal::MemoryPoolTrimThread(this, intervalMillis);
+}
+
+void GlobalCodegenMemoryPool::StopBackgroundTrimming()
+{
+    internal::MemoryPoolTrimThread* trimThread;
+    {
+        std::lock_guard<std::mutex> lock(m_trimMutex);
+        trimThread = m_trimThread;
+        m_trimThread = nullptr;
+    }
+    // Not holding m_trimMutex, since the thread may be waiting for it in Trim()
+    //
+    delete trimThread;
+}
+
+size_t GlobalCodegenMemoryPool::GetNumFreeChunks() const
+{
+    int numFreeChunks = 0;
+    for (const std::atomic<int>& size : m_freeListSizeApproximations)
+    {
+        numFreeChunks += size.load(std::memory_order_relaxed);
+    }
+    return numFreeChunks > 0 ? static_cast<size_t>(numFreeChunks) : 0;
+}
+
+size_t GlobalCodegenMemoryPool::GetIdleBytes() const
+{
+    return m_cachedLargeObjectBytes.load(std::memory_order_relaxed) + GetNumFreeChunks() * x_memoryChunkSize;
+}
+
+size_t GlobalCodegenMemoryPool::TrimLargeObjects(size_t bytesToTrim)
+{
+    // The biggest objects first, as they are the least likely to be reused
+    //
+    size_t trimmed = 0;
+    for (size_t i = x_numCachedLargeObjectSizeClasses; i-- > 0 && trimmed < bytesToTrim;)
+    {
+        size_t allocSize = static_cast<size_t>(1) << (i + x_minLargeObjectSizeLog2);
+        uintptr_t address;
+        while (trimmed < bytesToTrim && m_largeObjectFreeLists[i].try_dequeue(address /*out*/))
+        {
+            m_largeObjectFreeListSizes[i].fetch_sub(1, std::memory_order_relaxed);
+            m_cachedLargeObjectBytes.fetch_sub(allocSize, std::memory_order_relaxed);
+            UnmapLargeObject(address, allocSize);
+            trimmed += allocSize;
+        }
+    }
+    return trimmed;
+}
+
+size_t GlobalCodegenMemoryPool::TrimChunks(size_t bytesToTrim)
+{
+    // Chunks of MAP_HUGETLB regions cannot be unmapped one by one
+    //
+    if (m_hugePageMode == MemoryPoolHugePageMode::Explicit)
+    {
+        return 0;
+    }
+    size_t trimmed = 0;
+    for (size_t node = 0; node < x_maxNumaNodes; node++)
+    {
+        uintptr_t address;
+        while (trimmed < bytesToTrim && m_freeLists[node].try_dequeue(address /*out*/))
+        {
+            m_freeListSizeApproximations[node].fetch_sub(1);
+            UnmapChunk(address);
+            trimmed += x_memoryChunkSize;
+        }
+    }
+    return trimmed;
+}
+
+void GlobalCodegenMemoryPool::AddBytesInUse(size_t size)
+{
+    // Add first and back out on failure, so concurrent allocations cannot exceed the limit together
+    //
+    size_t bytesInUse = m_bytesInUse.fetch_add(size, std::memory_order_relaxed) + size;
+    size_t memoryLimit = m_memoryLimit.load(std::memory_order_relaxed);
+    if (unlikely(memoryLimit != 0 && bytesInUse > memoryLimit))
+    {
+        m_bytesInUse.fetch_sub(size, std::memory_order_relaxed);
+        ThrowMemoryLimitExceededError(memoryLimit, bytesInUse - size, size);
+    }
+    size_t peak = m_peakBytesInUse.load(std::memory_order_relaxed);
+    while (peak < bytesInUse)
+    {
+        if (m_peakBytesInUse.compare_exchange_weak(peak /*inout*/, bytesInUse, std::memory_order_relaxed))
+        {
+            break;
+        }
+    }
+}
+
+void GlobalCodegenMemoryPool::FlushThreadLocalCache()
+{
+    internal::MemoryPoolThreadLocalCache& cache = internal::t_memoryPoolThreadLocalCache;
+    std::lock_guard<std::mutex> lock(internal::MemoryPoolThreadLocalCache::GetRegistry().m_mutex);
+    cache.DetachPool(this);
+}
+
+size_t GlobalCodegenMemoryPool::GetCurrentNumaNode()
+{
+    if (!m_isNumaAware)
+    {
+        return 0;
+    }
+    unsigned int cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+    {
+        return 0;
+    }
+    return node % x_maxNumaNodes;
+}
+
+size_t GlobalCodegenMemoryPool::GetNumaNodeOfAddress(uintptr_t address)
+{
+    if (!m_isNumaAware)
+    {
+        return 0;
+    }
+    // MPOL_F_NODE | MPOL_F_ADDR: get the node on which 'address' is allocated
+    // Fails on kernels without NUMA support, in which case there is only one node anyway
+    //
+    int node = -1;
+    const unsigned long flags = 1UL | 2UL;
+    if (syscall(SYS_get_mempolicy, &node, nullptr, 0UL, reinterpret_cast<void*>(address), flags) != 0 || node < 0)
+    {
+        return 0;
+    }
+    return static_cast<size_t>(node) % x_maxNumaNodes;
+}
+
+void GlobalCodegenMemoryPool::RefillThreadLocalCache(uintptr_t* chunks, size_t* numChunks /*inout*/)
+{
+    TestAssert(*numChunks == 0);
+    size_t node = GetCurrentNumaNode();
+    size_t numDequeued = m_freeLists[node].try_dequeue_bulk(chunks, (m_threadLocalCacheSize + 1) / 2);
+    *numChunks = numDequeued;
+    m_freeListSizeApproximations[node].fetch_sub(static_cast<int>(numDequeued));
+}
+
+void GlobalCodegenMemoryPool::ReturnChunksToSharedFreeList(uintptr_t* chunks, size_t* numChunks /*inout*/, size_t numToReturn)
+{
+    TestAssert(numToReturn <= *numChunks);
+    for (size_t i = 0; i < numToReturn; i++)
+    {
+        (*numChunks)--;
+        ReturnChunkToSharedFreeList(chunks[*numChunks]);
+    }
+}
+
+uintptr_t GlobalCodegenMemoryPool::GetMemoryChunkFromSharedFreeList()
+{
+    // Chunks on other NUMA nodes are not reused: each free list is bounded by x_maxChunksInMemoryPool,
+    // so it is better to get local memory from the OS
+    //
+    size_t node = GetCurrentNumaNode();
+    uintptr_t result;
+    if (m_freeLists[node].try_dequeue(result /*out*/))
+    {
+        m_freeListSizeApproximations[node].fetch_sub(1);
+        return result;
+    }
+    return AllocateChunkFromOS(node);
+}
+
+void GlobalCodegenMemoryPool::ReturnChunkToSharedFreeList(uintptr_t address)
+{
+    bool enqueued = false;
+    // The bound is per free list: since chunks are only reused on their own node,
+    // a full free list on one node must not make another node give its chunks back to the OS.
+    // Important to cast x_maxChunksInMemoryPool to int, not the other way around:
+    // the m_freeListSizeApproximations is just an approximation, it can be negative under concurrency
+    // Chunks of MAP_HUGETLB regions cannot be unmapped one by one, so they are always kept.
+    //
+    size_t node = GetNumaNodeOfAddress(address);
+    if (likely(m_freeListSizeApproximations[node].load() <= static_cast<int>(x_maxChunksInMemoryPool) ||
+               m_hugePageMode == MemoryPoolHugePageMode::Explicit))
+    {
+        // enqueue() returns false if we run OOM
+        //
+        enqueued = m_freeLists[node].enqueue(address);
+    }
+    if (unlikely(!enqueued))
+    {
+        // Just unmap the memory
+        //
+        UnmapChunk(address);
+    }
+    else
+    {
+        m_freeListSizeApproximations[node].fetch_add(1);
+    }
+}
+
+void GlobalCodegenMemoryPool::UnmapChunk(uintptr_t address)
+{
+    int ret = munmap(reinterpret_cast<void*>(address), x_memoryChunkSize);
+    if (unlikely(ret != 0))
+    {
+        int err = errno;
+        fprintf(stderr, "[WARNING] [Memory Pool] munmap failed with error %d(%s)\n", err, strerror(err));
+        return;
+    }
+    m_numMappedChunks.fetch_sub(1, std::memory_order_relaxed);
+}
+
+uintptr_t GlobalCodegenMemoryPool::AllocateChunkFromOS(size_t node)
+{
+    if (m_hugePageMode == MemoryPoolHugePageMode::None)
+    {
+        void* mmapResult = mmap(nullptr, x_memoryChunkSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (mmapResult == MAP_FAILED)
+        {
+            ReleaseAssert(false && "Out Of Memory");
+        }
+        m_numMappedChunks.fetch_add(1, std::memory_order_relaxed);
+        return reinterpret_cast<uintptr_t>(mmapResult);
+    }
+
+    uintptr_t region = 0;
+    if (m_hugePageMode == MemoryPoolHugePageMode::Explicit)
+    {
+        void* mmapResult = mmap(nullptr, x_hugePageRegionSize, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+        if (mmapResult != MAP_FAILED)
+        {
+            region = reinterpret_cast<uintptr_t>(mmapResult);
+        }
+        else if (!m_hugePageFallbackWarned.exchange(true))
+        {
+            int err = errno;
+            fprintf(stderr, "[WARNING] [Memory Pool] mmap with MAP_HUGETLB failed with error %d(%s), "
+                            "falling back to transparent huge pages\n", err, strerror(err));
+        }
+    }
+    if (region == 0)
+    {
+        region = MapTransparentHugePageRegion();
+    }
+
+    // Keep the first chunk, and put the others into the free list
+    //
+    uintptr_t otherChunks[x_chunksPerHugePageRegion - 1];
+    for (size_t i = 1; i < x_chunksPerHugePageRegion; i++)
+    {
+        otherChunks[i - 1] = region + i * x_memoryChunkSize;
+    }
+    if (!m_freeLists[node].enqueue_bulk(otherChunks, x_chunksPerHugePageRegion - 1))
+    {
+        ReleaseAssert(false && "Out Of Memory");
+    }
+    m_freeListSizeApproximations[node].fetch_add(static_cast<int>(x_chunksPerHugePageRegion - 1));
+    m_numMappedChunks.fetch_add(x_chunksPerHugePageRegion, std::memory_order_relaxed);
+    return region;
+}
+
+uintptr_t GlobalCodegenMemoryPool::MapTransparentHugePageRegion()
+{
+    // Map twice the size, so we can cut out a region aligned to the huge page size
+    //
+    size_t mapSize = 2 * x_hugePageRegionSize;
+    void* mmapResult = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mmapResult == MAP_FAILED)
+    {
+        ReleaseAssert(false && "Out Of Memory");
+    }
+    uintptr_t start = reinterpret_cast<uintptr_t>(mmapResult);
+    uintptr_t region = (start + x_hugePageRegionSize - 1) & ~(x_hugePageRegionSize - 1);
+    uintptr_t regionEnd = region + x_hugePageRegionSize;
+    if (region > start)
+    {
+        ReleaseAssert(munmap(reinterpret_cast<void*>(start), region - start) == 0);
+    }
+    if (start + mapSize > regionEnd)
+    {
+        ReleaseAssert(munmap(reinterpret_cast<void*>(regionEnd), start + mapSize - regionEnd) == 0);
+    }
+
+    // It is fine if the kernel does not support transparent huge pages, we just get normal pages
+    //
+    std::ignore = madvise(reinterpret_cast<void*>(region), x_hugePageRegionSize, MADV_HUGEPAGE);
+
+    // Populate the region, as MAP_POPULATE does. With transparent huge pages this takes a single page fault.
+    // Unmapping a chunk of the region later splits the huge page, which the kernel handles.
+    //
+    for (uintptr_t address = region; address < regionEnd; address += 4096)
+    {
+        *reinterpret_cast<volatile uint8_t*>(address) = 0;
+    }
+    return region;
+}
+
+}   // namespace PochiVM
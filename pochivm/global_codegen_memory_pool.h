@@ -1,79 +1,413 @@
 #pragma once
 
+#include <new>
+#include <mutex>
+
 #include "concurrent_queue.h"
 
 namespace PochiVM
 {
 
+// How the memory of a GlobalCodegenMemoryPool is backed by the OS
+//
+enum class MemoryPoolHugePageMode
+{
+    // Each chunk is mmap'ed separately, backed by 4KB pages
+    //
+    None,
+    // Chunks are carved out of 2MB-aligned regions, which are madvise'd with MADV_HUGEPAGE,
+    // so the kernel backs them with transparent huge pages if it can
+    //
+    Transparent,
+    // Chunks are carved out of 2MB regions mmap'ed with MAP_HUGETLB. This requires huge pages to be reserved
+    // (/proc/sys/vm/nr_hugepages), and the default huge page size to be 2MB.
+    // Falls back to Transparent if no huge page is available. The memory is never returned to the OS.
+    //
+    Explicit
+};
+
+// Thrown when an allocation would exceed the memory limit of a memory pool or of an arena allocator.
+// It derives from std::bad_alloc: generated code unwinds as on any other out-of-memory error,
+// running the destructors of its C++ objects (so the arena allocators return their chunks),
+// and the C++ caller of the generated function may catch it.
+//
+class MemoryLimitExceededError : public std::bad_alloc
+{
+public:
+    MemoryLimitExceededError(size_t memoryLimit, size_t bytesInUse, size_t bytesRequested)
+        : m_memoryLimit(memoryLimit)
+        , m_bytesInUse(bytesInUse)
+        , m_bytesRequested(bytesRequested)
+    { }
+
+    const char* what() const noexcept override;
+
+    size_t m_memoryLimit;
+    size_t m_bytesInUse;
+    size_t m_bytesRequested;
+};
+
+// Out-of-line, so the runtime library bitcode only contains a call, not the exception object type
+//
+[[noreturn]] void ThrowMemoryLimitExceededError(size_t memoryLimit, size_t bytesInUse, size_t bytesRequested);
+
+// A snapshot of the counters of a GlobalCodegenMemoryPool.
+// The counters are updated independently, so under concurrency they may be slightly inconsistent with each other.
+//
+struct MemoryPoolStats
+{
+    // Memory handed out to the allocators: chunks in use plus large allocations
+    //
+    size_t m_bytesInUse;
+    size_t m_peakBytesInUse;
+    size_t m_numChunksInUse;
+    size_t m_numLargeAllocations;
+    size_t m_largeAllocationBytes;
+    // Chunks in the shared free lists (approximate), and chunks currently mapped from the OS
+    // (in use, free, or cached by threads)
+    //
+    size_t m_numFreeChunks;
+    size_t m_numMappedChunks;
+    // Freed large objects kept for reuse (approximate)
+    //
+    size_t m_cachedLargeObjectBytes;
+    // Total memory returned to the OS by Trim()
+    //
+    size_t m_trimmedBytes;
+    // 0 if unlimited
+    //
+    size_t m_memoryLimit;
+};
+
+// The counters of an arena allocator. Like the allocators, not thread-safe.
+//
+struct MemoryAllocatorStats
+{
+    // Memory held by the allocator: its chunks plus its large allocations.
+    // The peak is since the construction of the allocator, it is not reset by Reset().
+    //
+    size_t m_bytesInUse;
+    size_t m_peakBytesInUse;
+    size_t m_numChunks;
+    size_t m_numLargeAllocations;
+    size_t m_largeAllocationBytes;
+    // 0 if unlimited
+    //
+    size_t m_memoryLimit;
+};
+
+namespace internal
+{
+
+struct MemoryPoolThreadLocalCache;
+struct MemoryPoolTrimThread;
+
+}   // namespace internal
+
+// The pool of 256KB memory chunks used by the arena allocators (TempArenaAllocator and the like)
+//
+// GetMemoryChunk() and FreeMemoryChunk() are only called when an allocator needs a new chunk or is reset,
+// so they are defined out-of-line in global_codegen_memory_pool.cpp. This also keeps the thread-local cache out of
+// the runtime library bitcode, which may be inlined into generated code.
+//
 class GlobalCodegenMemoryPool
 {
 public:
     GlobalCodegenMemoryPool()
-        : m_freeListSizeApproximation(0)
-        , m_freeList()
+        : m_freeListSizeApproximations()
+        , m_freeLists()
+        , m_hugePageMode(MemoryPoolHugePageMode::None)
+        , m_isNumaAware(false)
+        , m_threadLocalCacheSize(0)
+        , m_hasAllocated(false)
+        , m_hugePageFallbackWarned(false)
+        , m_memoryLimit(0)
+        , m_bytesInUse(0)
+        , m_peakBytesInUse(0)
+        , m_numChunksInUse(0)
+        , m_numLargeAllocations(0)
+        , m_largeAllocationBytes(0)
+        , m_numMappedChunks(0)
+        , m_largeObjectFreeLists()
+        , m_largeObjectFreeListSizes()
+        , m_cachedLargeObjectBytes(0)
+        , m_trimTargetIdleBytes(x_defaultTrimTargetIdleBytes)
+        , m_trimDelayMillis(x_defaultTrimDelayMillis)
+        , m_isIdleAboveTarget(false)
+        , m_idleAboveTargetSinceMillis(0)
+        , m_trimmedBytes(0)
+        , m_trimMutex()
+        , m_trimThread(nullptr)
     { }
 
+    // Return the free chunks to the OS. The chunks cached by all threads are taken back first,
+    // so threads that have used the pool may outlive it, but must not use it anymore.
+    // The background trimming thread, if any, is stopped.
+    //
+    ~GlobalCodegenMemoryPool();
+
     // We allocate memory in 256KB chunks
     //
     static constexpr size_t x_memoryChunkSize = 256 * 1024;
 
-    // The maximum number of memory chunks we keep in the codegen memory pool
+    // The maximum number of memory chunks we keep in the codegen memory pool (in each NUMA node's free list if NUMA-aware)
     // We don't give memory back to OS before we reach the threshold
     //
     static constexpr size_t x_maxChunksInMemoryPool = 32 * 1024;
 
-    uintptr_t WARN_UNUSED GetMemoryChunk()
+    // The size of the regions chunks are carved from, when huge pages are used
+    //
+    static constexpr size_t x_hugePageRegionSize = 2 * 1024 * 1024;
+    static constexpr size_t x_chunksPerHugePageRegion = x_hugePageRegionSize / x_memoryChunkSize;
+
+    // NUMA nodes beyond this number share free lists
+    //
+    static constexpr size_t x_maxNumaNodes = 8;
+
+    static constexpr size_t x_maxThreadLocalCacheSize = 16;
+
+    // Large objects are allocations that do not fit in a chunk. They are rounded up to power-of-two size classes,
+    // starting at the chunk size, and each gets its own mmap'ed memory. Freed large objects of up to
+    // 2^x_maxCachedLargeObjectSizeLog2 bytes are kept in per-class free lists for reuse, up to
+    // x_maxCachedLargeObjectBytesPerSizeClass per class. Bigger ones are returned to the OS.
+    //
+    static constexpr size_t x_minLargeObjectSizeLog2 = 18;
+    static constexpr size_t x_maxCachedLargeObjectSizeLog2 = 26;
+    static constexpr size_t x_numCachedLargeObjectSizeClasses = x_maxCachedLargeObjectSizeLog2 - x_minLargeObjectSizeLog2 + 1;
+    static constexpr size_t x_maxCachedLargeObjectBytesPerSizeClass = 64 * 1024 * 1024;
+    static_assert(x_memoryChunkSize == (static_cast<size_t>(1) << x_minLargeObjectSizeLog2), "the smallest size class is a chunk");
+
+    // The memory actually taken by a large object of 'size' bytes
+    //
+    static constexpr size_t GetLargeObjectAllocationSize(size_t size)
     {
-        uintptr_t result;
-        bool success = m_freeList.try_dequeue(result /*out*/);
-        if (success)
+        if (size <= x_memoryChunkSize)
         {
-            m_freeListSizeApproximation.fetch_sub(1);
-            return result;
+            return x_memoryChunkSize;
         }
+        return static_cast<size_t>(1) << (64 - __builtin_clzll(size - 1));
+    }
 
-        void* mmapResult = mmap(nullptr, x_memoryChunkSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
-        if (mmapResult == MAP_FAILED)
-        {
-            ReleaseAssert(false && "Out Of Memory");
-        }
+    // The configuration setters below may only be called before the first chunk is allocated from the pool
+    //
+    void SetHugePageMode(MemoryPoolHugePageMode mode)
+    {
+        TestAssert(!m_hasAllocated.load(std::memory_order_relaxed));
+        m_hugePageMode = mode;
+    }
 
-        return reinterpret_cast<uintptr_t>(mmapResult);
+    // If true, each NUMA node has its own free list, so a chunk is only reused by threads
+    // running on the node its memory resides on. New chunks are populated by the allocating thread,
+    // so under the default first-touch policy their memory is on the node of that thread.
+    //
+    void SetNumaAware(bool value)
+    {
+        TestAssert(!m_hasAllocated.load(std::memory_order_relaxed));
+        m_isNumaAware = value;
     }
 
-    void FreeMemoryChunk(uintptr_t address)
+    // The maximum number of chunks each thread caches for the pool, 0 (the default) to disable the cache.
+    // With the cache, a thread that repeatedly gets and frees chunks rarely touches the shared free lists.
+    // A thread may cache chunks for at most 4 pools at the same time, other pools are used without the cache.
+    //
+    void SetThreadLocalCacheSize(size_t value)
     {
-        TestAssert(address % 4096 == 0);
-        bool enqueued = false;
-        // Important to cast x_maxChunksInMemoryPool to int, not the other way around:
-        // the m_freeListSizeApproximation is just an approximation, it can be negative under concurrency
-        //
-        if (likely(m_freeListSizeApproximation.load() <= static_cast<int>(x_maxChunksInMemoryPool)))
-        {
-            // enqueue() returns false if we run OOM
-            //
-            enqueued = m_freeList.enqueue(address);
-        }
-        if (unlikely(!enqueued))
-        {
-            // Just unmap the memory
-            //
-            int ret = munmap(reinterpret_cast<void*>(address), x_memoryChunkSize);
-            if (unlikely(ret != 0))
-            {
-                int err = errno;
-                fprintf(stderr, "[WARNING] [Memory Pool] munmap failed with error %d(%s)\n", err, strerror(err));
-            }
-        }
-        else
+        TestAssert(!m_hasAllocated.load(std::memory_order_relaxed));
+        TestAssert(value <= x_maxThreadLocalCacheSize);
+        m_threadLocalCacheSize = value;
+    }
+
+    // The limit on the memory handed out by the pool (see MemoryPoolStats::m_bytesInUse), 0 (the default) for no limit.
+    // GetMemoryChunk() and AddLargeAllocation() throw MemoryLimitExceededError if they would exceed it.
+    // Unlike the other settings, it may be changed at any time.
+    //
+    void SetMemoryLimit(size_t bytes)
+    {
+        m_memoryLimit.store(bytes, std::memory_order_relaxed);
+    }
+
+    uintptr_t WARN_UNUSED GetMemoryChunk();
+
+    void FreeMemoryChunk(uintptr_t address);
+
+    // The memory of a large object is page-aligned. Unlike chunks, it is not populated in advance,
+    // and it is not zero-filled if it is reused. Throws std::bad_alloc if the OS is out of memory.
+    // 'size' passed to FreeLargeObject() must be the one passed to GetLargeObject(), or have the same size class.
+    //
+    uintptr_t WARN_UNUSED GetLargeObject(size_t size);
+
+    void FreeLargeObject(uintptr_t address, size_t size);
+
+    MemoryPoolStats GetStats() const;
+
+    // The idle memory of the pool is its free chunks and its cached large objects. It is kept for reuse,
+    // so only Trim() returns it to the OS (apart from the x_maxChunksInMemoryPool bound on each free list).
+    // Trim() does so once the idle memory has stayed above 'targetIdleBytes' for 'delayMillis',
+    // keeping 'targetIdleBytes' of it. The idle memory is sampled when Trim() is called, so the delay is
+    // measured in calls: call it periodically (or use the background thread), and a workload that
+    // briefly frees a lot of memory between two calls keeps it.
+    // It may be changed at any time.
+    //
+    static constexpr size_t x_defaultTrimTargetIdleBytes = 64 * 1024 * 1024;
+    static constexpr uint64_t x_defaultTrimDelayMillis = 5000;
+
+    void SetTrimPolicy(size_t targetIdleBytes, uint64_t delayMillis)
+    {
+        m_trimTargetIdleBytes.store(targetIdleBytes, std::memory_order_relaxed);
+        m_trimDelayMillis.store(delayMillis, std::memory_order_relaxed);
+    }
+
+    // Apply the trim policy, or if 'ignoreDelay', trim down to the target right away.
+    // Cached large objects are unmapped first, then free chunks. The chunks cached by threads are not touched,
+    // and with MemoryPoolHugePageMode::Explicit free chunks are never returned.
+    // Returns the number of bytes returned to the OS. Thread-safe, and does not block the allocation paths.
+    //
+    size_t Trim(bool ignoreDelay = false);
+
+    // Start a low-priority thread calling Trim() every 'intervalMillis', until StopBackgroundTrimming()
+    // or the destruction of the pool
+    //
+    void StartBackgroundTrimming(uint64_t intervalMillis);
+    void StopBackgroundTrimming();
+
+    // Return the chunks cached by the current thread to the shared free lists.
+    // This happens automatically when the thread exits.
+    //
+    void FlushThreadLocalCache();
+
+private:
+    friend struct internal::MemoryPoolThreadLocalCache;
+
+    size_t GetCurrentNumaNode();
+    size_t GetNumaNodeOfAddress(uintptr_t address);
+    void RefillThreadLocalCache(uintptr_t* chunks, size_t* numChunks /*inout*/);
+    void ReturnChunksToSharedFreeList(uintptr_t* chunks, size_t* numChunks /*inout*/, size_t numToReturn);
+    uintptr_t WARN_UNUSED GetMemoryChunkFromSharedFreeList();
+    void ReturnChunkToSharedFreeList(uintptr_t address);
+    void UnmapChunk(uintptr_t address);
+    uintptr_t WARN_UNUSED AllocateChunkFromOS(size_t node);
+    static uintptr_t WARN_UNUSED MapTransparentHugePageRegion();
+    void AddBytesInUse(size_t size);
+    void AddLargeAllocation(size_t size);
+    void RemoveLargeAllocation(size_t size);
+    uintptr_t WARN_UNUSED MapLargeObject(size_t allocSize);
+    static void UnmapLargeObject(uintptr_t address, size_t allocSize);
+    size_t GetNumFreeChunks() const;
+    size_t GetIdleBytes() const;
+    size_t TrimLargeObjects(size_t bytesToTrim);
+    size_t TrimChunks(size_t bytesToTrim);
+
+    // The approximate size of each free list
+    //
+    std::atomic<int> m_freeListSizeApproximations[x_maxNumaNodes];
+    ConcurrentQueue<uintptr_t> m_freeLists[x_maxNumaNodes];
+    MemoryPoolHugePageMode m_hugePageMode;
+    bool m_isNumaAware;
+    size_t m_threadLocalCacheSize;
+    std::atomic<bool> m_hasAllocated;
+    std::atomic<bool> m_hugePageFallbackWarned;
+    std::atomic<size_t> m_memoryLimit;
+    std::atomic<size_t> m_bytesInUse;
+    std::atomic<size_t> m_peakBytesInUse;
+    std::atomic<size_t> m_numChunksInUse;
+    std::atomic<size_t> m_numLargeAllocations;
+    std::atomic<size_t> m_largeAllocationBytes;
+    std::atomic<size_t> m_numMappedChunks;
+    ConcurrentQueue<uintptr_t> m_largeObjectFreeLists[x_numCachedLargeObjectSizeClasses];
+    std::atomic<size_t> m_largeObjectFreeListSizes[x_numCachedLargeObjectSizeClasses];
+    std::atomic<size_t> m_cachedLargeObjectBytes;
+    std::atomic<size_t> m_trimTargetIdleBytes;
+    std::atomic<uint64_t> m_trimDelayMillis;
+    // Whether the idle memory was above the target when last sampled, and since when. Guarded by m_trimMutex.
+    //
+    bool m_isIdleAboveTarget;
+    uint64_t m_idleAboveTargetSinceMillis;
+    std::atomic<size_t> m_trimmedBytes;
+    std::mutex m_trimMutex;
+    internal::MemoryPoolTrimThread* m_trimThread;
+};
+
+// The memory accounting of an arena allocator, which the allocator updates as it gets chunks and makes large allocations.
+// The limit is checked before the memory is obtained, so the allocator is unchanged if MemoryLimitExceededError is thrown.
+//
+class MemoryAllocatorAccounting
+{
+public:
+    MemoryAllocatorAccounting()
+        : m_memoryLimit(0)
+        , m_numChunks(0)
+        , m_numLargeAllocations(0)
+        , m_largeAllocationBytes(0)
+        , m_peakBytesInUse(0)
+    { }
+
+    // 0 for no limit
+    //
+    void SetMemoryLimit(size_t bytes)
+    {
+        m_memoryLimit = bytes;
+    }
+
+    size_t GetBytesInUse() const
+    {
+        return m_numChunks * GlobalCodegenMemoryPool::x_memoryChunkSize + m_largeAllocationBytes;
+    }
+
+    void CheckMemoryLimit(size_t bytesRequested) const
+    {
+        if (unlikely(m_memoryLimit != 0 && GetBytesInUse() + bytesRequested > m_memoryLimit))
         {
-            m_freeListSizeApproximation.fetch_add(1);
+            ThrowMemoryLimitExceededError(m_memoryLimit, GetBytesInUse(), bytesRequested);
         }
     }
 
+    void AddChunk()
+    {
+        m_numChunks++;
+        UpdatePeak();
+    }
+
+    void AddLargeAllocation(size_t size)
+    {
+        m_numLargeAllocations++;
+        m_largeAllocationBytes += size;
+        UpdatePeak();
+    }
+
+    void RemoveLargeAllocation(size_t size)
+    {
+        TestAssert(m_numLargeAllocations > 0 && m_largeAllocationBytes >= size);
+        m_numLargeAllocations--;
+        m_largeAllocationBytes -= size;
+    }
+
+    // All chunks and large allocations have been freed
+    //
+    void Reset()
+    {
+        m_numChunks = 0;
+        m_numLargeAllocations = 0;
+        m_largeAllocationBytes = 0;
+    }
+
+    MemoryAllocatorStats GetStats() const
+    {
+        return MemoryAllocatorStats {
+            GetBytesInUse(), m_peakBytesInUse, m_numChunks, m_numLargeAllocations, m_largeAllocationBytes, m_memoryLimit
+        };
+    }
+
 private:
-    std::atomic<int> m_freeListSizeApproximation;
-    ConcurrentQueue<uintptr_t> m_freeList;
+    void UpdatePeak()
+    {
+        m_peakBytesInUse = std::max(m_peakBytesInUse, GetBytesInUse());
+    }
+
+    size_t m_memoryLimit;
+    size_t m_numChunks;
+    size_t m_numLargeAllocations;
+    size_t m_largeAllocationBytes;
+    size_t m_peakBytesInUse;
 };
 
 }   // namespace PochiVM
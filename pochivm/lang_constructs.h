@@ -5,6 +5,7 @@
 #include "pochivm_context.h"
 #include "ast_variable.h"
 #include "destructor_helper.h"
+#include "fastinterp_osr_entry.h"
 
 namespace PochiVM
 {
@@ -126,6 +127,8 @@ public:
         m_contents.push_back(stmt);
     }
 
+    std::vector<AstNodeBase*>& GetContents() { return m_contents; }
+
 private:
     std::vector<AstNodeBase*> m_contents;
 };
@@ -196,6 +199,8 @@ public:
         m_contents.push_back(stmt);
     }
 
+    std::vector<AstNodeBase*>& GetContents() { return m_contents; }
+
 private:
     std::vector<AstNodeBase*> m_contents;
 };
@@ -222,6 +227,12 @@ public:
         m_elseClause = elseClause;
     }
 
+    AstNodeBase* GetCondClause() const { return m_condClause; }
+    void SetCondClause(AstNodeBase* condClause)
+    {
+        TestAssert(condClause->GetTypeId().IsBool());
+        m_condClause = condClause;
+    }
     AstScope* GetThenClause() const { return m_thenClause; }
     AstScope* GetElseClause() const { return m_elseClause; }
 
@@ -274,6 +285,7 @@ public:
         : AstNodeBase(AstNodeType::AstWhileLoop, TypeId::Get<void>())
         , m_condClause(condClause)
         , m_body(body)
+        , m_fastInterpOsrEntry(nullptr)
     {
         TestAssert(m_condClause->GetTypeId().IsBool());
     }
@@ -334,9 +346,23 @@ public:
     virtual FastInterpSnippet WARN_UNUSED PrepareForFastInterp(FISpillLocation spillLoc) override final;
     virtual void FastInterpSetupSpillLocation() override final;
 
+    AstNodeBase* GetCondClause() const { return m_condClause; }
+    void SetCondClause(AstNodeBase* condClause)
+    {
+        TestAssert(condClause->GetTypeId().IsBool());
+        m_condClause = condClause;
+    }
+    AstScope* GetBody() const { return m_body; }
+
+    // If set, the back-edge of the loop in FastInterp is an on-stack-replacement point, see FastInterpOsrEntry
+    //
+    void SetFastInterpOsrEntry(FastInterpOsrEntry* osrEntry) { m_fastInterpOsrEntry = osrEntry; }
+    FastInterpOsrEntry* GetFastInterpOsrEntry() const { return m_fastInterpOsrEntry; }
+
 private:
     AstNodeBase* m_condClause;
     AstScope* m_body;
+    FastInterpOsrEntry* m_fastInterpOsrEntry;
 };
 
 // For-loop construct
@@ -353,6 +379,7 @@ public:
         , m_condClause(condClause)
         , m_stepClause(stepClause)
         , m_body(body)
+        , m_fastInterpOsrEntry(nullptr)
     {
         TestAssert(m_condClause->GetTypeId().IsBool());
     }
@@ -430,14 +457,26 @@ public:
     virtual void FastInterpSetupSpillLocation() override final;
 
     AstBlock* GetInitBlock() const { return m_startClause; }
+    AstNodeBase* GetCondClause() const { return m_condClause; }
+    void SetCondClause(AstNodeBase* condClause)
+    {
+        TestAssert(condClause->GetTypeId().IsBool());
+        m_condClause = condClause;
+    }
     AstScope* GetBody() const { return m_body; }
     AstBlock* GetStepBlock() const { return m_stepClause; }
 
+    // If set, the back-edge of the loop in FastInterp is an on-stack-replacement point, see FastInterpOsrEntry
+    //
+    void SetFastInterpOsrEntry(FastInterpOsrEntry* osrEntry) { m_fastInterpOsrEntry = osrEntry; }
+    FastInterpOsrEntry* GetFastInterpOsrEntry() const { return m_fastInterpOsrEntry; }
+
 private:
     AstBlock* m_startClause;
     AstNodeBase* m_condClause;
     AstBlock* m_stepClause;
     AstScope* m_body;
+    FastInterpOsrEntry* m_fastInterpOsrEntry;
 };
 
 // break/continue statement
@@ -483,4 +522,47 @@ private:
     bool m_isBreak;
 };
 
+// Returns whether the code after 'stmt' in the same statement list is unreachable, i.e. every path through 'stmt'
+// ends with a Return, or with a Break or Continue if 'treatBreakContinueAsTerminating'.
+// Loops are never looked into. This must agree with the reachability analysis in AstFunction::Validate().
+// In a validated function, anything after a terminating statement can only be empty blocks or scopes,
+// so a block or scope is terminating if any of its statements is.
+//
+inline bool WARN_UNUSED IsTerminatingStatement(AstNodeBase* stmt, bool treatBreakContinueAsTerminating)
+{
+    AstNodeType nodeType = stmt->GetAstNodeType();
+    if (nodeType == AstNodeType::AstReturnStmt)
+    {
+        return true;
+    }
+    else if (nodeType == AstNodeType::AstBreakOrContinueStmt)
+    {
+        return treatBreakContinueAsTerminating;
+    }
+    else if (nodeType == AstNodeType::AstBlock || nodeType == AstNodeType::AstScope)
+    {
+        std::vector<AstNodeBase*>& contents = (nodeType == AstNodeType::AstBlock) ?
+                    assert_cast<AstBlock*>(stmt)->GetContents() : assert_cast<AstScope*>(stmt)->GetContents();
+        for (AstNodeBase* s : contents)
+        {
+            if (IsTerminatingStatement(s, treatBreakContinueAsTerminating))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    else if (nodeType == AstNodeType::AstIfStatement)
+    {
+        AstIfStatement* ifStmt = assert_cast<AstIfStatement*>(stmt);
+        return ifStmt->HasElseClause() &&
+               IsTerminatingStatement(ifStmt->GetThenClause(), treatBreakContinueAsTerminating) &&
+               IsTerminatingStatement(ifStmt->GetElseClause(), treatBreakContinueAsTerminating);
+    }
+    else
+    {
+        return false;
+    }
+}
+
 }   // namespace PochiVM
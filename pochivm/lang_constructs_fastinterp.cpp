@@ -3,6 +3,7 @@
 #include "arith_expr.h"
 #include "logical_operator.h"
 #include "destructor_helper.h"
+#include "fastinterp_local_var_liveness.h"
 
 namespace PochiVM
 {
@@ -52,6 +53,7 @@ FastInterpSnippet WARN_UNUSED AstBlock::PrepareForFastInterp(FISpillLocation TES
         thread_pochiVMContext->m_fastInterpStackFrameManager->AssertNoTemp();
         FastInterpSnippet snippet = stmt->PrepareForFastInterp(x_FINoSpill);
         result = result.AddContinuation(snippet);
+        thread_pochiVMContext->m_fastInterpLocalVarLiveness->ReleaseAfterStatement(stmt);
     }
     thread_pochiVMContext->m_fastInterpStackFrameManager->AssertNoTemp();
     return result;
@@ -76,6 +78,7 @@ FastInterpSnippet WARN_UNUSED AstScope::PrepareForFastInterp(FISpillLocation TES
         thread_pochiVMContext->m_fastInterpStackFrameManager->AssertNoTemp();
         FastInterpSnippet snippet = stmt->PrepareForFastInterp(x_FINoSpill);
         result = result.AddContinuation(snippet);
+        thread_pochiVMContext->m_fastInterpLocalVarLiveness->ReleaseAfterStatement(stmt);
     }
     thread_pochiVMContext->m_fastInterpStackFrameManager->AssertNoTemp();
 
@@ -89,7 +92,7 @@ FastInterpSnippet WARN_UNUSED AstScope::PrepareForFastInterp(FISpillLocation TES
     for (auto rit = list.rbegin(); rit != list.rend(); rit++)
     {
         AstVariable* var = assert_cast<AstVariable*>(*rit);
-        thread_pochiVMContext->m_fastInterpStackFrameManager->PopLocalVar(var->GetTypeId().RemovePointer());
+        thread_pochiVMContext->m_fastInterpLocalVarLiveness->ReleaseAtScopeEnd(var);
     }
     return result;
 }
@@ -348,6 +351,23 @@ void AstWhileLoop::FastInterpSetupSpillLocation()
     m_body->FastInterpSetupSpillLocation();
 }
 
+// The back-edge of a loop that is an OSR point, see FastInterpOsrEntry.
+// Boilerplate placeholder 0 (the loop head) is left for the caller to populate.
+//
+static FastInterpBoilerplateInstance* WARN_UNUSED FIGenerateOsrBackEdge(FastInterpOsrEntry* osrEntry)
+{
+    AstFunction* fn = osrEntry->GetFunction();
+    TestAssert(fn == thread_llvmContext->m_curFunction);
+    TestAssert(fn->GetIsNoExceptForCodegen());
+    FastInterpBoilerplateInstance* inst = thread_pochiVMContext->m_fastInterpEngine->InstantiateBoilerplate(
+                FastInterpBoilerplateLibrary<FIOsrBackEdgeImpl>::SelectBoilerplateBluePrint(
+                    fn->GetReturnType().GetOneLevelPtrFastInterpTypeId()));
+    inst->PopulateConstantPlaceholder<uint64_t>(0, osrEntry->GetCounterVariable()->GetFastInterpOffset());
+    inst->PopulateConstantPlaceholder<uint64_t>(1, osrEntry->GetThreshold());
+    inst->PopulateConstantPlaceholder<uintptr_t*>(2, osrEntry->GetCompiledContinuationSlot());
+    return inst;
+}
+
 FastInterpSnippet WARN_UNUSED AstWhileLoop::PrepareForFastInterp(FISpillLocation TESTBUILD_ONLY(spillLoc))
 {
     TestAssert(spillLoc.IsNoSpill());
@@ -356,9 +376,18 @@ FastInterpSnippet WARN_UNUSED AstWhileLoop::PrepareForFastInterp(FISpillLocation
     FastInterpBoilerplateInstance* loopEntry = FIGetNoopBoilerplate();
     FastInterpBoilerplateInstance* afterLoop = FIGetNoopBoilerplate();
 
+    // If the loop is an OSR point, the back-edge (including 'continue') goes through the OSR check
+    //
+    FastInterpBoilerplateInstance* backEdge = loopEntry;
+    if (m_fastInterpOsrEntry != nullptr)
+    {
+        backEdge = FIGenerateOsrBackEdge(m_fastInterpOsrEntry);
+        backEdge->PopulateBoilerplateFnPtrPlaceholder(0, loopEntry);
+    }
+
     AutoScopedVarManagerFIBreakContinueTarget asvmfbct(afterLoop /*breakTarget*/,
                                                        m_body /*breakTargetScope*/,
-                                                       loopEntry /*continueTarget*/,
+                                                       backEdge /*continueTarget*/,
                                                        m_body /*continueTargetScope*/);
 
     FastInterpSnippet loopBody = m_body->PrepareForFastInterp(x_FINoSpill);
@@ -374,7 +403,7 @@ FastInterpSnippet WARN_UNUSED AstWhileLoop::PrepareForFastInterp(FISpillLocation
 
     if (!loopBody.IsUncontinuable())
     {
-        loopBody.m_tail->PopulateBoilerplateFnPtrPlaceholder(0, loopEntry);
+        loopBody.m_tail->PopulateBoilerplateFnPtrPlaceholder(0, backEdge);
     }
 
     loopEntry->SetAlignmentLog2(4);
@@ -457,7 +486,7 @@ FastInterpSnippet WARN_UNUSED AstForLoop::PrepareForFastInterp(FISpillLocation T
     for (auto rit = list.rbegin(); rit != list.rend(); rit++)
     {
         AstVariable* var = assert_cast<AstVariable*>(*rit);
-        thread_pochiVMContext->m_fastInterpStackFrameManager->PopLocalVar(var->GetTypeId().RemovePointer());
+        thread_pochiVMContext->m_fastInterpLocalVarLiveness->ReleaseAtScopeEnd(var);
     }
 
     // Now link everything together
@@ -470,7 +499,18 @@ FastInterpSnippet WARN_UNUSED AstForLoop::PrepareForFastInterp(FISpillLocation T
     {
         loopBody.m_tail->PopulateBoilerplateFnPtrPlaceholder(0, loopStep.m_entry);
     }
-    loopStep.m_tail->PopulateBoilerplateFnPtrPlaceholder(0, condClauseEntry);
+    if (m_fastInterpOsrEntry == nullptr)
+    {
+        loopStep.m_tail->PopulateBoilerplateFnPtrPlaceholder(0, condClauseEntry);
+    }
+    else
+    {
+        // The back-edge is after the step block, so it is also reached by 'continue'
+        //
+        FastInterpBoilerplateInstance* backEdge = FIGenerateOsrBackEdge(m_fastInterpOsrEntry);
+        backEdge->PopulateBoilerplateFnPtrPlaceholder(0, condClauseEntry);
+        loopStep.m_tail->PopulateBoilerplateFnPtrPlaceholder(0, backEdge);
+    }
 
     condClauseEntry->SetAlignmentLog2(4);
 
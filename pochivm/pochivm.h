@@ -5,6 +5,8 @@
 #include "api_lang_constructs.h"
 #include "api_function_proto.h"
 #include "api_throw_catch.h"
+#include "api_atomic.h"
+#include "api_bit_intrinsic.h"
 #include "generated/pochivm_runtime_headers.generated.h"
 #include "codegen_context.h"
 #include "codegen_arena_allocator.h"
@@ -10,19 +10,32 @@ class AstScope;
 class AstVariable;
 class AstModule;
 class FIStackFrameManager;
+class FILocalVarLiveness;
 class FastInterpCodegenEngine;
 class AstFunction;
 class AstCallExpr;
-class FastInterpGeneratedProgram;
 
+// Thread-safety model:
+//
+// All mutable codegen state lives in the thread-local contexts (this one, thread_llvmContext and thread_errorContext),
+// which each thread that builds modules must set up for itself. The data shared between threads is read-only
+// and initialized once per process: the C++ function metadata and bitcode, and the FastInterp boilerplate library,
+// are all generated at build time and only fixed up by static initializers. The global codegen memory pool is
+// thread-safe. So any number of threads may build their own modules concurrently without synchronization.
+//
+// A module is built by one thread at a time: the thread of which it is the current module (m_curModule).
+// A module may be handed to another thread by DetachModule() on the old thread and AttachModule() on the new one,
+// at any point of its construction. The module owns its AST and its FastInterp generated code, so both stay valid
+// after the handoff, and the FastInterp generated code may be executed by any thread.
+//
 struct PochiVMContext
 {
     PochiVMContext()
         : m_astTraverseColorMark(1)
         , m_debugInterpStackFrameBase(0)
         , m_fastInterpStackFrameManager(nullptr)
+        , m_fastInterpLocalVarLiveness(nullptr)
         , m_fastInterpEngine(nullptr)
-        , m_fastInterpGeneratedProgram(nullptr)
         , m_curModule(nullptr)
     { }
 
@@ -45,9 +58,12 @@ struct PochiVMContext
     ScopedVariableManager m_scopedVariableManager;
 
     FIStackFrameManager* m_fastInterpStackFrameManager;
+    FILocalVarLiveness* m_fastInterpLocalVarLiveness;
     FastInterpCodegenEngine* m_fastInterpEngine;
     std::vector<std::pair<AstFunction*, AstCallExpr*>> m_fastInterpFnCallFixList;
-    FastInterpGeneratedProgram* m_fastInterpGeneratedProgram;
+    // The (caller, callee) of each tail call that reuses the stack frame, see AstReturnStmt
+    //
+    std::vector<std::pair<AstFunction*, AstFunction*>> m_fastInterpTailCallList;
 
     // Current module
     //
@@ -9,7 +9,7 @@ uintptr_t GeneratedFunctionPointerImpl::GetControlValueForFastInterpFn(AstFuncti
     TestAssert(generatedFnAddress < (1ULL << 48));
     FIStackframeSizeCategory sfSizeCat = fn->GetFastInterpStackSizeCategory();
     uint64_t value = (1ULL << 62);
-    if (fn->GetIsNoExcept())
+    if (fn->GetIsNoExceptForCodegen())
     {
         value |= (1ULL << 61);
     }
@@ -3,6 +3,7 @@
 #include "common.h"
 #include "fastinterp/fastinterp_tpl_return_type.h"
 #include "fastinterp/fastinterp_tpl_stackframe_category.h"
+#include "fastinterp_interp_stack.h"
 
 namespace PochiVM
 {
@@ -39,12 +40,28 @@ public:
     R operator()(Args... args) const noexcept
     {
         TestAssert(m_fnPtr != nullptr);
-        uintptr_t sf = reinterpret_cast<uintptr_t>(alloca(m_stackframeSize));
+        // Use the interpreter stack if one is installed for this thread, otherwise allocate on C stack
+        //
+        FastInterpInterpStack* interpStack = thread_pochiVMFastInterpInterpStack;
+        if (likely(interpStack == nullptr))
+        {
+            uintptr_t sf = reinterpret_cast<uintptr_t>(alloca(m_stackframeSize));
+            return CallImpl(sf, args...);
+        }
+        else
+        {
+            FastInterpInterpStackFrameHolder holder(interpStack, m_stackframeSize);
+            return CallImpl(holder.Get(), args...);
+        }
+    }
+
+private:
+    R CallImpl(uintptr_t sf, Args... args) const noexcept
+    {
         PopulateParams(sf + 8, args...);
         return reinterpret_cast<R(*)(uintptr_t) noexcept>(m_fnPtr)(sf);
     }
 
-private:
     static void PopulateParams(uintptr_t /*sf*/) noexcept { }
 
     template<typename T, typename... TArgs>
@@ -80,7 +97,24 @@ public:
     R operator()(Args... args) const
     {
         TestAssert(m_fnPtr != nullptr);
-        uintptr_t sf = reinterpret_cast<uintptr_t>(alloca(m_stackframeSize));
+        // Use the interpreter stack if one is installed for this thread, otherwise allocate on C stack
+        //
+        FastInterpInterpStack* interpStack = thread_pochiVMFastInterpInterpStack;
+        if (likely(interpStack == nullptr))
+        {
+            uintptr_t sf = reinterpret_cast<uintptr_t>(alloca(m_stackframeSize));
+            return CallImpl(sf, args...);
+        }
+        else
+        {
+            FastInterpInterpStackFrameHolder holder(interpStack, m_stackframeSize);
+            return CallImpl(holder.Get(), args...);
+        }
+    }
+
+private:
+    R CallImpl(uintptr_t sf, Args... args) const
+    {
         PopulateParams(sf + 8, args...);
         if (m_isNoExcept)
         {
@@ -120,7 +154,6 @@ public:
         }
     }
 
-private:
     static void PopulateParams(uintptr_t /*sf*/) noexcept { }
 
     template<typename T, typename... TArgs>
@@ -203,6 +236,23 @@ public:
     static uintptr_t GetControlValueForFastInterpFn(AstFunction* fn, uintptr_t generatedFnAddress);
     static uintptr_t GetControlValueForDebugInterpFn(AstFunction* fn);
 
+    // Accessors for the decoded fields, used by DecodedGeneratedFunctionPointer
+    //
+    Kind GetKind() const
+    {
+        TestAssert(GetType() <= 2);
+        return static_cast<Kind>(GetType());
+    }
+
+    bool IsFastInterpNoExcept() const { return IsNoExcept(); }
+
+    uint32_t GetFastInterpStackFrameSize() const
+    {
+        return FIStackframeSizeCategoryHelper::GetSize(static_cast<FIStackframeSizeCategory>(GetStackFrameCategory()));
+    }
+
+    void* GetFunctionAddress() const { return reinterpret_cast<void*>(GetPointer()); }
+
 private:
     static void PopulateParams(uintptr_t /*sf*/) noexcept { }
 
@@ -276,4 +326,184 @@ private:
     uint64_t m_control;
 };
 
+// A GeneratedFunctionPointer with the control word decoded in advance.
+// Calling a GeneratedFunctionPointer decodes the control word and selects the execution mode on every call.
+// When the same function pointer is called many times from C++ (e.g. a comparator passed to std::sort),
+// construct this object once outside the loop instead, so each call is a direct call to the
+// LLVM function or the FastInterp entry point, with the FastInterp stack frame size pre-resolved.
+//
+template<bool isNoExcept, typename R, typename... Args>
+class DecodedGeneratedFunctionPointerImpl
+{
+public:
+    using Kind = GeneratedFunctionPointerImpl::Kind;
+
+    DecodedGeneratedFunctionPointerImpl() noexcept
+        : m_control(0)
+        , m_fnPtr(nullptr)
+        , m_kind(Kind::LLVM_MODE)
+        , m_fastInterpStackframeSize(0)
+        , m_isFastInterpNoExcept(false)
+    { }
+
+    DecodedGeneratedFunctionPointerImpl(uintptr_t control) noexcept
+        : m_control(control)
+    {
+        GeneratedFunctionPointerImpl impl(control);
+        m_kind = impl.GetKind();
+        m_fnPtr = impl.GetFunctionAddress();
+        if (m_kind == Kind::FAST_INTERP_MODE)
+        {
+            m_fastInterpStackframeSize = impl.GetFastInterpStackFrameSize();
+            m_isFastInterpNoExcept = impl.IsFastInterpNoExcept();
+            TestAssertImp(isNoExcept, m_isFastInterpNoExcept);
+        }
+        else
+        {
+            m_fastInterpStackframeSize = 0;
+            m_isFastInterpNoExcept = false;
+        }
+    }
+
+    R Call(Args... args) const noexcept(isNoExcept)
+    {
+        TestAssert(m_fnPtr != nullptr);
+        if (likely(m_kind == Kind::FAST_INTERP_MODE))
+        {
+            if constexpr(isNoExcept)
+            {
+                return FastInterpFunction<R(*)(Args...) noexcept>(m_fnPtr, m_fastInterpStackframeSize)(args...);
+            }
+            else
+            {
+                return FastInterpFunction<R(*)(Args...)>(m_fnPtr, m_fastInterpStackframeSize, m_isFastInterpNoExcept)(args...);
+            }
+        }
+        else if (m_kind == Kind::LLVM_MODE)
+        {
+            if constexpr(isNoExcept)
+            {
+                return reinterpret_cast<R(*)(Args...) noexcept>(m_fnPtr)(args...);
+            }
+            else
+            {
+                return reinterpret_cast<R(*)(Args...)>(m_fnPtr)(args...);
+            }
+        }
+        else
+        {
+            // DebugInterp mode is slow anyway, just go through the normal path
+            //
+            return GeneratedFunctionPointerImpl(m_control).Call<isNoExcept, R, Args...>(args...);
+        }
+    }
+
+    uintptr_t GetControlValue() const { return m_control; }
+
+private:
+    uintptr_t m_control;
+    void* m_fnPtr;
+    Kind m_kind;
+    uint32_t m_fastInterpStackframeSize;
+    bool m_isFastInterpNoExcept;
+};
+
+template<typename T>
+class DecodedGeneratedFunctionPointer;
+
+template<typename R, typename... Args>
+class DecodedGeneratedFunctionPointer<R(*)(Args...) noexcept>
+{
+public:
+    DecodedGeneratedFunctionPointer() noexcept : m_impl() { }
+
+    DecodedGeneratedFunctionPointer(uintptr_t control) noexcept
+        : m_impl(control)
+    { }
+
+    R operator()(Args... args) const noexcept
+    {
+        return m_impl.Call(args...);
+    }
+
+    uintptr_t GetControlValue() const { return m_impl.GetControlValue(); }
+
+private:
+    DecodedGeneratedFunctionPointerImpl<true /*isNoExcept*/, R, Args...> m_impl;
+};
+
+template<typename R, typename... Args>
+class DecodedGeneratedFunctionPointer<R(*)(Args...)>
+{
+public:
+    DecodedGeneratedFunctionPointer() noexcept : m_impl() { }
+
+    DecodedGeneratedFunctionPointer(uintptr_t control) noexcept
+        : m_impl(control)
+    { }
+
+    R operator()(Args... args) const
+    {
+        return m_impl.Call(args...);
+    }
+
+    uintptr_t GetControlValue() const { return m_impl.GetControlValue(); }
+
+private:
+    DecodedGeneratedFunctionPointerImpl<false /*isNoExcept*/, R, Args...> m_impl;
+};
+
+// A monomorphic inline cache for a C++ call site that calls generated function pointers.
+// The decoded form of the last seen control word is kept, so as long as the call site keeps seeing the
+// same target, each call only costs a compare in addition to the direct call. A different target
+// simply replaces the cached entry.
+//
+// Example:
+//    GeneratedFunctionPointerCallSite<FnPrototype> callSite;
+//    for (...) { callSite(fnPtr, args...); }
+//
+template<typename T>
+class GeneratedFunctionPointerCallSite
+{
+    static_assert(sizeof(T) == 0, "T must be a C function pointer");
+};
+
+template<typename R, typename... Args>
+class GeneratedFunctionPointerCallSite<R(*)(Args...) noexcept>
+{
+public:
+    GeneratedFunctionPointerCallSite() noexcept : m_cache() { }
+
+    R operator()(uintptr_t control, Args... args) noexcept
+    {
+        if (unlikely(control != m_cache.GetControlValue()))
+        {
+            m_cache = DecodedGeneratedFunctionPointer<R(*)(Args...) noexcept>(control);
+        }
+        return m_cache(args...);
+    }
+
+private:
+    DecodedGeneratedFunctionPointer<R(*)(Args...) noexcept> m_cache;
+};
+
+template<typename R, typename... Args>
+class GeneratedFunctionPointerCallSite<R(*)(Args...)>
+{
+public:
+    GeneratedFunctionPointerCallSite() noexcept : m_cache() { }
+
+    R operator()(uintptr_t control, Args... args)
+    {
+        if (unlikely(control != m_cache.GetControlValue()))
+        {
+            m_cache = DecodedGeneratedFunctionPointer<R(*)(Args...)>(control);
+        }
+        return m_cache(args...);
+    }
+
+private:
+    DecodedGeneratedFunctionPointer<R(*)(Args...)> m_cache;
+};
+
 }   //namespace PochiVM
@@ -8,6 +8,7 @@
 #include "reflective_stringify_helper.h"
 #include "ast_comparison_expr_type.h"
 #include "ast_arithmetic_expr_type.h"
+#include "cpp_function_attribute.h"
 
 namespace PochiVM
 {
@@ -963,6 +964,7 @@ struct RawFnTypeNamesInfo
           , m_isWrapperUsingSret(isWrapperUsingSret)
           , m_wrapperFnAddress(wrapperFnAddress)
           , m_isCopyCtorOrAssignmentOp(isCopyCtorOrAssignmentOp)
+          , m_attributes(CppFunctionAttribute::None)
     {
         if (!isUsingWrapper) { ReleaseAssert(!isWrapperUsingSret); }
     }
@@ -1008,6 +1010,9 @@ struct RawFnTypeNamesInfo
     // Whether this function is a copy constructor or assignment operator
     //
     bool m_isCopyCtorOrAssignmentOp;
+    // The hints given at registration on how generated code should call the function
+    //
+    CppFunctionAttribute m_attributes;
 };
 
 // get_raw_fn_typenames_info<t>::get()
@@ -1239,29 +1244,48 @@ void RegisterDestructorIfNeeded()
     }
 }
 
+// Internal helper: record the attributes given at registration, see cpp_function_attribute.h
+//
+inline void SetRegisteredFnAttributes(ReflectionHelper::RawFnTypeNamesInfo& info /*inout*/, CppFunctionAttribute attrs)
+{
+    const char* conflict = GetCppFunctionAttributeConflict(attrs, info.m_isUsingWrapper, info.m_isWrapperUsingSret);
+    if (conflict != nullptr)
+    {
+        fprintf(stderr, "Invalid attributes for function %s%s%s: %s\n",
+                (info.m_classTypename != nullptr ? info.m_classTypename : ""),
+                (info.m_classTypename != nullptr ? "::" : ""),
+                info.m_fnName, conflict);
+        abort();
+    }
+    info.m_attributes = attrs;
+}
+
 template<auto t>
-void RegisterFreeFn()
+void RegisterFreeFn(CppFunctionAttribute attrs = CppFunctionAttribute::None)
 {
     ReflectionHelper::RawFnTypeNamesInfo info =
             ReflectionHelper::get_raw_fn_typenames_info<t>::get(ReflectionHelper::FunctionType::FreeFn);
+    SetRegisteredFnAttributes(info, attrs);
     __pochivm_report_info__(&info);
     RegisterDestructorIfNeeded<t>();
 }
 
 template<auto t>
-void RegisterMemberFn()
+void RegisterMemberFn(CppFunctionAttribute attrs = CppFunctionAttribute::None)
 {
     ReflectionHelper::RawFnTypeNamesInfo info =
             ReflectionHelper::get_raw_fn_typenames_info<t>::get(ReflectionHelper::FunctionType::NonStaticMemberFn);
+    SetRegisteredFnAttributes(info, attrs);
     __pochivm_report_info__(&info);
     RegisterDestructorIfNeeded<t>();
 }
 
 template<auto t>
-void RegisterStaticMemberFn()
+void RegisterStaticMemberFn(CppFunctionAttribute attrs = CppFunctionAttribute::None)
 {
     ReflectionHelper::RawFnTypeNamesInfo info =
             ReflectionHelper::get_raw_fn_typenames_info<t>::get(ReflectionHelper::FunctionType::StaticMemberFn);
+    SetRegisteredFnAttributes(info, attrs);
     __pochivm_report_info__(&info);
     RegisterDestructorIfNeeded<t>();
 }
@@ -56,6 +56,10 @@ FastInterpBoilerplateInstance* WARN_UNUSED ScopedVariableManager::FIGenerateEHEn
     TestAssert(m_operationMode == OperationMode::FASTINTERP);
 
     TestAssert(m_scopeStack.size() > 0);
+    // A function inferred to never throw is generated with the noexcept convention,
+    // so it must not contain anything that requires an exception handling path.
+    //
+    TestAssert(!thread_llvmContext->m_curFunction->GetIsNoExceptInferred());
 
     if (m_fiCurrentEHCatchBlock == nullptr)
     {
@@ -83,6 +87,7 @@ FastInterpBoilerplateInstance* WARN_UNUSED ScopedVariableManager::FIGenerateEHEn
                             static_cast<FINumOpaqueIntegralParams>(0),
                             static_cast<FINumOpaqueFloatingParams>(0)));
         }
+        m_fiCurrentEHCatchBlock->MarkAsColdPathEntry();
     }
 
     if (GetNumNontrivialDestructorObjects() == 0 || thread_llvmContext->m_curFunction->GetIsNoExcept())
@@ -176,7 +181,9 @@ FastInterpBoilerplateInstance* WARN_UNUSED ScopedVariableManager::FIGenerateEHEn
         TestAssert(m_fiExceptionDtorTree[i].first == static_cast<int>(m_scopeStack[i].second.size()));
     }
 #endif
-    return m_fiExceptionDtorTree.back().second;
+    FastInterpBoilerplateInstance* ret = m_fiExceptionDtorTree.back().second;
+    ret->MarkAsColdPathEntry();
+    return ret;
 }
 #pragma clang diagnostic pop    // for "-Wno-sign-conversion"
 
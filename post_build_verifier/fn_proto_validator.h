@@ -150,7 +150,7 @@ struct validate_bc_code
         ReleaseAssert(bitcode != nullptr);
         SMDiagnostic llvmErr;
         std::unique_ptr<LLVMContext> context(new LLVMContext);
-        MemoryBufferRef mb(StringRef(reinterpret_cast<const char*>(bitcode->m_bitcode), bitcode->m_length),
+        MemoryBufferRef mb(StringRef(reinterpret_cast<const char*>(bitcode->GetBitcode()), bitcode->m_length),
                            StringRef(bitcode->m_symbolName));
         std::unique_ptr<Module> module = parseIR(mb, llvmErr, *context.get());
         if (module == nullptr)
@@ -46,7 +46,7 @@ static void FindAllSymbols(const PochiVM::BitcodeData* bitcode,
     // these are symbols that might potentially be resolved to the host process.
     //
     SMDiagnostic llvmErr;
-    MemoryBufferRef mb(StringRef(reinterpret_cast<const char*>(bitcode->m_bitcode), bitcode->m_length),
+    MemoryBufferRef mb(StringRef(reinterpret_cast<const char*>(bitcode->GetBitcode()), bitcode->m_length),
                        StringRef(bitcode->m_symbolName));
     std::unique_ptr<LLVMContext> context(new LLVMContext);
     std::unique_ptr<Module> module = parseIR(mb, llvmErr, *context.get());
@@ -2,6 +2,7 @@
 
 #include "pochivm/common.h"
 #include "pochivm/global_codegen_memory_pool.h"
+#include "pochivm/arena_allocator_impl.h"
 #include "pochivm/pochivm_function_pointer.h"
 
 namespace MiniDbBackend
@@ -122,97 +123,56 @@ extern PochiVM::GlobalCodegenMemoryPool g_queryExecutionMemoryPool;
 class QueryExecutionTempAllocator
 {
 public:
-    QueryExecutionTempAllocator()
-        : m_listHead(0)
-        , m_currentAddress(8)
-        , m_currentAddressEnd(0)
-        , m_largeAllocationHead(0)
-    { }
-
-    ~QueryExecutionTempAllocator()
-    {
-        FreeAllMemoryChunks();
-    }
-
     void Reset()
     {
-        FreeAllMemoryChunks();
+        m_impl.Reset();
     }
 
-    uintptr_t Allocate(size_t size)
+    // Allocate() throws PochiVM::MemoryLimitExceededError if the allocator would hold more than 'bytes' of memory,
+    // 0 (the default) for no limit. The error unwinds out of the generated query, see MemoryLimitExceededError.
+    //
+    void SetMemoryLimit(size_t bytes)
     {
-        size_t alignment = 8;
-        if (size > g_queryExecutionMemoryPool.x_memoryChunkSize - 4096)
-        {
-            char* buf = new char[size + 8];
-            *reinterpret_cast<uintptr_t*>(buf) = m_largeAllocationHead;
-            m_largeAllocationHead = reinterpret_cast<uintptr_t>(buf);
-            return reinterpret_cast<uintptr_t>(buf) + 8;
-        }
-        AlignCurrentAddress(alignment);
-        if (m_currentAddress + size > m_currentAddressEnd)
-        {
-            GetNewMemoryChunk();
-            AlignCurrentAddress(alignment);
-            TestAssert(m_currentAddress + size <= m_currentAddressEnd);
-        }
-        TestAssert(m_currentAddress % alignment == 0);
-        uintptr_t result = m_currentAddress;
-        m_currentAddress += size;
-        TestAssert(m_currentAddress <= m_currentAddressEnd);
-        return result;
+        m_impl.SetMemoryLimit(bytes);
     }
 
-private:
-    void GetNewMemoryChunk()
+    PochiVM::MemoryAllocatorStats GetStats() const
     {
-        uintptr_t address = g_queryExecutionMemoryPool.GetMemoryChunk();
-        AppendToList(address);
-        // the first 8 bytes of the region is used as linked list
-        //
-        m_currentAddress = address + 8;
-        m_currentAddressEnd = address + g_queryExecutionMemoryPool.x_memoryChunkSize;
+        return m_impl.GetStats();
     }
 
-    void AlignCurrentAddress(size_t alignment)
+    // Allocations larger than this are large objects, which get their own memory from the pool
+    //
+    static constexpr size_t x_maxSmallAllocationSize =
+            PochiVM::ArenaAllocatorImpl<g_queryExecutionMemoryPool>::x_maxSmallAllocationSize;
+
+    uintptr_t Allocate(size_t size)
     {
-        size_t mask = alignment - 1;
-        m_currentAddress += mask;
-        m_currentAddress &= ~mask;
+        return m_impl.Allocate(8 /*alignment*/, size);
     }
 
-    void AppendToList(uintptr_t address)
+    // 'size' must be the size 'address' was allocated (or last reallocated) with.
+    // A large object is returned to the pool. Otherwise the memory is only reclaimed right away
+    // if it is the last allocation, and by Reset() if not.
+    //
+    void Free(uintptr_t address, size_t size)
     {
-        *reinterpret_cast<uintptr_t*>(address) = m_listHead;
-        m_listHead = address;
+        m_impl.Free(address, size);
     }
 
-    void FreeAllMemoryChunks()
+    // Resize an allocation, 'oldSize' must be the size 'address' was allocated (or last reallocated) with.
+    // The last allocation is resized in place if its chunk has room, and a large object if it stays in its size class.
+    // Otherwise the contents are moved to a new allocation, and 'address' is freed as by Free().
+    //
+    uintptr_t Reallocate(uintptr_t address, size_t oldSize, size_t newSize)
     {
-        while (m_largeAllocationHead != 0)
-        {
-            uintptr_t next = *reinterpret_cast<uintptr_t*>(m_largeAllocationHead);
-            char* c = reinterpret_cast<char*>(m_largeAllocationHead);
-            delete [] c;
-            m_largeAllocationHead = next;
-        }
-        while (m_listHead != 0)
-        {
-            uintptr_t next = *reinterpret_cast<uintptr_t*>(m_listHead);
-            g_queryExecutionMemoryPool.FreeMemoryChunk(m_listHead);
-            m_listHead = next;
-        }
-        m_currentAddress = 8;
-        m_currentAddressEnd = 0;
+        return m_impl.Reallocate(address, 8 /*alignment*/, oldSize, newSize);
     }
 
-    uintptr_t m_listHead;
-    uintptr_t m_currentAddress;
-    uintptr_t m_currentAddressEnd;
-    uintptr_t m_largeAllocationHead;
+private:
+    PochiVM::ArenaAllocatorImpl<g_queryExecutionMemoryPool> m_impl;
 };
 
-
 inline size_t HashString(char* input)
 {
     size_t result = 0;
@@ -238,26 +198,29 @@ inline int CompareString(char* input1, char* input2)
 
 // TODO: the generated header file still has some name resolution issue, workaround for now
 //
+// The generated function pointers are decoded once on construction,
+// so the hash table and std::sort do not pay for decoding the control word on every call.
+//
 struct GeneratedKeyCmpFnOperator
 {
     using KeyType = uintptr_t;
+    using FnPrototype = bool(*)(KeyType, KeyType) noexcept;
     bool operator()(const KeyType& lhs, const KeyType& rhs) const
     {
-        using FnPrototype = bool(*)(KeyType, KeyType) noexcept;
-        return PochiVM::GeneratedFunctionPointer<FnPrototype>(m_cmpFn)(lhs, rhs);
+        return m_cmpFn(lhs, rhs);
     }
-    uintptr_t m_cmpFn;
+    PochiVM::DecodedGeneratedFunctionPointer<FnPrototype> m_cmpFn;
 };
 
 struct GeneratedKeyHashFnOperator
 {
     using KeyType = uintptr_t;
+    using FnPrototype = size_t(*)(KeyType) noexcept;
     size_t operator()(const KeyType& k) const
     {
-        using FnPrototype = size_t(*)(KeyType) noexcept;
-        return PochiVM::GeneratedFunctionPointer<FnPrototype>(m_hashFn)(k);
+        return m_hashFn(k);
     }
-    uintptr_t m_hashFn;
+    PochiVM::DecodedGeneratedFunctionPointer<FnPrototype> m_hashFn;
 };
 
 namespace MiniDbBackend
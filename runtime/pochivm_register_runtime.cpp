@@ -12,13 +12,16 @@ static void RegisterRuntimeLibrary()
     // ****************************************
     // Register the list of functions callable from generated code, using the APIs below.
     //
-    //    void RegisterFreeFn<function pointer>()
-    //    void RegisterMemberFn<member function pointer>()
-    //    void RegisterStaticMemberFn<member function pointer>()
+    //    void RegisterFreeFn<function pointer>(optional CppFunctionAttribute)
+    //    void RegisterMemberFn<member function pointer>(optional CppFunctionAttribute)
+    //    void RegisterStaticMemberFn<member function pointer>(optional CppFunctionAttribute)
     //    void RegisterMemberObject<member object pointer>()
     //    void RegisterConstructor<ClassName, ArgTypeNames...>()
     //    void RegisterExceptionObjectType<Type>()
     //
+    // The optional CppFunctionAttribute tells the code generators how to call the function from generated code,
+    // e.g. always inline it, or never import its bitcode. See pochivm/cpp_function_attribute.h.
+    //
     // While you may write any logic you like, keep in mind that you will get a segfault if you try to
     // call functions or access global values which implementations reside in other CPP files.
     // E.g. suppose implementation of function 'f' is not in this file.
@@ -152,6 +155,13 @@ static void RegisterRuntimeLibrary()
 
     RegisterFreeFn<&TestNoExceptButThrows>();
 
+    RegisterFreeFn<&TestCppFnAttributes::Square>(CppFunctionAttribute::AlwaysInline | CppFunctionAttribute::Pure);
+    RegisterFreeFn<&TestCppFnAttributes::SumArray>(CppFunctionAttribute::ReadOnly | CppFunctionAttribute::Hot);
+    RegisterFreeFn<&TestCppFnAttributes::ReportError>(CppFunctionAttribute::Cold);
+    RegisterFreeFn<&TestCppFnAttributes::NegateNarrow>(CppFunctionAttribute::AddressOnly);
+    RegisterFreeFn<&TestCppFnAttributes::IsOddNarrow>(CppFunctionAttribute::AddressOnly);
+    RegisterFreeFn<&TestCppFnAttributes::RepeatX>(CppFunctionAttribute::AddressOnly);
+
     RegisterExceptionObjectType<int>();
     RegisterExceptionObjectType<int*****>();
     RegisterExceptionObjectType<int*>();
@@ -253,6 +263,9 @@ static void RegisterRuntimeLibrary()
     RegisterConstructor<MiniDbBackend::QueryExecutionTempAllocator>();
     RegisterMemberFn<&MiniDbBackend::QueryExecutionTempAllocator::Allocate>();
     RegisterMemberFn<&MiniDbBackend::QueryExecutionTempAllocator::Reset>();
+    RegisterMemberFn<&MiniDbBackend::QueryExecutionTempAllocator::Free>();
+    RegisterMemberFn<&MiniDbBackend::QueryExecutionTempAllocator::Reallocate>();
+    RegisterMemberFn<&MiniDbBackend::QueryExecutionTempAllocator::SetMemoryLimit>();
 
     RegisterConstructor<TestGeneratedFnPtr, uintptr_t>();
     RegisterMemberFn<&TestGeneratedFnPtr::execute>();
@@ -15,3 +15,29 @@ void FreeFunctionStoreValue(int* dst, int src)
     *dst = src;
 }
 
+
+namespace TestCppFnAttributes
+{
+
+void ReportError(int* counter, int code)
+{
+    *counter += code;
+}
+
+int8_t NegateNarrow(int8_t x, uint16_t y, bool negate)
+{
+    int8_t r = static_cast<int8_t>(x + static_cast<int8_t>(y));
+    return negate ? static_cast<int8_t>(-r) : r;
+}
+
+bool IsOddNarrow(int16_t x)
+{
+    return (x & 1) != 0;
+}
+
+std::string RepeatX(int n)
+{
+    return std::string(static_cast<size_t>(n), 'x');
+}
+
+}
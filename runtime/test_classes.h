@@ -174,3 +174,43 @@ inline void VoidStarParamTest2(void*& a, void** b)
 }
 
 }
+
+// Functions registered with CppFunctionAttribute hints
+//
+namespace TestCppFnAttributes
+{
+
+// AlwaysInline | Pure
+//
+inline int64_t Square(int64_t x) noexcept
+{
+    return x * x;
+}
+
+// ReadOnly | Hot
+//
+inline int64_t SumArray(int64_t* arr, int n)
+{
+    int64_t sum = 0;
+    for (int i = 0; i < n; i++)
+    {
+        sum += arr[i];
+    }
+    return sum;
+}
+
+// Cold
+//
+void ReportError(int* counter, int code);
+
+// AddressOnly. The narrow integer and bool parameters and return values
+// check the ABI attributes of the declaration built without bitcode.
+//
+int8_t NegateNarrow(int8_t x, uint16_t y, bool negate);
+bool IsOddNarrow(int16_t x);
+
+// AddressOnly, returns a C++ object
+//
+std::string RepeatX(int n);
+
+}
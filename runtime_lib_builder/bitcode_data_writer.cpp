@@ -0,0 +1,78 @@
+#include "runtime_lib_builder/bitcode_data_writer.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Compression.h"
+#include "llvm/Support/Error.h"
+
+using namespace llvm;
+
+static void PrintByteArray(FILE* fp, const uint8_t* data, size_t length)
+{
+    fprintf(fp, "{\n    ");
+    for (size_t i = 0; i < length; i++)
+    {
+        uint8_t value = data[i];
+        fprintf(fp, "%d", value);
+        if (i + 1 != length)
+        {
+            fprintf(fp, ", ");
+            if (i % 16 == 15)
+            {
+                fprintf(fp, "\n    ");
+            }
+        }
+    }
+    fprintf(fp, "\n};\n\n");
+}
+
+void PrintBitcodeDataDefinitionOrDie(FILE* fp,
+                                     const std::string& resVarname,
+                                     const std::string& symbolNameExpr,
+                                     const uint8_t* bitcodeRawData,
+                                     size_t bitcodeSize)
+{
+    ReleaseAssert(bitcodeRawData[bitcodeSize] == 0);
+    std::string bitcodeDataVarname = resVarname + "_bitcode_data";
+
+    size_t compressedSize = 0;
+    if (OPTION_COMPRESS_RUNTIME_BITCODE)
+    {
+        if (!zlib::isAvailable())
+        {
+            fprintf(stderr, "[ERROR] POCHIVM_COMPRESS_RUNTIME_BITCODE is set, but LLVM is built without zlib support. "
+                            "Rebuild LLVM with zlib, or turn off the option.\n");
+            abort();
+        }
+        SmallVector<char, 0> compressed;
+        Error err = zlib::compress(StringRef(reinterpret_cast<const char*>(bitcodeRawData), bitcodeSize),
+                                   compressed /*out*/);
+        if (err)
+        {
+            fprintf(stderr, "Failed to compress bitcode for '%s': %s\n",
+                    resVarname.c_str(), toString(std::move(err)).c_str());
+            abort();
+        }
+        compressedSize = compressed.size();
+        ReleaseAssert(compressedSize > 0);
+
+        // Put all the compressed stubs into one section, so they are not interleaved with the hot read-only data.
+        // The pages of the section are never touched unless the stub is decompressed.
+        //
+        fprintf(fp, "__attribute__((section(\"pochivm_compressed_bc\")))\n");
+        fprintf(fp, "const uint8_t %s[%d] = ", bitcodeDataVarname.c_str(), static_cast<int>(compressedSize));
+        PrintByteArray(fp, reinterpret_cast<const uint8_t*>(compressed.data()), compressedSize);
+    }
+    else
+    {
+        fprintf(fp, "const uint8_t %s[%d] = ", bitcodeDataVarname.c_str(), static_cast<int>(bitcodeSize + 1));
+        PrintByteArray(fp, bitcodeRawData, bitcodeSize + 1);
+    }
+
+    fprintf(fp, "const BitcodeData %s = {\n", resVarname.c_str());
+    fprintf(fp, "    %s,\n", symbolNameExpr.c_str());
+    fprintf(fp, "    %s,\n", bitcodeDataVarname.c_str());
+    fprintf(fp, "    %d,\n", static_cast<int>(bitcodeSize));
+    fprintf(fp, "    %d /*compressedLength*/,\n", static_cast<int>(compressedSize));
+    fprintf(fp, "    nullptr /*decompressedBitcode*/\n};\n");
+}
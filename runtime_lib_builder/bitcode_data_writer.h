@@ -0,0 +1,23 @@
+#pragma once
+
+#include "pochivm/common.h"
+
+// Whether the bitcode stubs are stored compressed in the runtime library.
+// See comments in pochivm/bitcode_data.h.
+//
+#ifdef POCHIVM_COMPRESS_RUNTIME_BITCODE
+const static bool OPTION_COMPRESS_RUNTIME_BITCODE = true;
+#else
+const static bool OPTION_COMPRESS_RUNTIME_BITCODE = false;
+#endif
+
+// Print the definition of the BitcodeData object 'resVarname' (and the array holding its data)
+// into a generated 'bc.*.data.h' header file.
+// 'symbolNameExpr' is printed as-is as the expression initializing BitcodeData::m_symbolName.
+// 'bitcodeRawData' must have a trailing '\0' after its 'bitcodeSize' bytes.
+//
+void PrintBitcodeDataDefinitionOrDie(FILE* fp,
+                                     const std::string& resVarname,
+                                     const std::string& symbolNameExpr,
+                                     const uint8_t* bitcodeRawData,
+                                     size_t bitcodeSize);
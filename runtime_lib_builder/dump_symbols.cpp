@@ -4,6 +4,7 @@
 #include "pochivm/common.h"
 #include "pochivm/pochivm_reflection_helper.h"
 #include "runtime_lib_builder/symbol_list_util.h"
+#include "runtime_lib_builder/bitcode_data_writer.h"
 #include "pochivm/ir_special_function_patch.h"
 
 #include "reflective_stringify_parser.h"
@@ -139,6 +140,7 @@ struct ParsedFnTypeNamesInfo
         m_isWrapperUsingSret = src->m_isWrapperUsingSret;
         m_wrapperFnAddress = src->m_wrapperFnAddress;
         m_isCopyCtorOrAssignmentOp = src->m_isCopyCtorOrAssignmentOp;
+        m_attributes = src->m_attributes;
 
         if (m_prefix != "")
         {
@@ -353,6 +355,7 @@ struct ParsedFnTypeNamesInfo
     void* m_wrapperFnAddress;
     std::string m_wrapperFnMangledSymbolName;
     bool m_isCopyCtorOrAssignmentOp;
+    PochiVM::CppFunctionAttribute m_attributes;
 };
 
 static std::map<void*, ParsedFnTypeNamesInfo> g_symbolAddrToTypeData;
@@ -457,6 +460,7 @@ static bool CmpParsedFnTypeNamesInfo(const ParsedFnTypeNamesInfo& a, const Parse
     if (a.m_isWrapperUsingSret != b.m_isWrapperUsingSret) { return a.m_isWrapperUsingSret < b.m_isWrapperUsingSret; }
     if (a.m_wrapperFnAddress != b.m_wrapperFnAddress) { return a.m_wrapperFnAddress < b.m_wrapperFnAddress; }
     if (a.m_isCopyCtorOrAssignmentOp != b.m_isCopyCtorOrAssignmentOp) { return a.m_isCopyCtorOrAssignmentOp < b.m_isCopyCtorOrAssignmentOp; }
+    if (a.m_attributes != b.m_attributes) { return a.m_attributes < b.m_attributes; }
     return a.m_wrapperFnMangledSymbolName < b.m_wrapperFnMangledSymbolName;
 }
 
@@ -499,6 +503,35 @@ static void PrintFnTemplateParams(FILE* fp, const ParsedFnTypeNamesInfo& info)
 
 static int g_curUniqueFunctionOrdinal = 0;
 
+// For each unique function ordinal, the expression giving its CppFunctionMetadata in the generated headers
+//
+static std::vector<std::string> g_cppFnMetadataExprs;
+
+// The metadata of each registered C++ function (other than destructors, see DestructorCppFnMetadata) is
+// defined in a specialization of 'CppFnMetadata<uniqueFunctionOrdinal>' in a header of its own, instead of in the
+// generated API function, so that the metadata can also be found by ordinal (see AstCppFunctionMetadataTable).
+// The class is opened before printing the metadata, which must be named '__pochivm_cpp_fn_metadata'.
+//
+static void PrintCppFnMetadataClassBegin(FILE* mp)
+{
+    fprintf(mp, "template<> class CppFnMetadata<%d> {\nprivate:\n", g_curUniqueFunctionOrdinal);
+}
+
+// Close the class opened by PrintCppFnMetadataClassBegin(), after the metadata has been printed
+// (which also incremented g_curUniqueFunctionOrdinal). Returns the expression giving the metadata.
+//
+static std::string PrintCppFnMetadataClassEnd(FILE* mp)
+{
+    int ordinal = g_curUniqueFunctionOrdinal - 1;
+    fprintf(mp, "public:\n");
+    fprintf(mp, "    static constexpr const CppFunctionMetadata* value = &__pochivm_cpp_fn_metadata;\n");
+    fprintf(mp, "};\n\n");
+    std::string expr = std::string("CppFnMetadata<") + std::to_string(ordinal) + ">::value";
+    ReleaseAssert(g_cppFnMetadataExprs.size() == static_cast<size_t>(ordinal));
+    g_cppFnMetadataExprs.push_back(expr);
+    return expr;
+}
+
 static void PrintValidateFnPrototype(FILE* fp,
                                      const std::vector<std::string>& params,
                                      const std::string& ret,
@@ -512,12 +545,13 @@ static void PrintValidateFnPrototype(FILE* fp,
     fprintf(fp, ">::Check(&%s);\n", varname.c_str());
 }
 
-static void PrintFnCallBody(FILE* fp, FILE* gp, const ParsedFnTypeNamesInfo& info)
+static void PrintFnCallBody(FILE* fp, FILE* mp, FILE* gp, const ParsedFnTypeNamesInfo& info)
 {
     ReleaseAssert(info.m_fnType != PochiVM::ReflectionHelper::FunctionType::Constructor &&
                   info.m_fnType != PochiVM::ReflectionHelper::FunctionType::Destructor &&
                   info.m_fnType != PochiVM::ReflectionHelper::FunctionType::NonStaticMemberObject);
     fprintf(fp, "{\n");
+    PrintCppFnMetadataClassBegin(mp);
     int numParams = static_cast<int>(info.m_params.size());
     if (info.m_fnType == PochiVM::ReflectionHelper::FunctionType::NonStaticMemberFn)
     {
@@ -525,19 +559,19 @@ static void PrintFnCallBody(FILE* fp, FILE* gp, const ParsedFnTypeNamesInfo& inf
     }
     std::vector<std::string> cppParams;
     std::string cppRet;
-    fprintf(fp, "    static constexpr TypeId __pochivm_cpp_fn_params[%d] = {", numParams);
+    fprintf(mp, "    static constexpr TypeId __pochivm_cpp_fn_params[%d] = {", numParams);
     if (info.m_fnType == PochiVM::ReflectionHelper::FunctionType::NonStaticMemberFn)
     {
         std::string s = std::string("typename std::add_pointer<") + info.m_prefix + ">::type";
         cppParams.push_back(s);
-        fprintf(fp, "\n        TypeId::Get<%s>()", s.c_str());
+        fprintf(mp, "\n        TypeId::Get<%s>()", s.c_str());
         if (info.m_params.size() > 0)
         {
-            fprintf(fp, ",");
+            fprintf(mp, ",");
         }
         else
         {
-            fprintf(fp, "\n    ");
+            fprintf(mp, "\n    ");
         }
     }
     for (size_t i = 0; i < info.m_params.size(); i++)
@@ -552,17 +586,17 @@ static void PrintFnCallBody(FILE* fp, FILE* gp, const ParsedFnTypeNamesInfo& inf
             s = info.m_params[i];
         }
         cppParams.push_back(s);
-        fprintf(fp, "\n        TypeId::Get<%s>()", s.c_str());
+        fprintf(mp, "\n        TypeId::Get<%s>()", s.c_str());
         if (i != info.m_params.size() - 1)
         {
-            fprintf(fp, ",");
+            fprintf(mp, ",");
         }
         else
         {
-            fprintf(fp, "\n    ");
+            fprintf(mp, "\n    ");
         }
     }
-    fprintf(fp, "};\n");
+    fprintf(mp, "};\n");
     {
         std::string s;
         if (info.m_isRetApiVar)
@@ -573,103 +607,103 @@ static void PrintFnCallBody(FILE* fp, FILE* gp, const ParsedFnTypeNamesInfo& inf
         {
             s = info.m_ret;
         }
-        fprintf(fp, "    static constexpr TypeId __pochivm_cpp_fn_ret = TypeId::Get<%s>();\n", s.c_str());
+        fprintf(mp, "    static constexpr TypeId __pochivm_cpp_fn_ret = TypeId::Get<%s>();\n", s.c_str());
         cppRet = s;
     }
 
     if (info.m_fnType == PochiVM::ReflectionHelper::FunctionType::NonStaticMemberFn)
     {
-        fprintf(fp, "    using __pochivm_func_t = %s(%s::*)(", info.m_origRet.c_str(), info.m_prefix.c_str());
+        fprintf(mp, "    using __pochivm_func_t = %s(%s::*)(", info.m_origRet.c_str(), info.m_prefix.c_str());
     }
     else
     {
-        fprintf(fp, "    using __pochivm_func_t = %s(*)(", info.m_origRet.c_str());
+        fprintf(mp, "    using __pochivm_func_t = %s(*)(", info.m_origRet.c_str());
     }
     for (size_t i = 0; i < info.m_params.size(); i++)
     {
-        fprintf(fp, "\n        %s", info.m_origParams[i].c_str());
+        fprintf(mp, "\n        %s", info.m_origParams[i].c_str());
         if (i != info.m_params.size() - 1)
         {
-            fprintf(fp, ",");
+            fprintf(mp, ",");
         }
         else
         {
-            fprintf(fp, "\n    ");
+            fprintf(mp, "\n    ");
         }
     }
-    fprintf(fp, ")%s%s;\n", (info.m_isConst ? " const" : ""), (info.m_isNoExcept ? " noexcept" : ""));
+    fprintf(mp, ")%s%s;\n", (info.m_isConst ? " const" : ""), (info.m_isNoExcept ? " noexcept" : ""));
 
-    fprintf(fp, "    using __pochivm_wrapper_generator_t = ReflectionHelper::function_wrapper_helper<\n");
-    fprintf(fp, "            static_cast<__pochivm_func_t>(\n");
-    fprintf(fp, "                    ");
+    fprintf(mp, "    using __pochivm_wrapper_generator_t = ReflectionHelper::function_wrapper_helper<\n");
+    fprintf(mp, "            static_cast<__pochivm_func_t>(\n");
+    fprintf(mp, "                    ");
     if (info.m_fnType == PochiVM::ReflectionHelper::FunctionType::OutlineDefinedOverloadedOperator)
     {
         if (info.m_functionName == "operator++" || info.m_functionName == "operator--")
         {
             ReleaseAssert(info.m_params.size() == 1);
-            fprintf(fp, "&::PochiVM::ReflectionHelper::OutlinedOperatorWrapper::f<\n");
-            fprintf(fp, "                        %s,\n", info.m_origParams[0].c_str());
-            fprintf(fp, "                        %s /*isIncrement*/\n", (info.m_functionName == "operator++" ? "true" : "false"));
-            fprintf(fp, "                    >");
+            fprintf(mp, "&::PochiVM::ReflectionHelper::OutlinedOperatorWrapper::f<\n");
+            fprintf(mp, "                        %s,\n", info.m_origParams[0].c_str());
+            fprintf(mp, "                        %s /*isIncrement*/\n", (info.m_functionName == "operator++" ? "true" : "false"));
+            fprintf(mp, "                    >");
         }
         else
         {
-            fprintf(fp, "&::PochiVM::ReflectionHelper::OutlinedOperatorWrapper::f<\n");
+            fprintf(mp, "&::PochiVM::ReflectionHelper::OutlinedOperatorWrapper::f<\n");
             ReleaseAssert(info.m_params.size() == 2);
-            fprintf(fp, "                        %s,\n", info.m_origParams[0].c_str());
-            fprintf(fp, "                        %s,\n", info.m_origParams[1].c_str());
-            fprintf(fp, "                        ");
+            fprintf(mp, "                        %s,\n", info.m_origParams[0].c_str());
+            fprintf(mp, "                        %s,\n", info.m_origParams[1].c_str());
+            fprintf(mp, "                        ");
             if (info.m_functionName == "operator==")
             {
-                fprintf(fp, "::PochiVM::AstComparisonExprType::EQUAL");
+                fprintf(mp, "::PochiVM::AstComparisonExprType::EQUAL");
             }
             else if (info.m_functionName == "operator!=")
             {
-                fprintf(fp, "::PochiVM::AstComparisonExprType::NOT_EQUAL");
+                fprintf(mp, "::PochiVM::AstComparisonExprType::NOT_EQUAL");
             }
             else if (info.m_functionName == "operator<")
             {
-                fprintf(fp, "::PochiVM::AstComparisonExprType::LESS_THAN");
+                fprintf(mp, "::PochiVM::AstComparisonExprType::LESS_THAN");
             }
             else if (info.m_functionName == "operator<=")
             {
-                fprintf(fp, "::PochiVM::AstComparisonExprType::LESS_EQUAL");
+                fprintf(mp, "::PochiVM::AstComparisonExprType::LESS_EQUAL");
             }
             else if (info.m_functionName == "operator>")
             {
-                fprintf(fp, "::PochiVM::AstComparisonExprType::GREATER_THAN");
+                fprintf(mp, "::PochiVM::AstComparisonExprType::GREATER_THAN");
             }
             else if (info.m_functionName == "operator>=")
             {
-                fprintf(fp, "::PochiVM::AstComparisonExprType::GREATER_EQUAL");
+                fprintf(mp, "::PochiVM::AstComparisonExprType::GREATER_EQUAL");
             }
             else
             {
                 ReleaseAssert(false);
             }
-            fprintf(fp, "\n                    >");
+            fprintf(mp, "\n                    >");
         }
     }
     else if (info.m_prefix == "")
     {
-        fprintf(fp, "&::%s", info.m_functionName.c_str());
+        fprintf(mp, "&::%s", info.m_functionName.c_str());
     }
     else
     {
-        fprintf(fp, "&::%s::%s", info.m_prefix.c_str(), info.m_functionName.c_str());
+        fprintf(mp, "&::%s::%s", info.m_prefix.c_str(), info.m_functionName.c_str());
     }
     if (info.m_templateParams.size() > 0)
     {
-        PrintFnTemplateParams(fp, info);
+        PrintFnTemplateParams(mp, info);
     }
-    fprintf(fp, "\n");
-    fprintf(fp, "            )\n");
-    fprintf(fp, "        >;\n");
-    fprintf(fp, "    using __pochivm_wrapper_fn_t = typename __pochivm_wrapper_generator_t::WrapperFnPtrType;\n");
+    fprintf(mp, "\n");
+    fprintf(mp, "            )\n");
+    fprintf(mp, "        >;\n");
+    fprintf(mp, "    using __pochivm_wrapper_fn_t = typename __pochivm_wrapper_generator_t::WrapperFnPtrType;\n");
 
     bool isUsingSret = info.m_isUsingWrapper && info.m_isWrapperUsingSret;
     size_t offset = 0;
-    fprintf(fp, "    using __pochivm_wrapper_fn_typeinfo = AstTypeHelper::function_type_helper<__pochivm_wrapper_fn_t>;\n");
+    fprintf(mp, "    using __pochivm_wrapper_fn_typeinfo = AstTypeHelper::function_type_helper<__pochivm_wrapper_fn_t>;\n");
 
     if (isUsingSret)
     {
@@ -677,66 +711,68 @@ static void PrintFnCallBody(FILE* fp, FILE* gp, const ParsedFnTypeNamesInfo& inf
         cppParams.insert(cppParams.begin(), cppRet);
         cppRet = "void";
         ReleaseAssert(!info.m_isRetApiVar);
-        fprintf(fp, "    static_assert(TypeId::Get<typename ReflectionHelper::recursive_remove_cv<typename __pochivm_wrapper_fn_typeinfo::ReturnType>::type>() ==\n");
-        fprintf(fp, "                  TypeId::Get<void>(), \"unexpected return type\");\n");
+        fprintf(mp, "    static_assert(TypeId::Get<typename ReflectionHelper::recursive_remove_cv<typename __pochivm_wrapper_fn_typeinfo::ReturnType>::type>() ==\n");
+        fprintf(mp, "                  TypeId::Get<void>(), \"unexpected return type\");\n");
 
-        fprintf(fp, "    static_assert(TypeId::Get<typename ReflectionHelper::recursive_remove_cv<typename __pochivm_wrapper_fn_typeinfo::ArgType<%d>>::type>() ==\n",
+        fprintf(mp, "    static_assert(TypeId::Get<typename ReflectionHelper::recursive_remove_cv<typename __pochivm_wrapper_fn_typeinfo::ArgType<%d>>::type>() ==\n",
                 static_cast<int>(offset));
-        fprintf(fp, "                  __pochivm_cpp_fn_ret.AddPointer(), \"unexpected param type (sret)\");\n");
+        fprintf(mp, "                  __pochivm_cpp_fn_ret.AddPointer(), \"unexpected param type (sret)\");\n");
         offset++;
     }
     else
     {
-        fprintf(fp, "    static_assert(TypeId::Get<typename ReflectionHelper::recursive_remove_cv<typename __pochivm_wrapper_fn_typeinfo::ReturnType>::type>() ==\n");
-        fprintf(fp, "                  __pochivm_cpp_fn_ret, \"unexpected return type\");\n");
+        fprintf(mp, "    static_assert(TypeId::Get<typename ReflectionHelper::recursive_remove_cv<typename __pochivm_wrapper_fn_typeinfo::ReturnType>::type>() ==\n");
+        fprintf(mp, "                  __pochivm_cpp_fn_ret, \"unexpected return type\");\n");
     }
 
     for (int i = 0; i < numParams; i++)
     {
-        fprintf(fp, "    static_assert(TypeId::Get<typename ReflectionHelper::recursive_remove_cv<typename __pochivm_wrapper_fn_typeinfo::ArgType<%d>>::type>() ==\n",
+        fprintf(mp, "    static_assert(TypeId::Get<typename ReflectionHelper::recursive_remove_cv<typename __pochivm_wrapper_fn_typeinfo::ArgType<%d>>::type>() ==\n",
                 static_cast<int>(offset));
-        fprintf(fp, "                  __pochivm_cpp_fn_params[%d], ", i);
+        fprintf(mp, "                  __pochivm_cpp_fn_params[%d], ", i);
         if (info.m_fnType == PochiVM::ReflectionHelper::FunctionType::NonStaticMemberFn)
         {
             if (i == 0)
             {
-                fprintf(fp, "\"unexpected param type ('this' pointer)\");\n");
+                fprintf(mp, "\"unexpected param type ('this' pointer)\");\n");
             }
             else
             {
-                fprintf(fp, "\"unexpected param type (param %d)\");\n", i - 1);
+                fprintf(mp, "\"unexpected param type (param %d)\");\n", i - 1);
             }
         }
         else
         {
-            fprintf(fp, "\"unexpected param type (param %d)\");\n", i);
+            fprintf(mp, "\"unexpected param type (param %d)\");\n", i);
         }
         offset++;
     }
-    fprintf(fp, "    static_assert(__pochivm_wrapper_fn_typeinfo::numArgs == %d, \"unexpected number of arguments\");\n", static_cast<int>(offset));
+    fprintf(mp, "    static_assert(__pochivm_wrapper_fn_typeinfo::numArgs == %d, \"unexpected number of arguments\");\n", static_cast<int>(offset));
 
-    fprintf(fp, "    static constexpr InterpCallCppFunctionImpl __pochivm_interpfn = AstTypeHelper::interp_call_cpp_fn_helper<__pochivm_wrapper_generator_t::wrapperFn>::interpFn;\n");
+    fprintf(mp, "    static constexpr InterpCallCppFunctionImpl __pochivm_interpfn = AstTypeHelper::interp_call_cpp_fn_helper<__pochivm_wrapper_generator_t::wrapperFn>::interpFn;\n");
 
-    fprintf(fp, "    static constexpr CppFunctionMetadata __pochivm_cpp_fn_metadata = {\n");
+    fprintf(mp, "    static constexpr CppFunctionMetadata __pochivm_cpp_fn_metadata = {\n");
     std::string varname = std::string("__pochivm_internal_bc_") + GetUniqueSymbolHash(info.m_mangledSymbolName);
-    fprintf(fp, "        &%s,\n", varname.c_str());
-    fprintf(fp, "        __pochivm_cpp_fn_params,\n");
-    fprintf(fp, "        %d /*numParams*/,\n", numParams);
-    fprintf(fp, "        __pochivm_cpp_fn_ret /*returnType*/,\n");
-    fprintf(fp, "        %s /*isUsingSret*/,\n", (isUsingSret ? "true" : "false"));
-    fprintf(fp, "        __pochivm_wrapper_generator_t::isWrapperNoExcept /*isNoExcept*/,\n");
-    fprintf(fp, "        __pochivm_interpfn /*interpFn*/,\n");
-    fprintf(fp, "        AstTypeHelper::fastinterp_call_cpp_fn_helper<__pochivm_wrapper_generator_t::isWrapperNoExcept, %s /*ReturnType*/, __pochivm_interpfn>::get /*fastInterpFn*/,\n",
+    fprintf(mp, "        &%s,\n", varname.c_str());
+    fprintf(mp, "        __pochivm_cpp_fn_params,\n");
+    fprintf(mp, "        %d /*numParams*/,\n", numParams);
+    fprintf(mp, "        __pochivm_cpp_fn_ret /*returnType*/,\n");
+    fprintf(mp, "        %s /*isUsingSret*/,\n", (isUsingSret ? "true" : "false"));
+    fprintf(mp, "        __pochivm_wrapper_generator_t::isWrapperNoExcept /*isNoExcept*/,\n");
+    fprintf(mp, "        __pochivm_interpfn /*interpFn*/,\n");
+    fprintf(mp, "        AstTypeHelper::fastinterp_call_cpp_fn_helper<__pochivm_wrapper_generator_t::isWrapperNoExcept, %s /*ReturnType*/, __pochivm_interpfn>::get /*fastInterpFn*/,\n",
             cppRet.c_str());
-    fprintf(fp, "        %d /*uniqueFunctionOrdinal*/,\n", g_curUniqueFunctionOrdinal);
+    fprintf(mp, "        %d /*uniqueFunctionOrdinal*/,\n", g_curUniqueFunctionOrdinal);
     g_curUniqueFunctionOrdinal++;
-    fprintf(fp, "    };\n");
+    fprintf(mp, "        static_cast<CppFunctionAttribute>(%uU) /*attributes*/,\n", static_cast<uint32_t>(info.m_attributes));
+    fprintf(mp, "    };\n");
+    std::string metadataExpr = PrintCppFnMetadataClassEnd(mp);
 
     PrintValidateFnPrototype(gp, cppParams, cppRet, varname);
 
     fprintf(fp, "    return %s<%s>(new AstCallExpr(\n",
             (info.m_isRetApiVar ? "Reference" : "Value"), info.m_ret.c_str());
-    fprintf(fp, "            &__pochivm_cpp_fn_metadata,\n");
+    fprintf(fp, "            %s,\n", metadataExpr.c_str());
     fprintf(fp, "            std::vector<AstNodeBase*>{");
     if (info.m_fnType == PochiVM::ReflectionHelper::FunctionType::NonStaticMemberFn)
     {
@@ -782,15 +818,16 @@ static void PrintFnCallBody(FILE* fp, FILE* gp, const ParsedFnTypeNamesInfo& inf
     }
 }
 
-static void PrintConstructorFnCallBody(FILE* fp, FILE* gp, const ParsedFnTypeNamesInfo& info)
+static void PrintConstructorFnCallBody(FILE* fp, FILE* mp, FILE* gp, const ParsedFnTypeNamesInfo& info)
 {
     ReleaseAssert(info.m_fnType == PochiVM::ReflectionHelper::FunctionType::Constructor);
     fprintf(fp, "{\n");
+    PrintCppFnMetadataClassBegin(mp);
     ReleaseAssert(info.m_params.size() > 0);
     int numCtorParams = static_cast<int>(info.m_params.size()) - 1;
     std::vector<std::string> cppParams;
     std::string cppRet = "void";
-    fprintf(fp, "    static constexpr TypeId __pochivm_cpp_fn_params[%d] = {", static_cast<int>(info.m_params.size()));
+    fprintf(mp, "    static constexpr TypeId __pochivm_cpp_fn_params[%d] = {", static_cast<int>(info.m_params.size()));
     for (size_t i = 0; i < info.m_params.size(); i++)
     {
         std::string s;
@@ -803,70 +840,72 @@ static void PrintConstructorFnCallBody(FILE* fp, FILE* gp, const ParsedFnTypeNam
             s = info.m_params[i];
         }
         cppParams.push_back(s);
-        fprintf(fp, "\n        TypeId::Get<%s>()", s.c_str());
+        fprintf(mp, "\n        TypeId::Get<%s>()", s.c_str());
         if (i != info.m_params.size() - 1)
         {
-            fprintf(fp, ",");
+            fprintf(mp, ",");
         }
         else
         {
-            fprintf(fp, "\n    ");
+            fprintf(mp, "\n    ");
         }
     }
-    fprintf(fp, "};\n");
-    fprintf(fp, "    static constexpr TypeId __pochivm_cpp_fn_ret = TypeId::Get<%s%s%s>();\n",
+    fprintf(mp, "};\n");
+    fprintf(mp, "    static constexpr TypeId __pochivm_cpp_fn_ret = TypeId::Get<%s%s%s>();\n",
             (info.m_isRetApiVar ? "typename std::add_pointer<" : ""),
             info.m_ret.c_str(),
             (info.m_isRetApiVar ? ">::type" : ""));
-    fprintf(fp, "    using __pochivm_wrapper_t = ReflectionHelper::constructor_wrapper_helper<");
+    fprintf(mp, "    using __pochivm_wrapper_t = ReflectionHelper::constructor_wrapper_helper<");
     for (size_t i = 0; i < info.m_params.size(); i++)
     {
-        fprintf(fp, "\n        %s%s%s",
+        fprintf(mp, "\n        %s%s%s",
                 (i == 0 ? "typename std::remove_pointer<" : ""),
                 info.m_origParams[i].c_str(),
                 (i == 0 ? ">::type" : ""));
         if (i != info.m_params.size() - 1)
         {
-            fprintf(fp, ",");
+            fprintf(mp, ",");
         }
         else
         {
-            fprintf(fp, "\n    ");
+            fprintf(mp, "\n    ");
         }
     }
-    fprintf(fp, ">;\n");
+    fprintf(mp, ">;\n");
 
-    fprintf(fp, "    using __pochivm_wrapper_fn_typeinfo = AstTypeHelper::function_type_helper<__pochivm_wrapper_t::WrapperFnPtrType>;\n");
+    fprintf(mp, "    using __pochivm_wrapper_fn_typeinfo = AstTypeHelper::function_type_helper<__pochivm_wrapper_t::WrapperFnPtrType>;\n");
 
     for (int i = 0; i < static_cast<int>(info.m_params.size()); i++)
     {
-        fprintf(fp, "    static_assert(TypeId::Get<typename ReflectionHelper::recursive_remove_cv<typename __pochivm_wrapper_fn_typeinfo::ArgType<%d>>::type>() ==\n",
+        fprintf(mp, "    static_assert(TypeId::Get<typename ReflectionHelper::recursive_remove_cv<typename __pochivm_wrapper_fn_typeinfo::ArgType<%d>>::type>() ==\n",
                 i);
-        fprintf(fp, "                  __pochivm_cpp_fn_params[%d], ", i);
-        fprintf(fp, "\"unexpected param type (constructor param %d)\");\n", i);
+        fprintf(mp, "                  __pochivm_cpp_fn_params[%d], ", i);
+        fprintf(mp, "\"unexpected param type (constructor param %d)\");\n", i);
     }
-    fprintf(fp, "    static_assert(__pochivm_cpp_fn_ret == TypeId::Get<void>(), \"unexpected return type\");\n");
-    fprintf(fp, "    static_assert(__pochivm_wrapper_fn_typeinfo::numArgs == %d + 1, \"unexpected number of arguments\");\n", numCtorParams);
+    fprintf(mp, "    static_assert(__pochivm_cpp_fn_ret == TypeId::Get<void>(), \"unexpected return type\");\n");
+    fprintf(mp, "    static_assert(__pochivm_wrapper_fn_typeinfo::numArgs == %d + 1, \"unexpected number of arguments\");\n", numCtorParams);
 
-    fprintf(fp, "    static constexpr InterpCallCppFunctionImpl __pochivm_interpfn = AstTypeHelper::interp_call_cpp_fn_helper<__pochivm_wrapper_t::wrapperFn>::interpFn;\n");
-    fprintf(fp, "    static constexpr CppFunctionMetadata __pochivm_cpp_fn_metadata = {\n");
+    fprintf(mp, "    static constexpr InterpCallCppFunctionImpl __pochivm_interpfn = AstTypeHelper::interp_call_cpp_fn_helper<__pochivm_wrapper_t::wrapperFn>::interpFn;\n");
+    fprintf(mp, "    static constexpr CppFunctionMetadata __pochivm_cpp_fn_metadata = {\n");
     std::string varname = std::string("__pochivm_internal_bc_") + GetUniqueSymbolHash(info.m_mangledSymbolName);
-    fprintf(fp, "        &%s,\n", varname.c_str());
-    fprintf(fp, "        __pochivm_cpp_fn_params,\n");
-    fprintf(fp, "        %d /*numParams*/,\n", static_cast<int>(info.m_params.size()));
-    fprintf(fp, "        __pochivm_cpp_fn_ret /*returnType*/,\n");
-    fprintf(fp, "        false /*isUsingSret*/,\n");
-    fprintf(fp, "        __pochivm_wrapper_t::isWrapperFnNoExcept /*isNoExcept*/,\n");
-    fprintf(fp, "        __pochivm_interpfn /*interpFn*/,\n");
-    fprintf(fp, "        AstTypeHelper::fastinterp_call_cpp_fn_helper<__pochivm_wrapper_t::isWrapperFnNoExcept, %s /*ReturnType*/, __pochivm_interpfn>::get /*fastInterpFn*/,\n",
+    fprintf(mp, "        &%s,\n", varname.c_str());
+    fprintf(mp, "        __pochivm_cpp_fn_params,\n");
+    fprintf(mp, "        %d /*numParams*/,\n", static_cast<int>(info.m_params.size()));
+    fprintf(mp, "        __pochivm_cpp_fn_ret /*returnType*/,\n");
+    fprintf(mp, "        false /*isUsingSret*/,\n");
+    fprintf(mp, "        __pochivm_wrapper_t::isWrapperFnNoExcept /*isNoExcept*/,\n");
+    fprintf(mp, "        __pochivm_interpfn /*interpFn*/,\n");
+    fprintf(mp, "        AstTypeHelper::fastinterp_call_cpp_fn_helper<__pochivm_wrapper_t::isWrapperFnNoExcept, %s /*ReturnType*/, __pochivm_interpfn>::get /*fastInterpFn*/,\n",
             cppRet.c_str());
-    fprintf(fp, "        %d /*uniqueFunctionOrdinal*/,\n", g_curUniqueFunctionOrdinal);
+    fprintf(mp, "        %d /*uniqueFunctionOrdinal*/,\n", g_curUniqueFunctionOrdinal);
     g_curUniqueFunctionOrdinal++;
-    fprintf(fp, "    };\n");
+    fprintf(mp, "        CppFunctionAttribute::None /*attributes*/,\n");
+    fprintf(mp, "    };\n");
+    std::string metadataExpr = PrintCppFnMetadataClassEnd(mp);
 
     PrintValidateFnPrototype(gp, cppParams, cppRet, varname);
 
-    fprintf(fp, "    m_constructorMd = &__pochivm_cpp_fn_metadata;\n");
+    fprintf(fp, "    m_constructorMd = %s;\n", metadataExpr.c_str());
     fprintf(fp, "    m_params = std::vector<AstNodeBase*>{");
     for (size_t i = 0; i < static_cast<size_t>(numCtorParams); i++)
     {
@@ -1108,6 +1147,22 @@ static void GenerateCppRuntimeHeaderFile(const std::string& generatedFileFolder,
     fprintf(gp, "namespace PochiVM {\n\n");
     fprintf(gp, "void ValidateAllBitcodeFnPrototypes() {\n");
 
+    // The metadata of all registered C++ functions other than destructors, see PrintCppFnMetadataClassBegin()
+    //
+    std::string metadataFilename = generatedFileFolder + "/pochivm_runtime_cpp_fn_metadata.generated.h";
+    FILE* mp = fopen(metadataFilename.c_str(), "w");
+    if (mp == nullptr)
+    {
+        fprintf(stderr, "Failed to open file '%s' for write, errno = %d (%s)\n",
+                metadataFilename.c_str(), errno, strerror(errno));
+        abort();
+    }
+    fprintf(mp, "// GENERATED FILE, DO NOT EDIT!\n//\n\n");
+    fprintf(mp, "#pragma once\n");
+    fprintf(mp, "#include \"pochivm/ast_type_helper.h\"\n\n");
+    fprintf(mp, "namespace PochiVM {\n\n");
+    fprintf(mp, "template<int uniqueFunctionOrdinal>\nclass CppFnMetadata;\n\n");
+
     // generate Ast syntax header
     //
     std::set<std::string> allDefaultConstructibleClasses;
@@ -1126,6 +1181,7 @@ static void GenerateCppRuntimeHeaderFile(const std::string& generatedFileFolder,
         fprintf(fp, "#pragma once\n");
         fprintf(fp, "#include \"runtime/pochivm_runtime_headers.h\"\n");
         fprintf(fp, "#include \"pochivm_runtime_cpp_types.generated.h\"\n");
+        fprintf(fp, "#include \"pochivm_runtime_cpp_fn_metadata.generated.h\"\n");
         fprintf(fp, "#include \"pochivm/function_proto.h\"\n");
         fprintf(fp, "#include \"pochivm/api_base.h\"\n");
         fprintf(fp, "#include \"pochivm/api_function_proto.h\"\n\n");
@@ -1218,32 +1274,35 @@ static void GenerateCppRuntimeHeaderFile(const std::string& generatedFileFolder,
                         ReleaseAssert(info.m_isRetApiVar && !info.m_isUsingWrapper);
                         ReleaseAssert(info.m_params.size() == 1 && !info.m_isParamsApiVar[0]);
                         fprintf(fp, "    Reference<%s> %s() { \n", info.m_ret.c_str(), info.m_functionName.c_str());
-                        fprintf(fp, "        using __pochivm_classname = %s;\n", className.c_str());
-                        fprintf(fp, "        static constexpr TypeId __pochivm_cpp_fn_params[1] = { TypeId::Get<%s>() };\n",
+                        PrintCppFnMetadataClassBegin(mp);
+                        fprintf(mp, "    using __pochivm_classname = %s;\n", className.c_str());
+                        fprintf(mp, "    static constexpr TypeId __pochivm_cpp_fn_params[1] = { TypeId::Get<%s>() };\n",
                                 info.m_params[0].c_str());
                         std::string cppRet = std::string("typename std::add_pointer<") + info.m_ret + ">::type";
-                        fprintf(fp, "        static constexpr TypeId __pochivm_cpp_fn_ret = TypeId::Get<%s>();\n", cppRet.c_str());
-                        fprintf(fp, "        static_assert(__pochivm_cpp_fn_params[0] == TypeId::Get<__pochivm_classname>().AddPointer(), \"unexpected param type\");\n");
-                        fprintf(fp, "        using __pochivm_wrapper_t = ReflectionHelper::member_object_accessor_wrapper<&__pochivm_classname::%s>;\n",
+                        fprintf(mp, "    static constexpr TypeId __pochivm_cpp_fn_ret = TypeId::Get<%s>();\n", cppRet.c_str());
+                        fprintf(mp, "    static_assert(__pochivm_cpp_fn_params[0] == TypeId::Get<__pochivm_classname>().AddPointer(), \"unexpected param type\");\n");
+                        fprintf(mp, "    using __pochivm_wrapper_t = ReflectionHelper::member_object_accessor_wrapper<&__pochivm_classname::%s>;\n",
                                 info.m_functionName.c_str());
-                        fprintf(fp, "        using __pochivm_wrapper_wrapper_t = ReflectionHelper::function_wrapper_helper<__pochivm_wrapper_t::wrapperFn>;\n");
-                        fprintf(fp, "        static constexpr InterpCallCppFunctionImpl __pochivm_interpfn = AstTypeHelper::interp_call_cpp_fn_helper<__pochivm_wrapper_wrapper_t::wrapperFn>::interpFn;\n");
-                        fprintf(fp, "        static constexpr CppFunctionMetadata __pochivm_cpp_fn_metadata = {\n");
+                        fprintf(mp, "    using __pochivm_wrapper_wrapper_t = ReflectionHelper::function_wrapper_helper<__pochivm_wrapper_t::wrapperFn>;\n");
+                        fprintf(mp, "    static constexpr InterpCallCppFunctionImpl __pochivm_interpfn = AstTypeHelper::interp_call_cpp_fn_helper<__pochivm_wrapper_wrapper_t::wrapperFn>::interpFn;\n");
+                        fprintf(mp, "    static constexpr CppFunctionMetadata __pochivm_cpp_fn_metadata = {\n");
                         std::string varname = std::string("__pochivm_internal_bc_") + GetUniqueSymbolHash(info.m_mangledSymbolName);
-                        fprintf(fp, "            &%s,\n", varname.c_str());
-                        fprintf(fp, "            __pochivm_cpp_fn_params,\n");
-                        fprintf(fp, "            1 /*numParams*/,\n");
-                        fprintf(fp, "            __pochivm_cpp_fn_ret /*returnType*/,\n");
-                        fprintf(fp, "            false /*isUsingSret*/,\n");
-                        fprintf(fp, "            __pochivm_wrapper_wrapper_t::isWrapperNoExcept /*isNoExcept*/,\n");
-                        fprintf(fp, "            __pochivm_interpfn /*interpFn*/,\n");
-                        fprintf(fp, "            AstTypeHelper::fastinterp_call_cpp_fn_helper<__pochivm_wrapper_wrapper_t::isWrapperNoExcept, %s /*ReturnType*/, __pochivm_interpfn>::get /*fastInterpFn*/,\n",
+                        fprintf(mp, "        &%s,\n", varname.c_str());
+                        fprintf(mp, "        __pochivm_cpp_fn_params,\n");
+                        fprintf(mp, "        1 /*numParams*/,\n");
+                        fprintf(mp, "        __pochivm_cpp_fn_ret /*returnType*/,\n");
+                        fprintf(mp, "        false /*isUsingSret*/,\n");
+                        fprintf(mp, "        __pochivm_wrapper_wrapper_t::isWrapperNoExcept /*isNoExcept*/,\n");
+                        fprintf(mp, "        __pochivm_interpfn /*interpFn*/,\n");
+                        fprintf(mp, "        AstTypeHelper::fastinterp_call_cpp_fn_helper<__pochivm_wrapper_wrapper_t::isWrapperNoExcept, %s /*ReturnType*/, __pochivm_interpfn>::get /*fastInterpFn*/,\n",
                                 cppRet.c_str());
-                        fprintf(fp, "            %d /*uniqueFunctionOrdinal*/,\n", g_curUniqueFunctionOrdinal);
+                        fprintf(mp, "        %d /*uniqueFunctionOrdinal*/,\n", g_curUniqueFunctionOrdinal);
                         g_curUniqueFunctionOrdinal++;
-                        fprintf(fp, "        };\n");
-                        fprintf(fp, "        return Reference<%s>(new AstCallExpr(&__pochivm_cpp_fn_metadata, std::vector<AstNodeBase*>{ __pochivm_ref_ptr }));\n",
-                                info.m_ret.c_str());
+                        fprintf(mp, "        CppFunctionAttribute::None /*attributes*/,\n");
+                        fprintf(mp, "    };\n");
+                        std::string metadataExpr = PrintCppFnMetadataClassEnd(mp);
+                        fprintf(fp, "        return Reference<%s>(new AstCallExpr(%s, std::vector<AstNodeBase*>{ __pochivm_ref_ptr }));\n",
+                                info.m_ret.c_str(), metadataExpr.c_str());
                         fprintf(fp, "    }\n\n");
                         std::vector<std::string> cppParams;
                         cppParams.push_back(info.m_params[0]);
@@ -1412,7 +1471,7 @@ static void GenerateCppRuntimeHeaderFile(const std::string& generatedFileFolder,
                                     info.m_ret.c_str(), info.m_functionName.c_str());
                             PrintFnParams(fp, info);
                             fprintf(fp, "\n");
-                            PrintFnCallBody(fp, gp, info);
+                            PrintFnCallBody(fp, mp, gp, info);
                         }
                     }
                     else
@@ -1473,7 +1532,7 @@ static void GenerateCppRuntimeHeaderFile(const std::string& generatedFileFolder,
                             PrintFnTemplateParams(fp, info);
                             PrintFnParams(fp, info);
                             fprintf(fp, "\n");
-                            PrintFnCallBody(fp, gp, info);
+                            PrintFnCallBody(fp, mp, gp, info);
                         }
                     }
                     start = end;
@@ -1507,7 +1566,7 @@ static void GenerateCppRuntimeHeaderFile(const std::string& generatedFileFolder,
                             info.m_ret.c_str(), info.m_functionName.c_str());
                     PrintFnParams(fp, info);
                     fprintf(fp, "\n");
-                    PrintFnCallBody(fp, gp, info);
+                    PrintFnCallBody(fp, mp, gp, info);
                 }
             }
         }
@@ -1562,7 +1621,7 @@ static void GenerateCppRuntimeHeaderFile(const std::string& generatedFileFolder,
                     }
                     PrintFnParams(fp, info);
                     fprintf(fp, "\n");
-                    PrintFnCallBody(fp, gp, info);
+                    PrintFnCallBody(fp, mp, gp, info);
                 }
             }
         }
@@ -1622,7 +1681,7 @@ static void GenerateCppRuntimeHeaderFile(const std::string& generatedFileFolder,
                     //
                     PrintFnParams(fp, info, false /*doNotPrintVarName*/, 1 /*firstParam*/);
                     fprintf(fp, "\n");
-                    PrintConstructorFnCallBody(fp, gp, info);
+                    PrintConstructorFnCallBody(fp, mp, gp, info);
                 }
                 fprintf(fp, "};\n\n");
 
@@ -1647,6 +1706,9 @@ static void GenerateCppRuntimeHeaderFile(const std::string& generatedFileFolder,
 
         fprintf(fp, "\n} // namespace PochiVM\n\n");
         fclose(fp);
+
+        fprintf(mp, "\n} // namespace PochiVM\n\n");
+        fclose(mp);
     }
 
     {
@@ -1809,28 +1871,8 @@ static void GenerateCppRuntimeHeaderFile(const std::string& generatedFileFolder,
                 //
                 fprintf(fp, "extern const BitcodeData %s;\n\n", resVarname.c_str());
 
-                std::string bitcodeDataVarname = resVarname + "_bitcode_data";
-                fprintf(fp, "const uint8_t %s[%d] = {\n    ", bitcodeDataVarname.c_str(), static_cast<int>(bitcodeSize + 1));
-
-                for (size_t i = 0; i <= bitcodeSize; i++)
-                {
-                    uint8_t value = bitcodeRawData[i];
-                    fprintf(fp, "%d", value);
-                    if (i != bitcodeSize)
-                    {
-                        fprintf(fp, ", ");
-                        if (i % 16 == 15)
-                        {
-                            fprintf(fp, "\n    ");
-                        }
-                    }
-                }
-                fprintf(fp, "\n};\n\n");
-
-                fprintf(fp, "const BitcodeData %s = {\n", resVarname.c_str());
-                fprintf(fp, "    \"__pochivm_exception_typeinfo_objects_bc_stub__\",\n");
-                fprintf(fp, "    %s,\n", bitcodeDataVarname.c_str());
-                fprintf(fp, "    %d\n};\n", static_cast<int>(bitcodeSize));
+                PrintBitcodeDataDefinitionOrDie(fp, resVarname, "\"__pochivm_exception_typeinfo_objects_bc_stub__\"",
+                                                bitcodeRawData, bitcodeSize);
 
                 fprintf(fp, "\n}  // namespace PochiVM\n\n");
 
@@ -1853,7 +1895,8 @@ static void GenerateCppRuntimeHeaderFile(const std::string& generatedFileFolder,
 
         fprintf(fp, "// GENERATED FILE, DO NOT EDIT!\n//\n\n");
         fprintf(fp, "#pragma once\n");
-        fprintf(fp, "#include \"pochivm/ast_type_helper.h\"\n\n");
+        fprintf(fp, "#include \"pochivm/ast_type_helper.h\"\n");
+        fprintf(fp, "#include \"pochivm_runtime_cpp_fn_metadata.generated.h\"\n\n");
         fprintf(fp, "namespace PochiVM {\n\n");
 
         // generate all destructors
@@ -1914,10 +1957,13 @@ static void GenerateCppRuntimeHeaderFile(const std::string& generatedFileFolder,
                         cppRet.c_str());
                 fprintf(fp, "        %d /*uniqueFunctionOrdinal*/,\n", g_curUniqueFunctionOrdinal);
                 g_curUniqueFunctionOrdinal++;
+                fprintf(fp, "        CppFunctionAttribute::None /*attributes*/,\n");
                 fprintf(fp, "    };\n");
                 fprintf(fp, "public:\n");
                 fprintf(fp, "    static constexpr const CppFunctionMetadata* value = &__pochivm_cpp_fn_metadata;\n");
                 fprintf(fp, "};\n\n");
+                ReleaseAssert(g_cppFnMetadataExprs.size() == static_cast<size_t>(g_curUniqueFunctionOrdinal - 1));
+                g_cppFnMetadataExprs.push_back(std::string("DestructorCppFnMetadata<") + className + ">::value");
                 std::vector<std::string> cppParams;
                 cppParams.push_back(info.m_params[0]);
                 PrintValidateFnPrototype(gp, cppParams, cppRet, varname);
@@ -1929,6 +1975,21 @@ static void GenerateCppRuntimeHeaderFile(const std::string& generatedFileFolder,
             fprintf(fp, "> {};\n\n");
         }
 
+        // generate the table of all C++ function metadata, indexed by unique function ordinal.
+        // All ordinals have been assigned at this point.
+        //
+        {
+            ReleaseAssert(g_cppFnMetadataExprs.size() == static_cast<size_t>(g_curUniqueFunctionOrdinal));
+            fprintf(fp, "inline constexpr const CppFunctionMetadata* AstCppFunctionMetadataTable[%d] = {\n",
+                    g_curUniqueFunctionOrdinal + 1);
+            for (const std::string& expr : g_cppFnMetadataExprs)
+            {
+                fprintf(fp, "    %s,\n", expr.c_str());
+            }
+            fprintf(fp, "    nullptr\n");
+            fprintf(fp, "};\n\n");
+        }
+
         // generate all exception types
         //
         {
@@ -1,5 +1,6 @@
 ﻿#include "pochivm/common.h"
 #include "runtime_lib_builder/symbol_list_util.h"
+#include "runtime_lib_builder/bitcode_data_writer.h"
 
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
@@ -817,32 +818,11 @@ static void ExtractFunction(const std::string& generatedFileDir,
             //
             fprintf(fp, "extern const BitcodeData %s;\n\n", resVarname.c_str());
 
-            std::string bitcodeDataVarname = resVarname + "_bitcode_data";
-            fprintf(fp, "const uint8_t %s[%d] = {\n    ", bitcodeDataVarname.c_str(), static_cast<int>(bitcodeSize + 1));
-
-            for (size_t i = 0; i <= bitcodeSize; i++)
-            {
-                uint8_t value = bitcodeRawData[i];
-                fprintf(fp, "%d", value);
-                if (i != bitcodeSize)
-                {
-                    fprintf(fp, ", ");
-                    if (i % 16 == 15)
-                    {
-                        fprintf(fp, "\n    ");
-                    }
-                }
-            }
-            fprintf(fp, "\n};\n\n");
-
             std::string symbolVarname = resVarname + "_symbol";
             fprintf(fp, "const char* const %s = \"%s\";\n\n",
                     symbolVarname.c_str(), functionName.c_str());
 
-            fprintf(fp, "const BitcodeData %s = {\n", resVarname.c_str());
-            fprintf(fp, "    %s,\n", symbolVarname.c_str());
-            fprintf(fp, "    %s,\n", bitcodeDataVarname.c_str());
-            fprintf(fp, "    %d\n};\n", static_cast<int>(bitcodeSize));
+            PrintBitcodeDataDefinitionOrDie(fp, resVarname, symbolVarname, bitcodeRawData, bitcodeSize);
 
             fprintf(fp, "\n}  // namespace PochiVM\n\n");
 
@@ -5777,3 +5777,174 @@ TEST(SanityCallCppFn, CharTypeSanity_4)
     }
 }
 
+
+TEST(SanityCallCppFn, RegistrationAttributes)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+
+    using FnPrototype1 = int64_t(*)(int64_t*, int, int*);
+    {
+        auto [fn, arr, n, counter] = NewFunction<FnPrototype1>("testfn1");
+        auto r = fn.NewVariable<int64_t>();
+        fn.SetBody(
+                Declare(r, CallFreeFn::TestCppFnAttributes::Square(CallFreeFn::TestCppFnAttributes::SumArray(arr, n))),
+                If(r > Literal<int64_t>(1000)).Then(
+                    CallFreeFn::TestCppFnAttributes::ReportError(counter, Literal<int>(1))
+                ),
+                Return(r)
+        );
+    }
+
+    using FnPrototype2 = int8_t(*)(int8_t, uint16_t, bool);
+    {
+        auto [fn, x, y, negate] = NewFunction<FnPrototype2>("testfn2");
+        fn.SetBody(
+                Return(CallFreeFn::TestCppFnAttributes::NegateNarrow(x, y, negate))
+        );
+    }
+
+    using FnPrototype3 = bool(*)(int16_t);
+    {
+        auto [fn, x] = NewFunction<FnPrototype3>("testfn3");
+        fn.SetBody(
+                Return(CallFreeFn::TestCppFnAttributes::IsOddNarrow(x))
+        );
+    }
+
+    using FnPrototype4 = size_t(*)(int);
+    {
+        auto [fn, n] = NewFunction<FnPrototype4>("testfn4");
+        auto s = fn.NewVariable<std::string>();
+        fn.SetBody(
+                Declare(s, CallFreeFn::TestCppFnAttributes::RepeatX(n)),
+                Return(s.size())
+        );
+    }
+
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Validate());
+    thread_pochiVMContext->m_curModule->PrepareForDebugInterp();
+    thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+
+    auto checkFn1 = [](std::function<int64_t(int64_t*, int, int*)> fn)
+    {
+        int64_t arr[4] = { 1, 2, 3, 4 };
+        int counter = 0;
+        ReleaseAssert(fn(arr, 4, &counter) == 100);
+        ReleaseAssert(counter == 0);
+        arr[3] = 40;
+        ReleaseAssert(fn(arr, 4, &counter) == 2116);
+        ReleaseAssert(counter == 1);
+    };
+    auto checkFn2 = [](std::function<int8_t(int8_t, uint16_t, bool)> fn)
+    {
+        ReleaseAssert(fn(-3, 1, false) == -2);
+        ReleaseAssert(fn(-3, 1, true) == 2);
+        ReleaseAssert(fn(100, 27, false) == 127);
+        ReleaseAssert(fn(100, 28, false) == -128);
+    };
+    auto checkFn3 = [](std::function<bool(int16_t)> fn)
+    {
+        ReleaseAssert(fn(-7) == true);
+        ReleaseAssert(fn(-32768) == false);
+    };
+    auto checkFn4 = [](std::function<size_t(int)> fn)
+    {
+        ReleaseAssert(fn(0) == 0);
+        ReleaseAssert(fn(100) == 100);
+    };
+
+    checkFn1(thread_pochiVMContext->m_curModule->GetDebugInterpGeneratedFunction<FnPrototype1>("testfn1"));
+    checkFn2(thread_pochiVMContext->m_curModule->GetDebugInterpGeneratedFunction<FnPrototype2>("testfn2"));
+    checkFn3(thread_pochiVMContext->m_curModule->GetDebugInterpGeneratedFunction<FnPrototype3>("testfn3"));
+    checkFn4(thread_pochiVMContext->m_curModule->GetDebugInterpGeneratedFunction<FnPrototype4>("testfn4"));
+
+    checkFn1(thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<FnPrototype1>("testfn1"));
+    checkFn2(thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<FnPrototype2>("testfn2"));
+    checkFn3(thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<FnPrototype3>("testfn3"));
+    checkFn4(thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<FnPrototype4>("testfn4"));
+
+    thread_pochiVMContext->m_curModule->EmitIR();
+
+    // Check that the attributes are applied to the imported C++ functions
+    //
+    {
+        llvm::Module* module = thread_pochiVMContext->m_curModule->GetBuiltLLVMModule();
+        auto findFn = [&](const std::string& name) -> llvm::Function*
+        {
+            llvm::Function* result = nullptr;
+            for (llvm::Function& f : *module)
+            {
+                std::string symbol = f.getName().str();
+                if (symbol.find("TestCppFnAttributes") != std::string::npos && symbol.find(name) != std::string::npos)
+                {
+                    ReleaseAssert(result == nullptr);
+                    result = &f;
+                }
+            }
+            ReleaseAssert(result != nullptr);
+            return result;
+        };
+        using llvm::Attribute;
+        llvm::Function* square = findFn("Square");
+        ReleaseAssert(!square->isDeclaration());
+        ReleaseAssert(square->hasFnAttribute(Attribute::AttrKind::AlwaysInline));
+        ReleaseAssert(square->hasFnAttribute(Attribute::AttrKind::ReadNone));
+
+        llvm::Function* sumArray = findFn("SumArray");
+        ReleaseAssert(!sumArray->isDeclaration());
+        ReleaseAssert(sumArray->hasFnAttribute(Attribute::AttrKind::ReadOnly));
+        ReleaseAssert(sumArray->hasFnAttribute(Attribute::AttrKind::InlineHint));
+
+        llvm::Function* reportError = findFn("ReportError");
+        ReleaseAssert(reportError->hasFnAttribute(Attribute::AttrKind::Cold));
+
+        // The bitcode of the AddressOnly functions is not imported
+        //
+        for (const char* name : { "NegateNarrow", "IsOddNarrow", "RepeatX" })
+        {
+            llvm::Function* f = findFn(name);
+            ReleaseAssert(f->isDeclaration());
+            ReleaseAssert(f->hasFnAttribute(Attribute::AttrKind::NoInline));
+        }
+        llvm::Function* negateNarrow = findFn("NegateNarrow");
+        ReleaseAssert(negateNarrow->hasAttribute(llvm::AttributeList::AttrIndex::ReturnIndex, Attribute::AttrKind::SExt));
+        ReleaseAssert(negateNarrow->hasParamAttribute(0, Attribute::AttrKind::SExt));
+        ReleaseAssert(negateNarrow->hasParamAttribute(1, Attribute::AttrKind::ZExt));
+        ReleaseAssert(negateNarrow->hasParamAttribute(2, Attribute::AttrKind::ZExt));
+        ReleaseAssert(findFn("RepeatX")->hasParamAttribute(0, Attribute::AttrKind::StructRet));
+    }
+
+    thread_pochiVMContext->m_curModule->OptimizeIRIfNotDebugMode(2 /*optLevel*/);
+
+    if (!x_isDebugBuild)
+    {
+        // Square is always inlined
+        //
+        llvm::Function* testfn1 = thread_pochiVMContext->m_curModule->GetBuiltLLVMModule()->getFunction("testfn1");
+        for (llvm::BasicBlock& bb : *testfn1)
+        {
+            for (llvm::Instruction& inst : bb)
+            {
+                if (llvm::isa<llvm::CallInst>(&inst))
+                {
+                    llvm::Function* callee = llvm::dyn_cast<llvm::CallInst>(&inst)->getCalledFunction();
+                    ReleaseAssert(callee == nullptr || callee->getName().str().find("Square") == std::string::npos);
+                }
+            }
+        }
+    }
+
+    {
+        SimpleJIT jit;
+        jit.SetAllowResolveSymbolInHostProcess(true);
+        jit.SetModule(thread_pochiVMContext->m_curModule);
+        checkFn1(jit.GetFunction<FnPrototype1>("testfn1"));
+        checkFn2(jit.GetFunction<FnPrototype2>("testfn2"));
+        checkFn3(jit.GetFunction<FnPrototype3>("testfn3"));
+        checkFn4(jit.GetFunction<FnPrototype4>("testfn4"));
+    }
+}
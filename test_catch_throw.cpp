@@ -850,3 +850,117 @@ TEST(SanityCatchThrow, ThrowSanity_8)
         ReleaseAssert(r.order == tmp);
     }
 }
+
+TEST(SanityCatchThrow, NoExceptInference)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+    thread_pochiVMContext->m_curModule->SetNoExceptInferenceEnabled(true);
+
+    using FnPrototype = int(*)(int);
+    {
+        auto [fn, x] = NewFunction<FnPrototype>("thrower");
+        fn.SetBody(
+                If(x == Literal<int>(0)).Then(
+                    Throw(Constructor<std::bad_alloc>())
+                ),
+                Return(x + Literal<int>(1))
+        );
+    }
+    {
+        auto [fn, x] = NewFunction<FnPrototype>("caller1");
+        fn.SetBody(
+                Return(Call<FnPrototype>("thrower", x) + Literal<int>(1))
+        );
+    }
+    {
+        auto [fn, x] = NewFunction<FnPrototype>("pure");
+        fn.SetBody(
+                Return(x * Literal<int>(2))
+        );
+    }
+    {
+        auto [fn, x] = NewFunction<FnPrototype>("caller2");
+        fn.SetBody(
+                Return(Call<FnPrototype>("pure", x) + Call<FnPrototype>("caller2_rec", x))
+        );
+    }
+    {
+        // Mutual recursion with 'caller2', does not throw
+        //
+        auto [fn, x] = NewFunction<FnPrototype>("caller2_rec");
+        fn.SetBody(
+                If(x > Literal<int>(0)).Then(
+                    Return(Call<FnPrototype>("caller2", x - Literal<int>(1)))
+                ),
+                Return(Literal<int>(0))
+        );
+    }
+
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Validate());
+
+    AstModule* m = thread_pochiVMContext->m_curModule;
+    ReleaseAssert(!m->GetAstFunction("thrower")->GetIsNoExceptInferred());
+    ReleaseAssert(!m->GetAstFunction("caller1")->GetIsNoExceptInferred());
+    ReleaseAssert(m->GetAstFunction("pure")->GetIsNoExceptInferred());
+    ReleaseAssert(m->GetAstFunction("caller2")->GetIsNoExceptInferred());
+    ReleaseAssert(m->GetAstFunction("caller2_rec")->GetIsNoExceptInferred());
+
+    // Inference does not change the prototype visible to the user
+    //
+    ReleaseAssert(!m->GetAstFunction("pure")->GetIsNoExcept());
+
+    m->PrepareForFastInterp();
+
+    {
+        FastInterpFunction<FnPrototype> interpFn = m->GetFastInterpGeneratedFunction<FnPrototype>("caller1");
+        ReleaseAssert(interpFn(3) == 5);
+        try {
+            interpFn(0);
+            ReleaseAssert(false);
+        } catch(std::bad_alloc& w) {
+            ReleaseAssert(std::string(w.what()) == "std::bad_alloc");
+        }
+    }
+
+    {
+        FastInterpFunction<FnPrototype> interpFn = m->GetFastInterpGeneratedFunction<FnPrototype>("caller2");
+        // caller2(3) = 6 + caller2(2) = 6 + 4 + caller2(1) = 6 + 4 + 2 + caller2(0) = 12
+        //
+        ReleaseAssert(interpFn(3) == 12);
+    }
+
+    m->EmitIR();
+
+    {
+        llvm::Module* module = m->GetBuiltLLVMModule();
+        ReleaseAssert(!module->getFunction("thrower")->hasFnAttribute(llvm::Attribute::AttrKind::NoUnwind));
+        ReleaseAssert(!module->getFunction("caller1")->hasFnAttribute(llvm::Attribute::AttrKind::NoUnwind));
+        ReleaseAssert(module->getFunction("pure")->hasFnAttribute(llvm::Attribute::AttrKind::NoUnwind));
+        ReleaseAssert(module->getFunction("caller2")->hasFnAttribute(llvm::Attribute::AttrKind::NoUnwind));
+        ReleaseAssert(module->getFunction("caller2_rec")->hasFnAttribute(llvm::Attribute::AttrKind::NoUnwind));
+    }
+
+    m->OptimizeIRIfNotDebugMode(2 /*optLevel*/);
+
+    {
+        SimpleJIT jit;
+        jit.SetAllowResolveSymbolInHostProcess(true);
+        jit.SetModule(m);
+
+        FnPrototype jitFn = jit.GetFunction<FnPrototype>("caller1");
+        ReleaseAssert(jitFn(3) == 5);
+        try {
+            jitFn(0);
+            ReleaseAssert(false);
+        } catch(std::bad_alloc& w) {
+            ReleaseAssert(std::string(w.what()) == "std::bad_alloc");
+        }
+
+        FnPrototype jitFn2 = jit.GetFunction<FnPrototype>("caller2");
+        ReleaseAssert(jitFn2(3) == 12);
+    }
+}
@@ -1176,3 +1176,27 @@ TEST(SanityError, AddressOfNonExistentGeneratedFunction)
 
     AssertIsExpectedOutput(thread_errorContext->m_errorMsg);
 }
+
+TEST(SanityError, TailCallPrototypeMismatch)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+
+    using CalleePrototype = int(*)(int, int);
+    {
+        auto [fn, x, y] = NewFunction<CalleePrototype>("callee");
+        fn.SetBody(Return(x + y));
+    }
+    {
+        using FnPrototype = int(*)(int);
+        auto [fn, x] = NewFunction<FnPrototype>("BadFn");
+        fn.SetBody(TailCall<CalleePrototype>("callee", x, x));
+    }
+
+    ReleaseAssert(!thread_pochiVMContext->m_curModule->Validate());
+    ReleaseAssert(thread_errorContext->HasError());
+
+    AssertIsExpectedOutput(thread_errorContext->m_errorMsg);
+}
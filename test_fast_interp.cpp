@@ -5,6 +5,9 @@
 #include "codegen_context.hpp"
 #include "test_util_helper.h"
 
+#include <sys/wait.h>
+#include <unistd.h>
+
 using namespace PochiVM;
 
 TEST(TestFastInterp, Sanity_1)
@@ -958,3 +961,1510 @@ TEST(TestFastInterp, Sanity_27)
         ReleaseAssert(ret == 33 * (12 - 34) + 12 * -34);
     }
 }
+
+TEST(TestFastInterp, InlineSmallFunctions)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+
+    using UnaryFn = int(*)(int) noexcept;
+    using BinaryFn = int(*)(int, int) noexcept;
+    using PredFn = bool(*)(int) noexcept;
+    {
+        auto [fn, x] = NewFunction<UnaryFn>("sq");
+        fn.SetBody(
+                Return(x * x)
+        );
+    }
+    {
+        auto [fn, x, hi] = NewFunction<BinaryFn>("clamp");
+        fn.SetBody(
+                If(x > hi).Then(
+                    Return(hi)
+                ),
+                Return(x)
+        );
+    }
+    {
+        auto [fn, x] = NewFunction<PredFn>("is_even");
+        fn.SetBody(
+                Return(x % Literal<int>(2) == Literal<int>(0))
+        );
+    }
+    {
+        auto [fn, n] = NewFunction<UnaryFn>("sum_to");
+        auto s = fn.NewVariable<int>();
+        auto i = fn.NewVariable<int>();
+        fn.SetBody(
+                Declare(s, Literal<int>(0)),
+                Declare(i, Literal<int>(0)),
+                While(i < n).Do(
+                    Assign(s, s + i),
+                    Assign(i, i + Literal<int>(1))
+                ),
+                Return(s)
+        );
+    }
+    {
+        // Not inlinable since it calls another function, but 'sq' is inlined into it
+        //
+        auto [fn, x] = NewFunction<UnaryFn>("sq_plus_one");
+        fn.SetBody(
+                Return(Call<UnaryFn>("sq", x) + Literal<int>(1))
+        );
+    }
+    {
+        auto [fn, a, b] = NewFunction<BinaryFn>("testfn");
+        auto r = fn.NewVariable<int>();
+        auto k = fn.NewVariable<int>();
+        fn.SetBody(
+                Declare(r, Call<UnaryFn>("sq", a) + Call<BinaryFn>("clamp", b, Literal<int>(10))),
+                Declare(k, Literal<int>(0)),
+                While(k < a && Call<PredFn>("is_even", k + b)).Do(
+                    Assign(k, k + Literal<int>(2))
+                ),
+                If(Call<PredFn>("is_even", a) || Call<PredFn>("is_even", b)).Then(
+                    Assign(r, r + Call<UnaryFn>("sum_to", a))
+                ).Else(
+                    Assign(r, r - Call<UnaryFn>("sq_plus_one", b))
+                ),
+                Return(r + k)
+        );
+    }
+
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Validate());
+    thread_pochiVMContext->m_curModule->SetFastInterpInlineThreshold(100);
+    thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+
+    auto countCalls = [](const char* fnName) -> int
+    {
+        int numCalls = 0;
+        thread_pochiVMContext->m_curModule->GetAstFunction(fnName)->TraverseFunctionBody(
+            [&](AstNodeBase* cur, AstNodeBase* /*parent*/, FunctionRef<void(void)> Recurse)
+            {
+                if (cur->GetAstNodeType() == AstNodeType::AstCallExpr)
+                {
+                    numCalls++;
+                }
+                Recurse();
+            });
+        return numCalls;
+    };
+    ReleaseAssert(countCalls("testfn") == 1);
+    ReleaseAssert(countCalls("sq_plus_one") == 0);
+
+    auto expectedFn = [](int a, int b) -> int
+    {
+        auto isEven = [](int x) { return x % 2 == 0; };
+        int r = a * a + std::min(b, 10);
+        int k = 0;
+        while (k < a && isEven(k + b)) { k += 2; }
+        if (isEven(a) || isEven(b))
+        {
+            for (int i = 0; i < a; i++) { r += i; }
+        }
+        else
+        {
+            r -= b * b + 1;
+        }
+        return r + k;
+    };
+
+    {
+        FastInterpFunction<BinaryFn> interpFn = thread_pochiVMContext->m_curModule->
+                                GetFastInterpGeneratedFunction<BinaryFn>("testfn");
+        for (int a = -5; a <= 20; a++)
+        {
+            for (int b = -5; b <= 20; b++)
+            {
+                ReleaseAssert(interpFn(a, b) == expectedFn(a, b));
+            }
+        }
+    }
+}
+
+namespace {
+
+// The compiled continuations of OsrLoopIntoCompiledContinuation are published through these trampolines,
+// which count the transfers from FastInterp code into each continuation
+//
+using OsrTestContinuationPrototype = uint64_t(*)(uintptr_t) noexcept;
+OsrTestContinuationPrototype g_osrTestContinuations[2];
+int g_osrTestNumTransfers[2];
+
+template<int ord>
+uint64_t OsrTestTrampoline(uintptr_t stackframe) noexcept
+{
+    g_osrTestNumTransfers[ord]++;
+    return g_osrTestContinuations[ord](stackframe);
+}
+
+}   // anonymous namespace
+
+TEST(TestFastInterp, OsrLoopIntoCompiledContinuation)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+
+    using FnPrototype = uint64_t(*)(int) noexcept;
+    {
+        auto [fn, n] = NewFunction<FnPrototype>("testfn");
+        auto s = fn.NewVariable<uint64_t>();
+        auto i = fn.NewVariable<int>();
+        auto k = fn.NewVariable<int>();
+        fn.SetBody(
+                Declare(s, Literal<uint64_t>(0)),
+                Declare(i, Literal<int>(0)),
+                While(i < n).Do(
+                    Assign(s, s + StaticCast<uint64_t>(i) * StaticCast<uint64_t>(i)),
+                    Assign(i, i + Literal<int>(1))
+                ),
+                For(Declare(k, Literal<int>(0)), k < n, Increment(k)).Do(
+                    If(k % Literal<int>(3) == Literal<int>(0)).Then(
+                        Continue()
+                    ),
+                    Assign(s, s + StaticCast<uint64_t>(k))
+                ),
+                Return(s + StaticCast<uint64_t>(i))
+        );
+    }
+
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Validate());
+    thread_pochiVMContext->m_curModule->SetFastInterpOsrThreshold(16);
+    thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+
+    const std::vector<FastInterpOsrEntry*>& entries = thread_pochiVMContext->m_curModule->GetFastInterpOsrEntries();
+    ReleaseAssert(entries.size() == 2);
+
+    // The continuations are added after Validate(), so validate them separately
+    //
+    for (FastInterpOsrEntry* entry : entries)
+    {
+        AstFunction* continuation = thread_pochiVMContext->m_curModule->GetAstFunction(entry->GetContinuationFnName());
+        ReleaseAssert(continuation != nullptr);
+        AstTraverseColorMark::ClearAll();
+        ReleaseAssert(continuation->Validate());
+        ReleaseAssert(!thread_errorContext->HasError());
+    }
+
+    auto expectedFn = [](int n) -> uint64_t
+    {
+        uint64_t s = 0;
+        int i = 0;
+        while (i < n) { s += static_cast<uint64_t>(i) * static_cast<uint64_t>(i); i++; }
+        for (int k = 0; k < n; k++)
+        {
+            if (k % 3 == 0) { continue; }
+            s += static_cast<uint64_t>(k);
+        }
+        return s + static_cast<uint64_t>(i);
+    };
+
+    FastInterpFunction<FnPrototype> interpFn = thread_pochiVMContext->m_curModule->
+                            GetFastInterpGeneratedFunction<FnPrototype>("testfn");
+    for (int n = -3; n <= 100; n++)
+    {
+        ReleaseAssert(interpFn(n) == expectedFn(n));
+    }
+
+    // Compile the continuations and publish them, so the loops transfer to compiled code
+    //
+    thread_pochiVMContext->m_curModule->EmitIR();
+    thread_pochiVMContext->m_curModule->OptimizeIRIfNotDebugMode(2 /*optLevel*/);
+
+    SimpleJIT jit;
+    jit.SetModule(thread_pochiVMContext->m_curModule);
+    OsrTestContinuationPrototype trampolines[2] = { OsrTestTrampoline<0>, OsrTestTrampoline<1> };
+    for (size_t i = 0; i < 2; i++)
+    {
+        g_osrTestContinuations[i] = jit.GetFunction<OsrTestContinuationPrototype>(entries[i]->GetContinuationFnName());
+        g_osrTestNumTransfers[i] = 0;
+        ReleaseAssert(!entries[i]->IsCompiledContinuationAvailable());
+    }
+
+    // Only publish the continuation of the for-loop first. The while-loop keeps running in FastInterp,
+    // and the for-loop transfers once per call after 'threshold' iterations.
+    // The loops below the threshold never transfer.
+    //
+    entries[1]->SetCompiledContinuation(reinterpret_cast<void*>(trampolines[1]));
+    ReleaseAssert(entries[1]->IsCompiledContinuationAvailable() && !entries[0]->IsCompiledContinuationAvailable());
+    for (int n = -3; n <= 15; n++)
+    {
+        ReleaseAssert(interpFn(n) == expectedFn(n));
+    }
+    ReleaseAssert(g_osrTestNumTransfers[0] == 0 && g_osrTestNumTransfers[1] == 0);
+    for (int n = 50; n <= 100; n++)
+    {
+        ReleaseAssert(interpFn(n) == expectedFn(n));
+    }
+    ReleaseAssert(g_osrTestNumTransfers[0] == 0 && g_osrTestNumTransfers[1] == 51);
+
+    // Now the while-loop transfers, and the compiled continuation runs the for-loop itself
+    //
+    entries[0]->SetCompiledContinuation(reinterpret_cast<void*>(trampolines[0]));
+    for (int n = -3; n <= 15; n++)
+    {
+        ReleaseAssert(interpFn(n) == expectedFn(n));
+    }
+    ReleaseAssert(g_osrTestNumTransfers[0] == 0 && g_osrTestNumTransfers[1] == 51);
+    for (int n = 50; n <= 100; n++)
+    {
+        ReleaseAssert(interpFn(n) == expectedFn(n));
+    }
+    ReleaseAssert(g_osrTestNumTransfers[0] == 51 && g_osrTestNumTransfers[1] == 51);
+}
+
+TEST(TestFastInterp, ConstantFolding)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+
+    using FnPrototype = int(*)(int) noexcept;
+    {
+        auto [fn, a] = NewFunction<FnPrototype>("testfn");
+        auto scale = fn.NewVariable<int>();
+        auto r = fn.NewVariable<int>();
+        fn.SetBody(
+                Declare(scale, Literal<int>(4) * Literal<int>(2) + Literal<int>(0)),
+                Declare(r, a * Literal<int>(1) + scale),
+                If(Literal<int>(3) > Literal<int>(5)).Then(
+                    Assign(r, Literal<int>(0))
+                ),
+                If(!(!(a > Literal<int>(0))) && Literal<bool>(true)).Then(
+                    Assign(r, r * scale - Literal<int>(0))
+                ),
+                While(Literal<bool>(false)).Do(
+                    Assign(r, r + Literal<int>(1))
+                ),
+                If(scale == Literal<int>(8)).Then(
+                    Return(r + StaticCast<int>(Literal<int16_t>(100)))
+                ).Else(
+                    Return(Literal<int>(-1))
+                )
+        );
+    }
+
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Validate());
+    thread_pochiVMContext->m_curModule->SetFastInterpConstantFolding(true);
+    thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+
+    // Expected to be left: 'a + 8', 'r * 8', 'r + 100', and the if-statement on 'a > 0'
+    //
+    int numArithExprs = 0;
+    int numIfStmts = 0;
+    int numLoops = 0;
+    thread_pochiVMContext->m_curModule->GetAstFunction("testfn")->TraverseFunctionBody(
+        [&](AstNodeBase* cur, AstNodeBase* /*parent*/, FunctionRef<void(void)> Recurse)
+        {
+            if (cur->GetAstNodeType() == AstNodeType::AstArithmeticExpr) { numArithExprs++; }
+            if (cur->GetAstNodeType() == AstNodeType::AstIfStatement) { numIfStmts++; }
+            if (cur->GetAstNodeType() == AstNodeType::AstWhileLoop) { numLoops++; }
+            Recurse();
+        });
+    ReleaseAssert(numArithExprs == 3);
+    ReleaseAssert(numIfStmts == 1);
+    ReleaseAssert(numLoops == 0);
+
+    auto expectedFn = [](int a) -> int
+    {
+        int r = a + 8;
+        if (a > 0) { r *= 8; }
+        return r + 100;
+    };
+
+    FastInterpFunction<FnPrototype> interpFn = thread_pochiVMContext->m_curModule->
+                            GetFastInterpGeneratedFunction<FnPrototype>("testfn");
+    for (int a = -20; a <= 20; a++)
+    {
+        ReleaseAssert(interpFn(a) == expectedFn(a));
+    }
+}
+
+TEST(TestFastInterp, IncrementalModuleUpdate)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+    AstModule* module = thread_pochiVMContext->m_curModule;
+
+    using FnPrototype = int(*)(int);
+    {
+        auto [fn, a] = NewFunction<FnPrototype>("square");
+        fn.SetBody(Return(a * a));
+    }
+    {
+        auto [fn, n] = NewFunction<FnPrototype>("sum_squares");
+        auto s = fn.NewVariable<int>();
+        auto i = fn.NewVariable<int>();
+        fn.SetBody(
+                Declare(s, Literal<int>(0)),
+                For(Declare(i, Literal<int>(1)), i <= n, Increment(i)).Do(
+                    Assign(s, s + Call<FnPrototype>("square", i))
+                ),
+                Return(s)
+        );
+    }
+
+    ReleaseAssert(module->Validate());
+    module->PrepareForFastInterp();
+    module->EmitIR();
+    module->OptimizeIRIfNotDebugMode(2 /*optLevel*/);
+
+    SimpleJIT jit;
+    jit.SetModule(module);
+
+    // Add a function calling the functions built above
+    //
+    module->StartIncrementalUpdate();
+    ReleaseAssert(module->GetGeneration() == 1);
+    {
+        auto [fn, n] = NewFunction<FnPrototype>("testfn");
+        fn.SetBody(
+                Return(Call<FnPrototype>("sum_squares", n) - Call<FnPrototype>("square", n + Literal<int>(1)))
+        );
+    }
+    ReleaseAssert(module->GetNumFunctions() == 3);
+    ReleaseAssert(module->GetAstFunction("testfn")->GetModuleGeneration() == 1);
+    ReleaseAssert(module->GetAstFunction("square")->GetModuleGeneration() == 0);
+
+    ReleaseAssert(module->Validate());
+    module->PrepareForFastInterp();
+    module->EmitIR();
+    module->OptimizeIRIfNotDebugMode(2 /*optLevel*/);
+
+    // The functions of the earlier generation are only declared in the new LLVM module
+    //
+    ReleaseAssert(module->GetBuiltLLVMModule()->getFunction("testfn")->isDeclaration() == false);
+    ReleaseAssert(module->GetBuiltLLVMModule()->getFunction("square")->isDeclaration());
+    ReleaseAssert(module->GetBuiltLLVMModule()->getFunction("sum_squares")->isDeclaration());
+
+    jit.AddModule(module);
+
+    auto expectedFn = [](int n) -> int
+    {
+        int s = 0;
+        for (int i = 1; i <= n; i++) { s += i * i; }
+        return s - (n + 1) * (n + 1);
+    };
+
+    FastInterpFunction<FnPrototype> interpFn = module->GetFastInterpGeneratedFunction<FnPrototype>("testfn");
+    FastInterpFunction<FnPrototype> interpFnGen0 = module->GetFastInterpGeneratedFunction<FnPrototype>("square");
+    FnPrototype jitFn = jit.GetFunction<FnPrototype>("testfn");
+    FnPrototype jitFnGen0 = jit.GetFunction<FnPrototype>("square");
+    for (int n = -3; n <= 30; n++)
+    {
+        ReleaseAssert(interpFn(n) == expectedFn(n));
+        ReleaseAssert(jitFn(n) == expectedFn(n));
+        ReleaseAssert(interpFnGen0(n) == n * n);
+        ReleaseAssert(jitFnGen0(n) == n * n);
+    }
+}
+
+TEST(TestFastInterp, ModuleSerializationRoundTrip)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+
+    using FnPrototype = int(*)(int);
+    {
+        auto [fn, a] = NewFunction<FnPrototype>("helper");
+        fn.SetBody(
+                If(a < Literal<int>(0)).Then(
+                    Return(Literal<int>(0) - a)
+                ).Else(
+                    Return(CallFreeFn::FreeFnRecursive(a % Literal<int>(10)))
+                )
+        );
+    }
+    {
+        auto [fn, n] = NewFunction<FnPrototype>("testfn");
+        auto s = fn.NewVariable<int>();
+        auto i = fn.NewVariable<int>();
+        fn.SetBody(
+                Declare(s, Literal<int>(0)),
+                Declare(i, Literal<int>(0) - n),
+                While(i <= n).Do(
+                    If(i == Literal<int>(7) && n > Literal<int>(20)).Then(Break()),
+                    Assign(s, s + Call<FnPrototype>("helper", i) * Literal<int>(3)),
+                    Increment(i)
+                ),
+                Return(s)
+        );
+    }
+
+    std::vector<uint8_t> data;
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Serialize(data));
+    delete thread_pochiVMContext->m_curModule;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test2");
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Deserialize(data.data(), data.size()));
+    ReleaseAssert(thread_pochiVMContext->m_curModule->GetNumFunctions() == 2);
+
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Validate());
+    thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+    thread_pochiVMContext->m_curModule->EmitIR();
+    thread_pochiVMContext->m_curModule->OptimizeIRIfNotDebugMode(2 /*optLevel*/);
+
+    SimpleJIT jit;
+    jit.SetModule(thread_pochiVMContext->m_curModule);
+
+    std::function<int(int)> fib = [&](int x) -> int
+    {
+        return x <= 1 ? 1 : fib(x - 1) + fib(x - 2);
+    };
+    auto expectedFn = [&](int n) -> int
+    {
+        int s = 0;
+        for (int i = -n; i <= n; i++)
+        {
+            if (i == 7 && n > 20) { break; }
+            s += (i < 0 ? -i : fib(i % 10)) * 3;
+        }
+        return s;
+    };
+
+    FastInterpFunction<FnPrototype> interpFn = thread_pochiVMContext->m_curModule->
+                           GetFastInterpGeneratedFunction<FnPrototype>("testfn");
+    FnPrototype jitFn = jit.GetFunction<FnPrototype>("testfn");
+    for (int n = -2; n <= 25; n++)
+    {
+        ReleaseAssert(interpFn(n) == expectedFn(n));
+        ReleaseAssert(jitFn(n) == expectedFn(n));
+    }
+
+    // Truncated data is rejected
+    //
+    AstModule* module = new AstModule("test3");
+    thread_pochiVMContext->m_curModule = module;
+    ReleaseAssert(!module->Deserialize(data.data(), data.size() - 1));
+    ReleaseAssert(thread_errorContext->HasError());
+    // The functions deserialized before the error are removed
+    //
+    ReleaseAssert(module->GetNumFunctions() == 0);
+    delete module;
+}
+
+TEST(TestFastInterp, ModuleDeserializationWithoutBuilding)
+{
+    // The module is built and serialized by a child process, so this process deserializes it
+    // without having built it, as a process loading a saved module would
+    //
+    using FnPrototype = int(*)(int);
+    int fds[2];
+    ReleaseAssert(pipe(fds) == 0);
+    pid_t pid = fork();
+    ReleaseAssert(pid >= 0);
+    if (pid == 0)
+    {
+        close(fds[0]);
+        {
+            AutoThreadPochiVMContext apv;
+            AutoThreadErrorContext arc;
+
+            thread_pochiVMContext->m_curModule = new AstModule("test");
+            auto [fn, n] = NewFunction<FnPrototype>("testfn");
+            auto s = fn.NewVariable<int>();
+            auto i = fn.NewVariable<int>();
+            fn.SetBody(
+                    Declare(s, Literal<int>(0)),
+                    For(Declare(i, Literal<int>(0)), i <= n, Increment(i)).Do(
+                        Assign(s, s + CallFreeFn::FreeFnRecursive(i))
+                    ),
+                    Return(s)
+            );
+            std::vector<uint8_t> data;
+            ReleaseAssert(thread_pochiVMContext->m_curModule->Serialize(data));
+            delete thread_pochiVMContext->m_curModule;
+
+            size_t written = 0;
+            while (written < data.size())
+            {
+                ssize_t r = write(fds[1], data.data() + written, data.size() - written);
+                ReleaseAssert(r > 0);
+                written += static_cast<size_t>(r);
+            }
+        }
+        close(fds[1]);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    std::vector<uint8_t> data;
+    uint8_t buf[4096];
+    while (true)
+    {
+        ssize_t r = read(fds[0], buf, sizeof(buf));
+        ReleaseAssert(r >= 0);
+        if (r == 0) { break; }
+        data.insert(data.end(), buf, buf + r);
+    }
+    close(fds[0]);
+    int status;
+    ReleaseAssert(waitpid(pid, &status, 0) == pid);
+    ReleaseAssert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    ReleaseAssert(data.size() > 0);
+
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Deserialize(data.data(), data.size()));
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Validate());
+    thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+
+    FastInterpFunction<FnPrototype> interpFn = thread_pochiVMContext->m_curModule->
+                           GetFastInterpGeneratedFunction<FnPrototype>("testfn");
+    int expected = 0;
+    for (int n = 0; n <= 20; n++)
+    {
+        expected += FreeFnRecursive(n);
+        ReleaseAssert(interpFn(n) == expected);
+    }
+}
+
+TEST(TestFastInterp, GeneratorYield)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+
+    {
+        auto [gen, n] = NewGenerator<int, void(*)(int)>("gen", "n");
+        auto i = gen.NewVariable<int>("i");
+        auto j = gen.NewVariable<int>("j");
+        gen.SetBody(
+                For(Declare(i, Literal<int>(0)), i < n, Increment(i)).Do(
+                    If(i % Literal<int>(2) == Literal<int>(0)).Then(
+                        Yield(i)
+                    ).Else(
+                        If(i > Literal<int>(10)).Then(Return())
+                    )
+                ),
+                Declare(j, n),
+                While(j > Literal<int>(0)).Do(
+                    Yield(j * j),
+                    Assign(j, j - Literal<int>(1))
+                )
+        );
+    }
+    {
+        // A consumer in generated code, pulling the values lazily
+        //
+        auto [fn, state, n] = NewFunction<int(*)(uintptr_t, int)>("consume");
+        auto x = fn.NewVariable<int>();
+        auto s = fn.NewVariable<int>();
+        fn.SetBody(
+                Call<void(*)(uintptr_t, int)>("gen", state, n),
+                Declare(x),
+                Declare(s, Literal<int>(0)),
+                While(Call<bool(*)(uintptr_t, int*)>("gen_next", state, x.Addr())).Do(
+                    Assign(s, s * Literal<int>(3) + x)
+                ),
+                Return(s)
+        );
+    }
+
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Validate());
+    ReleaseAssert(!thread_errorContext->HasError());
+    AstFunction* gen = thread_pochiVMContext->m_curModule->GetAstFunction("gen");
+    ReleaseAssert(gen->IsGeneratorLowered());
+    std::vector<uint64_t> stateBuf(gen->GetGeneratorStateSize() / sizeof(uint64_t));
+    uintptr_t state = reinterpret_cast<uintptr_t>(stateBuf.data());
+
+    thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+    thread_pochiVMContext->m_curModule->EmitIR();
+    thread_pochiVMContext->m_curModule->OptimizeIRIfNotDebugMode(2 /*optLevel*/);
+
+    SimpleJIT jit;
+    jit.SetModule(thread_pochiVMContext->m_curModule);
+
+    auto expectedValues = [](int n) -> std::vector<int>
+    {
+        std::vector<int> result;
+        for (int i = 0; i < n; i++)
+        {
+            if (i % 2 == 0) { result.push_back(i); }
+            else if (i > 10) { return result; }
+        }
+        for (int j = n; j > 0; j--) { result.push_back(j * j); }
+        return result;
+    };
+
+    using InitFn = void(*)(uintptr_t, int);
+    using NextFn = bool(*)(uintptr_t, int*);
+    using ConsumeFn = int(*)(uintptr_t, int);
+    FastInterpFunction<InitFn> interpInit = thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<InitFn>("gen");
+    FastInterpFunction<NextFn> interpNext = thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<NextFn>("gen_next");
+    FastInterpFunction<ConsumeFn> interpConsume = thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<ConsumeFn>("consume");
+    InitFn jitInit = jit.GetFunction<InitFn>("gen");
+    NextFn jitNext = jit.GetFunction<NextFn>("gen_next");
+    ConsumeFn jitConsume = jit.GetFunction<ConsumeFn>("consume");
+    for (int n = 0; n <= 15; n++)
+    {
+        std::vector<int> expected = expectedValues(n);
+        int expectedSum = 0;
+        for (int v : expected) { expectedSum = expectedSum * 3 + v; }
+
+        for (int k = 0; k < 2; k++)
+        {
+            if (k == 0) { interpInit(state, n); } else { jitInit(state, n); }
+            std::vector<int> actual;
+            int value;
+            while (k == 0 ? interpNext(state, &value) : jitNext(state, &value))
+            {
+                actual.push_back(value);
+            }
+            ReleaseAssert(actual == expected);
+            // A finished generator stays finished
+            //
+            ReleaseAssert(!(k == 0 ? interpNext(state, &value) : jitNext(state, &value)));
+        }
+        ReleaseAssert(interpConsume(state, n) == expectedSum);
+        ReleaseAssert(jitConsume(state, n) == expectedSum);
+    }
+}
+
+TEST(TestFastInterp, AtomicOperations)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+
+    {
+        auto [fn, p, q] = NewFunction<uint64_t(*)(uint64_t*, uint32_t*)>("ops");
+        auto r = fn.NewVariable<uint64_t>();
+        fn.SetBody(
+                AtomicStore(p, Literal<uint64_t>(10), std::memory_order_release),
+                Declare(r, AtomicFetchAdd(p, Literal<uint64_t>(5))),
+                Assign(r, r * Literal<uint64_t>(100) + AtomicFetchSub(p, Literal<uint64_t>(3), std::memory_order_relaxed)),
+                // fails, *p is 12
+                //
+                Assign(r, r * Literal<uint64_t>(100) + AtomicCompareExchange(p, Literal<uint64_t>(11), Literal<uint64_t>(20))),
+                // succeeds
+                //
+                Assign(r, r * Literal<uint64_t>(100) + AtomicCompareExchange(p, Literal<uint64_t>(12), Literal<uint64_t>(7), std::memory_order_acq_rel)),
+                Fence(),
+                Fence(std::memory_order_acquire),
+                Assign(r, r * Literal<uint64_t>(100) + StaticCast<uint64_t>(AtomicFetchOr(q, Literal<uint32_t>(6)))),
+                Assign(r, r * Literal<uint64_t>(100) + StaticCast<uint64_t>(AtomicFetchAnd(q, Literal<uint32_t>(5), std::memory_order_acquire))),
+                Return(r * Literal<uint64_t>(100) + AtomicLoad(p, std::memory_order_acquire) + StaticCast<uint64_t>(AtomicLoad(q)))
+        );
+    }
+    {
+        auto [fn, slot, expected, desired] = NewFunction<int32_t*(*)(int32_t**, int32_t*, int32_t*)>("cas_ptr");
+        fn.SetBody(
+                Return(AtomicCompareExchange(slot, expected, desired))
+        );
+    }
+    {
+        // Each iteration increments 'counter' with a fetch-add, and 'cursor' with a compare-exchange loop
+        //
+        auto [fn, counter, cursor, n] = NewFunction<void(*)(uint64_t*, uint64_t*, int)>("worker");
+        auto i = fn.NewVariable<int>();
+        auto ignored = fn.NewVariable<uint64_t>();
+        auto old = fn.NewVariable<uint64_t>();
+        fn.SetBody(
+                For(Declare(i, Literal<int>(0)), i < n, Increment(i)).Do(
+                    Declare(ignored, AtomicFetchAdd(counter, Literal<uint64_t>(1), std::memory_order_relaxed)),
+                    Declare(old, AtomicLoad(cursor, std::memory_order_relaxed)),
+                    While(AtomicCompareExchange(cursor, old, old + Literal<uint64_t>(1)) != old).Do(
+                        Assign(old, AtomicLoad(cursor, std::memory_order_relaxed))
+                    )
+                )
+        );
+    }
+
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Validate());
+    ReleaseAssert(!thread_errorContext->HasError());
+    thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+    thread_pochiVMContext->m_curModule->EmitIR();
+    thread_pochiVMContext->m_curModule->OptimizeIRIfNotDebugMode(2 /*optLevel*/);
+
+    SimpleJIT jit;
+    jit.SetModule(thread_pochiVMContext->m_curModule);
+
+    using OpsFn = uint64_t(*)(uint64_t*, uint32_t*);
+    using CasPtrFn = int32_t*(*)(int32_t**, int32_t*, int32_t*);
+    using WorkerFn = void(*)(uint64_t*, uint64_t*, int);
+
+    std::function<uint64_t(uint64_t*, uint32_t*)> opsFns[2] = {
+        thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<OpsFn>("ops"),
+        jit.GetFunction<OpsFn>("ops")
+    };
+    for (auto& ops : opsFns)
+    {
+        uint64_t p = 0;
+        uint32_t q = 3;
+        ReleaseAssert(ops(&p, &q) == 10151212030712ULL);
+        ReleaseAssert(p == 7 && q == 5);
+    }
+
+    std::function<int32_t*(int32_t**, int32_t*, int32_t*)> casPtrFns[2] = {
+        thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<CasPtrFn>("cas_ptr"),
+        jit.GetFunction<CasPtrFn>("cas_ptr")
+    };
+    for (auto& casPtr : casPtrFns)
+    {
+        int32_t a, b;
+        int32_t* slot = &a;
+        ReleaseAssert(casPtr(&slot, &b, nullptr) == &a && slot == &a);
+        ReleaseAssert(casPtr(&slot, &a, &b) == &a && slot == &b);
+    }
+
+    std::function<void(uint64_t*, uint64_t*, int)> workerFns[2] = {
+        thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<WorkerFn>("worker"),
+        jit.GetFunction<WorkerFn>("worker")
+    };
+    const int numThreads = 4;
+    const int numIterations = 20000;
+    uint64_t counter = 0;
+    uint64_t cursor = 0;
+    std::vector<std::thread> threads;
+    for (int k = 0; k < numThreads; k++)
+    {
+        // Half of the threads run the FastInterp version, the other half the LLVM version
+        //
+        std::function<void(uint64_t*, uint64_t*, int)> worker = workerFns[k % 2];
+        threads.push_back(std::thread([worker, &counter, &cursor]() {
+            worker(&counter, &cursor, numIterations);
+        }));
+    }
+    for (std::thread& th : threads)
+    {
+        th.join();
+    }
+    ReleaseAssert(counter == static_cast<uint64_t>(numThreads * numIterations));
+    ReleaseAssert(cursor == static_cast<uint64_t>(numThreads * numIterations));
+}
+
+namespace {
+
+template<typename T>
+void BuildBitIntrinsicTestFunctions(const std::string& suffix)
+{
+    using UnaryFn = T(*)(T);
+    using BinaryFn = T(*)(T, T);
+    using Crc32Fn = uint32_t(*)(uint32_t, T);
+    {
+        auto [fn, x] = NewFunction<UnaryFn>("popcount_" + suffix);
+        fn.SetBody(Return(PopCount(x)));
+    }
+    {
+        auto [fn, x] = NewFunction<UnaryFn>("clz_" + suffix);
+        fn.SetBody(Return(CountLeadingZeros(x)));
+    }
+    {
+        auto [fn, x] = NewFunction<UnaryFn>("ctz_" + suffix);
+        fn.SetBody(Return(CountTrailingZeros(x)));
+    }
+    {
+        auto [fn, x] = NewFunction<UnaryFn>("bswap_" + suffix);
+        fn.SetBody(Return(ByteSwap(x)));
+    }
+    {
+        auto [fn, x, y] = NewFunction<BinaryFn>("rotl_" + suffix);
+        fn.SetBody(Return(RotateLeft(x, y)));
+    }
+    {
+        auto [fn, x, y] = NewFunction<BinaryFn>("rotr_" + suffix);
+        fn.SetBody(Return(RotateRight(x, y)));
+    }
+    {
+        auto [fn, x, y] = NewFunction<BinaryFn>("mulhi_" + suffix);
+        fn.SetBody(Return(MulHi(x, y)));
+    }
+    {
+        auto [fn, crc, x] = NewFunction<Crc32Fn>("crc32_" + suffix);
+        fn.SetBody(Return(Crc32(crc, x)));
+    }
+}
+
+// Returns the debug interpreter, FastInterp and LLVM implementations of a generated function
+//
+template<typename FnPrototype>
+std::vector<std::function<typename std::remove_pointer<FnPrototype>::type>> WARN_UNUSED
+GetBitIntrinsicTestImpls(SimpleJIT& jit, const std::string& name)
+{
+    return {
+        thread_pochiVMContext->m_curModule->GetDebugInterpGeneratedFunction<FnPrototype>(name),
+        thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<FnPrototype>(name),
+        jit.GetFunction<FnPrototype>(name)
+    };
+}
+
+// Checks the generated functions against the C++ implementations on a set of interesting and pseudo-random values
+//
+template<typename T>
+void CheckBitIntrinsicTestFunctions(SimpleJIT& jit, const std::string& suffix)
+{
+    using UnaryFn = T(*)(T);
+    using BinaryFn = T(*)(T, T);
+    using Crc32Fn = uint32_t(*)(uint32_t, T);
+
+    std::vector<T> values {
+        0, 1, 2, 3, 7, 8,
+        std::numeric_limits<T>::max(), std::numeric_limits<T>::min(),
+        static_cast<T>(std::numeric_limits<T>::max() - 1), static_cast<T>(std::numeric_limits<T>::min() + 1)
+    };
+    uint64_t seed = 123456789;
+    for (int i = 0; i < 10; i++)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        values.push_back(static_cast<T>(seed >> 17));
+    }
+
+    auto checkUnary = [&](const std::string& name, T(*expectedFn)(T))
+    {
+        for (auto& fn : GetBitIntrinsicTestImpls<UnaryFn>(jit, name + "_" + suffix))
+        {
+            for (T x : values)
+            {
+                ReleaseAssert(fn(x) == expectedFn(x));
+            }
+        }
+    };
+    auto checkBinary = [&](const std::string& name, T(*expectedFn)(T, T))
+    {
+        for (auto& fn : GetBitIntrinsicTestImpls<BinaryFn>(jit, name + "_" + suffix))
+        {
+            for (T x : values)
+            {
+                for (T y : values)
+                {
+                    ReleaseAssert(fn(x, y) == expectedFn(x, y));
+                }
+            }
+        }
+    };
+
+    checkUnary("popcount", BitIntrinsicPopCount<T>);
+    checkUnary("clz", BitIntrinsicCountLeadingZeros<T>);
+    checkUnary("ctz", BitIntrinsicCountTrailingZeros<T>);
+    checkUnary("bswap", BitIntrinsicByteSwap<T>);
+    checkBinary("rotl", BitIntrinsicRotateLeft<T>);
+    checkBinary("rotr", BitIntrinsicRotateRight<T>);
+    checkBinary("mulhi", BitIntrinsicMulHi<T>);
+    for (auto& fn : GetBitIntrinsicTestImpls<Crc32Fn>(jit, "crc32_" + suffix))
+    {
+        for (T x : values)
+        {
+            ReleaseAssert(fn(0xFFFFFFFFU, x) == BitIntrinsicCrc32(0xFFFFFFFFU, x));
+            ReleaseAssert(fn(static_cast<uint32_t>(seed), x) == BitIntrinsicCrc32(static_cast<uint32_t>(seed), x));
+        }
+    }
+}
+
+}   // anonymous namespace
+
+TEST(TestFastInterp, BitIntrinsics)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+
+    BuildBitIntrinsicTestFunctions<int8_t>("i8");
+    BuildBitIntrinsicTestFunctions<int16_t>("i16");
+    BuildBitIntrinsicTestFunctions<int32_t>("i32");
+    BuildBitIntrinsicTestFunctions<int64_t>("i64");
+    BuildBitIntrinsicTestFunctions<uint8_t>("u8");
+    BuildBitIntrinsicTestFunctions<uint16_t>("u16");
+    BuildBitIntrinsicTestFunctions<uint32_t>("u32");
+    BuildBitIntrinsicTestFunctions<uint64_t>("u64");
+
+    {
+        // The left operands must be kept (or spilled) while the right operands are evaluated
+        //
+        auto [fn, x, y] = NewFunction<uint64_t(*)(uint64_t, uint64_t)>("nested");
+        fn.SetBody(
+                Return(MulHi(x + PopCount(y), RotateRight(x, y * ByteSwap(x))) +
+                       StaticCast<uint64_t>(Crc32(Crc32(StaticCast<uint32_t>(y), x), CountLeadingZeros(y))))
+        );
+    }
+    {
+        // The standard CRC-32C of a string
+        //
+        auto [fn, s] = NewFunction<uint32_t(*)(char*)>("crc32c_str");
+        auto crc = fn.NewVariable<uint32_t>();
+        fn.SetBody(
+                Declare(crc, static_cast<uint32_t>(0xFFFFFFFFU)),
+                While(*s != '\0').Do(
+                    Assign(crc, Crc32(crc, *s)),
+                    Assign(s, s + 1)
+                ),
+                // ~crc
+                //
+                Return(Literal<uint32_t>(0xFFFFFFFFU) - crc)
+        );
+    }
+
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Validate());
+    ReleaseAssert(!thread_errorContext->HasError());
+    thread_pochiVMContext->m_curModule->PrepareForDebugInterp();
+    thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+    thread_pochiVMContext->m_curModule->EmitIR();
+    thread_pochiVMContext->m_curModule->OptimizeIRIfNotDebugMode(2 /*optLevel*/);
+
+    SimpleJIT jit;
+    jit.SetModule(thread_pochiVMContext->m_curModule);
+
+    // A few known values, independent of the C++ implementations
+    //
+    for (auto& fn : GetBitIntrinsicTestImpls<uint64_t(*)(uint64_t)>(jit, "popcount_u64"))
+    {
+        ReleaseAssert(fn(0xFFFF0000FFFF0000ULL) == 32);
+    }
+    for (auto& fn : GetBitIntrinsicTestImpls<uint16_t(*)(uint16_t)>(jit, "clz_u16"))
+    {
+        ReleaseAssert(fn(1) == 15 && fn(0) == 16);
+    }
+    for (auto& fn : GetBitIntrinsicTestImpls<int32_t(*)(int32_t)>(jit, "ctz_i32"))
+    {
+        ReleaseAssert(fn(-8) == 3 && fn(0) == 32);
+    }
+    for (auto& fn : GetBitIntrinsicTestImpls<uint32_t(*)(uint32_t)>(jit, "bswap_u32"))
+    {
+        ReleaseAssert(fn(0x12345678U) == 0x78563412U);
+    }
+    for (auto& fn : GetBitIntrinsicTestImpls<uint8_t(*)(uint8_t, uint8_t)>(jit, "rotl_u8"))
+    {
+        ReleaseAssert(fn(0x81, 1) == 0x03 && fn(0x81, 9) == 0x03);
+    }
+    for (auto& fn : GetBitIntrinsicTestImpls<int16_t(*)(int16_t, int16_t)>(jit, "rotr_i16"))
+    {
+        ReleaseAssert(fn(1, -1) == 2);
+    }
+    for (auto& fn : GetBitIntrinsicTestImpls<uint64_t(*)(uint64_t, uint64_t)>(jit, "mulhi_u64"))
+    {
+        ReleaseAssert(fn(~0ULL, ~0ULL) == ~0ULL - 1);
+    }
+    for (auto& fn : GetBitIntrinsicTestImpls<int8_t(*)(int8_t, int8_t)>(jit, "mulhi_i8"))
+    {
+        ReleaseAssert(fn(-128, 127) == -64 && fn(-1, 1) == -1);
+    }
+    for (auto& fn : GetBitIntrinsicTestImpls<uint32_t(*)(char*)>(jit, "crc32c_str"))
+    {
+        char str[] = "123456789";
+        ReleaseAssert(fn(str) == 0xE3069283U);
+    }
+    for (auto& fn : GetBitIntrinsicTestImpls<uint64_t(*)(uint64_t, uint64_t)>(jit, "nested"))
+    {
+        uint64_t x = 0x123456789ABCDEF0ULL;
+        for (uint64_t y : { 0ULL, 1ULL, 0xFEDCBA9876543210ULL })
+        {
+            uint64_t expected = BitIntrinsicMulHi(x + BitIntrinsicPopCount(y), BitIntrinsicRotateRight(x, y * BitIntrinsicByteSwap(x))) +
+                    BitIntrinsicCrc32(BitIntrinsicCrc32(static_cast<uint32_t>(y), x), BitIntrinsicCountLeadingZeros(y));
+            ReleaseAssert(fn(x, y) == expected);
+        }
+    }
+
+    CheckBitIntrinsicTestFunctions<int8_t>(jit, "i8");
+    CheckBitIntrinsicTestFunctions<int16_t>(jit, "i16");
+    CheckBitIntrinsicTestFunctions<int32_t>(jit, "i32");
+    CheckBitIntrinsicTestFunctions<int64_t>(jit, "i64");
+    CheckBitIntrinsicTestFunctions<uint8_t>(jit, "u8");
+    CheckBitIntrinsicTestFunctions<uint16_t>(jit, "u16");
+    CheckBitIntrinsicTestFunctions<uint32_t>(jit, "u32");
+    CheckBitIntrinsicTestFunctions<uint64_t>(jit, "u64");
+}
+
+TEST(TestFastInterp, BitIntrinsicCrc32SoftwareFallback)
+{
+    // The table-driven implementation must agree with the SSE4.2 instruction
+    //
+    if (BitIntrinsicUseHardwareCrc32())
+    {
+        uint64_t seed = 987654321;
+        uint32_t crc = 0xFFFFFFFFU;
+        for (int i = 0; i < 10000; i++)
+        {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            ReleaseAssert(BitIntrinsicCrc32Software(crc, static_cast<uint8_t>(seed)) == BitIntrinsicCrc32Hardware(crc, static_cast<uint8_t>(seed)));
+            ReleaseAssert(BitIntrinsicCrc32Software(crc, static_cast<int16_t>(seed)) == BitIntrinsicCrc32Hardware(crc, static_cast<int16_t>(seed)));
+            ReleaseAssert(BitIntrinsicCrc32Software(crc, static_cast<uint32_t>(seed)) == BitIntrinsicCrc32Hardware(crc, static_cast<uint32_t>(seed)));
+            ReleaseAssert(BitIntrinsicCrc32Software(crc, static_cast<int64_t>(seed)) == BitIntrinsicCrc32Hardware(crc, static_cast<int64_t>(seed)));
+            crc = static_cast<uint32_t>(seed >> 32);
+        }
+    }
+
+    // Generate code as if the host had no SSE4.2
+    //
+    BitIntrinsicForceSoftwareCrc32(true);
+    ReleaseAssert(!BitIntrinsicUseHardwareCrc32());
+
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+
+    BuildBitIntrinsicTestFunctions<int8_t>("i8");
+    BuildBitIntrinsicTestFunctions<uint16_t>("u16");
+    BuildBitIntrinsicTestFunctions<int32_t>("i32");
+    BuildBitIntrinsicTestFunctions<uint64_t>("u64");
+    {
+        auto [fn, s] = NewFunction<uint32_t(*)(char*)>("crc32c_str");
+        auto crc = fn.NewVariable<uint32_t>();
+        fn.SetBody(
+                Declare(crc, static_cast<uint32_t>(0xFFFFFFFFU)),
+                While(*s != '\0').Do(
+                    Assign(crc, Crc32(crc, *s)),
+                    Assign(s, s + 1)
+                ),
+                Return(Literal<uint32_t>(0xFFFFFFFFU) - crc)
+        );
+    }
+
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Validate());
+    ReleaseAssert(!thread_errorContext->HasError());
+    thread_pochiVMContext->m_curModule->PrepareForDebugInterp();
+    thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+    thread_pochiVMContext->m_curModule->EmitIR();
+    thread_pochiVMContext->m_curModule->OptimizeIRIfNotDebugMode(2 /*optLevel*/);
+
+    SimpleJIT jit;
+    jit.SetModule(thread_pochiVMContext->m_curModule);
+
+    for (auto& fn : GetBitIntrinsicTestImpls<uint32_t(*)(char*)>(jit, "crc32c_str"))
+    {
+        char str[] = "123456789";
+        ReleaseAssert(fn(str) == 0xE3069283U);
+    }
+
+    CheckBitIntrinsicTestFunctions<int8_t>(jit, "i8");
+    CheckBitIntrinsicTestFunctions<uint16_t>(jit, "u16");
+    CheckBitIntrinsicTestFunctions<int32_t>(jit, "i32");
+    CheckBitIntrinsicTestFunctions<uint64_t>(jit, "u64");
+
+    BitIntrinsicForceSoftwareCrc32(false);
+}
+
+TEST(TestFastInterp, TailCalls)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+
+    // Mutual recursion, 'sum_odd' has a larger stack frame than 'sum_even',
+    // so the frame of 'sum_even' must be large enough for both
+    //
+    using SumFn = uint64_t(*)(uint64_t, uint64_t);
+    {
+        auto [fn, n, acc] = NewFunction<SumFn>("sum_even");
+        fn.SetBody(
+                If(n == Literal<uint64_t>(0)).Then(
+                    Return(acc)
+                ),
+                TailCall<SumFn>("sum_odd", n - Literal<uint64_t>(1), acc + n)
+        );
+    }
+    {
+        auto [fn, n, acc] = NewFunction<SumFn>("sum_odd");
+        auto a = fn.NewVariable<uint64_t>();
+        auto b = fn.NewVariable<uint64_t>();
+        auto c = fn.NewVariable<uint64_t>();
+        fn.SetBody(
+                If(n == Literal<uint64_t>(0)).Then(
+                    Return(acc)
+                ),
+                Declare(a, n - Literal<uint64_t>(1)),
+                Declare(b, acc),
+                Declare(c, n),
+                TailCall<SumFn>("sum_even", a, b + c)
+        );
+    }
+    {
+        // The arguments are swapped, so the new parameters must not be stored before all arguments are evaluated
+        //
+        using GcdFn = uint64_t(*)(uint64_t, uint64_t) noexcept;
+        auto [fn, x, y] = NewFunction<GcdFn>("gcd");
+        fn.SetBody(
+                If(y == Literal<uint64_t>(0)).Then(
+                    Return(x)
+                ),
+                TailCall<GcdFn>("gcd", y, x % y)
+        );
+    }
+    {
+        using AddDownFn = void(*)(uint64_t*, uint64_t);
+        auto [fn, out, n] = NewFunction<AddDownFn>("add_down");
+        fn.SetBody(
+                If(n == Literal<uint64_t>(0)).Then(
+                    Return()
+                ),
+                Assign(*out, *out + n),
+                TailCall<AddDownFn>("add_down", out, n - Literal<uint64_t>(1))
+        );
+    }
+    {
+        auto [fn] = NewFunction<int(*)()>("zero_a");
+        fn.SetBody(TailCall<int(*)()>("zero_b"));
+    }
+    {
+        auto [fn] = NewFunction<int(*)()>("zero_b");
+        fn.SetBody(Return(Literal<int>(42)));
+    }
+
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Validate());
+    ReleaseAssert(!thread_errorContext->HasError());
+    thread_pochiVMContext->m_curModule->PrepareForDebugInterp();
+    thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+    thread_pochiVMContext->m_curModule->EmitIR();
+    thread_pochiVMContext->m_curModule->OptimizeIRIfNotDebugMode(2 /*optLevel*/);
+
+    SimpleJIT jit;
+    jit.SetModule(thread_pochiVMContext->m_curModule);
+
+    // The debug interpreter does not reuse stack frames, so only test it with a shallow recursion
+    //
+    {
+        auto fn = thread_pochiVMContext->m_curModule->GetDebugInterpGeneratedFunction<SumFn>("sum_even");
+        ReleaseAssert(fn(100, 0) == 5050);
+    }
+
+    // A recursion this deep overflows the stack unless the stack frame is reused
+    //
+    const uint64_t n = 10000000;
+    std::function<uint64_t(uint64_t, uint64_t)> sumFns[2] = {
+        thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<SumFn>("sum_even"),
+        jit.GetFunction<SumFn>("sum_even")
+    };
+    for (auto& fn : sumFns)
+    {
+        ReleaseAssert(fn(n, 0) == n * (n + 1) / 2);
+        ReleaseAssert(fn(n + 1, 7) == (n + 1) * (n + 2) / 2 + 7);
+    }
+
+    using GcdFn = uint64_t(*)(uint64_t, uint64_t) noexcept;
+    std::function<uint64_t(uint64_t, uint64_t)> gcdFns[3] = {
+        thread_pochiVMContext->m_curModule->GetDebugInterpGeneratedFunction<GcdFn>("gcd"),
+        thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<GcdFn>("gcd"),
+        jit.GetFunction<GcdFn>("gcd")
+    };
+    for (auto& fn : gcdFns)
+    {
+        ReleaseAssert(fn(1071, 462) == 21);
+        ReleaseAssert(fn(462, 1071) == 21);
+        ReleaseAssert(fn(17, 0) == 17);
+    }
+
+    using AddDownFn = void(*)(uint64_t*, uint64_t);
+    std::function<void(uint64_t*, uint64_t)> addDownFns[2] = {
+        thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<AddDownFn>("add_down"),
+        jit.GetFunction<AddDownFn>("add_down")
+    };
+    for (auto& fn : addDownFns)
+    {
+        uint64_t out = 1;
+        fn(&out, n);
+        ReleaseAssert(out == n * (n + 1) / 2 + 1);
+    }
+
+    std::function<int()> zeroFns[3] = {
+        thread_pochiVMContext->m_curModule->GetDebugInterpGeneratedFunction<int(*)()>("zero_a"),
+        thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<int(*)()>("zero_a"),
+        jit.GetFunction<int(*)()>("zero_a")
+    };
+    for (auto& fn : zeroFns)
+    {
+        ReleaseAssert(fn() == 42);
+    }
+}
+
+TEST(TestFastInterp, BatchFunctions)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+
+    using LessFn = bool(*)(int, int) noexcept;
+    {
+        auto [fn, a, b] = NewFunction<LessFn>("less");
+        fn.SetBody(Return(a < b));
+        NewBatchFunction<LessFn>(fn, "less_batch");
+    }
+    using KeyFn = uint64_t(*)(uint64_t);
+    {
+        auto [fn, x] = NewFunction<KeyFn>("key");
+        fn.SetBody(Return(MulHi(x, Literal<uint64_t>(11400714819323198485ULL))));
+        NewBatchFunction<KeyFn>(fn, "key_batch");
+    }
+    using AddToFn = void(*)(uint64_t*, int);
+    {
+        auto [fn, p, v] = NewFunction<AddToFn>("add_to");
+        fn.SetBody(Assign(*p, *p + StaticCast<uint64_t>(v)));
+        NewBatchFunction<AddToFn>(fn, "add_to_batch");
+    }
+
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Validate());
+    ReleaseAssert(!thread_errorContext->HasError());
+    thread_pochiVMContext->m_curModule->PrepareForDebugInterp();
+    thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+    thread_pochiVMContext->m_curModule->EmitIR();
+    thread_pochiVMContext->m_curModule->OptimizeIRIfNotDebugMode(2 /*optLevel*/);
+
+    SimpleJIT jit;
+    jit.SetModule(thread_pochiVMContext->m_curModule);
+
+    static_assert(std::is_same<BatchFunctionPrototype<LessFn>, void(*)(int*, int*, bool*, size_t) noexcept>::value, "");
+    static_assert(std::is_same<BatchFunctionPrototype<KeyFn>, void(*)(uint64_t*, uint64_t*, size_t)>::value, "");
+    static_assert(std::is_same<BatchFunctionPrototype<AddToFn>, void(*)(uint64_t**, int*, size_t)>::value, "");
+
+    const size_t n = 1000;
+    std::vector<int> as, bs;
+    std::vector<uint64_t> xs;
+    for (size_t i = 0; i < n; i++)
+    {
+        as.push_back(static_cast<int>(i * 7 % 100) - 50);
+        bs.push_back(static_cast<int>(i * 13 % 100) - 50);
+        xs.push_back(i * i + 12345);
+    }
+
+    using LessBatchFn = BatchFunctionPrototype<LessFn>;
+    std::function<void(int*, int*, bool*, size_t)> lessFns[3] = {
+        thread_pochiVMContext->m_curModule->GetDebugInterpGeneratedFunction<LessBatchFn>("less_batch"),
+        thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<LessBatchFn>("less_batch"),
+        jit.GetFunction<LessBatchFn>("less_batch")
+    };
+    for (auto& fn : lessFns)
+    {
+        // The element past the end must not be written
+        //
+        bool out[n + 1];
+        out[n] = true;
+        fn(as.data(), bs.data(), out, n);
+        for (size_t i = 0; i < n; i++)
+        {
+            ReleaseAssert(out[i] == (as[i] < bs[i]));
+        }
+        ReleaseAssert(out[n] == true);
+        fn(as.data(), bs.data(), nullptr, 0);
+    }
+
+    using KeyBatchFn = BatchFunctionPrototype<KeyFn>;
+    std::function<void(uint64_t*, uint64_t*, size_t)> keyFns[3] = {
+        thread_pochiVMContext->m_curModule->GetDebugInterpGeneratedFunction<KeyBatchFn>("key_batch"),
+        thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<KeyBatchFn>("key_batch"),
+        jit.GetFunction<KeyBatchFn>("key_batch")
+    };
+    for (auto& fn : keyFns)
+    {
+        std::vector<uint64_t> out(n);
+        fn(xs.data(), out.data(), n);
+        for (size_t i = 0; i < n; i++)
+        {
+            ReleaseAssert(out[i] == static_cast<uint64_t>((static_cast<__uint128_t>(xs[i]) * 11400714819323198485ULL) >> 64));
+        }
+    }
+
+    using AddToBatchFn = BatchFunctionPrototype<AddToFn>;
+    std::function<void(uint64_t**, int*, size_t)> addToFns[3] = {
+        thread_pochiVMContext->m_curModule->GetDebugInterpGeneratedFunction<AddToBatchFn>("add_to_batch"),
+        thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<AddToBatchFn>("add_to_batch"),
+        jit.GetFunction<AddToBatchFn>("add_to_batch")
+    };
+    for (auto& fn : addToFns)
+    {
+        // All elements add to the same counter
+        //
+        uint64_t counter = 0;
+        std::vector<uint64_t*> ptrs(n, &counter);
+        std::vector<int> values;
+        for (size_t i = 0; i < n; i++)
+        {
+            values.push_back(static_cast<int>(i));
+        }
+        fn(ptrs.data(), values.data(), n);
+        ReleaseAssert(counter == n * (n - 1) / 2);
+    }
+}
+
+namespace {
+
+// A queue of modules handed from one thread to another, together with the constant the module was built with
+//
+struct ModuleHandoffQueue
+{
+    void Push(AstModule* module, uint64_t k)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_queue.push_back(std::make_pair(module, k));
+    }
+
+    std::pair<AstModule*, uint64_t> Pop()
+    {
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                if (!m_queue.empty())
+                {
+                    std::pair<AstModule*, uint64_t> ret = m_queue.front();
+                    m_queue.erase(m_queue.begin());
+                    return ret;
+                }
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    std::mutex m_mutex;
+    std::vector<std::pair<AstModule*, uint64_t>> m_queue;
+};
+
+}   // anonymous namespace
+
+TEST(TestFastInterp, ConcurrentModuleHandoff)
+{
+    // Each module is built by three threads in turn: the first one creates it with function 'step',
+    // the second one attaches it and adds 'testfn', the third one attaches it, compiles it and checks the result.
+    // Meanwhile other threads allocate from and free to g_codegenMemoryPool, which also backs the AST arenas,
+    // and check that no chunk is ever handed out twice.
+    //
+    using FnPrototype = uint64_t(*)(uint64_t) noexcept;
+    const int numThreadsPerStage = 4;
+    const int numModulesPerThread = 25;
+    const int numPoolThreads = 4;
+
+    size_t numChunksInUseBefore = g_codegenMemoryPool.GetStats().m_numChunksInUse;
+
+    ModuleHandoffQueue stage1, stage2;
+    std::atomic<bool> stopPoolThreads(false);
+    std::atomic<int> numModulesChecked(0);
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < numThreadsPerStage; t++)
+    {
+        threads.push_back(std::thread([&, t]() {
+            AutoThreadPochiVMContext apv;
+            AutoThreadErrorContext arc;
+            AutoThreadLLVMCodegenContext alc;
+            for (int m = 0; m < numModulesPerThread; m++)
+            {
+                uint64_t k = static_cast<uint64_t>(t * numModulesPerThread + m + 1);
+                NewModule("test");
+                {
+                    auto [fn, x] = NewFunction<FnPrototype>("step");
+                    fn.SetBody(Return(x * Literal<uint64_t>(k) + Literal<uint64_t>(1)));
+                }
+                AstModule* module = DetachModule();
+                ReleaseAssert(thread_pochiVMContext->m_curModule == nullptr);
+                ReleaseAssert(!module->IsAttachedToCurrentThread());
+                stage1.Push(module, k);
+            }
+        }));
+
+        threads.push_back(std::thread([&]() {
+            AutoThreadPochiVMContext apv;
+            AutoThreadErrorContext arc;
+            AutoThreadLLVMCodegenContext alc;
+            for (int m = 0; m < numModulesPerThread; m++)
+            {
+                auto [module, k] = stage1.Pop();
+                AttachModule(module);
+                ReleaseAssert(module->IsAttachedToCurrentThread());
+                {
+                    auto [fn, n] = NewFunction<FnPrototype>("testfn");
+                    auto s = fn.NewVariable<uint64_t>();
+                    auto i = fn.NewVariable<uint64_t>();
+                    fn.SetBody(
+                            Declare(s, Literal<uint64_t>(k)),
+                            For(Declare(i, Literal<uint64_t>(0)), i < n, Increment(i)).Do(
+                                Assign(s, s + Call<FnPrototype>("step", i))
+                            ),
+                            Return(s)
+                    );
+                }
+                stage2.Push(DetachModule(), k);
+            }
+        }));
+
+        threads.push_back(std::thread([&]() {
+            AutoThreadPochiVMContext apv;
+            AutoThreadErrorContext arc;
+            AutoThreadLLVMCodegenContext alc;
+            for (int m = 0; m < numModulesPerThread; m++)
+            {
+                auto [module, k] = stage2.Pop();
+                AttachModule(module);
+                ReleaseAssert(module->Validate());
+                ReleaseAssert(!thread_errorContext->HasError());
+                module->PrepareForFastInterp();
+                FastInterpFunction<FnPrototype> interpFn = module->GetFastInterpGeneratedFunction<FnPrototype>("testfn");
+                // s = k + sum(i * k + 1 for i in [0, 100))
+                //
+                ReleaseAssert(interpFn(100) == k + k * 4950 + 100);
+                delete module;
+                ReleaseAssert(thread_pochiVMContext->m_curModule == nullptr);
+                numModulesChecked++;
+            }
+        }));
+    }
+
+    for (int t = 0; t < numPoolThreads; t++)
+    {
+        threads.push_back(std::thread([&, t]() {
+            uint64_t tag = static_cast<uint64_t>(t + 1) << 48;
+            uint64_t iteration = 0;
+            std::vector<uintptr_t> chunks;
+            while (!stopPoolThreads.load())
+            {
+                for (size_t i = 0; i < 8; i++)
+                {
+                    uintptr_t chunk = g_codegenMemoryPool.GetMemoryChunk();
+                    uint64_t* words = reinterpret_cast<uint64_t*>(chunk);
+                    words[0] = tag | iteration;
+                    words[g_codegenMemoryPool.x_memoryChunkSize / sizeof(uint64_t) - 1] = tag | iteration;
+                    chunks.push_back(chunk);
+                }
+                for (uintptr_t chunk : chunks)
+                {
+                    uint64_t* words = reinterpret_cast<uint64_t*>(chunk);
+                    ReleaseAssert(words[0] == (tag | iteration));
+                    ReleaseAssert(words[g_codegenMemoryPool.x_memoryChunkSize / sizeof(uint64_t) - 1] == (tag | iteration));
+                    g_codegenMemoryPool.FreeMemoryChunk(chunk);
+                }
+                chunks.clear();
+                iteration++;
+            }
+        }));
+    }
+
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        if (i == static_cast<size_t>(numThreadsPerStage * 3))
+        {
+            // All module threads have finished, stop the pool threads
+            //
+            stopPoolThreads.store(true);
+        }
+        threads[i].join();
+    }
+
+    ReleaseAssert(numModulesChecked.load() == numThreadsPerStage * numModulesPerThread);
+    ReleaseAssert(stage1.m_queue.empty() && stage2.m_queue.empty());
+    ReleaseAssert(g_codegenMemoryPool.GetStats().m_numChunksInUse == numChunksInUseBefore);
+}
@@ -859,8 +859,8 @@ TEST(TestFastInterpInternal, SanityStackFrameManager_1)
     ReleaseAssert(sfm.PopTemp(TypeId::Get<int>()).IsNoSpill());
     ReleaseAssert(sfm.PopTemp(TypeId::Get<int>()).GetSpillLocation() == 32);
 
-    sfm.PopLocalVar(TypeId::Get<uint64_t>());
-    sfm.PopLocalVar(TypeId::Get<int>());
+    sfm.PopLocalVar(TypeId::Get<uint64_t>(), 16);
+    sfm.PopLocalVar(TypeId::Get<int>(), 8);
 
     ReleaseAssert(sfm.GetFinalStackFrameSize() == 40);
 }
@@ -893,8 +893,249 @@ TEST(TestFastInterpInternal, SanityStackFrameManager_2)
     ReleaseAssert(sfm.PopTemp(TypeId::Get<int>()).GetSpillLocation() == 40);
     ReleaseAssert(sfm.PopTemp(TypeId::Get<int>()).GetSpillLocation() == 32);
 
-    sfm.PopLocalVar(TypeId::Get<uint64_t>());
-    sfm.PopLocalVar(TypeId::Get<int>());
+    sfm.PopLocalVar(TypeId::Get<uint64_t>(), 16);
+    sfm.PopLocalVar(TypeId::Get<int>(), 8);
 
     ReleaseAssert(sfm.GetFinalStackFrameSize() == 80);
 }
+
+TEST(TestFastInterpInternal, SanityStackFrameManager_3)
+{
+    // Compact layout: freed local variables leave holes that are reused by
+    // later local variables and spilled temporaries
+    //
+    for (bool compact : { false, true })
+    {
+        FIStackFrameManager sfm;
+        sfm.SetCompactLayout(compact);
+        ReleaseAssert(sfm.PushLocalVar(TypeId::Get<int>()) == 8);
+        ReleaseAssert(sfm.PushLocalVar(TypeId::Get<uint64_t>()) == 16);
+        ReleaseAssert(sfm.PushLocalVar(TypeId::Get<int>()) == 24);
+        sfm.PopLocalVar(TypeId::Get<uint64_t>(), 16);
+
+        uint64_t offset = sfm.PushLocalVar(TypeId::Get<int>());
+        ReleaseAssert(offset == (compact ? 12 : 28));
+
+        sfm.PushTemp(TypeId::Get<int>(), true /*spill*/);
+        sfm.PushTemp(TypeId::Get<int>(), true /*spill*/);
+        ReleaseAssert(sfm.PopTemp(TypeId::Get<int>()).GetSpillLocation() == (compact ? 32 : 40));
+        ReleaseAssert(sfm.PopTemp(TypeId::Get<int>()).GetSpillLocation() == (compact ? 16 : 32));
+
+        sfm.PopLocalVar(TypeId::Get<int>(), 8);
+        sfm.PopLocalVar(TypeId::Get<int>(), offset);
+        sfm.PopLocalVar(TypeId::Get<int>(), 24);
+
+        ReleaseAssert(sfm.GetFinalStackFrameSize() == (compact ? 40 : 48));
+    }
+}
+
+TEST(TestFastInterpInternal, PeepholeRemoveNoop)
+{
+    // The entry point is a chain of two noops, which should be removed by the peephole pass
+    //
+    FastInterpCodegenEngine engine;
+    FastInterpBoilerplateInstance* noop1 = engine.InstantiateBoilerplate(
+                FastInterpBoilerplateLibrary<FINoopImpl>::SelectBoilerplateBluePrint(
+                    FIOpaqueParamsHelper::GetMaxOIP(),
+                    FIOpaqueParamsHelper::GetMaxOFP()));
+    FastInterpBoilerplateInstance* noop2 = engine.InstantiateBoilerplate(
+                FastInterpBoilerplateLibrary<FINoopImpl>::SelectBoilerplateBluePrint(
+                    FIOpaqueParamsHelper::GetMaxOIP(),
+                    FIOpaqueParamsHelper::GetMaxOFP()));
+    FastInterpBoilerplateInstance* inst = engine.InstantiateBoilerplate(
+                FastInterpBoilerplateLibrary<FIFullyInlinedArithmeticExprImpl>::SelectBoilerplateBluePrint(
+                    TypeId::Get<int>().GetDefaultFastInterpTypeId(),
+                    FISimpleOperandShapeCategory::LITERAL_NONZERO,
+                    FISimpleOperandShapeCategory::LITERAL_NONZERO,
+                    AstArithmeticExprType::ADD,
+                    false /*spillOutput*/,
+                    static_cast<FINumOpaqueIntegralParams>(0),
+                    static_cast<FINumOpaqueFloatingParams>(0)));
+    FastInterpBoilerplateInstance* inst2 = engine.InstantiateBoilerplate(
+                FastInterpBoilerplateLibrary<FIPartialInlineLhsAssignImpl>::SelectBoilerplateBluePrint(
+                    TypeId::Get<int>().GetDefaultFastInterpTypeId(),
+                    TypeId::Get<int32_t>().GetDefaultFastInterpTypeId(),
+                    FIOperandShapeCategory::VARIABLE,
+                    static_cast<FINumOpaqueIntegralParams>(0),
+                    FIOpaqueParamsHelper::GetMaxOFP()));
+    FastInterpBoilerplateInstance* noop3 = engine.InstantiateBoilerplate(
+                FastInterpBoilerplateLibrary<FINoopImpl>::SelectBoilerplateBluePrint(
+                    FIOpaqueParamsHelper::GetMaxOIP(),
+                    FIOpaqueParamsHelper::GetMaxOFP()));
+    FastInterpBoilerplateInstance* inst3 = engine.InstantiateBoilerplate(
+                FastInterpBoilerplateLibrary<FIOutlinedReturnImpl>::SelectBoilerplateBluePrint(
+                    TypeId::Get<void>().GetDefaultFastInterpTypeId(),
+                    true /*isNoExcept*/,
+                    false /*exceptionThrown*/,
+                    static_cast<FINumOpaqueIntegralParams>(0),
+                    static_cast<FINumOpaqueFloatingParams>(0)));
+    noop1->PopulateBoilerplateFnPtrPlaceholder(0, noop2);
+    noop2->PopulateBoilerplateFnPtrPlaceholder(0, inst);
+    inst->PopulateBoilerplateFnPtrPlaceholder(0, inst2);
+    inst->PopulateConstantPlaceholder<int>(1, 123);
+    inst->PopulateConstantPlaceholder<int>(2, 456);
+    inst2->PopulateBoilerplateFnPtrPlaceholder(0, noop3);
+    inst2->PopulateConstantPlaceholder<uint64_t>(0, 0, true);
+    noop3->PopulateBoilerplateFnPtrPlaceholder(0, inst3);
+
+    engine.TestOnly_RegisterUnitTestFunctionEntryPoint(TypeId::Get<void>().GetDefaultFastInterpTypeId(), true, 233, noop1);
+    std::unique_ptr<FastInterpGeneratedProgram> gp = engine.Materialize();
+
+    const FastInterpPeepholeStats& stats = engine.GetPeepholeStats();
+    ReleaseAssert(stats.m_numInstancesRemoved == 3);
+    ReleaseAssert(stats.m_numBytesRemoved > 0);
+    // the cdecl wrapper jump to 'noop1', and 'inst2' jump to 'noop3'
+    //
+    ReleaseAssert(stats.m_numJumpsThreaded == 2);
+
+    void* fnPtrVoid = gp->GetGeneratedFunctionAddress(reinterpret_cast<AstFunction*>(233));
+    ReleaseAssert(fnPtrVoid != nullptr);
+    using FnType = void(*)(uintptr_t);
+    FnType fnPtr = reinterpret_cast<FnType>(fnPtrVoid);
+
+    int result = 233;
+    fnPtr(reinterpret_cast<uintptr_t>(&result));
+    ReleaseAssert(result == 123 + 456);
+}
+
+TEST(TestFastInterpInternal, ColdPathLayout)
+{
+    // return (n <= 10) ? 1 : 2, where the 'else' branch is a cold path.
+    // The 'else' branch enters the cold path through a noop, and leaves it through another noop
+    // which jumps to the return shared with the hot path. Both noops are removed by the peephole pass.
+    // The cold mark of the first noop is transferred to its target, but the shared return must stay hot.
+    //
+    for (bool coldPathLayout : { false, true })
+    {
+        FastInterpCodegenEngine engine;
+        engine.SetColdPathLayoutEnabled(coldPathLayout);
+
+        // stack frame: n @ 8
+        //
+        FastInterpBoilerplateInstance* cmp = engine.InstantiateBoilerplate(
+                    FastInterpBoilerplateLibrary<FIFullyInlinedComparisonFavourTrueBranchImpl>::SelectBoilerplateBluePrint(
+                        TypeId::Get<int>().GetDefaultFastInterpTypeId(),
+                        TypeId::Get<int32_t>().GetDefaultFastInterpTypeId(),
+                        TypeId::Get<int32_t>().GetDefaultFastInterpTypeId(),
+                        FIOperandShapeCategory::VARIABLE,
+                        FIOperandShapeCategory::LITERAL_NONZERO,
+                        FIOpaqueParamsHelper::GetMaxOIP(),
+                        FIOpaqueParamsHelper::GetMaxOFP(),
+                        AstComparisonExprType::LESS_EQUAL), 4);
+        cmp->PopulateConstantPlaceholder<uint64_t>(0, 8);
+        cmp->PopulateConstantPlaceholder<int>(2, 10);
+
+        FastInterpBoilerplateInstance* litHot = engine.InstantiateBoilerplate(
+                    FastInterpBoilerplateLibrary<FILiteralMcMediumImpl>::SelectBoilerplateBluePrint(
+                        TypeId::Get<uint64_t>().GetOneLevelPtrFastInterpTypeId(),
+                        false /*isAllBitsZero*/,
+                        false /*spillOutput*/,
+                        static_cast<FINumOpaqueIntegralParams>(0),
+                        FIOpaqueParamsHelper::GetMaxOFP()));
+        litHot->PopulateConstantPlaceholder<uint64_t>(1, 1);
+        cmp->PopulateBoilerplateFnPtrPlaceholder(0, litHot);
+
+        FastInterpBoilerplateInstance* coldEntry = engine.InstantiateBoilerplate(
+                    FastInterpBoilerplateLibrary<FINoopImpl>::SelectBoilerplateBluePrint(
+                        FIOpaqueParamsHelper::GetMaxOIP(),
+                        FIOpaqueParamsHelper::GetMaxOFP()));
+        coldEntry->MarkAsColdPathEntry();
+        cmp->PopulateBoilerplateFnPtrPlaceholder(1, coldEntry);
+
+        FastInterpBoilerplateInstance* litCold = engine.InstantiateBoilerplate(
+                    FastInterpBoilerplateLibrary<FILiteralMcMediumImpl>::SelectBoilerplateBluePrint(
+                        TypeId::Get<uint64_t>().GetOneLevelPtrFastInterpTypeId(),
+                        false /*isAllBitsZero*/,
+                        false /*spillOutput*/,
+                        static_cast<FINumOpaqueIntegralParams>(0),
+                        FIOpaqueParamsHelper::GetMaxOFP()));
+        litCold->PopulateConstantPlaceholder<uint64_t>(1, 2);
+        coldEntry->PopulateBoilerplateFnPtrPlaceholder(0, litCold);
+
+        FastInterpBoilerplateInstance* sharedEntry = engine.InstantiateBoilerplate(
+                    FastInterpBoilerplateLibrary<FINoopImpl>::SelectBoilerplateBluePrint(
+                        FIOpaqueParamsHelper::GetMaxOIP(),
+                        FIOpaqueParamsHelper::GetMaxOFP()));
+        sharedEntry->MarkAsColdPathEntry();
+        litCold->PopulateBoilerplateFnPtrPlaceholder(0, sharedEntry);
+
+        FastInterpBoilerplateInstance* ret = engine.InstantiateBoilerplate(
+                    FastInterpBoilerplateLibrary<FIOutlinedReturnImpl>::SelectBoilerplateBluePrint(
+                        TypeId::Get<uint64_t>().GetOneLevelPtrFastInterpTypeId(),
+                        true /*isNoExcept*/,
+                        false /*exceptionThrown*/,
+                        static_cast<FINumOpaqueIntegralParams>(0),
+                        static_cast<FINumOpaqueFloatingParams>(0)));
+        litHot->PopulateBoilerplateFnPtrPlaceholder(0, ret);
+        sharedEntry->PopulateBoilerplateFnPtrPlaceholder(0, ret);
+
+        engine.TestOnly_RegisterUnitTestFunctionEntryPoint(TypeId::Get<uint64_t>().GetDefaultFastInterpTypeId(), true /*isNoExcept*/, 233, cmp);
+        std::unique_ptr<FastInterpGeneratedProgram> gp = engine.Materialize();
+        ReleaseAssert(engine.GetPeepholeStats().m_numInstancesRemoved == 2);
+
+        ReleaseAssert(cmp->TestOnly_IsHot());
+        ReleaseAssert(litHot->TestOnly_IsHot());
+        ReleaseAssert(ret->TestOnly_IsHot());
+        ReleaseAssert(litCold->TestOnly_IsHot() == !coldPathLayout);
+        if (coldPathLayout)
+        {
+            // The cold code is placed after all the hot code
+            //
+            int32_t coldAddr = litCold->TestOnly_GetRelativeCodeAddress();
+            ReleaseAssert(coldAddr > cmp->TestOnly_GetRelativeCodeAddress());
+            ReleaseAssert(coldAddr > litHot->TestOnly_GetRelativeCodeAddress());
+            ReleaseAssert(coldAddr > ret->TestOnly_GetRelativeCodeAddress());
+        }
+
+        void* fnPtrVoid = gp->GetGeneratedFunctionAddress(reinterpret_cast<AstFunction*>(233));
+        using FnProto = uint64_t(*)(uintptr_t);
+        FnProto fn = reinterpret_cast<FnProto>(fnPtrVoid);
+        for (int n = 5; n <= 15; n++)
+        {
+            uint8_t stackFrame[16];
+            *reinterpret_cast<int*>(stackFrame + 8) = n;
+            uint64_t result = fn(reinterpret_cast<uintptr_t>(stackFrame));
+            ReleaseAssert(result == (n <= 10 ? 1U : 2U));
+        }
+    }
+}
+
+TEST(TestFastInterpInternal, InterpStackSanity)
+{
+    FastInterpInterpStack stack(4096 /*segmentSize*/, 4096 * 4 /*maxSize*/);
+
+    FastInterpInterpStack::Position pos1, pos2, pos3, pos4;
+    uintptr_t sf1 = stack.Push(1000, pos1);
+    uintptr_t sf2 = stack.Push(2000, pos2);
+    ReleaseAssert(sf1 % 16 == 0);
+    ReleaseAssert(sf2 % 16 == 0);
+    ReleaseAssert(sf2 >= sf1 + 1000);
+    ReleaseAssert(stack.GetReservedSize() == 4096);
+
+    // Does not fit in the first segment, a new segment is needed
+    //
+    uintptr_t sf3 = stack.Push(2000, pos3);
+    ReleaseAssert(sf3 % 16 == 0);
+    ReleaseAssert(stack.GetReservedSize() == 4096 * 2);
+
+    // Larger than the segment size
+    //
+    uintptr_t sf4 = stack.Push(6000, pos4);
+    ReleaseAssert(sf4 % 16 == 0);
+    ReleaseAssert(stack.GetReservedSize() == 4096 * 4);
+    memset(reinterpret_cast<void*>(sf4), 0, 6000);
+
+    stack.Pop(6000, pos4);
+    stack.Pop(2000, pos3);
+    stack.Pop(2000, pos2);
+
+    // The freed space is reused
+    //
+    uintptr_t sf5 = stack.Push(2000, pos2);
+    ReleaseAssert(sf5 == sf2);
+    stack.Pop(2000, pos2);
+    stack.Pop(1000, pos1);
+
+    ReleaseAssert(stack.GetUsedSize() == 0);
+    ReleaseAssert(stack.GetPeakUsedSize() == 1008 + 2000 + 2000 + 6000);
+}
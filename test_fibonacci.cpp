@@ -46,6 +46,19 @@ TEST(Sanity, FibonacciSeq)
         ReleaseAssert(ret == 6765);
     }
 
+    {
+        // Same, but the stack frame of the entry function is allocated from the interpreter stack
+        //
+        AutoThreadFastInterpInterpStack afis;
+        FastInterpFunction<FnPrototype> interpFn = thread_pochiVMContext->m_curModule->
+                GetFastInterpGeneratedFunction<FnPrototype>("fib_nth");
+
+        uint64_t ret = interpFn(20);
+        ReleaseAssert(ret == 6765);
+        ReleaseAssert(thread_pochiVMFastInterpInterpStack->GetUsedSize() == 0);
+        ReleaseAssert(thread_pochiVMFastInterpInterpStack->GetPeakUsedSize() > 0);
+    }
+
     thread_pochiVMContext->m_curModule->EmitIR();
 
     std::string _dst;
@@ -66,3 +79,56 @@ TEST(Sanity, FibonacciSeq)
         ReleaseAssert(ret == 6765);
     }
 }
+
+TEST(Sanity, FibonacciSeqInterpStackCallFrames)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+
+    using FnPrototype = uint64_t(*)(int) noexcept;
+    auto [fn, n] = NewFunction<FnPrototype>("fib_nth", "n");
+
+    fn.SetBody(
+        If(n <= Literal<int>(2)).Then(
+                Return(Literal<uint64_t>(1))
+        ).Else(
+                Return(Call<FnPrototype>("fib_nth", n - Literal<int>(1))
+                       + Call<FnPrototype>("fib_nth", n - Literal<int>(2)))
+        )
+    );
+
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Validate());
+    thread_pochiVMContext->m_curModule->SetFastInterpCallFramesOnInterpStack(true);
+    thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+
+    FastInterpFunction<FnPrototype> interpFn = thread_pochiVMContext->m_curModule->
+            GetFastInterpGeneratedFunction<FnPrototype>("fib_nth");
+    size_t frameSize = thread_pochiVMContext->m_curModule->GetAstFunction("fib_nth")->GetFastInterpStackFrameSize();
+
+    {
+        // fib_nth(20) recurses down to fib_nth(2), so 19 frames are live at the deepest point.
+        // All of them, not only the entry frame, must be on the interpreter stack.
+        //
+        AutoThreadFastInterpInterpStack afis;
+        uint64_t ret = interpFn(20);
+        ReleaseAssert(ret == 6765);
+        ReleaseAssert(thread_pochiVMFastInterpInterpStack->GetUsedSize() == 0);
+        ReleaseAssert(thread_pochiVMFastInterpInterpStack->GetPeakUsedSize() >= 19 * frameSize);
+
+        // Every frame was popped, so the stack can be reused by the next call
+        //
+        ret = interpFn(10);
+        ReleaseAssert(ret == 55);
+        ReleaseAssert(thread_pochiVMFastInterpInterpStack->GetUsedSize() == 0);
+    }
+
+    // A runaway recursion hits the interpreter stack limit and reports it, instead of overflowing the C stack
+    //
+    ASSERT_DEATH({
+        AutoThreadFastInterpInterpStack afis(4096 /*segmentSize*/, 4096 * 4 /*maxSize*/);
+        std::ignore = interpFn(1000000000);
+    }, "Interpreter stack overflow");
+}
@@ -252,3 +252,83 @@ TEST(SanityGeneratedFunctionPointer, Sanity_3)
         ReleaseAssert(jitFn(123, 456) == 123 + 456);
     }
 }
+
+TEST(SanityGeneratedFunctionPointer, DecodedAndInlineCache)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+
+    using FnPrototype = int(*)(int, int) noexcept;
+    using FnPrototype2 = uintptr_t(*)(bool);
+    {
+        auto [fn, a, b] = NewFunction<FnPrototype>("a_plus_b");
+        fn.SetBody(Return(a + b));
+    }
+    {
+        auto [fn, a, b] = NewFunction<FnPrototype>("a_minus_b");
+        fn.SetBody(Return(a - b));
+    }
+    {
+        auto [fn, isPlus] = NewFunction<FnPrototype2>("get_ptr");
+        fn.SetBody(
+            If(isPlus).Then(
+                Return(GetGeneratedFunctionPointer("a_plus_b"))
+            ),
+            Return(GetGeneratedFunctionPointer("a_minus_b"))
+        );
+    }
+
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Validate());
+    ReleaseAssert(!thread_errorContext->HasError());
+
+    auto testFn = [](uintptr_t plus, uintptr_t minus)
+    {
+        DecodedGeneratedFunctionPointer<FnPrototype> decodedPlus(plus);
+        DecodedGeneratedFunctionPointer<int(*)(int, int)> decodedMinus(minus);
+        ReleaseAssert(decodedPlus.GetControlValue() == plus);
+        ReleaseAssert(decodedPlus(123, 456) == 123 + 456);
+        ReleaseAssert(decodedMinus(123, 456) == 123 - 456);
+
+        GeneratedFunctionPointerCallSite<FnPrototype> callSite;
+        for (int i = 0; i < 10; i++)
+        {
+            uintptr_t target = (i % 4 < 2) ? plus : minus;
+            int expected = (i % 4 < 2) ? (i + 1000) : (i - 1000);
+            ReleaseAssert(callSite(target, i, 1000) == expected);
+        }
+
+        std::vector<int> values { 5, 3, 9, 1, 7 };
+        DecodedGeneratedFunctionPointer<FnPrototype> cmp(minus);
+        std::sort(values.begin(), values.end(), [&](int x, int y) { return cmp(x, y) < 0; });
+        ReleaseAssert(values == std::vector<int>({ 1, 3, 5, 7, 9 }));
+    };
+
+    thread_pochiVMContext->m_curModule->PrepareForDebugInterp();
+    {
+        auto interpFn = thread_pochiVMContext->m_curModule->
+                GetDebugInterpGeneratedFunction<FnPrototype2>("get_ptr");
+        testFn(interpFn(true), interpFn(false));
+    }
+
+    thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+    {
+        FastInterpFunction<FnPrototype2> interpFn = thread_pochiVMContext->m_curModule->
+                               GetFastInterpGeneratedFunction<FnPrototype2>("get_ptr");
+        testFn(interpFn(true), interpFn(false));
+    }
+
+    thread_pochiVMContext->m_curModule->EmitIR();
+    thread_pochiVMContext->m_curModule->OptimizeIRIfNotDebugMode(2 /*optLevel*/);
+
+    SimpleJIT jit;
+    jit.SetAllowResolveSymbolInHostProcess(true);
+    jit.SetModule(thread_pochiVMContext->m_curModule);
+
+    {
+        FnPrototype2 jitFn = jit.GetFunction<FnPrototype2>("get_ptr");
+        testFn(jitFn(true), jitFn(false));
+    }
+}
@@ -5,6 +5,8 @@
 #include "mini_db_backend/query_plan_ast.hpp"
 
 #include "test_util_helper.h"
+#include <optional>
+#include <condition_variable>
 
 using namespace MiniDbBackend;
 using namespace PochiVM;
@@ -104,13 +106,19 @@ TEST(MiniDbBackendUnitTest, SimpleSelect)
     }
 }
 
+// If 'fastInterpInlineThreshold' is non-zero, the FastInterp modules are built with SetFastInterpInlineThreshold().
+// Since the inlining rewrites the AST in place, each backend is run on its own set of modules.
+//
 template<auto buildQueryFn>
-void BenchmarkTpchQuery()
+void BenchmarkTpchQuery(size_t fastInterpInlineThreshold = 0)
 {
     const int numRuns = 10;
     double buildAstTime = 1e100;
-    AstModule* modules[numRuns * 5];
-    for (int i = 0; i < numRuns * 5; i++)
+    // modules [0, 2 * numRuns) are used by FastInterp, [2 * numRuns, 4 * numRuns) by DebugInterp,
+    // and [4 * numRuns, 8 * numRuns) by LLVM
+    //
+    AstModule* modules[numRuns * 8];
+    for (int i = 0; i < numRuns * 8; i++)
     {
         double ts;
         {
@@ -125,25 +133,19 @@ void BenchmarkTpchQuery()
     for (int i = 0; i < numRuns * 2; i++)
     {
         thread_pochiVMContext->m_curModule = modules[i];
+        thread_pochiVMContext->m_curModule->SetFastInterpInlineThreshold(fastInterpInlineThreshold);
         double ts;
         {
             AutoTimer t(&ts);
             thread_pochiVMContext->m_curModule->PrepareForFastInterp();
         }
         fastInterpCodegenTime = std::min(fastInterpCodegenTime, ts);
-        if (i == 0)
-        {
-            // By default when the next module is generated, we delete the previous module
-            // Null it out to prevent it from being deleted.
-            //
-            thread_pochiVMContext->m_fastInterpGeneratedProgram = nullptr;
-        }
     }
 
     double debugInterpCodegenTime = 1e100;
     for (int i = 0; i < numRuns * 2; i++)
     {
-        thread_pochiVMContext->m_curModule = modules[i];
+        thread_pochiVMContext->m_curModule = modules[numRuns * 2 + i];
         double ts;
         {
             AutoTimer t(&ts);
@@ -159,7 +161,7 @@ void BenchmarkTpchQuery()
     {
         for (int i = 0; i < numRuns; i++)
         {
-            thread_pochiVMContext->m_curModule = modules[optLevel * numRuns + i];
+            thread_pochiVMContext->m_curModule = modules[(optLevel + 4) * numRuns + i];
             TestJitHelper* jit;
             double ts;
             {
@@ -213,7 +215,7 @@ void BenchmarkTpchQuery()
     }
 
     double debugInterpPerformance = 1e100;
-    thread_pochiVMContext->m_curModule = modules[0];
+    thread_pochiVMContext->m_curModule = modules[numRuns * 2];
     for (int i = 0; i < numRuns; i++)
     {
         DebugInterpFunction<FnPrototype> debugInterpFn = thread_pochiVMContext->m_curModule->
@@ -258,8 +260,13 @@ void BenchmarkTpchQuery()
            fastInterpPerformance, llvmPerformance[0], llvmPerformance[1], llvmPerformance[2], llvmPerformance[3], debugInterpPerformance);
 }
 
+// If 'fastInterpInlineThreshold' is non-zero, FastInterp is additionally checked on a separate module
+// built with SetFastInterpInlineThreshold()
+//
 template<auto buildQueryFn>
-void CheckTpchQueryCorrectness(const std::string& expectedResult, bool checkDebugInterp = true)
+void CheckTpchQueryCorrectness(const std::string& expectedResult,
+                               bool checkDebugInterp = true,
+                               size_t fastInterpInlineThreshold = 0)
 {
     buildQueryFn();
 
@@ -306,8 +313,25 @@ void CheckTpchQueryCorrectness(const std::string& expectedResult, bool checkDebu
         jitFn(&result);
         ReleaseAssert(expectedResult == result.m_start);
     }
+
+    if (fastInterpInlineThreshold > 0)
+    {
+        buildQueryFn();
+        thread_pochiVMContext->m_curModule->SetFastInterpInlineThreshold(fastInterpInlineThreshold);
+        thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+        FastInterpFunction<FnPrototype> interpFn = thread_pochiVMContext->m_curModule->
+                               GetFastInterpGeneratedFunction<FnPrototype>("execute_query");
+        SqlResultPrinter result;
+        interpFn(&result);
+        ReleaseAssert(expectedResult == result.m_start);
+    }
 }
 
+// The AST node count up to which the hash and compare functions of the hash tables are inlined
+// when FastInterp inlining is tested
+//
+const size_t x_tpchFastInterpInlineThreshold = 100;
+
 namespace
 {
 
@@ -683,7 +707,8 @@ TEST(MiniDbBackendUnitTest, TpchQuery1_Correctness)
         "| N | O | 23232475.000000 | 34817796765.830833 | 33077127289.602264 | 34400024394.849609 | 25.529154 | 38259.759511 | 0.049991 | 910037 |\n"
         "| R | F | 11788252.000000 | 17672163035.450062 | 16787827349.368053 | 17459618619.351471 | 25.495168 | 38220.660065 | 0.050049 | 462372 |\n";
 
-    CheckTpchQueryCorrectness<BuildTpchQuery1>(expectedResult, false /*checkDebugInterp*/);
+    CheckTpchQueryCorrectness<BuildTpchQuery1>(expectedResult, false /*checkDebugInterp*/,
+                                               x_tpchFastInterpInlineThreshold);
 }
 
 TEST(PaperBenchmark, TpchQuery1)
@@ -1540,7 +1565,8 @@ TEST(MiniDbBackendUnitTest, TpchQuery3_Correctness)
         "| 14591234 | 162619.165200 | 794908800 | 0 |\n"
         "| 10786852 | 161931.240100 | 792662400 | 0 |\n";
 
-    CheckTpchQueryCorrectness<BuildTpchQuery3>(expectedResult, false /*checkDebugInterp*/);
+    CheckTpchQueryCorrectness<BuildTpchQuery3>(expectedResult, false /*checkDebugInterp*/,
+                                               x_tpchFastInterpInlineThreshold);
 }
 
 TEST(PaperBenchmark, TpchQuery3)
@@ -1857,7 +1883,8 @@ TEST(MiniDbBackendUnitTest, TpchQuery10_Correctness)
         "| 1099228 | Customer#001099228 | 28067.544000 | 5859.980000 | ALGERIA | STyiULA18QY9wpe79ibbVwk903p9Ff | 10-919-516-9178 | the slyly ironic waters sleep at the somas. regular, ironic hockey players sleep. instructions sleep. re |\n"
         "| 334444 | Customer#000334444 | 11806.294500 | 9919.840000 | ALGERIA | 4P3phxzpTbc4XZ7pTIfx9JNpBZ8Nm,ugh9 | 10-327-401-9058 | use. furiously bold platelets cajole. quickly express requests instead of the quickly close deposits wake fluffily  |\n";
 
-    CheckTpchQueryCorrectness<BuildTpchQuery10>(expectedResult, false /*checkDebugInterp*/);
+    CheckTpchQueryCorrectness<BuildTpchQuery10>(expectedResult, false /*checkDebugInterp*/,
+                                                x_tpchFastInterpInlineThreshold);
 }
 
 TEST(PaperBenchmark, TpchQuery10)
@@ -2189,7 +2216,8 @@ TEST(MiniDbBackendUnitTest, TpchQuery5_Correctness)
 
     std::string expectedResult = "| ALGERIA | 52516.800000 |\n";
 
-    CheckTpchQueryCorrectness<BuildTpchQuery5>(expectedResult, false /*checkDebugInterp*/);
+    CheckTpchQueryCorrectness<BuildTpchQuery5>(expectedResult, false /*checkDebugInterp*/,
+                                               x_tpchFastInterpInlineThreshold);
 }
 
 TEST(PaperBenchmark, TpchQuery5)
@@ -2203,3 +2231,537 @@ TEST(PaperBenchmark, TpchQuery5)
     printf("******* TPCH Query 5 *******\n");
     BenchmarkTpchQuery<BuildTpchQuery5>();
 }
+
+namespace
+{
+
+template<auto buildQueryFn>
+void CompareTpchQueryHashFunctions(const char* queryName)
+{
+    const int numRuns = 10;
+    using FnPrototype = void(*)(SqlResultPrinter*);
+
+    // Index 0 is the original polynomial hash with modulo slot mapping, index 1 is CRC-32C with MulHi
+    //
+    double fastInterpPerformance[2] = { 1e100, 1e100 };
+    double llvmPerformance[2] = { 1e100, 1e100 };
+    std::string results[2];
+    for (int useCrc32 = 0; useCrc32 < 2; useCrc32++)
+    {
+        thread_queryCodegenContext.m_useLegacyHashFn = (useCrc32 == 0);
+        buildQueryFn();
+        thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+        FastInterpFunction<FnPrototype> interpFn = thread_pochiVMContext->m_curModule->
+                GetFastInterpGeneratedFunction<FnPrototype>("execute_query");
+        for (int i = 0; i < numRuns; i++)
+        {
+            double ts;
+            SqlResultPrinter printer;
+            {
+                AutoTimer t(&ts);
+                interpFn(&printer);
+            }
+            fastInterpPerformance[useCrc32] = std::min(fastInterpPerformance[useCrc32], ts);
+            results[useCrc32] = printer.m_start;
+        }
+
+        buildQueryFn();
+        thread_queryCodegenContext.m_useLegacyHashFn = false;
+
+        TestJitHelper jit;
+        thread_pochiVMContext->m_curModule->EmitIR();
+        jit.Init(2 /*optLevel*/);
+        FnPrototype jitFn = jit.GetFunction<FnPrototype>("execute_query");
+        for (int i = 0; i < numRuns; i++)
+        {
+            double ts;
+            SqlResultPrinter printer;
+            {
+                AutoTimer t(&ts);
+                jitFn(&printer);
+            }
+            llvmPerformance[useCrc32] = std::min(llvmPerformance[useCrc32], ts);
+            ReleaseAssert(results[useCrc32] == printer.m_start);
+        }
+    }
+    ReleaseAssert(results[0] == results[1]);
+
+    printf("%-4s FastInterp: %.7lf -> %.7lf    LLVM -O2: %.7lf -> %.7lf\n",
+           queryName, fastInterpPerformance[0], fastInterpPerformance[1], llvmPerformance[0], llvmPerformance[1]);
+}
+
+}   // anonymous namespace
+
+// Execution time of the group-by and hash join queries,
+// with the original hash function (before) and the CRC-32C hash function (after)
+//
+TEST(PaperBenchmark, TpchHashFunctionComparison)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    TpchLoadDatabase();
+
+    CompareTpchQueryHashFunctions<BuildTpchQuery1>("Q1");
+    CompareTpchQueryHashFunctions<BuildTpchQuery3>("Q3");
+    CompareTpchQueryHashFunctions<BuildTpchQuery5>("Q5");
+    CompareTpchQueryHashFunctions<BuildTpchQuery10>("Q10");
+}
+
+namespace
+{
+
+template<auto buildQueryFn>
+void CompareTpchQueryFastInterpInlining(const char* queryName)
+{
+    const int numRuns = 10;
+    using FnPrototype = void(*)(SqlResultPrinter*);
+
+    // Index 0 is without inlining, index 1 is with inlining. Each run uses a freshly built module,
+    // since the inlining rewrites the AST in place.
+    //
+    double codegenTime[2] = { 1e100, 1e100 };
+    double performance[2] = { 1e100, 1e100 };
+    std::string results[2];
+    for (int inlined = 0; inlined < 2; inlined++)
+    {
+        for (int i = 0; i < numRuns; i++)
+        {
+            buildQueryFn();
+            thread_pochiVMContext->m_curModule->SetFastInterpInlineThreshold(
+                        inlined ? x_tpchFastInterpInlineThreshold : 0);
+            double ts;
+            {
+                AutoTimer t(&ts);
+                thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+            }
+            codegenTime[inlined] = std::min(codegenTime[inlined], ts);
+        }
+
+        FastInterpFunction<FnPrototype> interpFn = thread_pochiVMContext->m_curModule->
+                GetFastInterpGeneratedFunction<FnPrototype>("execute_query");
+        for (int i = 0; i < numRuns; i++)
+        {
+            double ts;
+            SqlResultPrinter printer;
+            {
+                AutoTimer t(&ts);
+                interpFn(&printer);
+            }
+            performance[inlined] = std::min(performance[inlined], ts);
+            results[inlined] = printer.m_start;
+        }
+    }
+    ReleaseAssert(results[0] == results[1]);
+
+    printf("%-4s codegen: %.7lf -> %.7lf    execution: %.7lf -> %.7lf\n",
+           queryName, codegenTime[0], codegenTime[1], performance[0], performance[1]);
+}
+
+}   // anonymous namespace
+
+// FastInterp codegen and execution time of the group-by and hash join queries,
+// without (before) and with (after) inlining the hash and compare functions of the hash tables
+//
+TEST(PaperBenchmark, TpchFastInterpInlining)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    TpchLoadDatabase();
+
+    CompareTpchQueryFastInterpInlining<BuildTpchQuery1>("Q1");
+    CompareTpchQueryFastInterpInlining<BuildTpchQuery3>("Q3");
+    CompareTpchQueryFastInterpInlining<BuildTpchQuery5>("Q5");
+    CompareTpchQueryFastInterpInlining<BuildTpchQuery10>("Q10");
+}
+
+namespace
+{
+
+template<auto buildQueryFn>
+void ReportFastInterpStackFrameSize(const char* queryName)
+{
+    uint64_t sizes[2];
+    for (int compact = 0; compact < 2; compact++)
+    {
+        buildQueryFn();
+        thread_pochiVMContext->m_curModule->SetFastInterpCompactStackFrame(compact != 0);
+        thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+        sizes[compact] = thread_pochiVMContext->m_curModule->GetFastInterpTotalStackFrameSize();
+    }
+    printf("%-8s scoped: %6llu bytes, compact: %6llu bytes\n",
+           queryName, static_cast<unsigned long long>(sizes[0]), static_cast<unsigned long long>(sizes[1]));
+    // Releasing slots before the end of their scope must not make the stack frames larger
+    //
+    ReleaseAssert(sizes[1] <= sizes[0]);
+}
+
+}   // anonymous namespace
+
+// Total FastInterp stack frame size of the generated functions,
+// with variables laid out by scope versus by live range
+//
+TEST(MiniDbBackendUnitTest, FastInterpStackFrameSizeReport)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    TpchLoadDatabase();
+
+    ReportFastInterpStackFrameSize<BuildTpchQuery1>("Q1");
+    ReportFastInterpStackFrameSize<BuildTpchQuery3>("Q3");
+    ReportFastInterpStackFrameSize<BuildTpchQuery5>("Q5");
+    ReportFastInterpStackFrameSize<BuildTpchQuery6>("Q6");
+    ReportFastInterpStackFrameSize<BuildTpchQuery10>("Q10");
+    ReportFastInterpStackFrameSize<BuildTpchQuery12>("Q12");
+    ReportFastInterpStackFrameSize<BuildTpchQuery14>("Q14");
+    ReportFastInterpStackFrameSize<BuildTpchQuery19>("Q19");
+}
+
+// The memory limit of QueryExecutionTempAllocator: the error unwinds out of the generated function,
+// and the destructor of the allocator returns all its memory to the pool
+//
+TEST(MiniDbBackendUnitTest, QueryExecutionMemoryLimit)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+
+    using FnPrototype = void(*)(size_t, size_t);
+    {
+        auto [fn, memoryLimit, numAllocations] = NewFunction<FnPrototype>("allocate_with_limit");
+        auto alloc = fn.NewVariable<QueryExecutionTempAllocator>();
+        auto i = fn.NewVariable<size_t>();
+        auto ptr = fn.NewVariable<uintptr_t>();
+        fn.SetBody(
+            Declare(alloc),
+            alloc.SetMemoryLimit(memoryLimit),
+            Declare(ptr, Literal<uintptr_t>(0)),
+            For(Declare(i, Literal<size_t>(0)), i < numAllocations, Increment(i)).Do(
+                Assign(ptr, alloc.Allocate(Literal<size_t>(100000)))
+            )
+        );
+    }
+
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Validate());
+
+    // Two allocations fit in a chunk, so 8 allocations fit in 1MB, and the 9th needs a 5th chunk
+    //
+    const size_t limit = 4 * GlobalCodegenMemoryPool::x_memoryChunkSize;
+    auto checkFn = [&](const std::function<void(size_t, size_t)>& fn)
+    {
+        MemoryPoolStats before = g_queryExecutionMemoryPool.GetStats();
+        fn(limit, 8);
+        fn(0 /*memoryLimit*/, 100);
+        bool thrown = false;
+        try {
+            fn(limit, 9);
+        } catch (MemoryLimitExceededError& e) {
+            thrown = true;
+            ReleaseAssert(e.m_memoryLimit == limit);
+            ReleaseAssert(e.m_bytesInUse == limit);
+            ReleaseAssert(e.m_bytesRequested == GlobalCodegenMemoryPool::x_memoryChunkSize);
+        }
+        ReleaseAssert(thrown);
+        MemoryPoolStats after = g_queryExecutionMemoryPool.GetStats();
+        ReleaseAssert(after.m_bytesInUse == before.m_bytesInUse);
+        ReleaseAssert(after.m_numChunksInUse == before.m_numChunksInUse);
+        ReleaseAssert(after.m_peakBytesInUse >= before.m_bytesInUse + 40 * GlobalCodegenMemoryPool::x_memoryChunkSize);
+    };
+
+    thread_pochiVMContext->m_curModule->PrepareForDebugInterp();
+    checkFn(thread_pochiVMContext->m_curModule->GetDebugInterpGeneratedFunction<FnPrototype>("allocate_with_limit"));
+
+    thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+    checkFn(thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<FnPrototype>("allocate_with_limit"));
+
+    thread_pochiVMContext->m_curModule->EmitIR();
+    thread_pochiVMContext->m_curModule->OptimizeIRIfNotDebugMode(2 /*optLevel*/);
+
+    SimpleJIT jit;
+    jit.SetAllowResolveSymbolInHostProcess(true);
+    jit.SetModule(thread_pochiVMContext->m_curModule);
+    checkFn(jit.GetFunction<FnPrototype>("allocate_with_limit"));
+}
+
+// The accounting of the arena allocators and of the memory pool, including large allocations
+// and the memory limit of the pool
+//
+TEST(MiniDbBackendUnitTest, QueryExecutionMemoryAccounting)
+{
+    const size_t chunkSize = GlobalCodegenMemoryPool::x_memoryChunkSize;
+    MemoryPoolStats poolBefore = g_queryExecutionMemoryPool.GetStats();
+    {
+        QueryExecutionTempAllocator alloc;
+        std::ignore = alloc.Allocate(100);
+        std::ignore = alloc.Allocate(chunkSize);
+        MemoryAllocatorStats stats = alloc.GetStats();
+        ReleaseAssert(stats.m_numChunks == 1);
+        ReleaseAssert(stats.m_numLargeAllocations == 1);
+        ReleaseAssert(stats.m_largeAllocationBytes >= chunkSize);
+        ReleaseAssert(stats.m_bytesInUse == chunkSize + stats.m_largeAllocationBytes);
+
+        MemoryPoolStats pool = g_queryExecutionMemoryPool.GetStats();
+        ReleaseAssert(pool.m_bytesInUse == poolBefore.m_bytesInUse + stats.m_bytesInUse);
+        ReleaseAssert(pool.m_numLargeAllocations == poolBefore.m_numLargeAllocations + 1);
+
+        alloc.Reset();
+        MemoryAllocatorStats statsAfterReset = alloc.GetStats();
+        ReleaseAssert(statsAfterReset.m_bytesInUse == 0);
+        ReleaseAssert(statsAfterReset.m_peakBytesInUse == stats.m_bytesInUse);
+    }
+    ReleaseAssert(g_queryExecutionMemoryPool.GetStats().m_bytesInUse == poolBefore.m_bytesInUse);
+
+    g_queryExecutionMemoryPool.SetMemoryLimit(poolBefore.m_bytesInUse + chunkSize);
+    {
+        QueryExecutionTempAllocator alloc;
+        std::ignore = alloc.Allocate(100);
+        bool thrown = false;
+        try {
+            std::ignore = alloc.Allocate(chunkSize);
+        } catch (std::bad_alloc&) {
+            thrown = true;
+        }
+        ReleaseAssert(thrown);
+        ReleaseAssert(alloc.GetStats().m_bytesInUse == chunkSize);
+    }
+    g_queryExecutionMemoryPool.SetMemoryLimit(0);
+    ReleaseAssert(g_queryExecutionMemoryPool.GetStats().m_bytesInUse == poolBefore.m_bytesInUse);
+}
+
+// Free and Reallocate of the arena allocators, and the reuse of large objects through the pool
+//
+TEST(MiniDbBackendUnitTest, QueryExecutionLargeObjects)
+{
+    const size_t chunkSize = GlobalCodegenMemoryPool::x_memoryChunkSize;
+    MemoryPoolStats poolBefore = g_queryExecutionMemoryPool.GetStats();
+    {
+        QueryExecutionTempAllocator alloc;
+
+        // The last allocation grows and shrinks in place, and its memory is reclaimed by Free
+        //
+        uintptr_t small = alloc.Allocate(80);
+        ReleaseAssert(alloc.Reallocate(small, 80, 4000) == small);
+        ReleaseAssert(alloc.Reallocate(small, 4000, 40) == small);
+        alloc.Free(small, 40);
+        ReleaseAssert(alloc.Allocate(16) == small);
+
+        // A small allocation moves when it becomes a large object, keeping its contents
+        //
+        uintptr_t moved = alloc.Reallocate(small, 16, chunkSize);
+        ReleaseAssert(moved != small && moved % 4096 == 0);
+        reinterpret_cast<uint8_t*>(moved)[chunkSize - 1] = 123;
+
+        // A large object grows in place within its size class
+        //
+        uintptr_t large = alloc.Reallocate(moved, chunkSize, chunkSize * 3 / 2);
+        ReleaseAssert(large != moved);
+        ReleaseAssert(reinterpret_cast<uint8_t*>(large)[chunkSize - 1] == 123);
+        ReleaseAssert(alloc.Reallocate(large, chunkSize * 3 / 2, chunkSize * 2) == large);
+        MemoryAllocatorStats stats = alloc.GetStats();
+        ReleaseAssert(stats.m_numLargeAllocations == 1);
+        ReleaseAssert(stats.m_largeAllocationBytes == chunkSize * 2);
+
+        // A freed large object is reused by the next allocation of its size class
+        //
+        alloc.Free(large, chunkSize * 2);
+        ReleaseAssert(alloc.GetStats().m_numLargeAllocations == 0);
+        size_t cachedBytes = g_queryExecutionMemoryPool.GetStats().m_cachedLargeObjectBytes;
+        ReleaseAssert(cachedBytes >= chunkSize * 2);
+        std::ignore = alloc.Allocate(chunkSize * 2 - 100);
+        ReleaseAssert(g_queryExecutionMemoryPool.GetStats().m_cachedLargeObjectBytes == cachedBytes - chunkSize * 2);
+
+        std::ignore = alloc.Allocate(chunkSize * 100);
+        ReleaseAssert(alloc.GetStats().m_largeAllocationBytes == chunkSize * 2 + chunkSize * 128);
+    }
+    MemoryPoolStats poolAfter = g_queryExecutionMemoryPool.GetStats();
+    ReleaseAssert(poolAfter.m_bytesInUse == poolBefore.m_bytesInUse);
+    ReleaseAssert(poolAfter.m_numLargeAllocations == poolBefore.m_numLargeAllocations);
+
+    {
+        TempArenaAllocator alloc;
+        void* large = alloc.Allocate(64 /*alignment*/, chunkSize * 4);
+        memset(large, 1, chunkSize * 4);
+        void* small = alloc.Reallocate(large, 64 /*alignment*/, chunkSize * 4, 100);
+        ReleaseAssert(reinterpret_cast<uintptr_t>(small) % 64 == 0);
+        ReleaseAssert(reinterpret_cast<uint8_t*>(small)[99] == 1);
+        ReleaseAssert(alloc.GetStats().m_numLargeAllocations == 0);
+    }
+}
+
+// The trim policy of the memory pool: idle memory above the target is only returned once it has stayed there
+// for the delay, large objects first
+//
+TEST(MiniDbBackendUnitTest, MemoryPoolTrim)
+{
+    const size_t chunkSize = GlobalCodegenMemoryPool::x_memoryChunkSize;
+    GlobalCodegenMemoryPool pool;
+    pool.SetTrimPolicy(4 * chunkSize /*targetIdleBytes*/, 100 /*delayMillis*/);
+
+    std::vector<uintptr_t> chunks;
+    for (size_t i = 0; i < 20; i++)
+    {
+        chunks.push_back(pool.GetMemoryChunk());
+    }
+    uintptr_t largeObject = pool.GetLargeObject(chunkSize * 8);
+    for (uintptr_t chunk : chunks)
+    {
+        pool.FreeMemoryChunk(chunk);
+    }
+    pool.FreeLargeObject(largeObject, chunkSize * 8);
+
+    MemoryPoolStats stats = pool.GetStats();
+    ReleaseAssert(stats.m_numFreeChunks == 20 && stats.m_numMappedChunks == 20);
+    ReleaseAssert(stats.m_cachedLargeObjectBytes == chunkSize * 8);
+
+    // The idle memory has not stayed above the target long enough
+    //
+    ReleaseAssert(pool.Trim() == 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    ReleaseAssert(pool.Trim() == chunkSize * 24);
+    stats = pool.GetStats();
+    ReleaseAssert(stats.m_numFreeChunks == 4 && stats.m_numMappedChunks == 4);
+    ReleaseAssert(stats.m_cachedLargeObjectBytes == 0);
+    ReleaseAssert(stats.m_trimmedBytes == chunkSize * 24);
+
+    // At the target, nothing more to trim
+    //
+    ReleaseAssert(pool.Trim(true /*ignoreDelay*/) == 0);
+
+    // The background thread
+    //
+    for (size_t i = 0; i < 20; i++)
+    {
+        chunks[i] = pool.GetMemoryChunk();
+    }
+    for (uintptr_t chunk : chunks)
+    {
+        pool.FreeMemoryChunk(chunk);
+    }
+    pool.SetTrimPolicy(0 /*targetIdleBytes*/, 0 /*delayMillis*/);
+    pool.StartBackgroundTrimming(10 /*intervalMillis*/);
+    for (int i = 0; i < 500 && pool.GetStats().m_numMappedChunks > 0; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ReleaseAssert(pool.GetStats().m_numMappedChunks == 0);
+    pool.StopBackgroundTrimming();
+}
+
+
+TEST(MiniDbBackendUnitTest, MemoryPoolThreadLocalCache)
+{
+    GlobalCodegenMemoryPool pool;
+    pool.SetThreadLocalCacheSize(8);
+
+    // Freed chunks stay in the cache of the thread, and are reused by it
+    //
+    std::vector<uintptr_t> chunks;
+    for (size_t i = 0; i < 4; i++)
+    {
+        chunks.push_back(pool.GetMemoryChunk());
+    }
+    for (uintptr_t chunk : chunks)
+    {
+        pool.FreeMemoryChunk(chunk);
+    }
+    MemoryPoolStats stats = pool.GetStats();
+    ReleaseAssert(stats.m_numFreeChunks == 0 && stats.m_numMappedChunks == 4 && stats.m_numChunksInUse == 0);
+    {
+        std::set<uintptr_t> reused;
+        for (size_t i = 0; i < 4; i++)
+        {
+            reused.insert(pool.GetMemoryChunk());
+        }
+        ReleaseAssert(reused == std::set<uintptr_t>(chunks.begin(), chunks.end()));
+        ReleaseAssert(pool.GetStats().m_numMappedChunks == 4);
+    }
+    for (uintptr_t chunk : chunks)
+    {
+        pool.FreeMemoryChunk(chunk);
+    }
+    pool.FlushThreadLocalCache();
+    stats = pool.GetStats();
+    ReleaseAssert(stats.m_numFreeChunks == 4 && stats.m_numMappedChunks == 4);
+
+    // Another thread refills its cache from the shared free list, returns half of its cache when it is full,
+    // and the rest when it exits
+    //
+    std::thread t([&]() {
+        std::vector<uintptr_t> threadChunks;
+        for (size_t i = 0; i < 9; i++)
+        {
+            threadChunks.push_back(pool.GetMemoryChunk());
+        }
+        MemoryPoolStats s = pool.GetStats();
+        ReleaseAssert(s.m_numFreeChunks == 0 && s.m_numMappedChunks == 9);
+        for (uintptr_t chunk : threadChunks)
+        {
+            pool.FreeMemoryChunk(chunk);
+        }
+        s = pool.GetStats();
+        ReleaseAssert(s.m_numFreeChunks == 4 && s.m_numChunksInUse == 0);
+    });
+    t.join();
+    stats = pool.GetStats();
+    ReleaseAssert(stats.m_numFreeChunks == 9 && stats.m_numMappedChunks == 9 && stats.m_numChunksInUse == 0);
+}
+
+// A pool destroyed while another thread still caches chunks for it takes them back,
+// so neither the exiting thread nor a new pool at the same address sees them
+//
+TEST(MiniDbBackendUnitTest, MemoryPoolDestroyedWithThreadLocalCache)
+{
+    std::optional<GlobalCodegenMemoryPool> pool;
+    pool.emplace();
+    pool->SetThreadLocalCacheSize(8);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    int phase = 0;
+    auto waitForPhase = [&](int value)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return phase == value; });
+    };
+    auto setPhase = [&](int value)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            phase = value;
+        }
+        cv.notify_all();
+    };
+
+    std::thread t([&]() {
+        pool->FreeMemoryChunk(pool->GetMemoryChunk());
+        ReleaseAssert(pool->GetStats().m_numFreeChunks == 0);
+        setPhase(1);
+
+        // The pool has been destroyed and constructed again at the same address:
+        // the new pool must map a new chunk, not hand out the one cached for the old pool
+        //
+        waitForPhase(2);
+        uintptr_t chunk = pool->GetMemoryChunk();
+        ReleaseAssert(pool->GetStats().m_numMappedChunks == 1);
+        pool->FreeMemoryChunk(chunk);
+    });
+
+    waitForPhase(1);
+    GlobalCodegenMemoryPool* oldAddress = &pool.value();
+    pool.reset();
+    pool.emplace();
+    ReleaseAssert(&pool.value() == oldAddress);
+    pool->SetThreadLocalCacheSize(8);
+    setPhase(2);
+
+    t.join();
+    MemoryPoolStats stats = pool->GetStats();
+    ReleaseAssert(stats.m_numFreeChunks == 1 && stats.m_numMappedChunks == 1 && stats.m_numChunksInUse == 0);
+}
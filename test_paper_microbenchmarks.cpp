@@ -4,6 +4,8 @@
 #include "codegen_context.hpp"
 #include "test_util_helper.h"
 #include <random>
+#include <mutex>
+#include <condition_variable>
 
 // Uncomment to enable running paper microbenchmarks
 //
@@ -242,6 +244,42 @@ TEST(PAPER_MICROBENCHMARK_TEST_PREFIX, FibonacciSeq)
            fastInterpPerformance, llvmPerformance[0], llvmPerformance[1], llvmPerformance[2], llvmPerformance[3], debugInterpPerformance);
 }
 
+TEST(PAPER_MICROBENCHMARK_TEST_PREFIX, FibonacciSeqInterpStackCallFrames)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    using namespace PaperMicrobenchmarkFibonacciSequence;
+
+    // Deep recursion with the callee stack frames on the C stack (the default),
+    // and on the interpreter stack (see AstModule::SetFastInterpCallFramesOnInterpStack())
+    //
+    SetupModuleForExecution();
+    TimeFastInterpCodegenTime();
+    double cStackTime = GetBestResultOfRuns([]() {
+        return TimeFastInterpPerformance();
+    }, 3 /*numRuns*/);
+
+    SetupModuleForExecution();
+    thread_pochiVMContext->m_curModule->SetFastInterpCallFramesOnInterpStack(true);
+    TimeFastInterpCodegenTime();
+    double interpStackTime;
+    size_t peakUsedSize;
+    {
+        AutoThreadFastInterpInterpStack afis;
+        interpStackTime = GetBestResultOfRuns([]() {
+            return TimeFastInterpPerformance();
+        }, 3 /*numRuns*/);
+        peakUsedSize = thread_pochiVMFastInterpInterpStack->GetPeakUsedSize();
+    }
+
+    printf("******* Recursion Call Frame Microbenchmark (fib_nth(40)) *******\n");
+    printf("Callee frames on C stack:           %.7lf\n", cStackTime);
+    printf("Callee frames on interpreter stack: %.7lf (%.2lfx)\n", interpStackTime, interpStackTime / cStackTime);
+    printf("Interpreter stack peak usage:       %llu bytes\n", static_cast<unsigned long long>(peakUsedSize));
+}
+
 namespace PaperMicrobenchmarkEulerSieve
 {
 
@@ -1671,6 +1709,100 @@ TEST(PAPER_MICROBENCHMARK_TEST_PREFIX, AMillionIncrement_8)
     TestAMillionIncrementScaling(1000000);
 }
 
+// Report how much the FastInterp peephole pass (see FastInterpCodegenEngine::RunPeepholePass())
+// removes from the programs of the benchmark suite
+//
+TEST(PAPER_MICROBENCHMARK_TEST_PREFIX, PeepholeReport)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+
+    std::vector<std::pair<const char*, std::function<void()>>> benchmarks {
+        { "FibonacciSeq", []() { PaperMicrobenchmarkFibonacciSequence::SetupModuleForExecution(); } },
+        { "EulerSieve", []() { PaperMicrobenchmarkEulerSieve::SetupModuleForExecution(); } },
+        { "QuickSort", []() { PaperMicrobenchmarkQuickSort::SetupModuleForExecution(); } },
+        { "BrainfxxkPrintPrimes", []() { PaperMicrobenchmarkBrainfxxkPrintPrimes::SetupModule(); } },
+        { "BrainfxxkMandelbrot", []() { PaperMicrobenchmarkBrainfxxkMandelbrot::SetupModule(); } },
+        { "AMillionIncrement", []() { PaperMicrobenchmarkAMillionIncrement::SetupModule(10000); } }
+    };
+
+    printf("******* FastInterp Peephole Report *******\n");
+    printf("%-24s %12s %12s %12s\n", "Benchmark", "Instances", "Bytes", "Jumps");
+    printf("------------------------------------------------------------------\n");
+    FastInterpPeepholeStats total;
+    for (auto& benchmark : benchmarks)
+    {
+        benchmark.second();
+        thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+        const FastInterpPeepholeStats& stats = thread_pochiVMContext->m_fastInterpEngine->GetPeepholeStats();
+        printf("%-24s %12llu %12llu %12llu\n", benchmark.first,
+               static_cast<unsigned long long>(stats.m_numInstancesRemoved),
+               static_cast<unsigned long long>(stats.m_numBytesRemoved),
+               static_cast<unsigned long long>(stats.m_numJumpsThreaded));
+        total.m_numInstancesRemoved += stats.m_numInstancesRemoved;
+        total.m_numBytesRemoved += stats.m_numBytesRemoved;
+        total.m_numJumpsThreaded += stats.m_numJumpsThreaded;
+        delete thread_pochiVMContext->m_curModule;
+        thread_pochiVMContext->m_curModule = nullptr;
+    }
+    printf("------------------------------------------------------------------\n");
+    printf("%-24s %12llu %12llu %12llu\n", "Total",
+           static_cast<unsigned long long>(total.m_numInstancesRemoved),
+           static_cast<unsigned long long>(total.m_numBytesRemoved),
+           static_cast<unsigned long long>(total.m_numJumpsThreaded));
+}
+
+// Compare rebuilding a module through the API with deserializing it (see AstModule::Deserialize()).
+// Both include validating the module, so the module is ready to be prepared for a backend.
+//
+TEST(PAPER_MICROBENCHMARK_TEST_PREFIX, ModuleDeserialization)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+
+    std::vector<std::pair<const char*, std::function<void()>>> benchmarks {
+        { "FibonacciSeq (x100)", []() { PaperMicrobenchmarkFibonacciSequence::SetupModuleForCodegenTiming(); } },
+        { "EulerSieve (x100)", []() { PaperMicrobenchmarkEulerSieve::SetupModuleForCodegenTiming(); } },
+        { "AMillionIncrement", []() { PaperMicrobenchmarkAMillionIncrement::SetupModule(100000); } }
+    };
+
+    printf("******* Module Deserialization Microbenchmark *******\n");
+    printf("%-24s %12s %12s %12s %8s\n", "Module", "Bytes", "Rebuild", "Deserialize", "Speedup");
+    printf("------------------------------------------------------------------------\n");
+    for (auto& benchmark : benchmarks)
+    {
+        double rebuildTime = GetBestResultOfRuns([&]() {
+            double ts;
+            {
+                AutoTimer t(&ts);
+                benchmark.second();
+            }
+            delete thread_pochiVMContext->m_curModule;
+            return ts;
+        });
+
+        benchmark.second();
+        std::vector<uint8_t> data;
+        ReleaseAssert(thread_pochiVMContext->m_curModule->Serialize(data));
+        delete thread_pochiVMContext->m_curModule;
+
+        double deserializeTime = GetBestResultOfRuns([&]() {
+            double ts;
+            {
+                AutoTimer t(&ts);
+                thread_pochiVMContext->m_curModule = new AstModule("test");
+                ReleaseAssert(thread_pochiVMContext->m_curModule->Deserialize(data.data(), data.size()));
+                ReleaseAssert(thread_pochiVMContext->m_curModule->Validate());
+            }
+            delete thread_pochiVMContext->m_curModule;
+            return ts;
+        });
+
+        printf("%-24s %12llu %12.7lf %12.7lf %7.2lfx\n", benchmark.first, static_cast<unsigned long long>(data.size()),
+               rebuildTime, deserializeTime, rebuildTime / deserializeTime);
+    }
+}
+
 namespace PaperRegexMiniExample
 {
 
@@ -1842,3 +1974,522 @@ TEST(PAPER_MICROBENCHMARK_TEST_PREFIX, DumpQsortInputFile)
     }
     fclose(fp);
 }
+
+TEST(PAPER_MICROBENCHMARK_TEST_PREFIX, AstArenaAllocation)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    // Build a module with many small statements, then time the traversals and the teardown.
+    // AST nodes are allocated from the module arena (see AstModule::AllocateAstNodeMemory),
+    // or one by one from the heap as a baseline.
+    //
+    const int numFns = 1000;
+    const int numStmtsPerFn = 50;
+    printf("******* AST Arena Allocation Microbenchmark *******\n");
+    for (bool fromHeap : { false, true })
+    {
+        double createTime, traverseTime, validateTime, fastInterpTime, destroyTime;
+        {
+            AutoTimer t(&createTime);
+            NewModule("test");
+            thread_pochiVMContext->m_curModule->SetAllocateAstNodesFromHeap(fromHeap);
+            using FnPrototype = uint64_t(*)(uint64_t) noexcept;
+            for (int i = 0; i < numFns; i++)
+            {
+                auto [fn, n] = NewFunction<FnPrototype>("fn_" + std::to_string(i));
+                auto s = fn.NewVariable<uint64_t>();
+                fn.SetBody(Declare(s, n));
+                Scope body = fn.GetBody();
+                for (int k = 0; k < numStmtsPerFn; k++)
+                {
+                    body.Append(Assign(s, s * Literal<uint64_t>(static_cast<uint64_t>(k) + 3) + (n + Literal<uint64_t>(static_cast<uint64_t>(k)))));
+                }
+                body.Append(Return(s));
+            }
+        }
+
+        AstModule* module = thread_pochiVMContext->m_curModule;
+        size_t numNodes = 0;
+        {
+            AutoTimer t(&traverseTime);
+            for (int i = 0; i < numFns; i++)
+            {
+                module->GetAstFunction("fn_" + std::to_string(i))->TraverseFunctionBody(
+                    [&](AstNodeBase* /*cur*/, AstNodeBase* /*parent*/, FunctionRef<void(void)> Recurse)
+                    {
+                        numNodes++;
+                        Recurse();
+                    });
+            }
+        }
+        {
+            AutoTimer t(&validateTime);
+            ReleaseAssert(module->Validate());
+        }
+        {
+            AutoTimer t(&fastInterpTime);
+            module->PrepareForFastInterp();
+        }
+        {
+            AutoTimer t(&destroyTime);
+            delete module;
+        }
+        ReleaseAssert(thread_pochiVMContext->m_curModule == nullptr);
+
+        double n = static_cast<double>(numNodes);
+        printf("%s: %d functions, %d AST nodes\n", fromHeap ? "Heap (baseline)" : "Arena", numFns, static_cast<int>(numNodes));
+        printf("Create:               %.7lf s (%.1lf ns/node)\n", createTime, createTime / n * 1e9);
+        printf("Traverse:             %.7lf s (%.1lf ns/node)\n", traverseTime, traverseTime / n * 1e9);
+        printf("Validate:             %.7lf s (%.1lf ns/node)\n", validateTime, validateTime / n * 1e9);
+        printf("PrepareForFastInterp: %.7lf s (%.1lf ns/node)\n", fastInterpTime, fastInterpTime / n * 1e9);
+        printf("Destroy:              %.7lf s (%.1lf ns/node)\n", destroyTime, destroyTime / n * 1e9);
+    }
+}
+
+namespace {
+
+struct LargeModuleTimings
+{
+    double m_create;
+    double m_validate;
+    double m_fastInterp;
+    double m_emitIR;
+};
+
+// A chain of 'numFns' functions with the same name prefix, each calling the previous one
+//
+LargeModuleTimings TimeLargeModule(int numFns)
+{
+    LargeModuleTimings result;
+    using FnPrototype = uint64_t(*)(uint64_t) noexcept;
+    {
+        AutoTimer t(&result.m_create);
+        NewModule("test");
+        std::string prevFnName;
+        for (int i = 0; i < numFns; i++)
+        {
+            std::string fnName = thread_pochiVMContext->m_curModule->GetNextAvailableFnName("stress_fn");
+            auto [fn, x] = NewFunction<FnPrototype>(fnName);
+            if (i == 0)
+            {
+                fn.SetBody(Return(x));
+            }
+            else
+            {
+                fn.SetBody(Return(Call<FnPrototype>(prevFnName, x) + Literal<uint64_t>(1)));
+            }
+            prevFnName = fnName;
+        }
+    }
+    AstModule* module = thread_pochiVMContext->m_curModule;
+    ReleaseAssert(module->GetNumFunctions() == static_cast<size_t>(numFns));
+    {
+        AutoTimer t(&result.m_validate);
+        ReleaseAssert(module->Validate());
+    }
+    {
+        AutoTimer t(&result.m_fastInterp);
+        module->PrepareForFastInterp();
+    }
+    {
+        AutoTimer t(&result.m_emitIR);
+        module->EmitIR();
+    }
+    delete module;
+    return result;
+}
+
+}   // anonymous namespace
+
+TEST(PAPER_MICROBENCHMARK_TEST_PREFIX, LargeModuleScalability)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    // The per-function cost of each step should not grow with the number of functions
+    //
+    const int smallSize = 10000;
+    const int largeSize = 100000;
+    LargeModuleTimings small = TimeLargeModule(smallSize);
+    LargeModuleTimings large = TimeLargeModule(largeSize);
+
+    printf("******* Large Module Scalability Microbenchmark *******\n");
+    printf("                      %d fns (us/fn)   %d fns (us/fn)\n", smallSize, largeSize);
+    auto print = [&](const char* name, double smallTime, double largeTime)
+    {
+        printf("%-22s%-17.3lf%-17.3lf\n", name, smallTime / smallSize * 1e6, largeTime / largeSize * 1e6);
+    };
+    print("Create:", small.m_create, large.m_create);
+    print("Validate:", small.m_validate, large.m_validate);
+    print("PrepareForFastInterp:", small.m_fastInterp, large.m_fastInterp);
+    print("EmitIR:", small.m_emitIR, large.m_emitIR);
+
+    // For reference only, not asserted since wall-clock timings are noisy:
+    // the ratio stays close to 1 if a step is linear, and grows to about 10 if it is quadratic
+    //
+    auto printRatio = [&](const char* name, double smallTime, double largeTime)
+    {
+        printf("%-22s%.2lf\n", name, (largeTime / largeSize) / (smallTime / smallSize));
+    };
+    printf("Per-function cost ratio, %d fns vs %d fns:\n", largeSize, smallSize);
+    printRatio("Create:", small.m_create, large.m_create);
+    printRatio("Validate:", small.m_validate, large.m_validate);
+    printRatio("PrepareForFastInterp:", small.m_fastInterp, large.m_fastInterp);
+    printRatio("EmitIR:", small.m_emitIR, large.m_emitIR);
+}
+
+namespace {
+
+// The modules handed to one thread, in the order they were built
+//
+struct ConcurrentCompileQueue
+{
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    // The module and the ordinal of the thread that built it
+    //
+    std::queue<std::pair<AstModule*, int>> m_modules;
+};
+
+// Build a module, hand it to the next thread through its queue, then take the module built by the previous thread
+// from its own queue, and compile and run it. So with more than one thread, no module is compiled by its builder.
+//
+void ConcurrentCompileWorker(int threadOrd, int numThreads, int numModulesPerThread,
+                             std::vector<ConcurrentCompileQueue>& queues)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    using FnPrototype = uint64_t(*)(uint64_t) noexcept;
+    for (int m = 0; m < numModulesPerThread; m++)
+    {
+        uint64_t k = static_cast<uint64_t>(threadOrd * numModulesPerThread + m);
+        NewModule("test");
+        {
+            auto [fn, x] = NewFunction<FnPrototype>("step");
+            fn.SetBody(Return(x * Literal<uint64_t>(k) + Literal<uint64_t>(1)));
+        }
+        {
+            auto [fn, n] = NewFunction<FnPrototype>("testfn");
+            auto s = fn.NewVariable<uint64_t>();
+            auto i = fn.NewVariable<uint64_t>();
+            fn.SetBody(
+                    Declare(s, Literal<uint64_t>(k)),
+                    For(Declare(i, Literal<uint64_t>(0)), i < n, Increment(i)).Do(
+                        Assign(s, s + Call<FnPrototype>("step", i))
+                    ),
+                    Return(s)
+            );
+        }
+        {
+            ConcurrentCompileQueue& nextQueue = queues[static_cast<size_t>((threadOrd + 1) % numThreads)];
+            {
+                std::lock_guard<std::mutex> guard(nextQueue.m_mutex);
+                nextQueue.m_modules.push(std::make_pair(DetachModule(), threadOrd));
+            }
+            nextQueue.m_cv.notify_one();
+            ReleaseAssert(thread_pochiVMContext->m_curModule == nullptr);
+        }
+
+        AstModule* module;
+        int builderOrd;
+        {
+            ConcurrentCompileQueue& ownQueue = queues[static_cast<size_t>(threadOrd)];
+            std::unique_lock<std::mutex> lock(ownQueue.m_mutex);
+            ownQueue.m_cv.wait(lock, [&]() { return !ownQueue.m_modules.empty(); });
+            std::tie(module, builderOrd) = ownQueue.m_modules.front();
+            ownQueue.m_modules.pop();
+        }
+        ReleaseAssert(builderOrd == (threadOrd + numThreads - 1) % numThreads);
+        ReleaseAssert(numThreads == 1 || builderOrd != threadOrd);
+        AttachModule(module);
+
+        ReleaseAssert(module->Validate());
+        module->PrepareForFastInterp();
+        FastInterpFunction<FnPrototype> interpFn = module->GetFastInterpGeneratedFunction<FnPrototype>("testfn");
+        uint64_t interpResult = interpFn(100);
+
+        module->EmitIR();
+        module->OptimizeIRIfNotDebugMode(1 /*optLevel*/);
+        SimpleJIT jit;
+        jit.SetModule(module);
+        FnPrototype jitFn = jit.GetFunction<FnPrototype>("testfn");
+        ReleaseAssert(jitFn(100) == interpResult);
+
+        // The queues are FIFO, so this is the m-th module of the builder: s = k + k * 4950 + 100
+        //
+        uint64_t builderK = static_cast<uint64_t>(builderOrd * numModulesPerThread + m);
+        ReleaseAssert(interpResult == builderK * 4951 + 100);
+        delete module;
+        ReleaseAssert(thread_pochiVMContext->m_curModule == nullptr);
+    }
+}
+
+double TimeConcurrentCompile(int numThreads, int numModulesPerThread)
+{
+    std::vector<ConcurrentCompileQueue> queues(static_cast<size_t>(numThreads));
+    double wallTime;
+    {
+        AutoTimer t(&wallTime);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < numThreads; i++)
+        {
+            threads.push_back(std::thread(ConcurrentCompileWorker, i, numThreads, numModulesPerThread, std::ref(queues)));
+        }
+        for (std::thread& th : threads)
+        {
+            th.join();
+        }
+    }
+    for (ConcurrentCompileQueue& queue : queues)
+    {
+        ReleaseAssert(queue.m_modules.empty());
+    }
+    return wallTime;
+}
+
+}   // anonymous namespace
+
+TEST(PAPER_MICROBENCHMARK_TEST_PREFIX, ConcurrentModuleConstruction)
+{
+    // Each thread builds its own modules and hands each of them to the next thread,
+    // which validates it, generates FastInterp and LLVM code, and checks both agree
+    //
+    const int numModulesPerThread = 20;
+    const int threadCounts[] = { 1, 2, 4, 8, 16, 32 };
+    printf("******* Concurrent Module Construction Microbenchmark *******\n");
+    printf("Hardware concurrency: %u\n", std::thread::hardware_concurrency());
+    double baseThroughput = 0;
+    for (int numThreads : threadCounts)
+    {
+        double wallTime = TimeConcurrentCompile(numThreads, numModulesPerThread);
+        double throughput = static_cast<double>(numThreads * numModulesPerThread) / wallTime;
+        if (numThreads == 1)
+        {
+            baseThroughput = throughput;
+        }
+        printf("%2d threads: %.1lf modules/s (%.2lfx)\n", numThreads, throughput, throughput / baseThroughput);
+    }
+}
+
+namespace PaperMicrobenchmarkBatchInvocation
+{
+
+using KeyFn = uint64_t(*)(uint64_t);
+using KeyBatchFn = BatchFunctionPrototype<KeyFn>;
+
+void SetupModule()
+{
+    thread_pochiVMContext->m_curModule = new AstModule("test");
+    auto [fn, x] = NewFunction<KeyFn>("key", "x");
+    fn.SetBody(Return(MulHi(x + Literal<uint64_t>(0x9E3779B97F4A7C15ULL), Literal<uint64_t>(1000003))));
+    NewBatchFunction<KeyFn>(fn, "key_batch");
+    ReleaseAssert(thread_pochiVMContext->m_curModule->Validate());
+    ReleaseAssert(!thread_errorContext->HasError());
+}
+
+template<typename F>
+double TimePerElementCalls(const F& fn, std::vector<uint64_t>& in, std::vector<uint64_t>& out)
+{
+    double ts;
+    {
+        AutoTimer t(&ts);
+        for (size_t i = 0; i < in.size(); i++)
+        {
+            out[i] = fn(in[i]);
+        }
+    }
+    return ts;
+}
+
+template<typename F>
+double TimeBatchCall(const F& fn, std::vector<uint64_t>& in, std::vector<uint64_t>& out)
+{
+    double ts;
+    {
+        AutoTimer t(&ts);
+        fn(in.data(), out.data(), in.size());
+    }
+    return ts;
+}
+
+}   // namespace PaperMicrobenchmarkBatchInvocation
+
+TEST(PAPER_MICROBENCHMARK_TEST_PREFIX, BatchInvocation)
+{
+    AutoThreadPochiVMContext apv;
+    AutoThreadErrorContext arc;
+    AutoThreadLLVMCodegenContext alc;
+
+    using namespace PaperMicrobenchmarkBatchInvocation;
+
+    SetupModule();
+    thread_pochiVMContext->m_curModule->PrepareForFastInterp();
+    thread_pochiVMContext->m_curModule->EmitIR();
+    thread_pochiVMContext->m_curModule->OptimizeIRIfNotDebugMode(2 /*optLevel*/);
+    SimpleJIT jit;
+    jit.SetModule(thread_pochiVMContext->m_curModule);
+
+    const size_t n = 10000000;
+    std::vector<uint64_t> in, out(n), expected(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        in.push_back(i * 2654435761ULL);
+    }
+
+    FastInterpFunction<KeyFn> interpFn = thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<KeyFn>("key");
+    FastInterpFunction<KeyBatchFn> interpBatchFn = thread_pochiVMContext->m_curModule->GetFastInterpGeneratedFunction<KeyBatchFn>("key_batch");
+    KeyFn jitFn = jit.GetFunction<KeyFn>("key");
+    KeyBatchFn jitBatchFn = jit.GetFunction<KeyBatchFn>("key_batch");
+
+    double interpPerElement = GetBestResultOfRuns([&]() { return TimePerElementCalls(interpFn, in, expected); }, 3 /*numRuns*/);
+    double interpBatch = GetBestResultOfRuns([&]() { return TimeBatchCall(interpBatchFn, in, out); }, 3 /*numRuns*/);
+    ReleaseAssert(out == expected);
+    double jitPerElement = GetBestResultOfRuns([&]() { return TimePerElementCalls(jitFn, in, out); }, 3 /*numRuns*/);
+    ReleaseAssert(out == expected);
+    double jitBatch = GetBestResultOfRuns([&]() { return TimeBatchCall(jitBatchFn, in, out); }, 3 /*numRuns*/);
+    ReleaseAssert(out == expected);
+
+    printf("******* Batch Invocation Microbenchmark (%d elements) *******\n", static_cast<int>(n));
+    printf("FastInterp per-element: %.7lf\n", interpPerElement);
+    printf("FastInterp batch:       %.7lf (%.2lfx)\n", interpBatch, interpPerElement / interpBatch);
+    printf("LLVM per-element:       %.7lf\n", jitPerElement);
+    printf("LLVM batch:             %.7lf (%.2lfx)\n", jitBatch, jitPerElement / jitBatch);
+}
+
+namespace PaperMicrobenchmarkMemoryPool
+{
+
+struct MemoryPoolConfig
+{
+    const char* m_name;
+    MemoryPoolHugePageMode m_hugePageMode;
+    bool m_isNumaAware;
+    size_t m_threadLocalCacheSize;
+};
+
+const MemoryPoolConfig x_memoryPoolConfigs[] = {
+    { "4KB pages, no cache  ", MemoryPoolHugePageMode::None, false, 0 },
+    { "4KB pages, cache     ", MemoryPoolHugePageMode::None, false, 8 },
+    { "THP, cache           ", MemoryPoolHugePageMode::Transparent, false, 8 },
+    { "THP, NUMA, cache     ", MemoryPoolHugePageMode::Transparent, true, 8 },
+    { "hugetlb, NUMA, cache ", MemoryPoolHugePageMode::Explicit, true, 8 }
+};
+
+// Each iteration gets a few chunks, writes to them (as an arena allocator would), then frees them
+//
+void MemoryPoolWorker(GlobalCodegenMemoryPool* pool, int numIterations)
+{
+    const size_t numChunks = 4;
+    uintptr_t chunks[numChunks];
+    for (int iter = 0; iter < numIterations; iter++)
+    {
+        for (size_t i = 0; i < numChunks; i++)
+        {
+            chunks[i] = pool->GetMemoryChunk();
+            ReleaseAssert(chunks[i] % 4096 == 0);
+            *reinterpret_cast<uint64_t*>(chunks[i]) = static_cast<uint64_t>(iter);
+            *reinterpret_cast<uint64_t*>(chunks[i] + GlobalCodegenMemoryPool::x_memoryChunkSize - 8) = i;
+        }
+        for (size_t i = 0; i < numChunks; i++)
+        {
+            ReleaseAssert(*reinterpret_cast<uint64_t*>(chunks[i]) == static_cast<uint64_t>(iter));
+            ReleaseAssert(*reinterpret_cast<uint64_t*>(chunks[i] + GlobalCodegenMemoryPool::x_memoryChunkSize - 8) == i);
+            pool->FreeMemoryChunk(chunks[i]);
+        }
+    }
+}
+
+// If 'trimIntervalMillis' is not 0, a background thread trims all idle memory at that interval
+//
+double TimeMemoryPool(const MemoryPoolConfig& config, int numThreads, int numIterations, uint64_t trimIntervalMillis = 0)
+{
+    GlobalCodegenMemoryPool* pool = new GlobalCodegenMemoryPool();
+    pool->SetHugePageMode(config.m_hugePageMode);
+    pool->SetNumaAware(config.m_isNumaAware);
+    pool->SetThreadLocalCacheSize(config.m_threadLocalCacheSize);
+    if (trimIntervalMillis != 0)
+    {
+        pool->SetTrimPolicy(0 /*targetIdleBytes*/, 0 /*delayMillis*/);
+        pool->StartBackgroundTrimming(trimIntervalMillis);
+    }
+    double wallTime;
+    {
+        AutoTimer t(&wallTime);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < numThreads; i++)
+        {
+            threads.push_back(std::thread(MemoryPoolWorker, pool, numIterations));
+        }
+        for (std::thread& th : threads)
+        {
+            th.join();
+        }
+    }
+    // All threads have exited, so their cached chunks are back in the pool
+    //
+    delete pool;
+    return wallTime;
+}
+
+}   // namespace PaperMicrobenchmarkMemoryPool
+
+TEST(PAPER_MICROBENCHMARK_TEST_PREFIX, MultiThreadedMemoryPool)
+{
+    using namespace PaperMicrobenchmarkMemoryPool;
+
+    const int numIterations = 200000;
+    const int threadCounts[] = { 1, 2, 4, 8, 16 };
+    printf("******* Multi-threaded Memory Pool Microbenchmark (ns per chunk get+free, each thread) *******\n");
+    printf("Hardware concurrency: %u\n", std::thread::hardware_concurrency());
+    for (const MemoryPoolConfig& config : x_memoryPoolConfigs)
+    {
+        printf("%s", config.m_name);
+        for (int numThreads : threadCounts)
+        {
+            double wallTime = TimeMemoryPool(config, numThreads, numIterations);
+            double nsPerOp = wallTime * 1e9 / (static_cast<double>(numIterations) * 4);
+            printf("  %2dT: %6.1lfns", numThreads, nsPerOp);
+        }
+        printf("\n");
+    }
+}
+
+// The latency of the chunk get+free paths while a background thread trims the pool, in the worst case
+// where every trim returns all free chunks to the OS
+//
+TEST(PAPER_MICROBENCHMARK_TEST_PREFIX, MemoryPoolTrimming)
+{
+    using namespace PaperMicrobenchmarkMemoryPool;
+
+    const int numIterations = 200000;
+    const int threadCounts[] = { 1, 4, 16 };
+    const uint64_t trimIntervals[] = { 0, 100, 10, 1 };
+    printf("******* Memory Pool Trimming Microbenchmark (ns per chunk get+free, each thread) *******\n");
+    for (size_t configOrd : { static_cast<size_t>(0), static_cast<size_t>(1) })
+    {
+        const MemoryPoolConfig& config = x_memoryPoolConfigs[configOrd];
+        for (uint64_t trimInterval : trimIntervals)
+        {
+            if (trimInterval == 0)
+            {
+                printf("%s no trimming      ", config.m_name);
+            }
+            else
+            {
+                printf("%s trim every %3llums", config.m_name, static_cast<unsigned long long>(trimInterval));
+            }
+            for (int numThreads : threadCounts)
+            {
+                double wallTime = TimeMemoryPool(config, numThreads, numIterations, trimInterval);
+                double nsPerOp = wallTime * 1e9 / (static_cast<double>(numIterations) * 4);
+                printf("  %2dT: %6.1lfns", numThreads, nsPerOp);
+            }
+            printf("\n");
+        }
+    }
+}
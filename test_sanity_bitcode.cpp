@@ -8,6 +8,7 @@
 
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Linker/Linker.h"
+#include "llvm/Support/Compression.h"
 
 using namespace PochiVM;
 
@@ -20,7 +21,7 @@ std::unique_ptr<Module> GetModuleFromBitcodeStub(const BitcodeData& bc,
                                                  LLVMContext* context)
 {
     SMDiagnostic llvmErr;
-    MemoryBufferRef mb(StringRef(reinterpret_cast<const char*>(bc.m_bitcode), bc.m_length),
+    MemoryBufferRef mb(StringRef(reinterpret_cast<const char*>(bc.GetBitcode()), bc.m_length),
                        StringRef(bc.m_symbolName));
     std::unique_ptr<Module> module = parseIR(mb, llvmErr, *context);
     ReleaseAssert(module != nullptr);
@@ -832,3 +833,116 @@ TEST(SanityBitCode, SanityNotInlinableFunction_3)
         }
     }
 }
+
+TEST(SanityBitCode, BitcodeStubStorage)
+{
+    size_t n = std::extent<decltype(x_all_bitcode_data)>::value;
+    for (size_t i = 0; i < n; i++)
+    {
+        const BitcodeData* bc = x_all_bitcode_data[i];
+#ifdef POCHIVM_COMPRESS_RUNTIME_BITCODE
+        ReleaseAssert(bc->IsCompressed());
+        ReleaseAssert(bc->m_compressedLength < bc->m_length);
+#else
+        ReleaseAssert(!bc->IsCompressed());
+#endif
+        // The bitcode is decompressed only once, and the result is cached
+        //
+        const uint8_t* bitcode = bc->GetBitcode();
+        ReleaseAssert(bitcode == bc->GetBitcode());
+        ReleaseAssert(bc->m_length >= 4);
+        ReleaseAssert(bitcode[0] == 'B' && bitcode[1] == 'C' && bitcode[2] == 0xC0 && bitcode[3] == 0xDE);
+        ReleaseAssert(bitcode[bc->m_length] == 0);
+    }
+
+    // The stubs are still usable after decompression
+    //
+    LLVMContext context;
+    std::unique_ptr<Module> module = GetModuleFromBitcodeStub(__pochivm_internal_bc_fb2d7a235b0bee90ed026467, &context);
+    ReleaseAssert(module->getFunction(__pochivm_internal_bc_fb2d7a235b0bee90ed026467.m_symbolName) != nullptr);
+}
+
+// The stubs are only compressed if the project is built with POCHIVM_COMPRESS_RUNTIME_BITCODE,
+// so also test the decompression path on a hand-built compressed BitcodeData
+//
+TEST(SanityBitCode, DecompressBitcodeStub)
+{
+    if (!zlib::isAvailable())
+    {
+        printf("zlib is not available, test skipped.\n");
+        return;
+    }
+
+    const BitcodeData& original = __pochivm_internal_bc_fb2d7a235b0bee90ed026467;
+    StringRef raw(reinterpret_cast<const char*>(original.GetBitcode()), original.m_length);
+    SmallVector<char, 0> compressed;
+    ReleaseAssert(!zlib::compress(raw, compressed /*out*/));
+    ReleaseAssert(compressed.size() > 0);
+
+    auto check = [&](const uint8_t* bitcode)
+    {
+        ReleaseAssert(bitcode != reinterpret_cast<const uint8_t*>(compressed.data()));
+        ReleaseAssert(memcmp(bitcode, raw.data(), raw.size()) == 0);
+        ReleaseAssert(bitcode[raw.size()] == 0);
+    };
+
+    {
+        BitcodeData bc = {
+            original.m_symbolName,
+            reinterpret_cast<const uint8_t*>(compressed.data()),
+            original.m_length,
+            compressed.size(),
+            nullptr
+        };
+        ReleaseAssert(bc.IsCompressed());
+        const uint8_t* bitcode = bc.GetBitcode();
+        check(bitcode);
+        // Decompressed only once
+        //
+        ReleaseAssert(bc.GetBitcode() == bitcode);
+        ReleaseAssert(bc.m_decompressedBitcode.load() == bitcode);
+
+        LLVMContext context;
+        std::unique_ptr<Module> module = GetModuleFromBitcodeStub(bc, &context);
+        ReleaseAssert(module->getFunction(bc.m_symbolName) != nullptr);
+        delete [] bitcode;
+    }
+
+    // Threads racing to decompress the same stub must all get the one cached result
+    //
+    const int numThreads = 8;
+    const int numRounds = 50;
+    for (int round = 0; round < numRounds; round++)
+    {
+        BitcodeData bc = {
+            original.m_symbolName,
+            reinterpret_cast<const uint8_t*>(compressed.data()),
+            original.m_length,
+            compressed.size(),
+            nullptr
+        };
+        std::atomic<int> numReady(0);
+        std::vector<const uint8_t*> results(numThreads, nullptr);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < numThreads; i++)
+        {
+            threads.push_back(std::thread([&, i]() {
+                numReady.fetch_add(1);
+                while (numReady.load() < numThreads) { }
+                results[static_cast<size_t>(i)] = DecompressBitcodeData(&bc);
+            }));
+        }
+        for (std::thread& t : threads)
+        {
+            t.join();
+        }
+        const uint8_t* bitcode = bc.m_decompressedBitcode.load();
+        ReleaseAssert(bitcode != nullptr);
+        for (const uint8_t* result : results)
+        {
+            ReleaseAssert(result == bitcode);
+        }
+        check(bitcode);
+        delete [] bitcode;
+    }
+}
@@ -194,6 +194,16 @@ public:
         m_astModule = module;
     }
 
+    // JIT the next generation of the current module (see AstModule::StartIncrementalUpdate()).
+    // The modules JIT'ed before are kept, so the new functions may call them.
+    //
+    void AddModule(PochiVM::AstModule* module)
+    {
+        ReleaseAssert(m_jit != nullptr && m_astModule == module);
+        llvm::ExitOnError exitOnErr;
+        exitOnErr(m_jit->addIRModule(module->GetThreadSafeModule()));
+    }
+
     void SetNonAstModule(std::unique_ptr<llvm::orc::ThreadSafeModule> module)
     {
         llvm::ExitOnError exitOnErr;